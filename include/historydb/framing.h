@@ -0,0 +1,106 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#ifndef HISTORY_FRAMING_H
+#define HISTORY_FRAMING_H
+
+#include <stdint.h>
+
+#include <elliptics/utils.hpp>
+
+namespace history { namespace framing {
+
+/* Framed record in daily user log:
+	marker - one byte RECORD_MARKER. Legacy unframed logs are detected by its absence.
+	flags - one byte of record flags
+	length - varint size of the record payload
+	time - varint time of the record: seconds from the begin of the record's day or
+		absolute timestamp (in seconds) if ABSOLUTE_TIME flag is set
+	payload - record data
+*/
+const uint8_t RECORD_MARKER = 0xFE; // can't start text in UTF-8, so text legacy logs are never taken for framed
+const size_t MAX_HEADER_SIZE = 2 + 10 + 10; // marker, flags and two varints
+
+enum record_flags {
+	ABSOLUTE_TIME = 1 << 0 // time is absolute timestamp, it is used for logs with custom keys
+};
+
+/* Record of user log */
+struct record
+{
+	bool framed; // false for legacy data which has been written without framing
+	uint8_t flags; // record flags
+	uint64_t time; // time of the record as it is stored in the header
+	ioremap::elliptics::data_pointer data; // record payload, it shares memory with the iterated log
+
+	/* Returns absolute timestamp of the record (in seconds)
+		day_begin - timestamp of the begin of the daily log's day
+	*/
+	uint64_t timestamp(uint64_t day_begin) const {
+		return (flags & ABSOLUTE_TIME) ? time : day_begin + time;
+	}
+};
+
+/* Packs data into framed record
+	time - timestamp of the record (in seconds)
+	flags - record flags. If ABSOLUTE_TIME isn't set, time is stored as offset from the begin of its day.
+	data - record payload
+	returns header and payload in one buffer
+*/
+ioremap::elliptics::data_pointer pack(uint64_t time, uint8_t flags,
+                                      const ioremap::elliptics::data_pointer &data);
+
+/* Extracts payloads of records from part of user log, so user gets data as it has been appended
+	log - part of user log which starts at record boundary
+	complete - whether the part ends at the end of the log. Otherwise trailing incomplete record isn't unpacked,
+		it should be read again with the next part.
+	consumed - filled with size of the part which has been unpacked
+	returns concatenated payloads of records. Legacy unframed data is returned as is without copying.
+*/
+ioremap::elliptics::data_pointer unpack(const ioremap::elliptics::data_pointer &log, bool complete, size_t &consumed);
+
+/* Extracts payloads of records of whole user log */
+ioremap::elliptics::data_pointer unpack(const ioremap::elliptics::data_pointer &log);
+
+/* Returns size of framed record (header and payload) which starts the data,
+	0 if the data doesn't contain whole header of framed record
+*/
+uint64_t record_size(const ioremap::elliptics::data_pointer &data);
+
+/* Iterates over records of daily user log without copying.
+	Data which doesn't start with valid framed header (legacy log) is returned as one unframed record.
+*/
+class record_iterator
+{
+public:
+	record_iterator(const ioremap::elliptics::data_pointer &log);
+
+	/* Gets next record
+		rec - record which is filled with the next record
+		returns false if there is no more records
+	*/
+	bool next(record &rec);
+
+	size_t offset() const { return offset_; } // offset of the next record in the log
+
+private:
+	ioremap::elliptics::data_pointer	log_; // iterated log
+	size_t								offset_; // offset of the next record
+};
+
+}} /* namespace history::framing */
+
+#endif //HISTORY_FRAMING_H
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#ifndef HISTORY_HISTOGRAM_H
+#define HISTORY_HISTOGRAM_H
+
+#include <atomic>
+#include <stdint.h>
+
+namespace history {
+
+/* Log-linear histogram of latencies in the manner of HDR histogram.
+	Values below 2^SUB_BITS are counted exactly, larger values are counted in buckets whose width is
+	1/2^(SUB_BITS - 1) of their value, so recorded values are kept with relative error below 1.6%
+	in fixed memory for the whole uint64 range.
+	Counters are atomic, so values could be recorded from several threads without locks.
+	If the histogram has only one writer record_exclusive() could be used, it updates counters by plain stores.
+*/
+class histogram
+{
+public:
+	histogram();
+
+	void record(uint64_t value);
+	void record_exclusive(uint64_t value); // the same as record() without atomic read-modify-write, only one thread could record values
+	void add(const histogram &other); // adds values of other histogram
+	void clear();
+
+	uint64_t count() const;
+	uint64_t min() const; // 0 if the histogram is empty
+	uint64_t max() const;
+	double mean() const;
+
+	/* Returns the highest value which is equivalent to the value at specified percentile
+		percentile - percentile in [0, 100]
+	*/
+	uint64_t percentile(double percentile) const;
+
+private:
+	histogram(const histogram&) = delete;
+	histogram& operator=(const histogram&) = delete;
+
+	static const uint32_t SUB_BITS = 7;
+	static const uint32_t SUB_COUNT = 1 << SUB_BITS; // number of exact values
+	static const uint32_t HALF_COUNT = SUB_COUNT / 2; // number of buckets of one power of two
+	static const uint32_t BUCKETS = SUB_COUNT + (64 - SUB_BITS) * HALF_COUNT;
+
+	static uint32_t index(uint64_t value);
+	static uint64_t highest_value(uint32_t index); // the highest value which is counted by the bucket
+
+	std::atomic<uint64_t>	counts_[BUCKETS]; // number of values by buckets
+	std::atomic<uint64_t>	count_; // number of recorded values
+	std::atomic<uint64_t>	sum_; // sum of recorded values
+	std::atomic<uint64_t>	min_; // UINT64_MAX if the histogram is empty
+	std::atomic<uint64_t>	max_;
+};
+
+} /* namespace history */
+
+#endif //HISTORY_HISTOGRAM_H
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#ifndef HISTORY_OPERATION_COUNTERS_H
+#define HISTORY_OPERATION_COUNTERS_H
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <string>
+
+#include <boost/thread/mutex.hpp>
+
+#include "historydb/histogram.h"
+
+namespace history {
+
+/* Snapshot of counters of one operation */
+struct operation_stats
+{
+	std::string				name; // name of the operation
+	uint64_t				count; // number of finished operations
+	uint64_t				errors; // number of failed operations
+	uint64_t				in_flight; // number of operations which have been started but haven't been finished yet
+	uint64_t				bytes; // number of written or read bytes
+	uint64_t				min; // latencies in microseconds
+	double					mean;
+	uint64_t				p50;
+	uint64_t				p90;
+	uint64_t				p99;
+	uint64_t				p999;
+	uint64_t				max;
+	std::map<int, uint64_t>	error_codes; // number of errors by their codes (negative errno of elliptics), unknown codes aren't counted
+};
+
+/* Counters and latency histogram of one operation.
+	Each of the first THREADS threads records into own shard, so recording doesn't need atomic read-modify-write:
+	the only writer updates counters by relaxed loads and stores and stats() sums shards concurrently.
+	Other threads share one more shard which is updated by atomic increments.
+	Shard is allocated by the first operation of the thread, so only threads which run the operation take memory.
+	Only error codes are counted under the lock, because errors are rare.
+*/
+class operation_counters
+{
+public:
+	typedef std::chrono::steady_clock clock_type;
+
+	operation_counters();
+	~operation_counters();
+
+	void start(); // counts operation which is started
+	void finish(uint64_t latency, uint64_t bytes); // counts succeeded operation, latency in microseconds
+	void fail(uint64_t latency, int error); // counts failed operation, error - negative errno or 0 if it is unknown
+
+	operation_stats stats(const std::string &name) const;
+
+private:
+	operation_counters(const operation_counters&) = delete;
+	operation_counters& operator=(const operation_counters&) = delete;
+
+	static const uint32_t THREADS = 128; // number of threads which have own shards
+
+	struct shard
+	{
+		shard();
+
+		histogram				latencies; // also counts finished operations
+		std::atomic<uint64_t>	started;
+		std::atomic<uint64_t>	errors;
+		std::atomic<uint64_t>	bytes;
+	};
+
+	static uint32_t thread_index(); // index of own shard of the calling thread or THREADS for the shared shard
+	shard &get_shard(uint32_t index); // allocates the shard by the first call
+	static void increment(std::atomic<uint64_t> &counter, uint64_t value, bool exclusive);
+
+	std::atomic<shard*>		shards_[THREADS + 1]; // shards by thread indexes, null until the first operation of the thread
+	mutable boost::mutex	mutex_; // protects error_codes_
+	std::map<int, uint64_t>	error_codes_;
+};
+
+/* Measures one operation: counts it as started on creation and records the latency by finish() or fail().
+	If neither has been called the operation is counted as failed on destruction.
+	Timer of async operation could outlive the object which owns counters, so the owner could be kept by the timer.
+*/
+class operation_timer
+{
+public:
+	operation_timer(operation_counters &counters, std::shared_ptr<void> owner = std::shared_ptr<void>());
+	~operation_timer();
+
+	void finish(uint64_t bytes = 0);
+	void fail(int error = 0);
+
+private:
+	operation_timer(const operation_timer&) = delete;
+	operation_timer& operator=(const operation_timer&) = delete;
+
+	uint64_t elapsed() const; // microseconds since the start
+
+	const std::shared_ptr<void>							owner_; // keeps counters_ alive, it could be null
+	operation_counters									&counters_;
+	const operation_counters::clock_type::time_point	start_;
+	bool												recorded_; // whether finish() or fail() has been called
+};
+
+} /* namespace history */
+
+#endif //HISTORY_OPERATION_COUNTERS_H
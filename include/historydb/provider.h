@@ -25,6 +25,10 @@
 
 #include <elliptics/utils.hpp>
 
+#include "historydb/framing.h"
+#include "historydb/operation_counters.h"
+#include "historydb/user_list.h"
+
 namespace history {
 
 struct server_info
@@ -34,6 +38,65 @@ struct server_info
 	int family;
 };
 
+/* Parameters of in-process storage which replaces elliptics in benchmarks and tests.
+	Data is kept only in memory of the provider, operations are completed by storage threads after their latency.
+*/
+struct memory_storage_config
+{
+	uint32_t read_latency; // latency of reads (in microseconds)
+	uint32_t write_latency; // latency of writes and appends (in microseconds)
+	uint32_t index_latency; // latency of index updates and lookups (in microseconds)
+	uint32_t threads; // number of threads which complete operations
+};
+
+/* Counters of in-process cache */
+struct cache_stats
+{
+	uint64_t hits; // number of requests which have been served by the cache
+	uint64_t misses; // number of requests which have been passed to elliptics
+	uint64_t evictions; // number of entries which have been evicted from the cache
+	uint64_t size; // estimated memory used by the cache (in bytes)
+};
+
+/* Ingest counters of days */
+struct day_stats
+{
+	uint64_t records; // number of appended records
+	uint64_t bytes; // size of appended records (in bytes)
+	uint64_t users; // estimated number of distinct users who have appended records
+};
+
+/* Record of user log for batch adding */
+struct log_record
+{
+	std::string user; // name of user
+	uint64_t time; // timestamp of the log record (in seconds). It is used only if subkey is empty
+	std::string subkey; // custom key for user logs
+	ioremap::elliptics::data_pointer data; // user log data
+};
+
+/* Page of user logs which is returned by paginated get_user_logs */
+struct user_logs_page
+{
+	std::vector<ioremap::elliptics::data_pointer> logs; // parts of user's daily logs in order of days
+	std::string next_cursor; // cursor of the next page, empty if all logs have been read
+};
+
+/* Page of active users which is returned by paginated get_active_users */
+struct active_users_page
+{
+	std::vector<std::string> users; // active users in order of activity chunks, users of one chunk are sorted
+	std::string next_cursor; // cursor of the next page, empty if all users have been returned
+};
+
+/* Operation which is applied to active users of operands by combine_active_users */
+enum class set_operation
+{
+	unite, // users which are active in any operand
+	intersect, // users which are active in each operand
+	subtract // users which are active in the first operand and aren't active in others
+};
+
 class provider
 {
 public:
@@ -52,6 +115,21 @@ public:
 	         uint32_t wait_timeout = 60,
 	         uint32_t check_timeout = 60);
 
+	/* Creates provider which doesn't connect to elliptics and keeps all data in memory.
+		It is intended for benchmarks and tests which should run without elliptics cluster,
+		all data is lost when the provider is destroyed.
+		config - latencies and threads of the in-memory storage
+	*/
+	provider(const memory_storage_config &config,
+	         const std::string &log_file,
+	         const int log_level);
+
+	/* Writes appends, sketches, bitmaps, calendars and ingest counters which are still buffered.
+		Writes which are in flight are completed after the provider is destroyed,
+		their activity and counters are written only if they have been buffered before the flush.
+	*/
+	~provider();
+
 	/* Sets parameters for elliptic's sessions.
 		groups - groups with which History DB will works
 		min_writes - for each write attempt some group or groups could fail write. min_writes - minimum numbers of groups which shouldn't fail write.
@@ -59,6 +137,155 @@ public:
 	void set_session_parameters(const std::vector<int> &groups, uint32_t min_writes,
 	                            uint32_t wait_timeout = 60, uint32_t check_timeout = 60);
 
+	/* Sets parameters of appends coalescing. Coalescing is disabled by default.
+		If it is enabled async add_log and add_log_with_activity buffer appends to the same user log key
+		and write them by one append. Callbacks of all merged appends receive result of this append.
+		window - maximum time in milliseconds which append could wait in the buffer. 0 disables coalescing.
+		max_bytes - if buffered appends of one key reach max_bytes they are written immediately.
+	*/
+	void set_coalescing_parameters(uint32_t window, uint32_t max_bytes);
+
+	/* Sets parameters of batch adding.
+		max_in_flight - maximum number of records of one batch which are written simultaneously (1024 by default)
+	*/
+	void set_batch_parameters(uint32_t max_in_flight);
+
+	/* Sets parameters of the cache of users which have been already marked as active. The cache is disabled by default.
+		If the cache is enabled add_activity and add_log_with_activity skip activity update for users
+		which have been already successfully marked as active for the same subkey by this provider.
+		The cache is cleared by set_session_parameters.
+		max_size - maximum memory (in bytes) which could be used by the cache. 0 disables the cache.
+	*/
+	void set_activity_cache_parameters(size_t max_size);
+
+	/* Returns counters of the cache of active users
+	*/
+	cache_stats get_activity_cache_stats();
+
+	/* Sets parameters of the cache of past days user logs. The cache is disabled by default.
+		If the cache is enabled get_user_logs and for_user_logs keep logs of past days (subkeys made from time) in memory
+		and serve repeated reads of them without elliptics. Logs with custom keys and logs of current day are always read from elliptics.
+		Appends through this provider remove appended log from the cache. The cache is cleared by set_session_parameters.
+		max_size - maximum memory (in bytes) which could be used by the cache. 0 disables the cache.
+	*/
+	void set_log_cache_parameters(size_t max_size);
+
+	/* Returns counters of the cache of past days user logs
+	*/
+	cache_stats get_log_cache_stats();
+
+	/* Sets parameters of the cache of active users of closed days. The cache is disabled by default.
+		If the cache is enabled get_active_users and for_active_users keep active users of past days (subkeys made from time)
+		in compact sorted arrays and request from elliptics only days which aren't cached, current day and custom keys.
+		Activity added through this provider removes its day from the cache. The cache is cleared by set_session_parameters.
+		max_size - maximum memory (in bytes) which could be used by the cache. 0 disables the cache.
+	*/
+	void set_active_users_cache_parameters(size_t max_size);
+
+	/* Returns counters of the cache of active users of closed days
+	*/
+	cache_stats get_active_users_cache_stats();
+
+	/* Returns counters and latencies of public operations and of operations of the storage.
+		Sync and async variants of operation are counted separately, names of async variants have ".async" suffix.
+		Names of storage operations have "storage." prefix, their errors are counted by elliptics error codes.
+	*/
+	std::vector<operation_stats> get_operation_stats();
+
+	/* Sets parameters of HyperLogLog sketches of daily activity. Sketches are disabled by default.
+		If sketches are enabled add_activity and add_log_with_activity add users to in-memory sketch of the subkey
+		after the user has been added to the index of activity,
+		changed sketches are merged into key subkey + ".hll" by compare-and-swap write every interval milliseconds.
+		count_active_users estimates number of active users by these sketches.
+		interval - interval of writing of sketches in milliseconds. 0 disables sketches.
+	*/
+	void set_activity_sketch_parameters(uint32_t interval);
+
+	/* Sets parameters of roaring bitmaps of daily activity. Bitmaps are disabled by default.
+		If bitmaps are enabled add_activity and add_log_with_activity map users to dense 32-bit ids by persistent dictionary
+		and add ids to in-memory bitmap of the subkey after the index of activity has been updated,
+		changed bitmaps are merged into key subkey + ".bitmap"
+		by compare-and-swap write every interval milliseconds. The index of activity is still updated.
+		combine_activity_bitmaps and count_activity_bitmaps read these bitmaps.
+		interval - interval of writing of bitmaps in milliseconds. 0 disables bitmaps.
+	*/
+	void set_activity_bitmap_parameters(uint32_t interval);
+
+	/* Sets parameters of per-user calendars of active days. Calendars are disabled by default.
+		If calendars are enabled days of add_activity, add_log and add_log_with_activity are added to in-memory calendar of the user,
+		changed calendars are merged into key "historydb.calendar." + user by compare-and-swap write every interval milliseconds.
+		Calendars are buffered and could lose days (e.g. on crash), so they are used only by get_user_active_days
+		and reads of logs don't skip days which are missed in the calendar.
+		interval - interval of writing of calendars in milliseconds. 0 disables calendars.
+	*/
+	void set_activity_calendar_parameters(uint32_t interval);
+
+	/* Sets parameters of daily ingest counters. Counters are disabled by default.
+		If counters are enabled each successful append of log adds its size and user to in-memory delta of the subkey,
+		deltas are added to key subkey + ".stats" by compare-and-swap write every interval milliseconds.
+		Delta whose write has failed is written again only if it is known not to be applied,
+		so records aren't counted twice but could be missed after partial writes or timeouts.
+		get_day_stats reads these counters.
+		interval - interval of writing of deltas in milliseconds. 0 disables counters.
+	*/
+	void set_day_stats_parameters(uint32_t interval);
+
+	/* Sets number of chunks to which daily activity is split (1 by default).
+		Each user is placed in the chunk selected by hash of the user name, chunk index name is subkey + '.' + chunk number.
+		If chunks is 1 activity is stored in the index named by subkey.
+		Activity which has been written with another number of chunks should be repartitioned by repartition_activity.
+	*/
+	void set_activity_chunks(uint32_t chunks);
+
+	/* Moves activity statistics for specified period from current number of chunks to new number of chunks.
+		It doesn't change number of chunks of this or any other provider and the layout of days isn't recorded,
+		so all providers which read or write the activity should be switched to new number of chunks by cutover:
+			1. set new number of chunks (set_activity_chunks) in all writers and readers of the activity;
+			2. repartition days which have been written with old number of chunks by provider whose number of chunks is still old.
+		Each user is moved to the chunk of the new layout, so days which have been partially written with new number of chunks
+		are repartitioned correctly. Until a day is moved readers with new number of chunks could miss its users.
+		begin_time - begin of the time period (in seconds)
+		end_time - end of the time period (in seconds)
+		chunks - new number of chunks
+	*/
+	void repartition_activity(uint64_t begin_time, uint64_t end_time, uint32_t chunks);
+
+	/* Moves activity statistics for specified subkeys from current number of chunks to new number of chunks.
+		Number of chunks isn't changed, see cutover of repartition_activity for period.
+		subkeys - custom keys of activity statistics
+		chunks - new number of chunks
+	*/
+	void repartition_activity(const std::vector<std::string> &subkeys, uint32_t chunks);
+
+	/* Sets parameters of bulk reading of user logs. Bulk reading is disabled by default.
+		If get_user_logs or for_user_logs requests at least min_keys daily logs, all logs are read by one elliptics bulk read
+		which sends one request to each destination node instead of one request per day.
+		If bulk read fails on some nodes, logs which weren't read are requested one by one.
+		min_keys - minimum number of daily logs which are read by bulk read. 0 disables bulk reading.
+	*/
+	void set_bulk_read_parameters(uint32_t min_keys);
+
+	/* Enables or disables framing of appended logs. Framing is disabled by default.
+		If it is enabled each appended data is prefixed by small header with record length and timestamp
+		(see historydb/framing.h), so records of daily logs could be iterated by framing::record_iterator.
+		Logs which have been written without framing are iterated as one unframed record.
+		get_user_logs and for_user_logs strip headers and return payloads as they have been appended,
+		records with headers are returned by get_user_records.
+		framed - whether appended logs should be framed
+	*/
+	void set_framed_logs(bool framed);
+
+	/* Sets parameters of the sparse offset index of framed user logs. The index isn't built by default.
+		If it is enabled get_user_records which reads part of a day builds the index from the read records
+		and writes it to the companion key (log key + ".offsets").
+		Each record which crosses boundary of step bytes adds entry with its end offset and maximum time of
+		records before it, so offsets don't depend on concurrent appends and records could be appended in any order.
+		The index is used to skip the beginning of daily log before requested period, the rest of the log is always read
+		and records appended after the last entry extend the index, so logs of the current day are indexed incrementally.
+		step - distance in bytes between index entries. 0 disables building of the index.
+	*/
+	void set_offset_index_parameters(uint32_t step);
+
 	/* Adds data to user logs
 		user - name of user
 		time - timestamp of the log record (in seconds)
@@ -159,6 +386,32 @@ public:
 	                           const ioremap::elliptics::data_pointer &data,
 	                           std::function<void(bool added)> callback);
 
+	/* Adds batch of records to user logs
+		records - records which should be added
+		returns vector of results: true for each record which has been added
+	*/
+	std::vector<bool> add_logs(const std::vector<log_record> &records);
+
+	/* Async adds batch of records to user logs
+		records - records which should be added
+		callback - complete callback which accepts vector of results: true for each record which has been added
+	*/
+	void add_logs(const std::vector<log_record> &records,
+	              std::function<void(const std::vector<bool> &added)> callback);
+
+	/* Adds batch of records to user logs and users to activity statistics
+		records - records which should be added
+		returns vector of results: true for each record which has been added
+	*/
+	std::vector<bool> add_logs_with_activity(const std::vector<log_record> &records);
+
+	/* Async adds batch of records to user logs and users to activity statistics
+		records - records which should be added
+		callback - complete callback which accepts vector of results: true for each record which has been added
+	*/
+	void add_logs_with_activity(const std::vector<log_record> &records,
+	                            std::function<void(const std::vector<bool> &added)> callback);
+
 	/* Gets user's logs for specified period
 		user - name of user
 		begin_time - begin of the time period (in seconds)
@@ -195,9 +448,101 @@ public:
 	                   const std::vector<std::string> &subkeys,
 	                   std::function<void(const std::vector<ioremap::elliptics::data_pointer> &data)> callback);
 
+	/* Gets one page of user's logs for specified period. Daily logs are read by ranges, so one page contains
+		at most max_bytes of logs data and big daily log could be split between several pages.
+		Framed logs are split only between records. Record which is bigger than max_bytes is returned whole in own page.
+		user - name of user
+		begin_time - begin of the time period (in seconds)
+		end_time - end of the time period (in seconds)
+		max_bytes - maximum size of logs data in the page. 0 means no limit.
+		cursor - next_cursor of the previous page of the same request or empty string for the first page
+		returns page of user's logs. Throws std::invalid_argument if cursor is invalid,
+		ioremap::elliptics::error if some log couldn't be read.
+	*/
+	user_logs_page get_user_logs(const std::string &user,
+	                             uint64_t begin_time, uint64_t end_time,
+	                             uint64_t max_bytes, const std::string &cursor);
+
+	/* Gets one page of user's logs for subkeys
+		user - name of user
+		subkeys - custom keys of user logs
+		max_bytes - maximum size of logs data in the page. 0 means no limit.
+		cursor - next_cursor of the previous page of the same request or empty string for the first page
+		returns page of user's logs
+	*/
+	user_logs_page get_user_logs(const std::string &user,
+	                             const std::vector<std::string> &subkeys,
+	                             uint64_t max_bytes, const std::string &cursor);
+
+	/* Async gets one page of user's logs for specified period
+		user - name of user
+		begin_time - begin of the time period (in seconds)
+		end_time - end of the time period (in seconds)
+		max_bytes - maximum size of logs data in the page. 0 means no limit.
+		cursor - next_cursor of the previous page of the same request or empty string for the first page
+		callback - result callback which accepts page of user's logs, completed is false if some log couldn't be read
+			(missing log isn't a failure)
+	*/
+	void get_user_logs(const std::string &user,
+	                   uint64_t begin_time, uint64_t end_time,
+	                   uint64_t max_bytes, const std::string &cursor,
+	                   std::function<void(const user_logs_page &page, bool completed)> callback);
+
+	/* Async gets one page of user's logs for subkeys
+		user - name of user
+		subkeys - custom keys of user logs
+		max_bytes - maximum size of logs data in the page. 0 means no limit.
+		cursor - next_cursor of the previous page of the same request or empty string for the first page
+		callback - result callback which accepts page of user's logs, completed is false if some log couldn't be read
+			(missing log isn't a failure)
+	*/
+	void get_user_logs(const std::string &user,
+	                   const std::vector<std::string> &subkeys,
+	                   uint64_t max_bytes, const std::string &cursor,
+	                   std::function<void(const user_logs_page &page, bool completed)> callback);
+
+	/* Gets user's log records for specified period. Unlike get_user_logs only framed records with time
+		within the period are returned. If daily log has offset index its beginning before the period isn't read.
+		Legacy unframed logs can't be filtered, so they are returned as whole unframed records.
+		user - name of user
+		begin_time - begin of the time period (in seconds)
+		end_time - end of the time period (in seconds), inclusive
+		returns vector of user's records in order of days and appends. Throws ioremap::elliptics::error if some log couldn't be read.
+	*/
+	std::vector<framing::record> get_user_records(const std::string &user, uint64_t begin_time, uint64_t end_time);
+
+	/* Async gets user's log records for specified period
+		user - name of user
+		begin_time - begin of the time period (in seconds)
+		end_time - end of the time period (in seconds), inclusive
+		callback - result callback which accepts vector of user's records in order of days and appends,
+			completed is false if some log couldn't be read (missing log isn't a failure)
+	*/
+	void get_user_records(const std::string &user,
+	                      uint64_t begin_time, uint64_t end_time,
+	                      std::function<void(const std::vector<framing::record> &records, bool completed)> callback);
+
+	/* Gets all records of user's logs for subkeys. Unlike get_user_logs records keep time and flags of their headers,
+		so logs could be copied or converted without loss of framing.
+		user - name of user
+		subkeys - custom keys of user logs
+		returns vector of user's records in order of subkeys and appends. Throws ioremap::elliptics::error if some log couldn't be read.
+	*/
+	std::vector<framing::record> get_user_records(const std::string &user, const std::vector<std::string> &subkeys);
+
+	/* Async gets all records of user's logs for subkeys
+		user - name of user
+		subkeys - custom keys of user logs
+		callback - result callback which accepts vector of user's records in order of subkeys and appends,
+			completed is false if some log couldn't be read (missing log isn't a failure)
+	*/
+	void get_user_records(const std::string &user,
+	                      const std::vector<std::string> &subkeys,
+	                      std::function<void(const std::vector<framing::record> &records, bool completed)> callback);
+
 	/* Gets active users with activity statistics for specified period
 		time - timestamp of the activity statistics day (in seconds)
-		returns set of active users
+		returns set of active users. Throws ioremap::elliptics::error if activity couldn't be read.
 	*/
 	std::set<std::string> get_active_users(uint64_t begin_time, uint64_t end_time);
 
@@ -209,7 +554,8 @@ public:
 
 	/* Async gets active users with activity statistics for specified period
 		time - timestamp of the activity statistics day (in seconds)
-		callback - result callback which accepts set of active users.
+		callback - result callback which accepts set of active users. It gets empty set if activity couldn't be read,
+			use get_active_users_list to distinguish failures.
 	*/
 	void get_active_users(uint64_t begin_time, uint64_t end_time,
 	                      std::function<void(const std::set<std::string>  &ctive_users)> callback);
@@ -221,6 +567,279 @@ public:
 	void get_active_users(const std::vector<std::string> &subkeys,
 	                      std::function<void(const std::set<std::string>  &ctive_users)> callback);
 
+	/* Gets one page of active users for specified period. Activity chunks are read one after another,
+		so one page reads only chunks which contain its users.
+		The whole chunk is read and sorted for each page which starts in it, so iterating over a chunk of n users
+		costs O(n * n / limit). Activity should be split into enough chunks (set_activity_chunks) for small limits.
+		begin_time - begin of the time period (in seconds)
+		end_time - end of the time period (in seconds)
+		limit - maximum number of users in the page. 0 means no limit.
+		cursor - next_cursor of the previous page of the same request or empty string for the first page
+		returns page of active users. Throws std::invalid_argument if cursor is invalid or activity chunks have been changed,
+		ioremap::elliptics::error if activity couldn't be read.
+	*/
+	active_users_page get_active_users(uint64_t begin_time, uint64_t end_time,
+	                                   size_t limit, const std::string &cursor);
+
+	/* Gets one page of active users for subkeys
+		subkeys - custom keys of activity statistics
+		limit - maximum number of users in the page. 0 means no limit.
+		cursor - next_cursor of the previous page of the same request or empty string for the first page
+		returns page of active users
+	*/
+	active_users_page get_active_users(const std::vector<std::string> &subkeys,
+	                                   size_t limit, const std::string &cursor);
+
+	/* Async gets one page of active users for specified period
+		begin_time - begin of the time period (in seconds)
+		end_time - end of the time period (in seconds)
+		limit - maximum number of users in the page. 0 means no limit.
+		cursor - next_cursor of the previous page of the same request or empty string for the first page
+		callback - result callback which accepts page of active users, completed is false if activity couldn't be read
+	*/
+	void get_active_users(uint64_t begin_time, uint64_t end_time,
+	                      size_t limit, const std::string &cursor,
+	                      std::function<void(const active_users_page &page, bool completed)> callback);
+
+	/* Async gets one page of active users for subkeys
+		subkeys - custom keys of activity statistics
+		limit - maximum number of users in the page. 0 means no limit.
+		cursor - next_cursor of the previous page of the same request or empty string for the first page
+		callback - result callback which accepts page of active users, completed is false if activity couldn't be read
+	*/
+	void get_active_users(const std::vector<std::string> &subkeys,
+	                      size_t limit, const std::string &cursor,
+	                      std::function<void(const active_users_page &page, bool completed)> callback);
+
+	/* Combines active users of several time periods by set operation which is applied from left to right.
+		Activity chunks are processed one after another and users of each operand in the chunk are combined by sorted merge,
+		so only result and users of one chunk are kept in memory.
+		op - set operation
+		periods - time periods (begin and end time in seconds) of operands, active users of each period are united
+		returns sorted list of users. Throws ioremap::elliptics::error if activity of some operand couldn't be read.
+	*/
+	user_list combine_active_users(set_operation op, const std::vector<std::pair<uint64_t, uint64_t>> &periods);
+
+	/* Combines active users of several groups of subkeys by set operation which is applied from left to right
+		op - set operation
+		operands - subkeys of operands, active users of subkeys of each operand are united
+		returns sorted list of users
+	*/
+	user_list combine_active_users(set_operation op, const std::vector<std::vector<std::string>> &operands);
+
+	/* Async combines active users of several time periods by set operation which is applied from left to right
+		op - set operation
+		periods - time periods (begin and end time in seconds) of operands, active users of each period are united
+		callback - result callback which accepts sorted list of users, completed is false if activity couldn't be read
+	*/
+	void combine_active_users(set_operation op, const std::vector<std::pair<uint64_t, uint64_t>> &periods,
+	                          std::function<void(const user_list &active_users, bool completed)> callback);
+
+	/* Async combines active users of several groups of subkeys by set operation which is applied from left to right
+		op - set operation
+		operands - subkeys of operands, active users of subkeys of each operand are united
+		callback - result callback which accepts sorted list of users, completed is false if activity couldn't be read
+	*/
+	void combine_active_users(set_operation op, const std::vector<std::vector<std::string>> &operands,
+	                          std::function<void(const user_list &active_users, bool completed)> callback);
+
+	/* Estimates number of unique active users for specified period by merging of daily HyperLogLog sketches.
+		Only one sketch of fixed size is read per day, standard error of estimation is about 1.6%.
+		Activity which has been added when sketches were disabled isn't counted.
+		begin_time - begin of the time period (in seconds)
+		end_time - end of the time period (in seconds)
+		returns estimated number of active users. Throws ioremap::elliptics::error if some sketch couldn't be read.
+	*/
+	uint64_t count_active_users(uint64_t begin_time, uint64_t end_time);
+
+	/* Estimates number of unique active users for subkeys
+		subkeys - custom keys of activity statistics
+		returns estimated number of active users
+	*/
+	uint64_t count_active_users(const std::vector<std::string> &subkeys);
+
+	/* Async estimates number of unique active users for specified period
+		begin_time - begin of the time period (in seconds)
+		end_time - end of the time period (in seconds)
+		callback - result callback which accepts estimated number of active users,
+			completed is false if some sketch couldn't be read (missing sketch is a day without activity)
+	*/
+	void count_active_users(uint64_t begin_time, uint64_t end_time,
+	                        std::function<void(uint64_t count, bool completed)> callback);
+
+	/* Async estimates number of unique active users for subkeys
+		subkeys - custom keys of activity statistics
+		callback - result callback which accepts estimated number of active users,
+			completed is false if some sketch couldn't be read (missing sketch is a day without activity)
+	*/
+	void count_active_users(const std::vector<std::string> &subkeys,
+	                        std::function<void(uint64_t count, bool completed)> callback);
+
+	/* Combines active users of several time periods by set operation over daily activity bitmaps.
+		One compressed bitmap is read per day and operands are combined by bitmap operations,
+		names of resulting ids are read from the user dictionary.
+		Activity which has been added when bitmaps were disabled isn't taken into account.
+		op - set operation
+		periods - time periods (begin and end time in seconds) of operands, active users of each period are united
+		returns sorted list of users. Throws ioremap::elliptics::error if activity of some operand couldn't be read.
+	*/
+	user_list combine_activity_bitmaps(set_operation op, const std::vector<std::pair<uint64_t, uint64_t>> &periods);
+
+	/* Combines active users of several groups of subkeys by set operation over daily activity bitmaps
+		op - set operation
+		operands - subkeys of operands, active users of subkeys of each operand are united
+		returns sorted list of users
+	*/
+	user_list combine_activity_bitmaps(set_operation op, const std::vector<std::vector<std::string>> &operands);
+
+	/* Async combines active users of several time periods by set operation over daily activity bitmaps
+		op - set operation
+		periods - time periods (begin and end time in seconds) of operands, active users of each period are united
+		callback - result callback which accepts sorted list of users, completed is false if activity or names couldn't be read
+	*/
+	void combine_activity_bitmaps(set_operation op, const std::vector<std::pair<uint64_t, uint64_t>> &periods,
+	                              std::function<void(const user_list &active_users, bool completed)> callback);
+
+	/* Async combines active users of several groups of subkeys by set operation over daily activity bitmaps
+		op - set operation
+		operands - subkeys of operands, active users of subkeys of each operand are united
+		callback - result callback which accepts sorted list of users, completed is false if activity or names couldn't be read
+	*/
+	void combine_activity_bitmaps(set_operation op, const std::vector<std::vector<std::string>> &operands,
+	                              std::function<void(const user_list &active_users, bool completed)> callback);
+
+	/* Counts exactly active users of combination of several time periods by daily activity bitmaps.
+		Names of users aren't read.
+		op - set operation
+		periods - time periods (begin and end time in seconds) of operands, active users of each period are united
+		returns number of users. Throws ioremap::elliptics::error if activity of some operand couldn't be read.
+	*/
+	uint64_t count_activity_bitmaps(set_operation op, const std::vector<std::pair<uint64_t, uint64_t>> &periods);
+
+	/* Counts exactly active users of combination of several groups of subkeys by daily activity bitmaps
+		op - set operation
+		operands - subkeys of operands, active users of subkeys of each operand are united
+		returns number of users
+	*/
+	uint64_t count_activity_bitmaps(set_operation op, const std::vector<std::vector<std::string>> &operands);
+
+	/* Async counts exactly active users of combination of several time periods by daily activity bitmaps
+		op - set operation
+		periods - time periods (begin and end time in seconds) of operands, active users of each period are united
+		callback - result callback which accepts number of users, completed is false if activity couldn't be read
+	*/
+	void count_activity_bitmaps(set_operation op, const std::vector<std::pair<uint64_t, uint64_t>> &periods,
+	                            std::function<void(uint64_t count, bool completed)> callback);
+
+	/* Async counts exactly active users of combination of several groups of subkeys by daily activity bitmaps
+		op - set operation
+		operands - subkeys of operands, active users of subkeys of each operand are united
+		callback - result callback which accepts number of users, completed is false if activity couldn't be read
+	*/
+	void count_activity_bitmaps(set_operation op, const std::vector<std::vector<std::string>> &operands,
+	                            std::function<void(uint64_t count, bool completed)> callback);
+
+	/* Gets ingest counters of specified period, counters of days are summed and users are estimated by HyperLogLog sketch.
+		Records which have been appended when counters were disabled aren't counted.
+		begin_time - begin of the time period (in seconds)
+		end_time - end of the time period (in seconds)
+		returns counters of the period. Throws ioremap::elliptics::error if counters of some day couldn't be read.
+	*/
+	day_stats get_day_stats(uint64_t begin_time, uint64_t end_time);
+
+	/* Gets ingest counters of subkeys
+		subkeys - custom keys of logs
+		returns counters of subkeys
+	*/
+	day_stats get_day_stats(const std::vector<std::string> &subkeys);
+
+	/* Async gets ingest counters of specified period
+		begin_time - begin of the time period (in seconds)
+		end_time - end of the time period (in seconds)
+		callback - result callback which accepts counters of the period, completed is false if counters couldn't be read
+	*/
+	void get_day_stats(uint64_t begin_time, uint64_t end_time,
+	                   std::function<void(const day_stats &stats, bool completed)> callback);
+
+	/* Async gets ingest counters of subkeys
+		subkeys - custom keys of logs
+		callback - result callback which accepts counters of subkeys, completed is false if counters couldn't be read
+	*/
+	void get_day_stats(const std::vector<std::string> &subkeys,
+	                   std::function<void(const day_stats &stats, bool completed)> callback);
+
+	/* Gets days on which the user has been active or has written logs by the user's calendar.
+		Days which have been written when calendars were disabled or haven't been flushed yet
+		by other providers are missed, so the result is a hint rather than an exact list.
+		user - name of user
+		begin_time - begin of the time period (in seconds)
+		end_time - end of the time period (in seconds)
+		returns sorted days since epoch, subkey of the day is its decimal number
+	*/
+	std::vector<uint64_t> get_user_active_days(const std::string &user, uint64_t begin_time, uint64_t end_time);
+
+	/* Async gets days on which the user has been active or has written logs
+		user - name of user
+		begin_time - begin of the time period (in seconds)
+		end_time - end of the time period (in seconds)
+		callback - result callback which accepts sorted days since epoch
+	*/
+	void get_user_active_days(const std::string &user, uint64_t begin_time, uint64_t end_time,
+	                          std::function<void(const std::vector<uint64_t> &days)> callback);
+
+	/* Gets active users for specified period as compact sorted list
+		begin_time - begin of the time period (in seconds)
+		end_time - end of the time period (in seconds)
+		returns sorted list of unique active users. Throws ioremap::elliptics::error if activity couldn't be read.
+	*/
+	user_list get_active_users_list(uint64_t begin_time, uint64_t end_time);
+
+	/* Gets active users for specified subkeys as compact sorted list
+		subkeys - custom keys of activity statistics
+		returns sorted list of unique active users
+	*/
+	user_list get_active_users_list(const std::vector<std::string> &subkeys);
+
+	/* Async gets active users for specified period as compact sorted list
+		begin_time - begin of the time period (in seconds)
+		end_time - end of the time period (in seconds)
+		callback - result callback which accepts sorted list of unique active users,
+			completed is false if activity couldn't be read (chunk without activity isn't a failure)
+	*/
+	void get_active_users_list(uint64_t begin_time, uint64_t end_time,
+	                           std::function<void(const user_list &active_users, bool completed)> callback);
+
+	/* Async gets active users for specified subkeys as compact sorted list
+		subkeys - custom keys of activity statistics
+		callback - result callback which accepts sorted list of unique active users,
+			completed is false if activity couldn't be read (chunk without activity isn't a failure)
+	*/
+	void get_active_users_list(const std::vector<std::string> &subkeys,
+	                           std::function<void(const user_list &active_users, bool completed)> callback);
+
+	/* Streams active users for specified period by batches as they come from storage.
+		Users aren't sorted and aren't buffered, each user is passed once if activity chunks haven't been changed.
+		The activity cache isn't used by streaming.
+		begin_time - begin of the time period (in seconds)
+		end_time - end of the time period (in seconds)
+		batch_size - maximum number of users passed to on_users at once
+		on_users - batch callback, calls of it are serialized
+		on_complete - complete callback which accepts false if some activity chunk hasn't been read
+	*/
+	void stream_active_users(uint64_t begin_time, uint64_t end_time, size_t batch_size,
+	                         std::function<void(const std::vector<std::string> &users)> on_users,
+	                         std::function<void(bool completed)> on_complete);
+
+	/* Streams active users for specified subkeys by batches as they come from storage
+		subkeys - custom keys of activity statistics
+		batch_size - maximum number of users passed to on_users at once
+		on_users - batch callback, calls of it are serialized
+		on_complete - complete callback which accepts false if some activity chunk hasn't been read
+	*/
+	void stream_active_users(const std::vector<std::string> &subkeys, size_t batch_size,
+	                         std::function<void(const std::vector<std::string> &users)> on_users,
+	                         std::function<void(bool completed)> on_complete);
+
 
 	/* Runs through users logs for specified time period and calls callback on each log file
 		user - name of user
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#ifndef HISTORY_USER_LIST_H
+#define HISTORY_USER_LIST_H
+
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace history {
+
+/* Sorted list of unique user names which are kept one after another in one buffer.
+	It costs one offset per user instead of tree node and string allocation per user.
+*/
+class user_list
+{
+public:
+	user_list();
+
+	/* Makes list from user names
+		users - user names in any order, could contain duplicates. It is sorted by the constructor.
+	*/
+	explicit user_list(std::vector<std::string> &users);
+
+	/* Merges sorted lists into one list without duplicates
+		lists - lists which should be merged
+		returns merged list
+	*/
+	static user_list merge(const std::vector<std::shared_ptr<const user_list>> &lists);
+
+	/* Makes list of users which are in both lists by one pass of sorted merge
+		lhs, rhs - lists which should be intersected
+		returns intersection of the lists
+	*/
+	static user_list intersect(const user_list &lhs, const user_list &rhs);
+
+	/* Makes list of users which are in lhs but aren't in rhs by one pass of sorted merge
+		lhs - list from which users are removed
+		rhs - list of users which should be removed
+		returns difference of the lists
+	*/
+	static user_list subtract(const user_list &lhs, const user_list &rhs);
+
+	size_t size() const { return offsets_.size() - 1; }
+	bool empty() const { return size() == 0; }
+
+	const char *data(size_t index) const { return arena_.data() + offsets_[index]; } // name of index-th user, it isn't null-terminated
+	size_t length(size_t index) const { return offsets_[index + 1] - offsets_[index]; } // length of index-th user name
+	std::string at(size_t index) const { return std::string(data(index), length(index)); }
+
+	bool contains(const std::string &user) const; // binary search of the user
+
+	size_t memory() const; // estimated memory used by the list
+
+private:
+	int compare(size_t index, const char *user, size_t size) const; // compares index-th user name with user
+	void push_back(const char *user, size_t size);
+
+	std::vector<char>		arena_; // user names without delimiters in sorted order
+	std::vector<uint64_t>	offsets_; // offsets of user names in arena_ and size of arena_ at the end
+};
+
+} /* namespace history */
+
+#endif //HISTORY_USER_LIST_H
@@ -25,7 +25,7 @@
 
 #include "historydb/provider.h"
 
-#include "test2.h"
+#include "test5.h"
 
 char UMM[]		= "User made money\n";
 char UCM[]		= "User check mail\n";
@@ -103,7 +103,8 @@ void test1(std::shared_ptr<history::provider> provider)
 
 	provider->for_active_users(tm, tm + 1, test1_for3);
 
-	//provider->repartition_activity(tm, 10);
+	provider->repartition_activity(tm, tm, 10);
+	provider->set_activity_chunks(10);
 
 	provider->for_active_users(tm, tm + 1, test1_for4);
 }
@@ -161,9 +162,9 @@ void run_test(int test_no, std::shared_ptr<history::provider> provider)
 {
 	switch(test_no) {
 		case 1:	test1(provider); break;
-		case 2:	test2(provider); break;
 		case 3: test3(provider); break;
 		case 4: test4(provider); break;
+		case 5: test5(provider); break;
 	}
 }
 
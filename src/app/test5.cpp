@@ -0,0 +1,115 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+
+#include <boost/thread.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "historydb/provider.h"
+#include "test5.h"
+
+namespace consts {
+	const uint32_t THREADS_NO = 10;
+	const uint32_t USERS_NO = 100;
+	const uint32_t DAYS_NO = 365;
+	const uint32_t REQUESTS_NO = 1000;
+	const uint32_t SECONDS_IN_DAY = 24 * 60 * 60;
+	const uint32_t RANGES[] = {30, 90, 365};
+	char RECORD[] = "User made money\n";
+} /* namespace consts */
+
+std::string bench_user(uint32_t no)
+{
+	return "bench_user" + boost::lexical_cast<std::string>(no);
+}
+
+void fill_logs(std::shared_ptr<history::provider> provider, uint64_t end_time)
+{
+	auto data = ioremap::elliptics::data_pointer::copy(consts::RECORD, sizeof(consts::RECORD));
+
+	std::vector<history::log_record> records;
+	records.reserve(consts::USERS_NO * consts::DAYS_NO);
+
+	for (uint32_t user = 0; user < consts::USERS_NO; ++user) {
+		for (uint32_t day = 0; day < consts::DAYS_NO; ++day) {
+			history::log_record record;
+			record.user = bench_user(user);
+			record.time = end_time - day * consts::SECONDS_IN_DAY;
+			record.data = data;
+			records.emplace_back(record);
+		}
+	}
+
+	auto results = provider->add_logs(records);
+	std::cout << "Written records: " << std::count(results.begin(), results.end(), true)
+	          << " of " << records.size() << std::endl;
+}
+
+void read_logs(std::shared_ptr<history::provider> provider, uint64_t begin_time, uint64_t end_time, uint32_t requests)
+{
+	for (uint32_t i = 0; i < requests; ++i) {
+		provider->get_user_logs(bench_user(rand() % consts::USERS_NO), begin_time, end_time);
+	}
+}
+
+double measure_rps(std::shared_ptr<history::provider> provider, uint64_t end_time, uint32_t days)
+{
+	const uint64_t begin_time = end_time - (days - 1) * consts::SECONDS_IN_DAY;
+	const auto start = boost::posix_time::microsec_clock::universal_time();
+
+	std::list<boost::thread> threads;
+	for (uint32_t i = 0; i < consts::THREADS_NO; ++i) {
+		threads.push_back(boost::thread(boost::bind(&read_logs, provider, begin_time, end_time,
+		                                            consts::REQUESTS_NO / consts::THREADS_NO)));
+	}
+
+	while(!threads.empty()) {
+		threads.begin()->join();
+		threads.erase(threads.begin());
+	}
+
+	const auto elapsed = boost::posix_time::microsec_clock::universal_time() - start;
+
+	return consts::REQUESTS_NO * 1000000.0 / std::max<int64_t>(elapsed.total_microseconds(), 1);
+}
+
+void test5(std::shared_ptr<history::provider> provider)
+{
+	std::cout << "Run test5" << std::endl;
+
+	const uint64_t end_time = time(NULL);
+
+	fill_logs(provider, end_time);
+
+	for (auto it = std::begin(consts::RANGES), end = std::end(consts::RANGES); it != end; ++it) {
+		provider->set_bulk_read_parameters(0);
+		const auto single_rps = measure_rps(provider, end_time, *it);
+
+		provider->set_bulk_read_parameters(1);
+		const auto bulk_rps = measure_rps(provider, end_time, *it);
+
+		std::cout << "Days: " << *it
+		          << " read_latest: " << single_rps << " rps"
+		          << " bulk_read: " << bulk_rps << " rps" << std::endl;
+	}
+
+	provider->set_bulk_read_parameters(0);
+}
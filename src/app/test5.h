@@ -14,8 +14,8 @@
  * limitations under the License.
 */
 
-#ifndef APP_TEST2_H
-#define APP_TEST2_H
+#ifndef APP_TEST5_H
+#define APP_TEST5_H
 
 #include <memory>
 
@@ -23,6 +23,8 @@ namespace history {
 	class provider;
 } /* namespace history */
 
-void test2(std::shared_ptr<history::provider> provider);
+/* Compares requests per second of get_user_logs with and without bulk reading for 30/90/365-day ranges
+*/
+void test5(std::shared_ptr<history::provider> provider);
 
-#endif //APP_TEST2_H
+#endif //APP_TEST5_H
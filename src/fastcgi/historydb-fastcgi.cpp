@@ -48,6 +48,23 @@ const char DATA_ITEM[] = "data";
 const char BEGIN_TIME_ITEM[] = "begin_time";
 const char END_TIME_ITEM[] = "end_time";
 const char KEYS_ITEM[] = "keys";
+const char LIMIT_ITEM[] = "limit";
+const char CURSOR_ITEM[] = "cursor";
+const char OP_ITEM[] = "op";
+const char ENGINE_ITEM[] = "engine";
+const char PERIODS_ITEM[] = "periods";
+}
+
+set_operation parse_operation(const std::string &op)
+{
+	if (op == "union")
+		return set_operation::unite;
+	else if (op == "intersect")
+		return set_operation::intersect;
+	else if (op == "diff")
+		return set_operation::subtract;
+
+	throw std::invalid_argument("unknown operation: " + op);
 }
 
 handler::handler(fastcgi::ComponentContext* context)
@@ -105,11 +122,38 @@ void handler::onLoad()
 		m_logger->debug("Added %d group\n", group);
 	}
 
-	int min_writes = config->asInt(xpath + "/min_writes");
+	subs.clear();
+	config->subKeys(xpath + "/memory_storage", subs); // in-memory storage replaces elliptics if it is specified
+
+	if (!subs.empty()) {
+		const auto memory_xpath = xpath + "/memory_storage";
+		history::memory_storage_config memory_config;
+		memory_config.read_latency = config->asInt(memory_xpath + "/read_latency", 0);
+		memory_config.write_latency = config->asInt(memory_xpath + "/write_latency", 0);
+		memory_config.index_latency = config->asInt(memory_xpath + "/index_latency", 0);
+		memory_config.threads = config->asInt(memory_xpath + "/threads", 1);
+
+		m_logger->debug("Using in-memory storage\n");
+		m_provider = std::make_shared<history::provider>(memory_config,
+		                                                 log_file, history::get_log_level(log_level));
+	} else {
+		int min_writes = config->asInt(xpath + "/min_writes");
+
+		// creates historydb provider instance
+		m_provider = std::make_shared<history::provider>(servers, groups, min_writes,
+		                                                 log_file, history::get_log_level(log_level));
+	}
 
-	// creates historydb provider instance
-	m_provider = std::make_shared<history::provider>(servers, groups, min_writes,
-	                                                 log_file, history::get_log_level(log_level));
+	m_provider->set_activity_chunks(config->asInt(xpath + "/activity_chunks", 1));
+	m_provider->set_bulk_read_parameters(config->asInt(xpath + "/bulk_read_min_keys", 0));
+	m_provider->set_framed_logs(config->asInt(xpath + "/framed_logs", 0) != 0);
+	m_provider->set_offset_index_parameters(config->asInt(xpath + "/offset_index_step", 0));
+	m_provider->set_log_cache_parameters(config->asInt(xpath + "/log_cache_size", 0));
+	m_provider->set_active_users_cache_parameters(config->asInt(xpath + "/active_users_cache_size", 0));
+	m_provider->set_activity_sketch_parameters(config->asInt(xpath + "/activity_sketch_interval", 0));
+	m_provider->set_activity_bitmap_parameters(config->asInt(xpath + "/activity_bitmap_interval", 0));
+	m_provider->set_activity_calendar_parameters(config->asInt(xpath + "/activity_calendar_interval", 0));
+	m_provider->set_day_stats_parameters(config->asInt(xpath + "/day_stats_interval", 0));
 }
 
 void handler::onUnload()
@@ -140,6 +184,10 @@ void handler::init_handlers()
 	ADD_HANDLER("/add_log_with_activity",	handle_add_log_with_activity);
 	ADD_HANDLER("/get_active_users",		handle_get_active_users);
 	ADD_HANDLER("/get_user_logs",			handle_get_user_logs);
+	ADD_HANDLER("/count_active_users",		handle_count_active_users);
+	ADD_HANDLER("/combine_active_users",	handle_combine_active_users);
+	ADD_HANDLER("/get_user_active_days",	handle_get_user_active_days);
+	ADD_HANDLER("/get_day_stats",			handle_get_day_stats);
 }
 
 void handler::handle_root(fastcgi::Request* req, fastcgi::HandlerContext*)
@@ -263,7 +311,12 @@ void handler::handle_get_active_users(fastcgi::Request* req, fastcgi::HandlerCon
 	try {
 		fastcgi::RequestStream stream(req);
 
-		std::set<std::string> res;
+		const bool paginated = req->hasArg(consts::LIMIT_ITEM) || req->hasArg(consts::CURSOR_ITEM);
+		const size_t limit = req->hasArg(consts::LIMIT_ITEM) ? boost::lexical_cast<size_t>(req->getArg(consts::LIMIT_ITEM)) : 0;
+		const std::string cursor = req->hasArg(consts::CURSOR_ITEM) ? req->getArg(consts::CURSOR_ITEM) : std::string();
+
+		user_list res;
+		active_users_page page;
 
 		if (req->hasArg(consts::KEYS_ITEM) &&
 		    !req->getArg(consts::KEYS_ITEM).empty()) { // checks optional parameter key
@@ -272,12 +325,20 @@ void handler::handle_get_active_users(fastcgi::Request* req, fastcgi::HandlerCon
 			boost::split(keys, keys_value, boost::is_any_of(":"));
 			m_logger->debug("Gets active users by key: %s\n", keys.front().c_str());
 
-			res = m_provider->get_active_users(keys); // gets active users by key
+			if (paginated)
+				page = m_provider->get_active_users(keys, limit, cursor); // gets page of active users by key
+			else
+				res = m_provider->get_active_users_list(keys); // gets active users by key
 		}
 		else if(req->hasArg(consts::BEGIN_TIME_ITEM) &&
 		        req->hasArg(consts::END_TIME_ITEM)) { // checks optional parameter time
-			res = m_provider->get_active_users(boost::lexical_cast<uint64_t>(req->getArg(consts::BEGIN_TIME_ITEM)),
-											   boost::lexical_cast<uint64_t>(req->getArg(consts::END_TIME_ITEM))); // gets active users by time
+			const auto begin_time = boost::lexical_cast<uint64_t>(req->getArg(consts::BEGIN_TIME_ITEM));
+			const auto end_time = boost::lexical_cast<uint64_t>(req->getArg(consts::END_TIME_ITEM));
+
+			if (paginated)
+				page = m_provider->get_active_users(begin_time, end_time, limit, cursor); // gets page of active users by time
+			else
+				res = m_provider->get_active_users_list(begin_time, end_time); // gets active users by time
 		}
 		else
 			throw std::invalid_argument("Required parameters are missing");
@@ -287,13 +348,23 @@ void handler::handle_get_active_users(fastcgi::Request* req, fastcgi::HandlerCon
 
 		rapidjson::Value active_users(rapidjson::kArrayType);
 
-		for (auto it = res.begin(), itEnd = res.end(); it != itEnd; ++it) { // adds all active user with counters to json
+		for (size_t index = 0; index < res.size(); ++index) { // adds all active user with counters to json
+			rapidjson::Value user(res.data(index), res.length(index), d.GetAllocator());
+			active_users.PushBack(user, d.GetAllocator());
+		}
+
+		for (auto it = page.users.begin(), itEnd = page.users.end(); it != itEnd; ++it) { // adds users of the page to json
 			rapidjson::Value user(it->c_str(), it->size(), d.GetAllocator());
 			active_users.PushBack(user, d.GetAllocator());
 		}
 
 		d.AddMember("active_users", active_users, d.GetAllocator());
 
+		if (paginated) {
+			rapidjson::Value next_cursor(page.next_cursor.c_str(), page.next_cursor.size(), d.GetAllocator());
+			d.AddMember("next_cursor", next_cursor, d.GetAllocator()); // adds cursor of the next page, empty if there is no more users
+		}
+
 		rapidjson::StringBuffer buffer; // creates string buffer for serialized json
 		rapidjson::Writer<rapidjson::StringBuffer> writer(buffer); // creates json writer
 		d.Accept(writer); // accepts writer by json document
@@ -324,24 +395,40 @@ void handler::handle_get_user_logs(fastcgi::Request* req, fastcgi::HandlerContex
 		if (!req->hasArg(consts::USER_ITEM))
 			throw std::invalid_argument("Required parameters are missing");
 
-		std::vector<ioremap::elliptics::data_pointer> res;
+		user_logs_page page;
+
+		const bool paginated = req->hasArg(consts::LIMIT_ITEM) || req->hasArg(consts::CURSOR_ITEM);
+		const uint64_t max_bytes = req->hasArg(consts::LIMIT_ITEM) ? boost::lexical_cast<uint64_t>(req->getArg(consts::LIMIT_ITEM)) : 0;
+		const std::string cursor = req->hasArg(consts::CURSOR_ITEM) ? req->getArg(consts::CURSOR_ITEM) : std::string();
 
 		if(req->hasArg(consts::KEYS_ITEM)) {
 			std::string keys_value = req->getArg(consts::KEYS_ITEM);
 			std::vector<std::string> keys;
 			boost::split(keys, keys_value, boost::is_any_of(":"));
 
-			res = m_provider->get_user_logs(req->getArg(consts::USER_ITEM),
-											keys); // gets user logs from historydb library
+			if (paginated)
+				page = m_provider->get_user_logs(req->getArg(consts::USER_ITEM),
+												 keys, max_bytes, cursor); // gets page of user logs from historydb library
+			else
+				page.logs = m_provider->get_user_logs(req->getArg(consts::USER_ITEM),
+													  keys); // gets user logs from historydb library
 		}
 		else if(req->hasArg(consts::BEGIN_TIME_ITEM) && req->hasArg(consts::END_TIME_ITEM)) {
-			res = m_provider->get_user_logs(req->getArg(consts::USER_ITEM),
-											boost::lexical_cast<uint64_t>(req->getArg(consts::BEGIN_TIME_ITEM)),
-											boost::lexical_cast<uint64_t>(req->getArg(consts::END_TIME_ITEM))); // gets user logs from historydb library
+			const auto begin_time = boost::lexical_cast<uint64_t>(req->getArg(consts::BEGIN_TIME_ITEM));
+			const auto end_time = boost::lexical_cast<uint64_t>(req->getArg(consts::END_TIME_ITEM));
+
+			if (paginated)
+				page = m_provider->get_user_logs(req->getArg(consts::USER_ITEM),
+												 begin_time, end_time, max_bytes, cursor); // gets page of user logs from historydb library
+			else
+				page.logs = m_provider->get_user_logs(req->getArg(consts::USER_ITEM),
+													  begin_time, end_time); // gets user logs from historydb library
 		}
 		else
 			throw std::invalid_argument("Required parameters are missing");
 
+		const auto &res = page.logs;
+
 		rapidjson::Document d; // creates json document
 		d.SetObject();
 
@@ -354,6 +441,11 @@ void handler::handle_get_user_logs(fastcgi::Request* req, fastcgi::HandlerContex
 
 		d.AddMember("logs", user_logs, d.GetAllocator()); // adds logs array to json document
 
+		if (paginated) {
+			rapidjson::Value next_cursor(page.next_cursor.c_str(), page.next_cursor.size(), d.GetAllocator());
+			d.AddMember("next_cursor", next_cursor, d.GetAllocator()); // adds cursor of the next page, empty if there is no more logs
+		}
+
 		rapidjson::StringBuffer buffer; // creates string buffer for serialized json
 		rapidjson::Writer<rapidjson::StringBuffer> writer(buffer); // creates json writer
 		d.Accept(writer); // accepts writer by json document
@@ -378,6 +470,219 @@ void handler::handle_get_user_logs(fastcgi::Request* req, fastcgi::HandlerContex
 	}
 }
 
+void handler::handle_count_active_users(fastcgi::Request* req, fastcgi::HandlerContext*)
+{
+	m_logger->debug("Handle count active users request\n");
+	try {
+		fastcgi::RequestStream stream(req);
+
+		uint64_t count = 0;
+
+		if (req->hasArg(consts::KEYS_ITEM) &&
+		    !req->getArg(consts::KEYS_ITEM).empty()) { // checks optional parameter key
+			std::string keys_value = req->getArg(consts::KEYS_ITEM);
+			std::vector<std::string> keys;
+			boost::split(keys, keys_value, boost::is_any_of(":"));
+
+			count = m_provider->count_active_users(keys); // estimates active users by key
+		}
+		else if(req->hasArg(consts::BEGIN_TIME_ITEM) &&
+		        req->hasArg(consts::END_TIME_ITEM)) { // checks optional parameter time
+			count = m_provider->count_active_users(boost::lexical_cast<uint64_t>(req->getArg(consts::BEGIN_TIME_ITEM)),
+			                                       boost::lexical_cast<uint64_t>(req->getArg(consts::END_TIME_ITEM))); // estimates active users by time
+		}
+		else
+			throw std::invalid_argument("Required parameters are missing");
+
+		const std::string json = "{\"count\":" + boost::lexical_cast<std::string>(count) + "}";
+
+		m_logger->debug("Result json: %s\n", json.c_str());
+		req->setHeader("Content-Length", boost::lexical_cast<std::string>(json.size()));
+
+		stream << json; // write result json to fastcgi stream
+	}
+	catch(ioremap::elliptics::error&) {
+		req->setHeader("Content-Length", "0");
+		req->setStatus(500);
+	}
+	catch(...) {
+		req->setHeader("Content-Length", "0");
+		req->setStatus(400);
+	}
+}
+
+void handler::handle_combine_active_users(fastcgi::Request* req, fastcgi::HandlerContext*)
+{
+	m_logger->debug("Handle combine active users request\n");
+	try {
+		fastcgi::RequestStream stream(req);
+
+		if (!req->hasArg(consts::OP_ITEM))
+			throw std::invalid_argument("Required parameters are missing");
+
+		const auto op = parse_operation(req->getArg(consts::OP_ITEM));
+
+		bool bitmap = false; // whether operands are combined by activity bitmaps instead of the index
+		if (req->hasArg(consts::ENGINE_ITEM)) { // checks optional parameter engine
+			const std::string engine = req->getArg(consts::ENGINE_ITEM);
+			if (engine == "bitmap")
+				bitmap = true;
+			else if (engine != "index")
+				throw std::invalid_argument("Unknown engine");
+		}
+
+		user_list res;
+		std::vector<std::string> operands; // operands are separated by ';', subkeys or begin and end time of operand by ':'
+
+		if (req->hasArg(consts::KEYS_ITEM) &&
+		    !req->getArg(consts::KEYS_ITEM).empty()) { // checks optional parameter keys
+			std::string keys_value = req->getArg(consts::KEYS_ITEM);
+			boost::split(operands, keys_value, boost::is_any_of(";"));
+
+			std::vector<std::vector<std::string>> keys(operands.size());
+			for (size_t index = 0; index < operands.size(); ++index) {
+				boost::split(keys[index], operands[index], boost::is_any_of(":"));
+			}
+
+			res = bitmap ? m_provider->combine_activity_bitmaps(op, keys)
+			             : m_provider->combine_active_users(op, keys); // combines active users by keys
+		}
+		else if (req->hasArg(consts::PERIODS_ITEM)) { // checks optional parameter periods
+			std::string periods_value = req->getArg(consts::PERIODS_ITEM);
+			boost::split(operands, periods_value, boost::is_any_of(";"));
+
+			std::vector<std::pair<uint64_t, uint64_t>> periods;
+			periods.reserve(operands.size());
+			for (auto it = operands.begin(), end = operands.end(); it != end; ++it) {
+				std::vector<std::string> times;
+				boost::split(times, *it, boost::is_any_of(":"));
+				if (times.size() != 2)
+					throw std::invalid_argument("Invalid period");
+
+				periods.emplace_back(boost::lexical_cast<uint64_t>(times[0]),
+				                     boost::lexical_cast<uint64_t>(times[1]));
+			}
+
+			res = bitmap ? m_provider->combine_activity_bitmaps(op, periods)
+			             : m_provider->combine_active_users(op, periods); // combines active users by time periods
+		}
+		else
+			throw std::invalid_argument("Required parameters are missing");
+
+		rapidjson::Document d; // creates document for json serialization
+		d.SetObject();
+
+		rapidjson::Value active_users(rapidjson::kArrayType);
+
+		for (size_t index = 0; index < res.size(); ++index) { // adds all users of the result to json
+			rapidjson::Value user(res.data(index), res.length(index), d.GetAllocator());
+			active_users.PushBack(user, d.GetAllocator());
+		}
+
+		d.AddMember("active_users", active_users, d.GetAllocator());
+
+		rapidjson::StringBuffer buffer; // creates string buffer for serialized json
+		rapidjson::Writer<rapidjson::StringBuffer> writer(buffer); // creates json writer
+		d.Accept(writer); // accepts writer by json document
+
+		auto json = buffer.GetString();
+
+		m_logger->debug("Result json: %s\n", json);
+		req->setHeader("Content-Length", boost::lexical_cast<std::string>(buffer.Size()));
+
+		stream << json; // write result json to fastcgi stream
+	}
+	catch(ioremap::elliptics::error&) {
+		req->setHeader("Content-Length", "0");
+		req->setStatus(500);
+	}
+	catch(...) {
+		req->setHeader("Content-Length", "0");
+		req->setStatus(400);
+	}
+}
+
+void handler::handle_get_user_active_days(fastcgi::Request* req, fastcgi::HandlerContext*)
+{
+	m_logger->debug("Handle get user active days request\n");
+	try {
+		fastcgi::RequestStream stream(req);
+
+		if (!req->hasArg(consts::USER_ITEM) ||
+		    !req->hasArg(consts::BEGIN_TIME_ITEM) ||
+		    !req->hasArg(consts::END_TIME_ITEM))
+			throw std::invalid_argument("Required parameters are missing");
+
+		const auto days = m_provider->get_user_active_days(req->getArg(consts::USER_ITEM),
+		                                                   boost::lexical_cast<uint64_t>(req->getArg(consts::BEGIN_TIME_ITEM)),
+		                                                   boost::lexical_cast<uint64_t>(req->getArg(consts::END_TIME_ITEM)));
+
+		std::string json = "{\"days\":[";
+		for (auto it = days.begin(), end = days.end(); it != end; ++it) {
+			if (it != days.begin())
+				json += ',';
+			json += boost::lexical_cast<std::string>(*it);
+		}
+		json += "]}";
+
+		m_logger->debug("Result json: %s\n", json.c_str());
+		req->setHeader("Content-Length", boost::lexical_cast<std::string>(json.size()));
+
+		stream << json; // write result json to fastcgi stream
+	}
+	catch(ioremap::elliptics::error&) {
+		req->setHeader("Content-Length", "0");
+		req->setStatus(500);
+	}
+	catch(...) {
+		req->setHeader("Content-Length", "0");
+		req->setStatus(400);
+	}
+}
+
+void handler::handle_get_day_stats(fastcgi::Request* req, fastcgi::HandlerContext*)
+{
+	m_logger->debug("Handle get day stats request\n");
+	try {
+		fastcgi::RequestStream stream(req);
+
+		day_stats stats;
+
+		if (req->hasArg(consts::KEYS_ITEM) &&
+		    !req->getArg(consts::KEYS_ITEM).empty()) { // checks optional parameter key
+			std::string keys_value = req->getArg(consts::KEYS_ITEM);
+			std::vector<std::string> keys;
+			boost::split(keys, keys_value, boost::is_any_of(":"));
+
+			stats = m_provider->get_day_stats(keys); // sums counters of keys
+		}
+		else if(req->hasArg(consts::BEGIN_TIME_ITEM) &&
+		        req->hasArg(consts::END_TIME_ITEM)) { // checks optional parameter time
+			stats = m_provider->get_day_stats(boost::lexical_cast<uint64_t>(req->getArg(consts::BEGIN_TIME_ITEM)),
+			                                  boost::lexical_cast<uint64_t>(req->getArg(consts::END_TIME_ITEM))); // sums counters of days
+		}
+		else
+			throw std::invalid_argument("Required parameters are missing");
+
+		const std::string json = "{\"records\":" + boost::lexical_cast<std::string>(stats.records) +
+		                         ",\"bytes\":" + boost::lexical_cast<std::string>(stats.bytes) +
+		                         ",\"users\":" + boost::lexical_cast<std::string>(stats.users) + "}";
+
+		m_logger->debug("Result json: %s\n", json.c_str());
+		req->setHeader("Content-Length", boost::lexical_cast<std::string>(json.size()));
+
+		stream << json; // write result json to fastcgi stream
+	}
+	catch(ioremap::elliptics::error&) {
+		req->setHeader("Content-Length", "0");
+		req->setStatus(500);
+	}
+	catch(...) {
+		req->setHeader("Content-Length", "0");
+		req->setStatus(400);
+	}
+}
+
 FCGIDAEMON_REGISTER_FACTORIES_BEGIN()
 	FCGIDAEMON_ADD_DEFAULT_FACTORY("historydb", handler)
 FCGIDAEMON_REGISTER_FACTORIES_END()
@@ -56,6 +56,10 @@ namespace fcgi {
 		void handle_add_log_with_activity(fastcgi::Request* req, fastcgi::HandlerContext* context);
 		void handle_get_active_users(fastcgi::Request* req, fastcgi::HandlerContext* context); // handle get active user request
 		void handle_get_user_logs(fastcgi::Request* req, fastcgi::HandlerContext* context); // handle get user logs request
+		void handle_count_active_users(fastcgi::Request* req, fastcgi::HandlerContext* context); // handle count active users request
+		void handle_combine_active_users(fastcgi::Request* req, fastcgi::HandlerContext* context); // handle set operation over active users request
+		void handle_get_user_active_days(fastcgi::Request* req, fastcgi::HandlerContext* context); // handle get user active days request
+		void handle_get_day_stats(fastcgi::Request* req, fastcgi::HandlerContext* context); // handle get day stats request
 
 		fastcgi::Logger*	m_logger;
 		std::shared_ptr<history::provider>	m_provider;
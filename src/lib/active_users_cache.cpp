@@ -0,0 +1,99 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include "active_users_cache.h"
+
+namespace history {
+
+active_users_cache::active_users_cache(size_t max_size)
+: max_size_(max_size)
+, size_(0)
+, hits_(0)
+, misses_(0)
+, evictions_(0)
+{}
+
+std::shared_ptr<const user_list> active_users_cache::get(const std::string &subkey)
+{
+	boost::mutex::scoped_lock lock(mutex_);
+
+	auto it = days_.find(subkey);
+	if (it == days_.end()) {
+		++misses_;
+		return std::shared_ptr<const user_list>();
+	}
+
+	lru_.splice(lru_.begin(), lru_, it->second); // moves the day to the head of lru
+	++hits_;
+	return it->second->second;
+}
+
+void active_users_cache::insert(const std::string &subkey, std::shared_ptr<const user_list> users)
+{
+	if (users->memory() > max_size_) // the day is too big for the cache
+		return;
+
+	boost::mutex::scoped_lock lock(mutex_);
+
+	auto it = days_.find(subkey);
+	if (it != days_.end())
+		erase(it->second);
+
+	lru_.push_front(std::make_pair(subkey, users));
+	days_.insert(std::make_pair(subkey, lru_.begin()));
+	size_ += subkey.size() + users->memory();
+
+	while (size_ > max_size_) {
+		erase(--lru_.end());
+		++evictions_;
+	}
+}
+
+void active_users_cache::remove(const std::string &subkey)
+{
+	boost::mutex::scoped_lock lock(mutex_);
+
+	auto it = days_.find(subkey);
+	if (it != days_.end())
+		erase(it->second);
+}
+
+void active_users_cache::clear()
+{
+	boost::mutex::scoped_lock lock(mutex_);
+
+	evictions_ += lru_.size();
+	lru_.clear();
+	days_.clear();
+	size_ = 0;
+}
+
+cache_stats active_users_cache::stats()
+{
+	boost::mutex::scoped_lock lock(mutex_);
+
+	cache_stats ret = {hits_, misses_, evictions_, size_};
+	return ret;
+}
+
+void active_users_cache::erase(lru_t::iterator it)
+{
+	size_ -= it->first.size() + it->second->memory();
+	days_.erase(it->first);
+	lru_.erase(it);
+}
+
+} /* namespace history */
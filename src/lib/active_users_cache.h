@@ -0,0 +1,67 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#ifndef HISTORY_SRC_LIB_ACTIVE_USERS_CACHE_H
+#define HISTORY_SRC_LIB_ACTIVE_USERS_CACHE_H
+
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+
+#include <boost/thread/mutex.hpp>
+
+#include "historydb/provider.h"
+#include "historydb/user_list.h"
+
+namespace history {
+
+/* Keeps active users of closed days by subkeys.
+	If the cache exceeds max_size, least recently used days are evicted.
+*/
+class active_users_cache
+{
+public:
+	active_users_cache(size_t max_size);
+
+	std::shared_ptr<const user_list> get(const std::string &subkey); // returns null and counts miss if the day isn't cached
+	void insert(const std::string &subkey, std::shared_ptr<const user_list> users);
+	void remove(const std::string &subkey);
+	void clear();
+
+	cache_stats stats();
+
+private:
+	active_users_cache(const active_users_cache&) = delete;
+	active_users_cache& operator=(const active_users_cache&) = delete;
+
+	typedef std::list<std::pair<std::string, std::shared_ptr<const user_list>>> lru_t;
+
+	void erase(lru_t::iterator it);
+
+	const size_t							max_size_; // maximum memory which could be used by the cache
+	lru_t									lru_; // days in order of usage, most recently used first
+	std::map<std::string, lru_t::iterator>	days_; // positions of days in lru_ by subkeys
+	size_t									size_; // estimated memory used by the cache
+	uint64_t								hits_;
+	uint64_t								misses_;
+	uint64_t								evictions_; // number of evicted days
+	boost::mutex							mutex_;
+};
+
+} /* namespace history */
+
+#endif //HISTORY_SRC_LIB_ACTIVE_USERS_CACHE_H
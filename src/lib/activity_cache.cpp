@@ -0,0 +1,123 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include "activity_cache.h"
+
+#include <functional>
+
+namespace history {
+
+namespace consts {
+	const size_t ENTRY_OVERHEAD = sizeof(std::string) + 4 * sizeof(void*); // estimated memory overhead of one user in a set
+}
+
+activity_cache::activity_cache(size_t max_size)
+: shard_max_size_(max_size / SHARDS)
+{}
+
+bool activity_cache::contains(const std::string &user, const std::string &subkey)
+{
+	auto &s = get_shard(user);
+	boost::mutex::scoped_lock lock(s.mutex);
+
+	auto it = s.days.find(subkey);
+	if (it != s.days.end() && it->second.users.count(user)) {
+		++s.hits;
+		return true;
+	}
+
+	++s.misses;
+	return false;
+}
+
+void activity_cache::insert(const std::string &user, const std::string &subkey)
+{
+	auto &s = get_shard(user);
+	boost::mutex::scoped_lock lock(s.mutex);
+
+	auto it = s.days.find(subkey);
+	if (it == s.days.end()) {
+		it = s.days.insert(std::make_pair(subkey, day())).first;
+		it->second.generation = s.generation++;
+		s.size += subkey.size() + consts::ENTRY_OVERHEAD;
+	}
+
+	if (it->second.users.insert(user).second)
+		s.size += user.size() + consts::ENTRY_OVERHEAD;
+
+	if (s.size > shard_max_size_)
+		evict(s, subkey);
+}
+
+void activity_cache::clear()
+{
+	for (auto it = shards_, end = shards_ + SHARDS; it != end; ++it) {
+		boost::mutex::scoped_lock lock(it->mutex);
+		for (auto d = it->days.begin(), d_end = it->days.end(); d != d_end; ++d) {
+			it->evictions += d->second.users.size();
+		}
+		it->days.clear();
+		it->size = 0;
+	}
+}
+
+cache_stats activity_cache::stats()
+{
+	cache_stats ret = {0, 0, 0, 0};
+
+	for (auto it = shards_, end = shards_ + SHARDS; it != end; ++it) {
+		boost::mutex::scoped_lock lock(it->mutex);
+		ret.hits += it->hits;
+		ret.misses += it->misses;
+		ret.evictions += it->evictions;
+		ret.size += it->size;
+	}
+
+	return ret;
+}
+
+activity_cache::shard &activity_cache::get_shard(const std::string &user)
+{
+	return shards_[std::hash<std::string>()(user) % SHARDS];
+}
+
+void activity_cache::evict(shard &s, const std::string &keep)
+{
+	while (s.size > shard_max_size_) {
+		auto oldest = s.days.end();
+		for (auto it = s.days.begin(), end = s.days.end(); it != end; ++it) {
+			if (it->first != keep &&
+			    (oldest == end || it->second.generation < oldest->second.generation))
+				oldest = it;
+		}
+
+		if (oldest == s.days.end()) { // only current subkey is left - drops it
+			s.evictions += s.days.size() ? s.days.begin()->second.users.size() : 0;
+			s.days.clear();
+			s.size = 0;
+			return;
+		}
+
+		for (auto it = oldest->second.users.begin(), end = oldest->second.users.end(); it != end; ++it) {
+			s.size -= it->size() + consts::ENTRY_OVERHEAD;
+		}
+		s.size -= oldest->first.size() + consts::ENTRY_OVERHEAD;
+		s.evictions += oldest->second.users.size();
+		s.days.erase(oldest);
+	}
+}
+
+} /* namespace history */
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#ifndef HISTORY_SRC_LIB_ACTIVITY_CACHE_H
+#define HISTORY_SRC_LIB_ACTIVITY_CACHE_H
+
+#include <map>
+#include <string>
+#include <unordered_set>
+
+#include <boost/thread/mutex.hpp>
+
+#include "historydb/provider.h"
+
+namespace history {
+
+/* Remembers users which have been already marked as active for subkeys.
+	Users are kept in per-subkey sets which are split into shards by user name.
+	If shard exceeds its part of max_size, sets of the oldest subkeys are evicted from it.
+*/
+class activity_cache
+{
+public:
+	activity_cache(size_t max_size);
+
+	bool contains(const std::string &user, const std::string &subkey); // checks and counts hit or miss
+	void insert(const std::string &user, const std::string &subkey);
+	void clear();
+
+	cache_stats stats();
+
+private:
+	activity_cache(const activity_cache&) = delete;
+	activity_cache& operator=(const activity_cache&) = delete;
+
+	struct day
+	{
+		std::unordered_set<std::string>	users; // users which are active in the subkey
+		uint64_t						generation; // order of the subkey creation in the shard
+	};
+
+	struct shard
+	{
+		shard() : generation(0), size(0), hits(0), misses(0), evictions(0) {}
+
+		std::map<std::string, day>	days; // active users by subkeys
+		uint64_t					generation; // generation of the next subkey
+		size_t						size; // estimated memory used by the shard
+		uint64_t					hits;
+		uint64_t					misses;
+		uint64_t					evictions; // number of evicted users
+		boost::mutex				mutex;
+	};
+
+	shard &get_shard(const std::string &user);
+	void evict(shard &s, const std::string &keep);
+
+	static const size_t	SHARDS = 16; // number of shards
+
+	const size_t		shard_max_size_; // maximum memory which could be used by one shard
+	shard				shards_[SHARDS];
+};
+
+} /* namespace history */
+
+#endif //HISTORY_SRC_LIB_ACTIVITY_CACHE_H
@@ -0,0 +1,166 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#include "activity_calendar.h"
+
+#include <algorithm>
+#include <ctime>
+
+#include <string.h>
+
+namespace history {
+
+namespace consts {
+	const uint32_t CALENDAR_MAGIC = 0x31414348; // "HCA1" - format of serialized calendar
+	const uint32_t DAYS_IN_WORD = 64; // number of days in one word of bitset
+	const uint32_t SECONDS_IN_DAY = 24 * 60 * 60;
+}
+
+activity_calendar::activity_calendar()
+: since_(UINT32_MAX)
+, first_(0)
+{}
+
+bool activity_calendar::add(uint32_t day)
+{
+	if (since_ == UINT32_MAX)
+		since_ = ::time(NULL) / consts::SECONDS_IN_DAY; // earlier days could have been written before the calendar
+
+	if (day == UINT32_MAX || !extend(day, day + 1)) // bogus day isn't allowed to grow the bitset
+		return false;
+
+	uint64_t &word = words_[(day - first_) / consts::DAYS_IN_WORD];
+	const uint64_t bit = 1ULL << ((day - first_) % consts::DAYS_IN_WORD);
+	if (word & bit)
+		return false;
+
+	word |= bit;
+	return true;
+}
+
+bool activity_calendar::merge(const activity_calendar &other)
+{
+	bool changed = other.since_ < since_;
+	since_ = std::min(since_, other.since_); // both calendars are maintained since their days
+
+	if (other.words_.empty())
+		return changed;
+
+	if (!extend(other.first_, other.first_ + other.words_.size() * consts::DAYS_IN_WORD))
+		return changed; // days of the other calendar don't fit the span of the bitset
+
+	const size_t offset = (other.first_ - first_) / consts::DAYS_IN_WORD;
+	for (size_t index = 0; index < other.words_.size(); ++index) {
+		const uint64_t word = words_[offset + index] | other.words_[index];
+		changed |= (word != words_[offset + index]);
+		words_[offset + index] = word;
+	}
+
+	return changed;
+}
+
+bool activity_calendar::contains(uint32_t day) const
+{
+	if (day < first_ || day - first_ >= words_.size() * consts::DAYS_IN_WORD)
+		return false;
+
+	return (words_[(day - first_) / consts::DAYS_IN_WORD] >> ((day - first_) % consts::DAYS_IN_WORD)) & 1;
+}
+
+std::vector<uint64_t> activity_calendar::days(uint64_t begin, uint64_t end) const
+{
+	std::vector<uint64_t> ret;
+
+	const uint64_t last = static_cast<uint64_t>(first_) + words_.size() * consts::DAYS_IN_WORD;
+	begin = std::max<uint64_t>(begin, first_);
+	end = std::min(end, last);
+
+	for (uint64_t day = begin; day < end; ++day) {
+		if (contains(day))
+			ret.push_back(day);
+	}
+
+	return ret;
+}
+
+bool activity_calendar::load(const ioremap::elliptics::data_pointer &data)
+{
+	uint32_t header[4]; // magic, since, first day and number of words
+	if (data.size() < sizeof(header))
+		return false;
+
+	memcpy(header, data.data(), sizeof(header));
+
+	if (header[0] != consts::CALENDAR_MAGIC ||
+	    header[2] % consts::DAYS_IN_WORD != 0 ||
+	    header[3] > MAX_DAYS / consts::DAYS_IN_WORD ||
+	    data.size() != sizeof(header) + header[3] * sizeof(uint64_t) ||
+	    static_cast<uint64_t>(header[2]) + static_cast<uint64_t>(header[3]) * consts::DAYS_IN_WORD > UINT32_MAX)
+		return false;
+
+	activity_calendar loaded;
+	loaded.since_ = header[1];
+	loaded.first_ = header[2];
+	loaded.words_.resize(header[3]);
+	memcpy(loaded.words_.data(), data.data<char>() + sizeof(header), header[3] * sizeof(uint64_t));
+
+	merge(loaded);
+	return true;
+}
+
+ioremap::elliptics::data_pointer activity_calendar::save() const
+{
+	const uint32_t header[4] = {consts::CALENDAR_MAGIC, since_, first_, static_cast<uint32_t>(words_.size())};
+
+	auto ret = ioremap::elliptics::data_pointer::allocate(sizeof(header) + words_.size() * sizeof(uint64_t));
+	memcpy(ret.data(), header, sizeof(header));
+	if (!words_.empty())
+		memcpy(ret.data<char>() + sizeof(header), words_.data(), words_.size() * sizeof(uint64_t));
+
+	return ret;
+}
+
+bool activity_calendar::extend(uint32_t first, uint32_t end)
+{
+	first -= first % consts::DAYS_IN_WORD;
+
+	if (words_.empty()) {
+		if (end - first > MAX_DAYS)
+			return false;
+
+		first_ = first;
+		words_.assign((end - first + consts::DAYS_IN_WORD - 1) / consts::DAYS_IN_WORD, 0);
+		return true;
+	}
+
+	const uint64_t last = static_cast<uint64_t>(first_) + words_.size() * consts::DAYS_IN_WORD;
+	if (std::max<uint64_t>(last, end) - std::min(first_, first) > MAX_DAYS)
+		return false;
+
+	if (first < first_) { // prepends words of earlier days
+		words_.insert(words_.begin(), (first_ - first) / consts::DAYS_IN_WORD, 0);
+		first_ = first;
+	}
+
+	const size_t size = (end - first_ + consts::DAYS_IN_WORD - 1) / consts::DAYS_IN_WORD;
+	if (size > words_.size())
+		words_.resize(size, 0);
+
+	return true;
+}
+
+} /* namespace history */
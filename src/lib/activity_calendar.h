@@ -0,0 +1,60 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#ifndef HISTORY_SRC_LIB_ACTIVITY_CALENDAR_H
+#define HISTORY_SRC_LIB_ACTIVITY_CALENDAR_H
+
+#include <stdint.h>
+#include <vector>
+
+#include <elliptics/utils.hpp>
+
+namespace history {
+
+/* Days (since epoch) on which the user has been active or has written logs.
+	Days are kept as bitset which starts from the day aligned to 64, so calendar of several years takes few hundreds bytes.
+	Bitset covers at most MAX_DAYS days, days which don't fit it are ignored.
+	Calendar also keeps the day since which it is maintained, earlier days are unknown.
+	Calendars are buffered and could lose days, so absence of the day doesn't mean that the user has no logs in it.
+*/
+class activity_calendar
+{
+public:
+	activity_calendar();
+
+	bool add(uint32_t day); // adds the day, maintenance of new calendar starts from the current day; returns true if the calendar has been changed
+	bool merge(const activity_calendar &other); // returns true if the calendar has been changed
+
+	bool contains(uint32_t day) const;
+	std::vector<uint64_t> days(uint64_t begin, uint64_t end) const; // days of the calendar in [begin, end)
+
+	bool load(const ioremap::elliptics::data_pointer &data); // merges serialized calendar, returns false if data isn't valid calendar
+	ioremap::elliptics::data_pointer save() const;
+
+	static const uint32_t MAX_DAYS = 64 * 1024; // maximum span of bitset, about 179 years
+
+private:
+	bool extend(uint32_t first, uint32_t end); // extends bitset to cover days [first, end), returns false if the span exceeds MAX_DAYS
+
+	uint32_t				since_; // the day since which the calendar is maintained, UINT32_MAX if the calendar is empty
+	uint32_t				first_; // the first day of bitset, multiple of 64
+	std::vector<uint64_t>	words_; // bits of days starting from first_
+};
+
+} /* namespace history */
+
+#endif //HISTORY_SRC_LIB_ACTIVITY_CALENDAR_H
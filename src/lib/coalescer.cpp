@@ -0,0 +1,149 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include "coalescer.h"
+
+#include <string.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread_time.hpp>
+
+namespace history {
+
+coalescer::coalescer(write_t write, uint32_t window, uint32_t max_bytes)
+: write_(write)
+, window_(window)
+, max_bytes_(max_bytes)
+, stop_(false)
+{
+	thread_ = boost::thread(boost::bind(&coalescer::run, this));
+}
+
+coalescer::~coalescer()
+{
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		stop_ = true;
+	}
+	cond_.notify_all();
+	thread_.join();
+
+	flush(); // writes appends which were buffered while the thread was stopping
+}
+
+void coalescer::append(const std::string &key,
+                       const ioremap::elliptics::data_pointer &data,
+                       handler_t handler)
+{
+	pending ready;
+
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+
+		auto &p = pending_[key];
+		if (p.datas.empty())
+			p.created = boost::get_system_time();
+
+		p.datas.push_back(data);
+		p.handlers.push_back(handler);
+		p.size += data.size();
+
+		if (p.size < max_bytes_)
+			return;
+
+		std::swap(ready, p); // threshold is reached - the key should be written right now
+		pending_.erase(key);
+	}
+
+	write(key, ready);
+}
+
+void coalescer::flush()
+{
+	std::map<std::string, pending> ready;
+
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		std::swap(ready, pending_);
+	}
+
+	for (auto it = ready.begin(), end = ready.end(); it != end; ++it) {
+		write(it->first, it->second);
+	}
+}
+
+void coalescer::run()
+{
+	boost::mutex::scoped_lock lock(mutex_);
+
+	while (!stop_) {
+		cond_.timed_wait(lock, boost::get_system_time() + window_);
+
+		const auto deadline = boost::get_system_time() - window_;
+		std::map<std::string, pending> ready;
+
+		for (auto it = pending_.begin(); it != pending_.end();) {
+			if (it->second.created <= deadline) {
+				std::swap(ready[it->first], it->second);
+				pending_.erase(it++);
+			}
+			else
+				++it;
+		}
+
+		if (ready.empty())
+			continue;
+
+		lock.unlock(); // writes expired keys without blocking appenders
+
+		for (auto it = ready.begin(), end = ready.end(); it != end; ++it) {
+			write(it->first, it->second);
+		}
+
+		lock.lock();
+	}
+}
+
+void coalescer::write(const std::string &key, pending &p)
+{
+	auto data = p.datas.front();
+
+	if (p.datas.size() > 1) { // merges all buffered appends into one buffer
+		data = ioremap::elliptics::data_pointer::allocate(p.size);
+		size_t offset = 0;
+		for (auto it = p.datas.begin(), end = p.datas.end(); it != end; ++it) {
+			memcpy(data.data<char>() + offset, it->data(), it->size());
+			offset += it->size();
+		}
+	}
+
+	auto handlers = std::make_shared<std::vector<handler_t>>();
+	handlers->swap(p.handlers);
+
+	write_(key, data,
+	       boost::bind(&coalescer::on_written,
+	                   handlers,
+	                   _1));
+}
+
+void coalescer::on_written(std::shared_ptr<std::vector<handler_t>> handlers, const write_result &res)
+{
+	for (auto it = handlers->begin(), end = handlers->end(); it != end; ++it) {
+		(*it)(res);
+	}
+}
+
+} /* namespace history */
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#ifndef HISTORY_SRC_LIB_COALESCER_H
+#define HISTORY_SRC_LIB_COALESCER_H
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <elliptics/utils.hpp>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include "storage.h"
+
+namespace history {
+
+/* Buffers appends to the same key and writes them with one append.
+	Appends of one key are buffered until the oldest of them waits for window milliseconds
+	or until buffered data reaches max_bytes. Result of the merged write is passed to handlers of all merged appends.
+*/
+class coalescer
+{
+public:
+	typedef storage::write_handler_t handler_t;
+	typedef std::function<void(const std::string &key,
+	                           const ioremap::elliptics::data_pointer &data,
+	                           handler_t handler)> write_t;
+
+	coalescer(write_t write, uint32_t window, uint32_t max_bytes);
+	~coalescer(); // writes all buffered appends
+
+	/* Buffers data which should be appended to key
+		key - key of the record
+		data - data which should be appended
+		handler - handler which will be called with result of the merged write
+	*/
+	void append(const std::string &key,
+	            const ioremap::elliptics::data_pointer &data,
+	            handler_t handler);
+
+	void flush(); // writes all buffered appends immediately
+
+private:
+	coalescer(const coalescer&) = delete;
+	coalescer& operator=(const coalescer&) = delete;
+
+	struct pending
+	{
+		pending() : size(0) {}
+
+		std::vector<ioremap::elliptics::data_pointer>	datas; // buffered appends in arrival order
+		std::vector<handler_t>							handlers; // handlers of buffered appends
+		size_t											size; // total size of buffered appends
+		boost::system_time								created; // time of the first buffered append
+	};
+
+	void run(); // flushing thread body
+	void write(const std::string &key, pending &p);
+
+	static void on_written(std::shared_ptr<std::vector<handler_t>> handlers, const write_result &res);
+
+	write_t								write_; // writes merged data into storage
+	boost::posix_time::milliseconds		window_; // maximum time of buffering
+	uint32_t							max_bytes_; // maximum size of buffered data for one key
+	bool								stop_;
+	std::map<std::string, pending>		pending_; // buffered appends by keys
+	boost::mutex						mutex_;
+	boost::condition_variable			cond_;
+	boost::thread						thread_;
+};
+
+} /* namespace history */
+
+#endif //HISTORY_SRC_LIB_COALESCER_H
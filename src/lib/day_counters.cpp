@@ -0,0 +1,88 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#include "day_counters.h"
+
+#include <string.h>
+
+namespace history {
+
+namespace consts {
+	const uint32_t DAY_COUNTERS_MAGIC = 0x31534448; // "HDS1" - format of serialized counters
+	const size_t DAY_COUNTERS_HEADER = sizeof(uint32_t) + 2 * sizeof(uint64_t); // magic, records and bytes
+}
+
+day_counters::day_counters()
+: records_(0)
+, bytes_(0)
+{}
+
+bool day_counters::add(const record &r)
+{
+	++records_;
+	bytes_ += r.size;
+	users_.add(r.user);
+	return true;
+}
+
+bool day_counters::merge(const day_counters &other)
+{
+	records_ += other.records_;
+	bytes_ += other.bytes_;
+	return users_.merge(other.users_) || other.records_ != 0;
+}
+
+bool day_counters::load(const ioremap::elliptics::data_pointer &data)
+{
+	uint32_t magic;
+	if (data.size() < consts::DAY_COUNTERS_HEADER)
+		return false;
+
+	memcpy(&magic, data.data(), sizeof(magic));
+	if (magic != consts::DAY_COUNTERS_MAGIC)
+		return false;
+
+	hyperloglog users;
+	if (!users.load(ioremap::elliptics::data_pointer::copy(data.data<char>() + consts::DAY_COUNTERS_HEADER,
+	                                                        data.size() - consts::DAY_COUNTERS_HEADER)))
+		return false;
+
+	uint64_t counters[2];
+	memcpy(counters, data.data<char>() + sizeof(magic), sizeof(counters));
+
+	records_ += counters[0];
+	bytes_ += counters[1];
+	users_.merge(users);
+	return true;
+}
+
+ioremap::elliptics::data_pointer day_counters::save() const
+{
+	const auto users = users_.save();
+
+	auto ret = ioremap::elliptics::data_pointer::allocate(consts::DAY_COUNTERS_HEADER + users.size());
+	char *pos = ret.data<char>();
+
+	memcpy(pos, &consts::DAY_COUNTERS_MAGIC, sizeof(consts::DAY_COUNTERS_MAGIC));
+	memcpy(pos + sizeof(uint32_t), &records_, sizeof(records_));
+	memcpy(pos + sizeof(uint32_t) + sizeof(uint64_t), &bytes_, sizeof(bytes_));
+	memcpy(pos + consts::DAY_COUNTERS_HEADER, users.data(), users.size());
+
+	return ret;
+}
+
+} /* namespace history */
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#ifndef HISTORY_SRC_LIB_DAY_COUNTERS_H
+#define HISTORY_SRC_LIB_DAY_COUNTERS_H
+
+#include <stdint.h>
+#include <string>
+
+#include <elliptics/utils.hpp>
+
+#include "hyperloglog.h"
+
+namespace history {
+
+/* Ingest counters of one day: number of appended records, their size and sketch of users who have appended them.
+	Counters are kept as deltas in memory and are merged with stored counters by summing,
+	so several providers could update the same day.
+*/
+class day_counters
+{
+public:
+	struct record // appended record which is counted
+	{
+		const std::string	&user; // name of user
+		uint64_t			size; // size of appended data
+	};
+
+	day_counters();
+
+	bool add(const record &r); // returns true as counters are always changed
+	bool merge(const day_counters &other); // returns true if counters have been changed
+
+	bool load(const ioremap::elliptics::data_pointer &data); // adds serialized counters, returns false if data isn't valid counters
+	ioremap::elliptics::data_pointer save() const;
+
+	uint64_t records() const { return records_; }
+	uint64_t bytes() const { return bytes_; }
+	uint64_t users() const { return users_.estimate(); } // estimated number of distinct users
+
+private:
+	uint64_t	records_; // number of appended records
+	uint64_t	bytes_; // size of appended records
+	hyperloglog	users_; // users who have appended records
+};
+
+} /* namespace history */
+
+#endif //HISTORY_SRC_LIB_DAY_COUNTERS_H
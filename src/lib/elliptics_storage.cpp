@@ -0,0 +1,238 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#include "elliptics_storage.h"
+
+#include <errno.h>
+
+namespace history {
+
+elliptics_storage::elliptics_storage(ioremap::elliptics::node &node, const std::vector<int> &groups)
+: node_(node)
+, groups_(groups)
+{}
+
+void elliptics_storage::set_groups(const std::vector<int> &groups)
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	groups_ = groups;
+}
+
+void elliptics_storage::append(const std::string &key,
+                               const ioremap::elliptics::data_pointer &data,
+                               write_handler_t handler)
+{
+	auto s = create_session(DNET_IO_FLAGS_CACHE | DNET_IO_FLAGS_APPEND);
+
+	s.write_data(key, data, 0)
+	.connect([handler] (const ioremap::elliptics::sync_write_result &res, const ioremap::elliptics::error_info &error) {
+		handler(to_write_result(res, error));
+	});
+}
+
+void elliptics_storage::write_cas(const std::string &key, converter_t converter, write_handler_t handler)
+{
+	auto s = create_session(0);
+
+	s.write_cas(key, converter, 0)
+	.connect([handler] (const ioremap::elliptics::sync_write_result &res, const ioremap::elliptics::error_info &error) {
+		handler(to_write_result(res, error));
+	});
+}
+
+void elliptics_storage::read_latest(const std::string &key, uint64_t offset, uint64_t size, read_handler_t handler)
+{
+	auto s = create_session(0);
+
+	s.read_latest(key, offset, size)
+	.connect([handler] (const ioremap::elliptics::sync_read_result &entry, const ioremap::elliptics::error_info &error) {
+		read_result ret;
+
+		try {
+			if (!entry.empty()) {
+				ret.data = entry.front().file();
+				ret.total_size = entry.front().io_attribute()->total_size;
+			}
+			else if (error)
+				ret.error = to_error(error);
+			else
+				ret.error = storage_error(-ENOENT, "object isn't found");
+		}
+		catch (ioremap::elliptics::error& e) {
+			ret.error = storage_error(e.error_code(), e.error_message());
+		}
+
+		handler(ret);
+	});
+}
+
+void elliptics_storage::bulk_read(const std::vector<std::string> &keys, bulk_read_handler_t handler)
+{
+	auto s = create_session(0);
+	auto ids = std::make_shared<ids_t>(transform(s, keys));
+	const size_t size = keys.size();
+
+	s.bulk_read(keys) // elliptics groups keys by destination nodes and sends one request to each node
+	.connect([ids, size, handler] (const ioremap::elliptics::sync_read_result &result, const ioremap::elliptics::error_info &error) {
+		std::vector<read_result> ret(size);
+		std::vector<bool> found(size, false);
+
+		for (auto it = result.begin(), end = result.end(); it != end; ++it) {
+			try {
+				if (it->status() != 0)
+					continue;
+
+				auto id = ids->find(std::string(reinterpret_cast<const char*>(it->command()->id.id), DNET_ID_SIZE));
+				if (id == ids->end())
+					continue;
+
+				ret[id->second].data = it->file();
+				ret[id->second].total_size = it->io_attribute()->total_size;
+				found[id->second] = true;
+			}
+			catch (ioremap::elliptics::error& e) {}
+		}
+
+		// keys which aren't found get the error of the bulk read if it has failed on some nodes
+		const auto missed = error ? to_error(error) : storage_error(-ENOENT, "object isn't found");
+		for (size_t index = 0; index < size; ++index) {
+			if (!found[index])
+				ret[index].error = missed;
+		}
+
+		handler(ret);
+	});
+}
+
+void elliptics_storage::update_indexes(const std::string &key,
+                                       const std::vector<std::string> &indexes,
+                                       const std::vector<ioremap::elliptics::data_pointer> &datas,
+                                       write_handler_t handler)
+{
+	auto s = create_session(DNET_IO_FLAGS_CACHE);
+
+	s.update_indexes_internal(key, indexes, datas)
+	.connect([handler] (const ioremap::elliptics::sync_set_indexes_result &res, const ioremap::elliptics::error_info &error) {
+		handler(to_index_result(res, error));
+	});
+}
+
+void elliptics_storage::remove_indexes(const std::string &key,
+                                       const std::vector<std::string> &indexes,
+                                       write_handler_t handler)
+{
+	auto s = create_session(DNET_IO_FLAGS_CACHE);
+
+	s.remove_indexes_internal(key, indexes)
+	.connect([handler] (const ioremap::elliptics::sync_set_indexes_result &res, const ioremap::elliptics::error_info &error) {
+		handler(to_index_result(res, error));
+	});
+}
+
+void elliptics_storage::find_any_indexes(const std::vector<std::string> &indexes,
+                                         entry_handler_t on_entry,
+                                         complete_handler_t on_complete)
+{
+	auto s = create_session(0);
+	auto ids = std::make_shared<ids_t>(transform(s, indexes));
+	auto names = std::make_shared<std::vector<std::string>>(indexes);
+
+	s.find_any_indexes(indexes)
+	.connect([ids, names, on_entry] (const ioremap::elliptics::find_indexes_result_entry &entry) {
+	             found_entry ret;
+	             ret.indexes.reserve(entry.indexes.size());
+
+	             for (auto it = entry.indexes.begin(), end = entry.indexes.end(); it != end; ++it) {
+	                 found_index index;
+	                 auto id = ids->find(std::string(reinterpret_cast<const char*>(it->index.id), DNET_ID_SIZE));
+	                 if (id != ids->end()) // elliptics returns ids of indexes, so names are restored from requested indexes
+	                     index.name = (*names)[id->second];
+	                 index.data = it->data;
+	                 ret.indexes.push_back(index);
+	             }
+
+	             on_entry(ret);
+	         },
+	         [on_complete] (const ioremap::elliptics::error_info &error) {
+	             on_complete(to_error(error));
+	         });
+}
+
+ioremap::elliptics::session elliptics_storage::create_session(uint32_t io_flags) const
+{
+	auto ret = ioremap::elliptics::session(node_);
+
+	ret.set_ioflags(io_flags);
+	ret.set_cflags(0);
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		ret.set_groups(groups_); // sets groups
+	}
+	ret.set_exceptions_policy(ioremap::elliptics::session::exceptions_policy::no_exceptions);
+
+	return ret;
+}
+
+elliptics_storage::ids_t elliptics_storage::transform(const ioremap::elliptics::session &s,
+                                                      const std::vector<std::string> &names) const
+{
+	ids_t ret;
+
+	for (size_t index = 0; index < names.size(); ++index) {
+		dnet_raw_id id;
+		s.transform(names[index], id);
+		ret.insert(std::make_pair(std::string(reinterpret_cast<const char*>(id.id), DNET_ID_SIZE), index));
+	}
+
+	return ret;
+}
+
+write_result elliptics_storage::to_write_result(const ioremap::elliptics::sync_write_result &res,
+                                                const ioremap::elliptics::error_info &error)
+{
+	write_result ret;
+	ret.written = res.size();
+	ret.error = to_error(error);
+
+	if (!res.empty()) {
+		try {
+			ret.size = res.front().file_info()->size; // size of the object after the write
+		}
+		catch (ioremap::elliptics::error& e) {}
+	}
+
+	return ret;
+}
+
+write_result elliptics_storage::to_index_result(const ioremap::elliptics::sync_set_indexes_result &res,
+                                                const ioremap::elliptics::error_info &error)
+{
+	write_result ret;
+	ret.written = res.size();
+	ret.error = to_error(error);
+	return ret;
+}
+
+storage_error elliptics_storage::to_error(const ioremap::elliptics::error_info &error)
+{
+	if (!error)
+		return storage_error();
+
+	return storage_error(error.code(), error.message());
+}
+
+} /* namespace history */
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#ifndef HISTORY_SRC_LIB_ELLIPTICS_STORAGE_H
+#define HISTORY_SRC_LIB_ELLIPTICS_STORAGE_H
+
+#include <map>
+
+#include <elliptics/cppdef.h>
+
+#include "storage.h"
+
+namespace history {
+
+/* Storage which keeps objects and indexes in elliptics.
+	Appends and index updates go through elliptics cache, reads and compare-and-swap writes use default io flags.
+*/
+class elliptics_storage : public storage
+{
+public:
+	elliptics_storage(ioremap::elliptics::node &node, const std::vector<int> &groups);
+
+	void set_groups(const std::vector<int> &groups);
+
+	void append(const std::string &key,
+	            const ioremap::elliptics::data_pointer &data,
+	            write_handler_t handler);
+	void write_cas(const std::string &key, converter_t converter, write_handler_t handler);
+	void read_latest(const std::string &key, uint64_t offset, uint64_t size, read_handler_t handler);
+	void bulk_read(const std::vector<std::string> &keys, bulk_read_handler_t handler);
+	void update_indexes(const std::string &key,
+	                    const std::vector<std::string> &indexes,
+	                    const std::vector<ioremap::elliptics::data_pointer> &datas,
+	                    write_handler_t handler);
+	void remove_indexes(const std::string &key,
+	                    const std::vector<std::string> &indexes,
+	                    write_handler_t handler);
+
+	using storage::find_any_indexes;
+	void find_any_indexes(const std::vector<std::string> &indexes,
+	                      entry_handler_t on_entry,
+	                      complete_handler_t on_complete);
+
+private:
+	elliptics_storage(const elliptics_storage&) = delete;
+	elliptics_storage& operator=(const elliptics_storage&) = delete;
+
+	typedef std::map<std::string, size_t> ids_t; // positions of keys or indexes by their elliptics ids
+
+	ioremap::elliptics::session create_session(uint32_t io_flags) const;
+	ids_t transform(const ioremap::elliptics::session &s, const std::vector<std::string> &names) const;
+
+	static write_result to_write_result(const ioremap::elliptics::sync_write_result &res,
+	                                    const ioremap::elliptics::error_info &error);
+	static write_result to_index_result(const ioremap::elliptics::sync_set_indexes_result &res,
+	                                    const ioremap::elliptics::error_info &error);
+	static storage_error to_error(const ioremap::elliptics::error_info &error);
+
+	ioremap::elliptics::node	&node_;
+	std::vector<int>			groups_; // groups of elliptics
+	mutable boost::mutex		mutex_; // guards groups_
+};
+
+} /* namespace history */
+
+#endif //HISTORY_SRC_LIB_ELLIPTICS_STORAGE_H
@@ -0,0 +1,183 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include "historydb/framing.h"
+
+#include <string.h>
+
+namespace history { namespace framing {
+
+namespace consts {
+	const uint32_t SECONDS_IN_DAY = 24 * 60 * 60;
+}
+
+static size_t write_varint(uint8_t *out, uint64_t value)
+{
+	size_t size = 0;
+	while (value >= 0x80) {
+		out[size++] = static_cast<uint8_t>(value) | 0x80;
+		value >>= 7;
+	}
+	out[size++] = static_cast<uint8_t>(value);
+	return size;
+}
+
+static bool read_varint(const uint8_t *data, size_t size, size_t &offset, uint64_t &value)
+{
+	value = 0;
+	for (unsigned shift = 0; shift < 64 && offset < size; shift += 7) {
+		const uint8_t byte = data[offset++];
+		value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+	return false; // truncated or too long varint
+}
+
+/* Parses header of framed record at offset, on success offset is moved to the payload */
+static bool read_header(const uint8_t *data, size_t size, size_t &offset, uint8_t &flags, uint64_t &length, uint64_t &time)
+{
+	size_t pos = offset;
+	if (pos + 1 >= size || data[pos++] != RECORD_MARKER)
+		return false;
+
+	flags = data[pos++];
+	if (!read_varint(data, size, pos, length) || !read_varint(data, size, pos, time))
+		return false;
+
+	offset = pos;
+	return true;
+}
+
+ioremap::elliptics::data_pointer pack(uint64_t time, uint8_t flags,
+                                      const ioremap::elliptics::data_pointer &data)
+{
+	uint8_t header[MAX_HEADER_SIZE];
+	size_t header_size = 0;
+
+	header[header_size++] = RECORD_MARKER;
+	header[header_size++] = flags;
+	header_size += write_varint(header + header_size, data.size());
+	header_size += write_varint(header + header_size, (flags & ABSOLUTE_TIME) ? time : time % consts::SECONDS_IN_DAY);
+
+	auto ret = ioremap::elliptics::data_pointer::allocate(header_size + data.size());
+	memcpy(ret.data(), header, header_size);
+	if (!data.empty())
+		memcpy(ret.data<uint8_t>() + header_size, data.data(), data.size());
+
+	return ret;
+}
+
+record_iterator::record_iterator(const ioremap::elliptics::data_pointer &log)
+: log_(log)
+, offset_(0)
+{}
+
+bool record_iterator::next(record &rec)
+{
+	const size_t size = log_.size();
+	if (offset_ >= size)
+		return false;
+
+	const uint8_t *data = log_.data<uint8_t>();
+	size_t pos = offset_;
+	uint8_t flags = 0;
+	uint64_t length = 0, time = 0;
+
+	if (read_header(data, size, pos, flags, length, time) && length <= size - pos) {
+		rec.framed = true;
+		rec.flags = flags;
+		rec.time = time;
+		rec.data = log_.slice(pos, length);
+		offset_ = pos + length;
+		return true;
+	}
+
+	// legacy data hasn't record boundaries - the rest of the log is returned as one record
+	rec.framed = false;
+	rec.flags = 0;
+	rec.time = 0;
+	rec.data = log_.slice(offset_, size - offset_);
+	offset_ = size;
+	return true;
+}
+
+ioremap::elliptics::data_pointer unpack(const ioremap::elliptics::data_pointer &log, bool complete, size_t &consumed)
+{
+	const uint8_t *data = log.data<uint8_t>();
+	const size_t size = log.size();
+	size_t payload_size = 0;
+	consumed = 0;
+
+	while (consumed < size) { // counts payloads of complete records
+		size_t pos = consumed;
+		uint8_t flags;
+		uint64_t length, time;
+		if (!read_header(data, size, pos, flags, length, time) || length > size - pos)
+			break;
+
+		payload_size += length;
+		consumed = pos + length;
+	}
+
+	if (consumed == 0) {
+		if (!complete && size != 0 && data[0] == RECORD_MARKER)
+			return ioremap::elliptics::data_pointer(); // the first record isn't complete
+
+		consumed = size; // legacy log
+		return log;
+	}
+
+	const size_t tail = complete ? size - consumed : 0; // unframed or broken data after records is returned as is
+
+	auto ret = ioremap::elliptics::data_pointer::allocate(payload_size + tail);
+	uint8_t *out = ret.data<uint8_t>();
+
+	for (size_t offset = 0; offset < consumed;) {
+		uint8_t flags;
+		uint64_t length, time;
+		read_header(data, size, offset, flags, length, time);
+		memcpy(out, data + offset, length);
+		out += length;
+		offset += length;
+	}
+
+	if (tail) {
+		memcpy(out, data + consumed, tail);
+		consumed = size;
+	}
+
+	return ret;
+}
+
+ioremap::elliptics::data_pointer unpack(const ioremap::elliptics::data_pointer &log)
+{
+	size_t consumed;
+	return unpack(log, true, consumed);
+}
+
+uint64_t record_size(const ioremap::elliptics::data_pointer &data)
+{
+	size_t pos = 0;
+	uint8_t flags;
+	uint64_t length, time;
+	if (!read_header(data.data<uint8_t>(), data.size(), pos, flags, length, time))
+		return 0;
+
+	return pos + length;
+}
+
+}} /* namespace history::framing */
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#include "historydb/histogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace history {
+
+histogram::histogram()
+{
+	clear();
+}
+
+void histogram::record(uint64_t value)
+{
+	counts_[index(value)].fetch_add(1, std::memory_order_relaxed);
+	count_.fetch_add(1, std::memory_order_relaxed);
+	sum_.fetch_add(value, std::memory_order_relaxed);
+
+	uint64_t current = min_.load(std::memory_order_relaxed);
+	while (value < current && !min_.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+
+	current = max_.load(std::memory_order_relaxed);
+	while (value > current && !max_.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+void histogram::record_exclusive(uint64_t value)
+{
+	auto &bucket = counts_[index(value)];
+	bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	count_.store(count_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	sum_.store(sum_.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+
+	if (value < min_.load(std::memory_order_relaxed))
+		min_.store(value, std::memory_order_relaxed);
+
+	if (value > max_.load(std::memory_order_relaxed))
+		max_.store(value, std::memory_order_relaxed);
+}
+
+void histogram::add(const histogram &other)
+{
+	for (uint32_t i = 0; i < BUCKETS; ++i) {
+		const uint64_t count = other.counts_[i].load(std::memory_order_relaxed);
+		if (count != 0)
+			counts_[i].fetch_add(count, std::memory_order_relaxed);
+	}
+
+	count_.fetch_add(other.count_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	sum_.fetch_add(other.sum_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+	const uint64_t other_min = other.min_.load(std::memory_order_relaxed);
+	uint64_t current = min_.load(std::memory_order_relaxed);
+	while (other_min < current && !min_.compare_exchange_weak(current, other_min, std::memory_order_relaxed)) {}
+
+	const uint64_t other_max = other.max_.load(std::memory_order_relaxed);
+	current = max_.load(std::memory_order_relaxed);
+	while (other_max > current && !max_.compare_exchange_weak(current, other_max, std::memory_order_relaxed)) {}
+}
+
+void histogram::clear()
+{
+	for (uint32_t i = 0; i < BUCKETS; ++i) {
+		counts_[i].store(0, std::memory_order_relaxed);
+	}
+
+	count_.store(0, std::memory_order_relaxed);
+	sum_.store(0, std::memory_order_relaxed);
+	min_.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+	max_.store(0, std::memory_order_relaxed);
+}
+
+uint64_t histogram::count() const
+{
+	return count_.load(std::memory_order_relaxed);
+}
+
+uint64_t histogram::min() const
+{
+	const uint64_t ret = min_.load(std::memory_order_relaxed);
+	return ret == std::numeric_limits<uint64_t>::max() ? 0 : ret;
+}
+
+uint64_t histogram::max() const
+{
+	return max_.load(std::memory_order_relaxed);
+}
+
+double histogram::mean() const
+{
+	const uint64_t count = count_.load(std::memory_order_relaxed);
+	return count == 0 ? 0 : static_cast<double>(sum_.load(std::memory_order_relaxed)) / count;
+}
+
+uint64_t histogram::percentile(double percentile) const
+{
+	const uint64_t count = count_.load(std::memory_order_relaxed);
+	if (count == 0)
+		return 0;
+
+	uint64_t target = static_cast<uint64_t>(std::ceil(percentile / 100 * count));
+	if (target == 0)
+		target = 1;
+
+	uint64_t total = 0;
+	for (uint32_t i = 0; i < BUCKETS; ++i) {
+		total += counts_[i].load(std::memory_order_relaxed);
+		if (total >= target)
+			return std::min(highest_value(i), max()); // the bucket could be wider than recorded values
+	}
+
+	return max(); // counters have been changed by concurrent records
+}
+
+uint32_t histogram::index(uint64_t value)
+{
+	if (value < SUB_COUNT)
+		return value;
+
+	const uint32_t bit = 63 - __builtin_clzll(value); // the highest set bit, it is not less than SUB_BITS
+	const uint32_t shift = bit - SUB_BITS + 1;
+	return SUB_COUNT + (bit - SUB_BITS) * HALF_COUNT + ((value >> shift) - HALF_COUNT);
+}
+
+uint64_t histogram::highest_value(uint32_t index)
+{
+	if (index < SUB_COUNT)
+		return index;
+
+	const uint32_t bit = (index - SUB_COUNT) / HALF_COUNT + SUB_BITS;
+	const uint32_t shift = bit - SUB_BITS + 1;
+	const uint64_t top = (index - SUB_COUNT) % HALF_COUNT + HALF_COUNT;
+	return ((top + 1) << shift) - 1;
+}
+
+} /* namespace history */
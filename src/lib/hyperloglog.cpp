@@ -0,0 +1,122 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#include "hyperloglog.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <string.h>
+
+namespace history {
+
+hyperloglog::hyperloglog()
+: registers_(REGISTERS, 0)
+{}
+
+bool hyperloglog::add(const std::string &user)
+{
+	const uint64_t h = hash(user);
+	const size_t index = h >> (64 - PRECISION); // the highest bits choose the register
+	const uint64_t rest = (h << PRECISION) | (1ULL << (PRECISION - 1)); // the guard bit limits rank by 64 - PRECISION + 1
+
+	uint8_t rank = 1;
+	for (uint64_t bit = 1ULL << 63; !(rest & bit); bit >>= 1) {
+		++rank;
+	}
+
+	if (registers_[index] >= rank)
+		return false;
+
+	registers_[index] = rank;
+	return true;
+}
+
+bool hyperloglog::merge(const hyperloglog &other)
+{
+	bool changed = false;
+
+	for (size_t index = 0; index < REGISTERS; ++index) {
+		if (other.registers_[index] > registers_[index]) {
+			registers_[index] = other.registers_[index];
+			changed = true;
+		}
+	}
+
+	return changed;
+}
+
+bool hyperloglog::load(const ioremap::elliptics::data_pointer &data)
+{
+	if (data.size() != REGISTERS + 1 || *data.data<uint8_t>() != PRECISION)
+		return false;
+
+	const uint8_t *registers = data.data<uint8_t>() + 1;
+	for (size_t index = 0; index < REGISTERS; ++index) {
+		registers_[index] = std::max(registers_[index], registers[index]);
+	}
+
+	return true;
+}
+
+ioremap::elliptics::data_pointer hyperloglog::save() const
+{
+	auto ret = ioremap::elliptics::data_pointer::allocate(REGISTERS + 1);
+	*ret.data<uint8_t>() = PRECISION;
+	memcpy(ret.data<uint8_t>() + 1, registers_.data(), REGISTERS);
+	return ret;
+}
+
+uint64_t hyperloglog::estimate() const
+{
+	const double m = REGISTERS;
+	const double alpha = 0.7213 / (1 + 1.079 / m);
+
+	double sum = 0;
+	size_t zeros = 0;
+	for (auto it = registers_.begin(), end = registers_.end(); it != end; ++it) {
+		sum += std::ldexp(1.0, -*it);
+		if (*it == 0)
+			++zeros;
+	}
+
+	double ret = alpha * m * m / sum;
+
+	if (ret <= 2.5 * m && zeros != 0) // linear counting is more accurate for small cardinalities
+		ret = m * std::log(m / zeros);
+
+	return static_cast<uint64_t>(ret + 0.5);
+}
+
+uint64_t hyperloglog::hash(const std::string &user)
+{
+	uint64_t h = 14695981039346656037ULL; // FNV-1a
+	for (auto it = user.begin(), end = user.end(); it != end; ++it) {
+		h ^= static_cast<unsigned char>(*it);
+		h *= 1099511628211ULL;
+	}
+
+	h ^= h >> 33; // finalizer of MurmurHash3 spreads FNV-1a bits over the whole word
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+
+	return h;
+}
+
+} /* namespace history */
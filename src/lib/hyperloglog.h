@@ -0,0 +1,57 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#ifndef HISTORY_SRC_LIB_HYPERLOGLOG_H
+#define HISTORY_SRC_LIB_HYPERLOGLOG_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <elliptics/utils.hpp>
+
+namespace history {
+
+/* HyperLogLog sketch which estimates number of unique users with fixed memory.
+	Sketch has 2^PRECISION one-byte registers, standard error of estimation is about 1.6%.
+	Serialized sketch is precision byte followed by registers, so sketches are merged by maximum of registers.
+*/
+class hyperloglog
+{
+public:
+	static const uint8_t	PRECISION = 12;
+	static const size_t		REGISTERS = 1 << PRECISION;
+
+	hyperloglog();
+
+	bool add(const std::string &user); // returns true if the sketch has been changed
+	bool merge(const hyperloglog &other); // returns true if the sketch has been changed
+
+	bool load(const ioremap::elliptics::data_pointer &data); // merges serialized sketch, returns false if data isn't valid sketch
+	ioremap::elliptics::data_pointer save() const;
+
+	uint64_t estimate() const;
+
+private:
+	static uint64_t hash(const std::string &user); // hash which is the same in all processes and builds
+
+	std::vector<uint8_t>	registers_; // maximum rank of hashes per register
+};
+
+} /* namespace history */
+
+#endif //HISTORY_SRC_LIB_HYPERLOGLOG_H
@@ -0,0 +1,147 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include "log_cache.h"
+
+#include <functional>
+
+namespace history {
+
+namespace consts {
+	const size_t LOG_ENTRY_OVERHEAD = 2 * sizeof(std::string) + sizeof(ioremap::elliptics::data_pointer) + 6 * sizeof(void*); // estimated memory overhead of lru and map nodes of one cached log
+}
+
+log_cache::log_cache(size_t max_size)
+: shard_max_size_(max_size / SHARDS)
+{}
+
+bool log_cache::get(const std::string &key, ioremap::elliptics::data_pointer &data)
+{
+	auto &s = get_shard(key);
+	boost::mutex::scoped_lock lock(s.mutex);
+
+	auto it = s.entries.find(key);
+	if (it == s.entries.end()) {
+		++s.misses;
+		return false;
+	}
+
+	s.lru.splice(s.lru.begin(), s.lru, it->second); // moves the log to the head of lru
+	data = it->second->second;
+	++s.hits;
+	return true;
+}
+
+uint64_t log_cache::generation(const std::string &key)
+{
+	auto &s = get_shard(key);
+	boost::mutex::scoped_lock lock(s.mutex);
+	return s.removals;
+}
+
+void log_cache::insert(const std::string &key, const ioremap::elliptics::data_pointer &data)
+{
+	const size_t entry_size = key.size() + data.size() + consts::LOG_ENTRY_OVERHEAD;
+	if (entry_size > shard_max_size_) // the log is too big for the cache
+		return;
+
+	auto &s = get_shard(key);
+	boost::mutex::scoped_lock lock(s.mutex);
+	insert(s, key, data, entry_size);
+}
+
+void log_cache::insert(const std::string &key, const ioremap::elliptics::data_pointer &data, uint64_t generation)
+{
+	const size_t entry_size = key.size() + data.size() + consts::LOG_ENTRY_OVERHEAD;
+	if (entry_size > shard_max_size_) // the log is too big for the cache
+		return;
+
+	auto &s = get_shard(key);
+	boost::mutex::scoped_lock lock(s.mutex);
+
+	if (s.removals != generation) // some log of the shard has been changed while it was read
+		return;
+
+	insert(s, key, data, entry_size);
+}
+
+void log_cache::insert(shard &s, const std::string &key, const ioremap::elliptics::data_pointer &data, size_t entry_size)
+{
+	auto it = s.entries.find(key);
+	if (it != s.entries.end())
+		erase(s, it->second);
+
+	s.lru.push_front(std::make_pair(key, data));
+	s.entries.insert(std::make_pair(key, s.lru.begin()));
+	s.size += entry_size;
+
+	while (s.size > shard_max_size_) {
+		erase(s, --s.lru.end());
+		++s.evictions;
+	}
+}
+
+void log_cache::remove(const std::string &key)
+{
+	auto &s = get_shard(key);
+	boost::mutex::scoped_lock lock(s.mutex);
+
+	++s.removals;
+
+	auto it = s.entries.find(key);
+	if (it != s.entries.end())
+		erase(s, it->second);
+}
+
+void log_cache::clear()
+{
+	for (auto it = shards_, end = shards_ + SHARDS; it != end; ++it) {
+		boost::mutex::scoped_lock lock(it->mutex);
+		it->evictions += it->lru.size();
+		it->lru.clear();
+		it->entries.clear();
+		it->size = 0;
+	}
+}
+
+cache_stats log_cache::stats()
+{
+	cache_stats ret = {0, 0, 0, 0};
+
+	for (auto it = shards_, end = shards_ + SHARDS; it != end; ++it) {
+		boost::mutex::scoped_lock lock(it->mutex);
+		ret.hits += it->hits;
+		ret.misses += it->misses;
+		ret.evictions += it->evictions;
+		ret.size += it->size;
+	}
+
+	return ret;
+}
+
+log_cache::shard &log_cache::get_shard(const std::string &key)
+{
+	return shards_[std::hash<std::string>()(key) % SHARDS];
+}
+
+void log_cache::erase(shard &s, lru_t::iterator it)
+{
+	s.size -= it->first.size() + it->second.size() + consts::LOG_ENTRY_OVERHEAD;
+	s.entries.erase(it->first);
+	s.lru.erase(it);
+}
+
+} /* namespace history */
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#ifndef HISTORY_SRC_LIB_LOG_CACHE_H
+#define HISTORY_SRC_LIB_LOG_CACHE_H
+
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include <elliptics/utils.hpp>
+
+#include <boost/thread/mutex.hpp>
+
+#include "historydb/provider.h"
+
+namespace history {
+
+/* Keeps recently read daily user logs by their keys.
+	Logs are split into shards by key, each shard evicts least recently used logs if it exceeds its part of max_size.
+	Each shard counts removals, so log which has been read before concurrent removal isn't inserted after it.
+*/
+class log_cache
+{
+public:
+	log_cache(size_t max_size);
+
+	bool get(const std::string &key, ioremap::elliptics::data_pointer &data); // checks and counts hit or miss
+	uint64_t generation(const std::string &key); // should be taken before the log is read
+	void insert(const std::string &key, const ioremap::elliptics::data_pointer &data);
+	void insert(const std::string &key, const ioremap::elliptics::data_pointer &data, uint64_t generation); // skips the log if it has been removed since generation
+	void remove(const std::string &key);
+	void clear();
+
+	cache_stats stats();
+
+private:
+	log_cache(const log_cache&) = delete;
+	log_cache& operator=(const log_cache&) = delete;
+
+	typedef std::list<std::pair<std::string, ioremap::elliptics::data_pointer>> lru_t;
+
+	struct shard
+	{
+		shard() : size(0), hits(0), misses(0), evictions(0), removals(0) {}
+
+		lru_t											lru; // logs in order of usage, most recently used first
+		std::unordered_map<std::string, lru_t::iterator>	entries; // positions of logs in lru by keys
+		size_t											size; // estimated memory used by the shard
+		uint64_t										hits;
+		uint64_t										misses;
+		uint64_t										evictions; // number of evicted logs
+		uint64_t										removals; // number of remove calls, it is generation of the shard
+		boost::mutex									mutex;
+	};
+
+	shard &get_shard(const std::string &key);
+	void insert(shard &s, const std::string &key, const ioremap::elliptics::data_pointer &data, size_t entry_size);
+	void erase(shard &s, lru_t::iterator it);
+
+	static const size_t	SHARDS = 16; // number of shards
+
+	const size_t		shard_max_size_; // maximum memory which could be used by one shard
+	shard				shards_[SHARDS];
+};
+
+} /* namespace history */
+
+#endif //HISTORY_SRC_LIB_LOG_CACHE_H
@@ -0,0 +1,182 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include "measured_storage.h"
+
+#include <cerrno>
+
+namespace history {
+
+namespace consts {
+const char *STORAGE_OPERATIONS[] = {
+	"storage.append",
+	"storage.write_cas",
+	"storage.read_latest",
+	"storage.bulk_read",
+	"storage.update_indexes",
+	"storage.remove_indexes",
+	"storage.find_indexes"
+};
+}
+
+/* State of measured find_any_indexes which is shared by its handlers */
+struct measured_find
+{
+	measured_find(operation_counters &counters, std::shared_ptr<void> owner)
+	: timer(counters, owner)
+	, bytes(0)
+	{}
+
+	operation_timer			timer;
+	std::atomic<uint64_t>	bytes; // size of data of found indexes
+};
+
+measured_storage::measured_storage(std::shared_ptr<storage> s)
+: storage_(s)
+{}
+
+void measured_storage::set_groups(const std::vector<int> &groups)
+{
+	storage_->set_groups(groups);
+}
+
+void measured_storage::append(const std::string &key,
+                              const ioremap::elliptics::data_pointer &data,
+                              write_handler_t handler)
+{
+	storage_->append(key, data, measure_write(append_op, data.size(), handler));
+}
+
+void measured_storage::write_cas(const std::string &key, converter_t converter, write_handler_t handler)
+{
+	auto timer = std::make_shared<operation_timer>(counters_[write_cas_op], shared_from_this());
+
+	storage_->write_cas(key, converter, [timer, handler] (const write_result &res) {
+		if (res.error)
+			timer->fail(res.error.code);
+		else
+			timer->finish(res.size); // the whole object is rewritten
+		handler(res);
+	});
+}
+
+void measured_storage::read_latest(const std::string &key, uint64_t offset, uint64_t size, read_handler_t handler)
+{
+	auto timer = std::make_shared<operation_timer>(counters_[read_latest_op], shared_from_this());
+
+	storage_->read_latest(key, offset, size, [timer, handler] (const read_result &res) {
+		if (!res.error)
+			timer->finish(res.data.size());
+		else if (res.error.code == -ENOENT)
+			timer->finish(0);
+		else
+			timer->fail(res.error.code);
+		handler(res);
+	});
+}
+
+void measured_storage::bulk_read(const std::vector<std::string> &keys, bulk_read_handler_t handler)
+{
+	auto timer = std::make_shared<operation_timer>(counters_[bulk_read_op], shared_from_this());
+
+	storage_->bulk_read(keys, [timer, handler] (const std::vector<read_result> &res) {
+		uint64_t bytes = 0;
+		int error = 0;
+		for (auto it = res.begin(), end = res.end(); it != end; ++it) {
+			if (!it->error)
+				bytes += it->data.size();
+			else if (it->error.code != -ENOENT && error == 0)
+				error = it->error.code; // the first failed read is reported for the whole bulk read
+		}
+
+		if (error != 0)
+			timer->fail(error);
+		else
+			timer->finish(bytes);
+		handler(res);
+	});
+}
+
+void measured_storage::update_indexes(const std::string &key,
+                                      const std::vector<std::string> &indexes,
+                                      const std::vector<ioremap::elliptics::data_pointer> &datas,
+                                      write_handler_t handler)
+{
+	uint64_t bytes = 0;
+	for (auto it = datas.begin(), end = datas.end(); it != end; ++it) {
+		bytes += it->size();
+	}
+
+	storage_->update_indexes(key, indexes, datas, measure_write(update_indexes_op, bytes, handler));
+}
+
+void measured_storage::remove_indexes(const std::string &key,
+                                      const std::vector<std::string> &indexes,
+                                      write_handler_t handler)
+{
+	storage_->remove_indexes(key, indexes, measure_write(remove_indexes_op, 0, handler));
+}
+
+void measured_storage::find_any_indexes(const std::vector<std::string> &indexes,
+                                        entry_handler_t on_entry,
+                                        complete_handler_t on_complete)
+{
+	auto find = std::make_shared<measured_find>(counters_[find_indexes_op], shared_from_this());
+
+	storage_->find_any_indexes(indexes,
+	                           [find, on_entry] (const found_entry &entry) {
+	                               uint64_t bytes = 0;
+	                               for (auto it = entry.indexes.begin(), end = entry.indexes.end(); it != end; ++it) {
+	                                   bytes += it->data.size();
+	                               }
+	                               find->bytes.fetch_add(bytes, std::memory_order_relaxed);
+	                               on_entry(entry);
+	                           },
+	                           [find, on_complete] (const storage_error &error) {
+	                               if (!error || error.code == -ENOENT)
+	                                   find->timer.finish(find->bytes.load(std::memory_order_relaxed));
+	                               else
+	                                   find->timer.fail(error.code);
+	                               on_complete(error);
+	                           });
+}
+
+std::vector<operation_stats> measured_storage::stats() const
+{
+	std::vector<operation_stats> ret;
+	ret.reserve(operations_count);
+
+	for (int op = 0; op < operations_count; ++op) {
+		ret.emplace_back(counters_[op].stats(consts::STORAGE_OPERATIONS[op]));
+	}
+
+	return ret;
+}
+
+storage::write_handler_t measured_storage::measure_write(operation op, uint64_t bytes, write_handler_t handler)
+{
+	auto timer = std::make_shared<operation_timer>(counters_[op], shared_from_this());
+
+	return [timer, bytes, handler] (const write_result &res) {
+		if (res.error)
+			timer->fail(res.error.code);
+		else
+			timer->finish(bytes);
+		handler(res);
+	};
+}
+
+} /* namespace history */
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#ifndef HISTORY_SRC_LIB_MEASURED_STORAGE_H
+#define HISTORY_SRC_LIB_MEASURED_STORAGE_H
+
+#include "storage.h"
+
+#include "historydb/operation_counters.h"
+
+namespace history {
+
+/* Storage which measures operations of other storage: latency, bytes and errors by codes of each operation.
+	Missing objects (-ENOENT) are ordinary results of reads, so they aren't counted as errors.
+*/
+class measured_storage : public storage, public std::enable_shared_from_this<measured_storage>
+{
+public:
+	measured_storage(std::shared_ptr<storage> s);
+
+	void set_groups(const std::vector<int> &groups);
+
+	void append(const std::string &key,
+	            const ioremap::elliptics::data_pointer &data,
+	            write_handler_t handler);
+	void write_cas(const std::string &key, converter_t converter, write_handler_t handler);
+	void read_latest(const std::string &key, uint64_t offset, uint64_t size, read_handler_t handler);
+	void bulk_read(const std::vector<std::string> &keys, bulk_read_handler_t handler);
+	void update_indexes(const std::string &key,
+	                    const std::vector<std::string> &indexes,
+	                    const std::vector<ioremap::elliptics::data_pointer> &datas,
+	                    write_handler_t handler);
+	void remove_indexes(const std::string &key,
+	                    const std::vector<std::string> &indexes,
+	                    write_handler_t handler);
+
+	using storage::find_any_indexes;
+	void find_any_indexes(const std::vector<std::string> &indexes,
+	                      entry_handler_t on_entry,
+	                      complete_handler_t on_complete);
+
+	std::vector<operation_stats> stats() const; // stats of all operations
+
+private:
+	measured_storage(const measured_storage&) = delete;
+	measured_storage& operator=(const measured_storage&) = delete;
+
+	enum operation {
+		append_op,
+		write_cas_op,
+		read_latest_op,
+		bulk_read_op,
+		update_indexes_op,
+		remove_indexes_op,
+		find_indexes_op,
+		operations_count
+	};
+
+	write_handler_t measure_write(operation op, uint64_t bytes, write_handler_t handler); // bytes - size of written data
+
+	const std::shared_ptr<storage>	storage_; // measured storage
+	operation_counters				counters_[operations_count]; // counters by operations
+};
+
+} /* namespace history */
+
+#endif //HISTORY_SRC_LIB_MEASURED_STORAGE_H
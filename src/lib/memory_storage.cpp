@@ -0,0 +1,342 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#include "memory_storage.h"
+
+#include <errno.h>
+
+#include <algorithm>
+#include <queue>
+
+#include <boost/bind.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread_time.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+namespace history {
+
+/* Operation which should be completed at its due time
+*/
+struct scheduled_operation
+{
+	boost::system_time		due; // time when the operation should be completed
+	uint64_t				sequence; // keeps order of operations with the same due time
+	std::function<void()>	operation;
+};
+
+struct later
+{
+	bool operator()(const scheduled_operation &lhs, const scheduled_operation &rhs) const {
+		return lhs.due > rhs.due || (lhs.due == rhs.due && lhs.sequence > rhs.sequence);
+	}
+};
+
+struct memory_storage::queue
+{
+	queue() : sequence(0), stop(false) {}
+
+	std::priority_queue<scheduled_operation, std::vector<scheduled_operation>, later>	operations; // the earliest operation is on the top
+	uint64_t																		sequence; // sequence of the next scheduled operation
+	bool																			stop; // whether operations should be completed without waiting for their due time
+	boost::mutex																	mutex;
+	boost::condition_variable														cond;
+};
+
+memory_storage::memory_storage(const memory_storage_config &config)
+: config_(config)
+, written_(1)
+, queue_(std::make_shared<queue>())
+{
+	const uint32_t threads = std::max<uint32_t>(config_.threads, 1);
+	threads_.reserve(threads);
+
+	for (uint32_t index = 0; index < threads; ++index) {
+		threads_.emplace_back(boost::bind(&memory_storage::run, queue_));
+	}
+}
+
+memory_storage::~memory_storage()
+{
+	{
+		boost::mutex::scoped_lock lock(queue_->mutex);
+		queue_->stop = true;
+	}
+	queue_->cond.notify_all();
+
+	for (auto it = threads_.begin(), end = threads_.end(); it != end; ++it) {
+		if (it->get_id() != boost::this_thread::get_id()) {
+			it->join();
+			continue;
+		}
+
+		// the last owner has been released by an operation of this storage thread, so the thread completes
+		// remaining operations while the storage is alive and leaves the loop after the destructor
+		std::function<void()> operation;
+		while (pop(*queue_, operation)) {
+			operation();
+			operation = nullptr;
+		}
+		it->detach();
+	}
+}
+
+void memory_storage::set_groups(const std::vector<int> &groups)
+{
+	written_ = std::max<size_t>(groups.size(), 1);
+}
+
+void memory_storage::append(const std::string &key,
+                            const ioremap::elliptics::data_pointer &data,
+                            write_handler_t handler)
+{
+	auto copy = ioremap::elliptics::data_pointer::copy(data); // data could be released by the caller before the append
+
+	schedule(config_.write_latency, [this, key, copy, handler] () {
+		write_result res;
+
+		{
+			auto &s = get_shard(key);
+			boost::mutex::scoped_lock lock(s.mutex);
+
+			auto &object = s.objects[key];
+			object.append(copy.data<char>(), copy.size());
+			res.size = object.size();
+		}
+
+		res.written = written_;
+		handler(res);
+	});
+}
+
+void memory_storage::write_cas(const std::string &key, converter_t converter, write_handler_t handler)
+{
+	schedule(config_.write_latency, [this, key, converter, handler] () {
+		write_result res;
+
+		try {
+			auto &s = get_shard(key);
+			boost::mutex::scoped_lock lock(s.mutex); // converter is called under the lock, so concurrent writes don't lose updates
+
+			auto it = s.objects.find(key);
+			ioremap::elliptics::data_pointer stored;
+			if (it != s.objects.end())
+				stored = ioremap::elliptics::data_pointer::copy(it->second);
+
+			const auto converted = converter(stored);
+			auto &object = s.objects[key];
+			object.assign(converted.data<char>(), converted.size());
+
+			res.size = object.size();
+			res.written = written_;
+		}
+		catch (std::exception &e) {
+			res.error = storage_error(-EINVAL, e.what());
+		}
+
+		handler(res);
+	});
+}
+
+void memory_storage::read_latest(const std::string &key, uint64_t offset, uint64_t size, read_handler_t handler)
+{
+	schedule(config_.read_latency, [this, key, offset, size, handler] () {
+		handler(read(key, offset, size));
+	});
+}
+
+void memory_storage::bulk_read(const std::vector<std::string> &keys, bulk_read_handler_t handler)
+{
+	schedule(config_.read_latency, [this, keys, handler] () {
+		std::vector<read_result> res;
+		res.reserve(keys.size());
+
+		for (auto it = keys.begin(), end = keys.end(); it != end; ++it) {
+			res.emplace_back(read(*it, 0, 0));
+		}
+
+		handler(res);
+	});
+}
+
+void memory_storage::update_indexes(const std::string &key,
+                                    const std::vector<std::string> &indexes,
+                                    const std::vector<ioremap::elliptics::data_pointer> &datas,
+                                    write_handler_t handler)
+{
+	std::vector<std::string> copies; // datas could be released by the caller before the update
+	copies.reserve(indexes.size());
+	for (size_t index = 0; index < indexes.size(); ++index) {
+		copies.emplace_back(index < datas.size() ? datas[index].to_string() : std::string());
+	}
+
+	schedule(config_.index_latency, [this, key, indexes, copies, handler] () {
+		{
+			boost::mutex::scoped_lock lock(indexes_mutex_);
+			for (size_t index = 0; index < indexes.size(); ++index) {
+				indexes_[indexes[index]][key] = copies[index]; // data of the object which is already in the index is replaced
+			}
+		}
+
+		write_result res;
+		res.written = written_;
+		handler(res);
+	});
+}
+
+void memory_storage::remove_indexes(const std::string &key,
+                                    const std::vector<std::string> &indexes,
+                                    write_handler_t handler)
+{
+	schedule(config_.index_latency, [this, key, indexes, handler] () {
+		{
+			boost::mutex::scoped_lock lock(indexes_mutex_);
+			for (auto it = indexes.begin(), end = indexes.end(); it != end; ++it) {
+				auto found = indexes_.find(*it);
+				if (found == indexes_.end())
+					continue;
+
+				found->second.erase(key);
+				if (found->second.empty())
+					indexes_.erase(found);
+			}
+		}
+
+		write_result res;
+		res.written = written_;
+		handler(res);
+	});
+}
+
+void memory_storage::find_any_indexes(const std::vector<std::string> &indexes,
+                                      entry_handler_t on_entry,
+                                      complete_handler_t on_complete)
+{
+	schedule(config_.index_latency, [this, indexes, on_entry, on_complete] () {
+		std::map<std::string, found_entry> entries; // found objects by keys
+
+		{
+			boost::mutex::scoped_lock lock(indexes_mutex_);
+			for (auto it = indexes.begin(), end = indexes.end(); it != end; ++it) {
+				auto found = indexes_.find(*it);
+				if (found == indexes_.end())
+					continue;
+
+				for (auto obj = found->second.begin(), obj_end = found->second.end(); obj != obj_end; ++obj) {
+					found_index index;
+					index.name = *it;
+					index.data = ioremap::elliptics::data_pointer::copy(obj->second);
+					entries[obj->first].indexes.push_back(index);
+				}
+			}
+		}
+
+		for (auto it = entries.begin(), end = entries.end(); it != end; ++it) {
+			on_entry(it->second);
+		}
+
+		if (entries.empty()) // elliptics completes search without found objects with -ENOENT
+			on_complete(storage_error(-ENOENT, "objects aren't found in indexes"));
+		else
+			on_complete(storage_error());
+	});
+}
+
+void memory_storage::schedule(uint32_t latency, std::function<void()> operation)
+{
+	{
+		boost::mutex::scoped_lock lock(queue_->mutex);
+
+		scheduled_operation op = {boost::get_system_time() + boost::posix_time::microseconds(latency),
+		                          queue_->sequence++,
+		                          operation};
+		queue_->operations.push(op);
+	}
+
+	queue_->cond.notify_one();
+}
+
+void memory_storage::run(std::shared_ptr<queue> q)
+{
+	std::function<void()> operation;
+
+	while (pop(*q, operation)) {
+		operation();
+		operation = nullptr; // releases captured state before waiting for the next operation
+	}
+}
+
+bool memory_storage::pop(queue &q, std::function<void()> &operation)
+{
+	boost::mutex::scoped_lock lock(q.mutex);
+
+	while (true) {
+		if (q.operations.empty()) {
+			if (q.stop)
+				return false;
+			q.cond.wait(lock);
+			continue;
+		}
+
+		const auto due = q.operations.top().due;
+		if (!q.stop && due > boost::get_system_time()) {
+			q.cond.timed_wait(lock, due); // earlier operation which is scheduled meanwhile wakes the thread
+			continue;
+		}
+
+		operation = q.operations.top().operation;
+		q.operations.pop();
+
+		if (!q.operations.empty())
+			q.cond.notify_one(); // the next operation could be already due
+
+		return true;
+	}
+}
+
+memory_storage::shard &memory_storage::get_shard(const std::string &key)
+{
+	return shards_[std::hash<std::string>()(key) % SHARDS];
+}
+
+read_result memory_storage::read(const std::string &key, uint64_t offset, uint64_t size)
+{
+	read_result ret;
+
+	auto &s = get_shard(key);
+	boost::mutex::scoped_lock lock(s.mutex);
+
+	auto it = s.objects.find(key);
+	if (it == s.objects.end()) {
+		ret.error = storage_error(-ENOENT, "object isn't found: " + key);
+		return ret;
+	}
+
+	const auto &object = it->second;
+	if (offset > object.size()) {
+		ret.error = storage_error(-E2BIG, "offset is beyond the end of the object: " + key);
+		return ret;
+	}
+
+	const uint64_t available = object.size() - offset;
+	const uint64_t length = size == 0 ? available : std::min(size, available);
+
+	ret.data = ioremap::elliptics::data_pointer::copy(object.data() + offset, length);
+	ret.total_size = object.size();
+	return ret;
+}
+
+} /* namespace history */
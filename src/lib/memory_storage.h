@@ -0,0 +1,100 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#ifndef HISTORY_SRC_LIB_MEMORY_STORAGE_H
+#define HISTORY_SRC_LIB_MEMORY_STORAGE_H
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "historydb/provider.h"
+#include "storage.h"
+
+namespace history {
+
+/* Storage which keeps objects and indexes in memory of the process.
+	Each operation is applied and completed by one of storage threads after the latency of its kind,
+	so handlers are never called from the caller's thread like handlers of elliptics operations.
+	All groups are considered to be written by each successful write.
+*/
+class memory_storage : public storage
+{
+public:
+	memory_storage(const memory_storage_config &config);
+	~memory_storage(); // completes all scheduled operations
+
+	void set_groups(const std::vector<int> &groups);
+
+	void append(const std::string &key,
+	            const ioremap::elliptics::data_pointer &data,
+	            write_handler_t handler);
+	void write_cas(const std::string &key, converter_t converter, write_handler_t handler);
+	void read_latest(const std::string &key, uint64_t offset, uint64_t size, read_handler_t handler);
+	void bulk_read(const std::vector<std::string> &keys, bulk_read_handler_t handler);
+	void update_indexes(const std::string &key,
+	                    const std::vector<std::string> &indexes,
+	                    const std::vector<ioremap::elliptics::data_pointer> &datas,
+	                    write_handler_t handler);
+	void remove_indexes(const std::string &key,
+	                    const std::vector<std::string> &indexes,
+	                    write_handler_t handler);
+
+	using storage::find_any_indexes;
+	void find_any_indexes(const std::vector<std::string> &indexes,
+	                      entry_handler_t on_entry,
+	                      complete_handler_t on_complete);
+
+private:
+	memory_storage(const memory_storage&) = delete;
+	memory_storage& operator=(const memory_storage&) = delete;
+
+	struct queue; // operations which are scheduled for storage threads
+
+	struct shard
+	{
+		std::unordered_map<std::string, std::string>	objects; // data of objects by keys
+		boost::mutex									mutex;
+	};
+
+	void schedule(uint32_t latency, std::function<void()> operation);
+	static void run(std::shared_ptr<queue> q); // storage thread body
+	static bool pop(queue &q, std::function<void()> &operation); // waits for the next due operation, false if the queue is stopped
+
+	shard &get_shard(const std::string &key);
+	read_result read(const std::string &key, uint64_t offset, uint64_t size);
+
+	static const size_t	SHARDS = 16; // number of shards of objects
+
+	const memory_storage_config										config_;
+	std::atomic<uint32_t>											written_; // number of groups which are reported by writes
+	shard															shards_[SHARDS];
+	std::map<std::string, std::map<std::string, std::string>>		indexes_; // data of objects by keys by names of indexes
+	boost::mutex													indexes_mutex_; // guards indexes_
+	const std::shared_ptr<queue>									queue_;
+	std::vector<boost::thread>										threads_;
+};
+
+} /* namespace history */
+
+#endif //HISTORY_SRC_LIB_MEMORY_STORAGE_H
@@ -0,0 +1,181 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include "historydb/operation_counters.h"
+
+namespace history {
+
+operation_counters::shard::shard()
+: started(0)
+, errors(0)
+, bytes(0)
+{}
+
+operation_counters::operation_counters()
+{
+	for (uint32_t i = 0; i <= THREADS; ++i) {
+		shards_[i].store(nullptr, std::memory_order_relaxed);
+	}
+}
+
+operation_counters::~operation_counters()
+{
+	for (uint32_t i = 0; i <= THREADS; ++i) {
+		delete shards_[i].load(std::memory_order_relaxed);
+	}
+}
+
+void operation_counters::start()
+{
+	const uint32_t index = thread_index();
+	increment(get_shard(index).started, 1, index != THREADS);
+}
+
+void operation_counters::finish(uint64_t latency, uint64_t bytes)
+{
+	const uint32_t index = thread_index();
+	const bool exclusive = index != THREADS;
+	auto &s = get_shard(index);
+
+	if (bytes != 0)
+		increment(s.bytes, bytes, exclusive);
+
+	if (exclusive)
+		s.latencies.record_exclusive(latency);
+	else
+		s.latencies.record(latency);
+}
+
+void operation_counters::fail(uint64_t latency, int error)
+{
+	const uint32_t index = thread_index();
+	const bool exclusive = index != THREADS;
+	auto &s = get_shard(index);
+
+	increment(s.errors, 1, exclusive);
+
+	if (exclusive)
+		s.latencies.record_exclusive(latency);
+	else
+		s.latencies.record(latency);
+
+	if (error != 0) {
+		boost::mutex::scoped_lock lock(mutex_);
+		++error_codes_[error];
+	}
+}
+
+operation_stats operation_counters::stats(const std::string &name) const
+{
+	operation_stats ret;
+	ret.name = name;
+	ret.errors = ret.bytes = 0;
+
+	uint64_t started = 0;
+	std::unique_ptr<histogram> latencies(new histogram);
+
+	for (uint32_t i = 0; i <= THREADS; ++i) {
+		const shard *s = shards_[i].load(std::memory_order_acquire);
+		if (!s)
+			continue;
+
+		started += s->started.load(std::memory_order_relaxed);
+		ret.errors += s->errors.load(std::memory_order_relaxed);
+		ret.bytes += s->bytes.load(std::memory_order_relaxed);
+		latencies->add(s->latencies);
+	}
+
+	ret.count = latencies->count();
+	ret.in_flight = started > ret.count ? started - ret.count : 0; // operation could be started and finished by different threads
+	ret.min = latencies->min();
+	ret.mean = latencies->mean();
+	ret.p50 = latencies->percentile(50);
+	ret.p90 = latencies->percentile(90);
+	ret.p99 = latencies->percentile(99);
+	ret.p999 = latencies->percentile(99.9);
+	ret.max = latencies->max();
+
+	boost::mutex::scoped_lock lock(mutex_);
+	ret.error_codes = error_codes_;
+
+	return ret;
+}
+
+uint32_t operation_counters::thread_index()
+{
+	static std::atomic<uint32_t> next_index(0);
+	static __thread uint32_t index = THREADS + 1; // THREADS + 1 - the index hasn't been taken by the thread yet
+
+	if (index == THREADS + 1) {
+		index = next_index.fetch_add(1, std::memory_order_relaxed); // indexes aren't reused, so own shard has the only writer
+		if (index > THREADS)
+			index = THREADS;
+	}
+	return index;
+}
+
+operation_counters::shard &operation_counters::get_shard(uint32_t index)
+{
+	shard *s = shards_[index].load(std::memory_order_acquire);
+	if (!s) {
+		std::unique_ptr<shard> created(new shard);
+		if (shards_[index].compare_exchange_strong(s, created.get(), std::memory_order_acq_rel))
+			s = created.release(); // otherwise the shared shard has been created by other thread
+	}
+	return *s;
+}
+
+void operation_counters::increment(std::atomic<uint64_t> &counter, uint64_t value, bool exclusive)
+{
+	if (exclusive)
+		counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	else
+		counter.fetch_add(value, std::memory_order_relaxed);
+}
+
+operation_timer::operation_timer(operation_counters &counters, std::shared_ptr<void> owner)
+: owner_(owner)
+, counters_(counters)
+, start_(operation_counters::clock_type::now())
+, recorded_(false)
+{
+	counters_.start();
+}
+
+operation_timer::~operation_timer()
+{
+	if (!recorded_)
+		fail();
+}
+
+void operation_timer::finish(uint64_t bytes)
+{
+	recorded_ = true;
+	counters_.finish(elapsed(), bytes);
+}
+
+void operation_timer::fail(int error)
+{
+	recorded_ = true;
+	counters_.fail(elapsed(), error);
+}
+
+uint64_t operation_timer::elapsed() const
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(operation_counters::clock_type::now() - start_).count();
+}
+
+} /* namespace history */
@@ -17,14 +17,13 @@
 #include "historydb/provider.h"
 #include "provider_impl.cpp"
 
+#include <algorithm>
+#include <cstdlib>
+
 #include <boost/algorithm/string.hpp>
 
 namespace history {
 
-namespace consts {
-	const uint32_t SECONDS_IN_DAY = 24 * 60 * 60; // number of seconds in one day. used for calculation days
-}
-
 std::string time_to_subkey(uint64_t time)
 {
 	return boost::lexical_cast<std::string>(time / consts::SECONDS_IN_DAY);
@@ -47,6 +46,146 @@ std::vector<std::string> time_period_to_subkeys(uint64_t begin_time, uint64_t en
 	return ret;
 }
 
+std::vector<std::vector<std::string>> periods_to_operands(const std::vector<std::pair<uint64_t, uint64_t>> &periods)
+{
+	std::vector<std::vector<std::string>> ret;
+	ret.reserve(periods.size());
+
+	for (auto it = periods.begin(), end = periods.end(); it != end; ++it) {
+		ret.emplace_back(time_period_to_subkeys(it->first, it->second));
+	}
+
+	return ret;
+}
+
+/* Sizes of results which are counted as read bytes */
+template <typename T>
+uint64_t result_bytes(const T &/*result*/)
+{
+	return 0;
+}
+
+uint64_t result_bytes(const std::vector<ioremap::elliptics::data_pointer> &logs)
+{
+	uint64_t ret = 0;
+	for (auto it = logs.begin(), end = logs.end(); it != end; ++it) {
+		ret += it->size();
+	}
+	return ret;
+}
+
+uint64_t result_bytes(const user_logs_page &page)
+{
+	return result_bytes(page.logs);
+}
+
+uint64_t result_bytes(const std::vector<framing::record> &records)
+{
+	uint64_t ret = 0;
+	for (auto it = records.begin(), end = records.end(); it != end; ++it) {
+		ret += it->data.size();
+	}
+	return ret;
+}
+
+uint64_t records_bytes(const std::vector<log_record> &records)
+{
+	uint64_t ret = 0;
+	for (auto it = records.begin(), end = records.end(); it != end; ++it) {
+		ret += it->data.size();
+	}
+	return ret;
+}
+
+/* Results which are counted as failed operations */
+template <typename T>
+bool is_failed(const T &/*result*/)
+{
+	return false;
+}
+
+bool is_failed(bool succeeded)
+{
+	return !succeeded;
+}
+
+bool is_failed(const std::vector<bool> &added)
+{
+	return std::find(added.begin(), added.end(), false) != added.end();
+}
+
+template <typename T>
+void record_result(operation_timer &timer, uint64_t bytes, const T &result)
+{
+	if (is_failed(result))
+		timer.fail();
+	else
+		timer.finish(bytes + result_bytes(result));
+}
+
+template <typename T>
+void record_result(operation_timer &timer, uint64_t bytes, const T &result, bool completed)
+{
+	if (!completed)
+		timer.fail();
+	else
+		timer.finish(bytes + result_bytes(result));
+}
+
+template <typename T>
+struct measured_call
+{
+	template <typename Operation>
+	static T run(operation_timer &timer, uint64_t bytes, Operation &operation)
+	{
+		T ret = operation();
+		record_result(timer, bytes, ret);
+		return ret;
+	}
+};
+
+template <>
+struct measured_call<void>
+{
+	template <typename Operation>
+	static void run(operation_timer &timer, uint64_t bytes, Operation &operation)
+	{
+		operation();
+		timer.finish(bytes);
+	}
+};
+
+/* Runs sync operation and records it into counters. Elliptics errors of the operation are counted by their codes.
+	bytes - size of written data
+*/
+template <typename Operation>
+auto measure(operation_counters &counters, Operation operation, uint64_t bytes = 0) -> decltype(operation())
+{
+	operation_timer timer(counters);
+	try {
+		return measured_call<decltype(operation())>::run(timer, bytes, operation);
+	}
+	catch (ioremap::elliptics::error &e) {
+		timer.fail(-std::abs(e.error_code()));
+		throw;
+	}
+}
+
+/* Returns callback which records async operation into counters before calling the original callback.
+	owner - keeps counters alive until the operation is completed
+	bytes - size of written data
+*/
+template <typename... Args>
+std::function<void(Args...)> measure_callback(operation_counters &counters, std::shared_ptr<void> owner,
+                                              std::function<void(Args...)> callback, uint64_t bytes = 0)
+{
+	auto timer = std::make_shared<operation_timer>(counters, owner);
+	return [timer, callback, bytes] (Args... args) {
+		record_result(*timer, bytes, args...);
+		callback(args...);
+	};
+}
+
 provider::provider(const std::vector<server_info> &servers,
                    const std::vector<int> &groups, uint32_t min_writes,
                    const std::string &log_file, const int log_level,
@@ -65,96 +204,255 @@ provider::provider(const std::vector<std::string> &servers,
                                 wait_timeout, check_timeout))
 {}
 
+provider::provider(const memory_storage_config &config,
+                   const std::string &log_file, const int log_level)
+: m_impl(std::make_shared<impl>(config, log_file, log_level))
+{}
+
+provider::~provider()
+{
+	m_impl->shutdown();
+}
+
 void provider::set_session_parameters(const std::vector<int> &groups, uint32_t min_writes,
                                       uint32_t wait_timeout, uint32_t check_timeout)
 {
 	m_impl->set_session_parameters(groups, min_writes, wait_timeout, check_timeout);
 }
 
+void provider::set_coalescing_parameters(uint32_t window, uint32_t max_bytes)
+{
+	m_impl->set_coalescing_parameters(window, max_bytes);
+}
+
+void provider::set_batch_parameters(uint32_t max_in_flight)
+{
+	m_impl->set_batch_parameters(max_in_flight);
+}
+
+void provider::set_activity_cache_parameters(size_t max_size)
+{
+	m_impl->set_activity_cache_parameters(max_size);
+}
+
+cache_stats provider::get_activity_cache_stats()
+{
+	return m_impl->get_activity_cache_stats();
+}
+
+void provider::set_log_cache_parameters(size_t max_size)
+{
+	m_impl->set_log_cache_parameters(max_size);
+}
+
+cache_stats provider::get_log_cache_stats()
+{
+	return m_impl->get_log_cache_stats();
+}
+
+void provider::set_active_users_cache_parameters(size_t max_size)
+{
+	m_impl->set_active_users_cache_parameters(max_size);
+}
+
+cache_stats provider::get_active_users_cache_stats()
+{
+	return m_impl->get_active_users_cache_stats();
+}
+
+std::vector<operation_stats> provider::get_operation_stats()
+{
+	return m_impl->get_operation_stats();
+}
+
+void provider::set_activity_sketch_parameters(uint32_t interval)
+{
+	m_impl->set_activity_sketch_parameters(interval);
+}
+
+void provider::set_activity_bitmap_parameters(uint32_t interval)
+{
+	m_impl->set_activity_bitmap_parameters(interval);
+}
+
+void provider::set_activity_calendar_parameters(uint32_t interval)
+{
+	m_impl->set_activity_calendar_parameters(interval);
+}
+
+void provider::set_day_stats_parameters(uint32_t interval)
+{
+	m_impl->set_day_stats_parameters(interval);
+}
+
+void provider::set_activity_chunks(uint32_t chunks)
+{
+	m_impl->set_activity_chunks(chunks);
+}
+
+void provider::set_bulk_read_parameters(uint32_t min_keys)
+{
+	m_impl->set_bulk_read_parameters(min_keys);
+}
+
+void provider::set_framed_logs(bool framed)
+{
+	m_impl->set_framed_logs(framed);
+}
+
+void provider::set_offset_index_parameters(uint32_t step)
+{
+	m_impl->set_offset_index_parameters(step);
+}
+
+void provider::repartition_activity(uint64_t begin_time, uint64_t end_time, uint32_t chunks)
+{
+	measure(m_impl->counters(repartition_activity_op), [&] {
+		m_impl->repartition_activity(time_period_to_subkeys(begin_time, end_time), chunks);
+	});
+}
+
+void provider::repartition_activity(const std::vector<std::string> &subkeys, uint32_t chunks)
+{
+	measure(m_impl->counters(repartition_activity_op), [&] {
+		m_impl->repartition_activity(subkeys, chunks);
+	});
+}
+
 void provider::add_log(const std::string &user, uint64_t time,
                        const ioremap::elliptics::data_pointer &data)
 {
-	m_impl->add_log(user, time_to_subkey(time), data);
+	measure(m_impl->counters(add_log_op), [&] {
+		m_impl->add_log(user, time_to_subkey(time), m_impl->pack_log(time, data));
+	}, data.size());
 }
 
 void provider::add_log(const std::string &user, const std::string &subkey,
                        const ioremap::elliptics::data_pointer &data)
 {
-	m_impl->add_log(user, subkey, data);
+	measure(m_impl->counters(add_log_op), [&] {
+		m_impl->add_log(user, subkey, m_impl->pack_log(data));
+	}, data.size());
 }
 
 void provider::add_log(const std::string &user, uint64_t time,
                        const ioremap::elliptics::data_pointer &data,
                        std::function<void(bool added)> callback)
 {
-	m_impl->add_log(user, time_to_subkey(time), data, callback);
+	m_impl->add_log(user, time_to_subkey(time), m_impl->pack_log(time, data),
+	                measure_callback(m_impl->counters(add_log_async_op), m_impl, callback, data.size()));
 }
 
 void provider::add_log(const std::string &user, const std::string &subkey,
                        const ioremap::elliptics::data_pointer &data,
                        std::function<void(bool added)> callback)
 {
-	m_impl->add_log(user, subkey, data, callback);
+	m_impl->add_log(user, subkey, m_impl->pack_log(data),
+	                measure_callback(m_impl->counters(add_log_async_op), m_impl, callback, data.size()));
 }
 
 void provider::add_activity(const std::string &user, uint64_t time)
 {
-	m_impl->add_activity(user, time_to_subkey(time));
+	measure(m_impl->counters(add_activity_op), [&] {
+		m_impl->add_activity(user, time_to_subkey(time));
+	});
 }
 
 void provider::add_activity(const std::string &user, const std::string &subkey)
 {
-	m_impl->add_activity(user, subkey);
+	measure(m_impl->counters(add_activity_op), [&] {
+		m_impl->add_activity(user, subkey);
+	});
 }
 
 void provider::add_activity(const std::string &user, uint64_t time,
                             std::function<void(bool added)> callback)
 {
-	m_impl->add_activity(user, time_to_subkey(time), callback);
+	m_impl->add_activity(user, time_to_subkey(time),
+	                     measure_callback(m_impl->counters(add_activity_async_op), m_impl, callback));
 }
 
 void provider::add_activity(const std::string &user, const std::string &subkey,
                             std::function<void(bool added)> callback)
 {
-	m_impl->add_activity(user, subkey, callback);
+	m_impl->add_activity(user, subkey,
+	                     measure_callback(m_impl->counters(add_activity_async_op), m_impl, callback));
 }
 
 void provider::add_log_with_activity(const std::string &user, uint64_t time,
                                      const ioremap::elliptics::data_pointer &data)
 {
-	m_impl->add_log_with_activity(user, time_to_subkey(time), data);
+	measure(m_impl->counters(add_log_with_activity_op), [&] {
+		m_impl->add_log_with_activity(user, time_to_subkey(time), m_impl->pack_log(time, data));
+	}, data.size());
 }
 
 void provider::add_log_with_activity(const std::string &user, const std::string &subkey,
                                      const ioremap::elliptics::data_pointer &data)
 {
-	m_impl->add_log_with_activity(user, subkey, data);
+	measure(m_impl->counters(add_log_with_activity_op), [&] {
+		m_impl->add_log_with_activity(user, subkey, m_impl->pack_log(data));
+	}, data.size());
 }
 
 void provider::add_log_with_activity(const std::string &user, uint64_t time,
                                      const ioremap::elliptics::data_pointer &data,
                                      std::function<void(bool added)> callback)
 {
-	m_impl->add_log_with_activity(user, time_to_subkey(time), data, callback);
+	m_impl->add_log_with_activity(user, time_to_subkey(time), m_impl->pack_log(time, data),
+	                              measure_callback(m_impl->counters(add_log_with_activity_async_op), m_impl, callback, data.size()));
 }
 
 void provider::add_log_with_activity(const std::string &user, const std::string &subkey,
                                      const ioremap::elliptics::data_pointer &data,
                                      std::function<void(bool added)> callback)
 {
-	m_impl->add_log_with_activity(user, subkey, data, callback);
+	m_impl->add_log_with_activity(user, subkey, m_impl->pack_log(data),
+	                              measure_callback(m_impl->counters(add_log_with_activity_async_op), m_impl, callback, data.size()));
+}
+
+std::vector<bool> provider::add_logs(const std::vector<log_record> &records)
+{
+	return measure(m_impl->counters(add_logs_op), [&] {
+		return m_impl->add_logs(records, false);
+	}, records_bytes(records));
+}
+
+void provider::add_logs(const std::vector<log_record> &records,
+                        std::function<void(const std::vector<bool> &added)> callback)
+{
+	m_impl->add_logs(records, false,
+	                 measure_callback(m_impl->counters(add_logs_async_op), m_impl, callback, records_bytes(records)));
+}
+
+std::vector<bool> provider::add_logs_with_activity(const std::vector<log_record> &records)
+{
+	return measure(m_impl->counters(add_logs_with_activity_op), [&] {
+		return m_impl->add_logs(records, true);
+	}, records_bytes(records));
+}
+
+void provider::add_logs_with_activity(const std::vector<log_record> &records,
+                                      std::function<void(const std::vector<bool> &added)> callback)
+{
+	m_impl->add_logs(records, true,
+	                 measure_callback(m_impl->counters(add_logs_with_activity_async_op), m_impl, callback, records_bytes(records)));
 }
 
 std::vector<ioremap::elliptics::data_pointer>
 provider::get_user_logs(const std::string &user, uint64_t begin_time, uint64_t end_time)
 {
-	return m_impl->get_user_logs(user, time_period_to_subkeys(begin_time, end_time));
+	return measure(m_impl->counters(get_user_logs_op), [&] {
+		return m_impl->get_user_logs(user, time_period_to_subkeys(begin_time, end_time));
+	});
 }
 
 std::vector<ioremap::elliptics::data_pointer>
 provider::get_user_logs(const std::string &user, const std::vector<std::string> &subkeys)
 {
-	return m_impl->get_user_logs(user, subkeys);
+	return measure(m_impl->counters(get_user_logs_op), [&] {
+		return m_impl->get_user_logs(user, subkeys);
+	});
 }
 
 void provider::get_user_logs(const std::string &user,
@@ -163,35 +461,340 @@ void provider::get_user_logs(const std::string &user,
 {
 	m_impl->get_user_logs(user,
 	                     time_period_to_subkeys(begin_time, end_time),
-	                     callback);
+	                     measure_callback(m_impl->counters(get_user_logs_async_op), m_impl, callback));
 }
 
 void provider::get_user_logs(const std::string &user, const std::vector<std::string> &subkeys,
                              std::function<void(const std::vector<ioremap::elliptics::data_pointer> &data)> callback)
 {
-	m_impl->get_user_logs(user, subkeys, callback);
+	m_impl->get_user_logs(user, subkeys,
+	                      measure_callback(m_impl->counters(get_user_logs_async_op), m_impl, callback));
+}
+
+user_logs_page provider::get_user_logs(const std::string &user,
+                                       uint64_t begin_time, uint64_t end_time,
+                                       uint64_t max_bytes, const std::string &cursor)
+{
+	return measure(m_impl->counters(get_user_logs_page_op), [&] {
+		return m_impl->get_user_logs(user, time_period_to_subkeys(begin_time, end_time), max_bytes, cursor);
+	});
+}
+
+user_logs_page provider::get_user_logs(const std::string &user,
+                                       const std::vector<std::string> &subkeys,
+                                       uint64_t max_bytes, const std::string &cursor)
+{
+	return measure(m_impl->counters(get_user_logs_page_op), [&] {
+		return m_impl->get_user_logs(user, subkeys, max_bytes, cursor);
+	});
+}
+
+void provider::get_user_logs(const std::string &user,
+                             uint64_t begin_time, uint64_t end_time,
+                             uint64_t max_bytes, const std::string &cursor,
+                             std::function<void(const user_logs_page &page, bool completed)> callback)
+{
+	m_impl->get_user_logs(user,
+	                     time_period_to_subkeys(begin_time, end_time),
+	                     max_bytes, cursor,
+	                     measure_callback(m_impl->counters(get_user_logs_page_async_op), m_impl, callback));
+}
+
+void provider::get_user_logs(const std::string &user,
+                             const std::vector<std::string> &subkeys,
+                             uint64_t max_bytes, const std::string &cursor,
+                             std::function<void(const user_logs_page &page, bool completed)> callback)
+{
+	m_impl->get_user_logs(user, subkeys, max_bytes, cursor,
+	                      measure_callback(m_impl->counters(get_user_logs_page_async_op), m_impl, callback));
+}
+
+std::vector<framing::record> provider::get_user_records(const std::string &user, uint64_t begin_time, uint64_t end_time)
+{
+	return measure(m_impl->counters(get_user_records_op), [&] {
+		return m_impl->get_user_records(user, begin_time, end_time);
+	});
+}
+
+void provider::get_user_records(const std::string &user,
+                                uint64_t begin_time, uint64_t end_time,
+                                std::function<void(const std::vector<framing::record> &records, bool completed)> callback)
+{
+	m_impl->get_user_records(user, begin_time, end_time,
+	                         measure_callback(m_impl->counters(get_user_records_async_op), m_impl, callback));
+}
+
+std::vector<framing::record> provider::get_user_records(const std::string &user, const std::vector<std::string> &subkeys)
+{
+	return measure(m_impl->counters(get_user_records_op), [&] {
+		return m_impl->get_user_records(user, subkeys);
+	});
+}
+
+void provider::get_user_records(const std::string &user,
+                                const std::vector<std::string> &subkeys,
+                                std::function<void(const std::vector<framing::record> &records, bool completed)> callback)
+{
+	m_impl->get_user_records(user, subkeys,
+	                         measure_callback(m_impl->counters(get_user_records_async_op), m_impl, callback));
 }
 
 std::set<std::string> provider::get_active_users(uint64_t begin_time, uint64_t end_time)
 {
-	return m_impl->get_active_users(time_period_to_subkeys(begin_time, end_time));
+	return measure(m_impl->counters(get_active_users_op), [&] {
+		return m_impl->get_active_users(time_period_to_subkeys(begin_time, end_time));
+	});
 }
 
 std::set<std::string> provider::get_active_users(const std::vector<std::string> &subkeys)
 {
-	return m_impl->get_active_users(subkeys);
+	return measure(m_impl->counters(get_active_users_op), [&] {
+		return m_impl->get_active_users(subkeys);
+	});
 }
 
 void provider::get_active_users(uint64_t begin_time, uint64_t end_time,
                                 std::function<void(const std::set<std::string>  &ctive_users)> callback)
 {
-	m_impl->get_active_users(time_period_to_subkeys(begin_time, end_time), callback);
+	m_impl->get_active_users(time_period_to_subkeys(begin_time, end_time),
+	                         measure_callback(m_impl->counters(get_active_users_async_op), m_impl, callback));
 }
 
 void provider::get_active_users(const std::vector<std::string> &subkeys,
                                 std::function<void(const std::set<std::string>  &ctive_users)> callback)
 {
-	m_impl->get_active_users(subkeys, callback);
+	m_impl->get_active_users(subkeys,
+	                         measure_callback(m_impl->counters(get_active_users_async_op), m_impl, callback));
+}
+
+active_users_page provider::get_active_users(uint64_t begin_time, uint64_t end_time,
+                                             size_t limit, const std::string &cursor)
+{
+	return measure(m_impl->counters(get_active_users_page_op), [&] {
+		return m_impl->get_active_users(time_period_to_subkeys(begin_time, end_time), limit, cursor);
+	});
+}
+
+active_users_page provider::get_active_users(const std::vector<std::string> &subkeys,
+                                             size_t limit, const std::string &cursor)
+{
+	return measure(m_impl->counters(get_active_users_page_op), [&] {
+		return m_impl->get_active_users(subkeys, limit, cursor);
+	});
+}
+
+void provider::get_active_users(uint64_t begin_time, uint64_t end_time,
+                                size_t limit, const std::string &cursor,
+                                std::function<void(const active_users_page &page, bool completed)> callback)
+{
+	m_impl->get_active_users(time_period_to_subkeys(begin_time, end_time), limit, cursor,
+	                         measure_callback(m_impl->counters(get_active_users_page_async_op), m_impl, callback));
+}
+
+void provider::get_active_users(const std::vector<std::string> &subkeys,
+                                size_t limit, const std::string &cursor,
+                                std::function<void(const active_users_page &page, bool completed)> callback)
+{
+	m_impl->get_active_users(subkeys, limit, cursor,
+	                         measure_callback(m_impl->counters(get_active_users_page_async_op), m_impl, callback));
+}
+
+user_list provider::combine_active_users(set_operation op, const std::vector<std::pair<uint64_t, uint64_t>> &periods)
+{
+	return measure(m_impl->counters(combine_active_users_op), [&] {
+		return m_impl->combine_active_users(op, periods_to_operands(periods));
+	});
+}
+
+user_list provider::combine_active_users(set_operation op, const std::vector<std::vector<std::string>> &operands)
+{
+	return measure(m_impl->counters(combine_active_users_op), [&] {
+		return m_impl->combine_active_users(op, operands);
+	});
+}
+
+void provider::combine_active_users(set_operation op, const std::vector<std::pair<uint64_t, uint64_t>> &periods,
+                                    std::function<void(const user_list &active_users, bool completed)> callback)
+{
+	m_impl->combine_active_users(op, periods_to_operands(periods),
+	                             measure_callback(m_impl->counters(combine_active_users_async_op), m_impl, callback));
+}
+
+void provider::combine_active_users(set_operation op, const std::vector<std::vector<std::string>> &operands,
+                                    std::function<void(const user_list &active_users, bool completed)> callback)
+{
+	m_impl->combine_active_users(op, operands,
+	                             measure_callback(m_impl->counters(combine_active_users_async_op), m_impl, callback));
+}
+
+uint64_t provider::count_active_users(uint64_t begin_time, uint64_t end_time)
+{
+	return measure(m_impl->counters(count_active_users_op), [&] {
+		return m_impl->count_active_users(time_period_to_subkeys(begin_time, end_time));
+	});
+}
+
+uint64_t provider::count_active_users(const std::vector<std::string> &subkeys)
+{
+	return measure(m_impl->counters(count_active_users_op), [&] {
+		return m_impl->count_active_users(subkeys);
+	});
+}
+
+void provider::count_active_users(uint64_t begin_time, uint64_t end_time,
+                                  std::function<void(uint64_t count, bool completed)> callback)
+{
+	m_impl->count_active_users(time_period_to_subkeys(begin_time, end_time),
+	                           measure_callback(m_impl->counters(count_active_users_async_op), m_impl, callback));
+}
+
+void provider::count_active_users(const std::vector<std::string> &subkeys,
+                                  std::function<void(uint64_t count, bool completed)> callback)
+{
+	m_impl->count_active_users(subkeys,
+	                           measure_callback(m_impl->counters(count_active_users_async_op), m_impl, callback));
+}
+
+user_list provider::combine_activity_bitmaps(set_operation op, const std::vector<std::pair<uint64_t, uint64_t>> &periods)
+{
+	return measure(m_impl->counters(combine_activity_bitmaps_op), [&] {
+		return m_impl->combine_activity_bitmaps(op, periods_to_operands(periods));
+	});
+}
+
+user_list provider::combine_activity_bitmaps(set_operation op, const std::vector<std::vector<std::string>> &operands)
+{
+	return measure(m_impl->counters(combine_activity_bitmaps_op), [&] {
+		return m_impl->combine_activity_bitmaps(op, operands);
+	});
+}
+
+void provider::combine_activity_bitmaps(set_operation op, const std::vector<std::pair<uint64_t, uint64_t>> &periods,
+                                        std::function<void(const user_list &active_users, bool completed)> callback)
+{
+	m_impl->combine_activity_bitmaps(op, periods_to_operands(periods),
+	                                 measure_callback(m_impl->counters(combine_activity_bitmaps_async_op), m_impl, callback));
+}
+
+void provider::combine_activity_bitmaps(set_operation op, const std::vector<std::vector<std::string>> &operands,
+                                        std::function<void(const user_list &active_users, bool completed)> callback)
+{
+	m_impl->combine_activity_bitmaps(op, operands,
+	                                 measure_callback(m_impl->counters(combine_activity_bitmaps_async_op), m_impl, callback));
+}
+
+uint64_t provider::count_activity_bitmaps(set_operation op, const std::vector<std::pair<uint64_t, uint64_t>> &periods)
+{
+	return measure(m_impl->counters(count_activity_bitmaps_op), [&] {
+		return m_impl->count_activity_bitmaps(op, periods_to_operands(periods));
+	});
+}
+
+uint64_t provider::count_activity_bitmaps(set_operation op, const std::vector<std::vector<std::string>> &operands)
+{
+	return measure(m_impl->counters(count_activity_bitmaps_op), [&] {
+		return m_impl->count_activity_bitmaps(op, operands);
+	});
+}
+
+void provider::count_activity_bitmaps(set_operation op, const std::vector<std::pair<uint64_t, uint64_t>> &periods,
+                                      std::function<void(uint64_t count, bool completed)> callback)
+{
+	m_impl->count_activity_bitmaps(op, periods_to_operands(periods),
+	                               measure_callback(m_impl->counters(count_activity_bitmaps_async_op), m_impl, callback));
+}
+
+void provider::count_activity_bitmaps(set_operation op, const std::vector<std::vector<std::string>> &operands,
+                                      std::function<void(uint64_t count, bool completed)> callback)
+{
+	m_impl->count_activity_bitmaps(op, operands,
+	                               measure_callback(m_impl->counters(count_activity_bitmaps_async_op), m_impl, callback));
+}
+
+day_stats provider::get_day_stats(uint64_t begin_time, uint64_t end_time)
+{
+	return measure(m_impl->counters(get_day_stats_op), [&] {
+		return m_impl->get_day_stats(time_period_to_subkeys(begin_time, end_time));
+	});
+}
+
+day_stats provider::get_day_stats(const std::vector<std::string> &subkeys)
+{
+	return measure(m_impl->counters(get_day_stats_op), [&] {
+		return m_impl->get_day_stats(subkeys);
+	});
+}
+
+void provider::get_day_stats(uint64_t begin_time, uint64_t end_time,
+                             std::function<void(const day_stats &stats, bool completed)> callback)
+{
+	m_impl->get_day_stats(time_period_to_subkeys(begin_time, end_time),
+	                      measure_callback(m_impl->counters(get_day_stats_async_op), m_impl, callback));
+}
+
+void provider::get_day_stats(const std::vector<std::string> &subkeys,
+                             std::function<void(const day_stats &stats, bool completed)> callback)
+{
+	m_impl->get_day_stats(subkeys,
+	                      measure_callback(m_impl->counters(get_day_stats_async_op), m_impl, callback));
+}
+
+std::vector<uint64_t> provider::get_user_active_days(const std::string &user, uint64_t begin_time, uint64_t end_time)
+{
+	return measure(m_impl->counters(get_user_active_days_op), [&] {
+		return m_impl->get_user_active_days(user, begin_time / consts::SECONDS_IN_DAY, end_time / consts::SECONDS_IN_DAY + 1);
+	});
+}
+
+void provider::get_user_active_days(const std::string &user, uint64_t begin_time, uint64_t end_time,
+                                    std::function<void(const std::vector<uint64_t> &days)> callback)
+{
+	m_impl->get_user_active_days(user, begin_time / consts::SECONDS_IN_DAY, end_time / consts::SECONDS_IN_DAY + 1,
+	                             measure_callback(m_impl->counters(get_user_active_days_async_op), m_impl, callback));
+}
+
+user_list provider::get_active_users_list(uint64_t begin_time, uint64_t end_time)
+{
+	return measure(m_impl->counters(get_active_users_list_op), [&] {
+		return m_impl->get_active_users_list(time_period_to_subkeys(begin_time, end_time));
+	});
+}
+
+user_list provider::get_active_users_list(const std::vector<std::string> &subkeys)
+{
+	return measure(m_impl->counters(get_active_users_list_op), [&] {
+		return m_impl->get_active_users_list(subkeys);
+	});
+}
+
+void provider::get_active_users_list(uint64_t begin_time, uint64_t end_time,
+                                     std::function<void(const user_list &active_users, bool completed)> callback)
+{
+	m_impl->get_active_users_list(time_period_to_subkeys(begin_time, end_time),
+	                              measure_callback(m_impl->counters(get_active_users_list_async_op), m_impl, callback));
+}
+
+void provider::get_active_users_list(const std::vector<std::string> &subkeys,
+                                     std::function<void(const user_list &active_users, bool completed)> callback)
+{
+	m_impl->get_active_users_list(subkeys,
+	                              measure_callback(m_impl->counters(get_active_users_list_async_op), m_impl, callback));
+}
+
+void provider::stream_active_users(uint64_t begin_time, uint64_t end_time, size_t batch_size,
+                                   std::function<void(const std::vector<std::string> &users)> on_users,
+                                   std::function<void(bool completed)> on_complete)
+{
+	m_impl->stream_active_users(time_period_to_subkeys(begin_time, end_time), batch_size, on_users,
+	                            measure_callback(m_impl->counters(stream_active_users_async_op), m_impl, on_complete));
+}
+
+void provider::stream_active_users(const std::vector<std::string> &subkeys, size_t batch_size,
+                                   std::function<void(const std::vector<std::string> &users)> on_users,
+                                   std::function<void(bool completed)> on_complete)
+{
+	m_impl->stream_active_users(subkeys, batch_size, on_users,
+	                            measure_callback(m_impl->counters(stream_active_users_async_op), m_impl, on_complete));
 }
 
 
@@ -199,26 +802,34 @@ void provider::for_user_logs(const std::string &user,
                              uint64_t begin_time, uint64_t end_time,
                              std::function<bool(const ioremap::elliptics::data_pointer &data)> callback)
 {
-	m_impl->for_user_logs(user, time_period_to_subkeys(begin_time, end_time), callback);
+	measure(m_impl->counters(for_user_logs_op), [&] {
+		m_impl->for_user_logs(user, time_period_to_subkeys(begin_time, end_time), callback);
+	});
 }
 
 void provider::for_user_logs(const std::string &user,
                              const std::vector<std::string> &subkeys,
                              std::function<bool(const ioremap::elliptics::data_pointer &data)> callback)
 {
-	m_impl->for_user_logs(user, subkeys, callback);
+	measure(m_impl->counters(for_user_logs_op), [&] {
+		m_impl->for_user_logs(user, subkeys, callback);
+	});
 }
 
 void provider::for_active_users(uint64_t begin_time, uint64_t end_time,
                                 std::function<bool(const std::set<std::string> &active_users)> callback)
 {
-	m_impl->for_active_users(time_period_to_subkeys(begin_time, end_time), callback);
+	measure(m_impl->counters(for_active_users_op), [&] {
+		m_impl->for_active_users(time_period_to_subkeys(begin_time, end_time), callback);
+	});
 }
 
 void provider::for_active_users(const std::vector<std::string> &subkeys,
                                 std::function<bool(const std::set<std::string> &active_users)> callback)
 {
-	m_impl->for_active_users(subkeys, callback);
+	measure(m_impl->counters(for_active_users_op), [&] {
+		m_impl->for_active_users(subkeys, callback);
+	});
 }
 
 
@@ -15,9 +15,29 @@
 */
 
 #include "historydb/provider.h"
+#include "historydb/framing.h"
+#include "coalescer.h"
+#include "activity_cache.h"
+#include "log_cache.h"
+#include "active_users_cache.h"
+#include "hyperloglog.h"
+#include "sketch_buffer.h"
+#include "roaring.h"
+#include "user_dictionary.h"
+#include "activity_calendar.h"
+#include "day_counters.h"
+#include "storage.h"
+#include "elliptics_storage.h"
+#include "memory_storage.h"
+#include "measured_storage.h"
 
 #include <elliptics/cppdef.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
 #include <functional>
 #include <deque>
 
@@ -25,6 +45,7 @@
 #include <boost/bind.hpp>
 #include <boost/lambda/lambda.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include <boost/make_shared.hpp>
 
 #define __STDC_FORMAT_MACROS
@@ -34,6 +55,73 @@
 
 namespace history {
 
+typedef sketch_buffer<hyperloglog> activity_sketches; // buffered HyperLogLog sketches of daily activity
+typedef sketch_buffer<roaring_bitmap> activity_bitmaps; // buffered roaring bitmaps of ids of daily active users
+typedef sketch_buffer<activity_calendar> activity_calendars; // buffered calendars of active days by users
+typedef sketch_buffer<day_counters> day_stats_buffer; // buffered deltas of ingest counters by subkeys
+
+namespace consts {
+	const uint32_t SECONDS_IN_DAY = 24 * 60 * 60; // number of seconds in one day. used for calculation days
+	const char OFFSETS_SUFFIX[] = ".offsets"; // suffix of the key of daily log's offset index
+	const size_t OFFSET_ENTRY_SIZE = 2 * sizeof(uint64_t); // size of serialized offset index entry: time and offset
+	const char SKETCH_SUFFIX[] = ".hll"; // suffix of the key of HyperLogLog sketch of daily activity
+	const char BITMAP_SUFFIX[] = ".bitmap"; // suffix of the key of roaring bitmap of daily activity
+	const size_t USER_IDS_CACHE_SIZE = 1 << 20; // maximum number of user ids which are cached by the dictionary
+	const char CALENDAR_PREFIX[] = "historydb.calendar."; // prefix of the key of user's calendar of active days
+	const char STATS_SUFFIX[] = ".stats"; // suffix of the key of daily ingest counters
+	const char *PROVIDER_OPERATIONS[] = { // names of provider_operation, async variants have ".async" suffix
+		"add_log", "add_log.async",
+		"add_activity", "add_activity.async",
+		"add_log_with_activity", "add_log_with_activity.async",
+		"add_logs", "add_logs.async",
+		"add_logs_with_activity", "add_logs_with_activity.async",
+		"get_user_logs", "get_user_logs.async",
+		"get_user_logs_page", "get_user_logs_page.async",
+		"get_user_records", "get_user_records.async",
+		"get_active_users", "get_active_users.async",
+		"get_active_users_page", "get_active_users_page.async",
+		"get_active_users_list", "get_active_users_list.async",
+		"combine_active_users", "combine_active_users.async",
+		"count_active_users", "count_active_users.async",
+		"combine_activity_bitmaps", "combine_activity_bitmaps.async",
+		"count_activity_bitmaps", "count_activity_bitmaps.async",
+		"get_day_stats", "get_day_stats.async",
+		"get_user_active_days", "get_user_active_days.async",
+		"stream_active_users.async",
+		"for_user_logs",
+		"for_active_users",
+		"repartition_activity"
+	};
+}
+
+/* Public operations of provider which are measured, each sync and async variant has own counters */
+enum provider_operation {
+	add_log_op, add_log_async_op,
+	add_activity_op, add_activity_async_op,
+	add_log_with_activity_op, add_log_with_activity_async_op,
+	add_logs_op, add_logs_async_op,
+	add_logs_with_activity_op, add_logs_with_activity_async_op,
+	get_user_logs_op, get_user_logs_async_op,
+	get_user_logs_page_op, get_user_logs_page_async_op,
+	get_user_records_op, get_user_records_async_op,
+	get_active_users_op, get_active_users_async_op,
+	get_active_users_page_op, get_active_users_page_async_op,
+	get_active_users_list_op, get_active_users_list_async_op,
+	combine_active_users_op, combine_active_users_async_op,
+	count_active_users_op, count_active_users_async_op,
+	combine_activity_bitmaps_op, combine_activity_bitmaps_async_op,
+	count_activity_bitmaps_op, count_activity_bitmaps_async_op,
+	get_day_stats_op, get_day_stats_async_op,
+	get_user_active_days_op, get_user_active_days_async_op,
+	stream_active_users_async_op,
+	for_user_logs_op,
+	for_active_users_op,
+	repartition_activity_op,
+	provider_operations_count
+};
+
+std::string time_to_subkey(uint64_t time);
+
 struct waiter
 {
 	waiter(std::function<void(bool added)> callback,
@@ -49,11 +137,10 @@ struct waiter
 	, min_writes_(min_writes)
 	{}
 
-	void on_log(const ioremap::elliptics::sync_write_result &res,
-	            const ioremap::elliptics::error_info &error) {
+	void on_log(const write_result &res) {
 		boost::mutex::scoped_lock lock(mutex_);
-		if (res.size() < min_writes_) {
-			LOG(DNET_LOG_ERROR, "Can't write data to the minimum number of groups while appending data to user log error: %s\n", error.message().c_str());
+		if (res.written < min_writes_) {
+			LOG(DNET_LOG_ERROR, "Can't write data to the minimum number of groups while appending data to user log error: %s\n", res.error.message.c_str());
 			result_ = false;
 		}
 
@@ -62,11 +149,10 @@ struct waiter
 		handle();
 	}
 
-	void on_activity(const ioremap::elliptics::sync_set_indexes_result &res,
-	                 const ioremap::elliptics::error_info &error) {
+	void on_activity(const write_result &res) {
 		boost::mutex::scoped_lock lock(mutex_);
-		if (res.size() < min_writes_) {
-			LOG(DNET_LOG_ERROR, "Can't write data while adding activity error: %s\n", error.message().c_str());
+		if (res.written < min_writes_) {
+			LOG(DNET_LOG_ERROR, "Can't write data while adding activity error: %s\n", res.error.message.c_str());
 			result_ = false;
 		}
 
@@ -92,6 +178,330 @@ private:
 	uint32_t min_writes_;
 };
 
+/* State of one batch of records which is written by provider::impl::add_logs
+*/
+struct batch
+{
+	batch(const std::vector<log_record> &records_,
+	      bool with_activity_,
+	      std::function<void(const std::vector<bool> &added)> callback_,
+	      uint32_t max_in_flight_)
+	: records(records_)
+	, results(records_.size(), false)
+	, with_activity(with_activity_)
+	, callback(callback_)
+	, max_in_flight(max_in_flight_)
+	, next(0)
+	, in_flight(0)
+	, completed(0)
+	, submitting(false)
+	{}
+
+	const std::vector<log_record>						records; // records of the batch
+	std::vector<bool>									results; // results of records writing
+	const bool											with_activity; // whether activity should be updated for each record
+	std::function<void(const std::vector<bool> &added)>	callback; // complete callback
+	const uint32_t										max_in_flight; // maximum number of simultaneously written records
+	size_t												next; // index of the next record which should be written
+	size_t												in_flight; // number of records which are being written
+	size_t												completed; // number of written records
+	bool												submitting; // whether some thread is submitting records now
+	boost::mutex										mutex;
+};
+
+/* Collects active users from all activity chunks which are requested simultaneously
+*/
+struct active_users_gather
+{
+	active_users_gather(size_t requests_,
+	                    std::function<void(const user_list &active_users, bool completed)> callback_)
+	: requests(requests_)
+	, failed(false)
+	, callback(callback_)
+	{}
+
+	size_t																requests; // number of requests which are not completed yet
+	std::vector<std::string>											found; // users found by requests, each user is found once in its chunk
+	std::vector<std::shared_ptr<const user_list>>						cached; // active users of days which have been found in the cache
+	std::shared_ptr<active_users_cache>									cache; // cache of closed days, null if the cache is disabled
+	std::vector<std::string>											closed_subkeys; // requested closed days which should be put into the cache
+	std::vector<std::vector<std::string>>								closed_users; // users of closed_subkeys which have been found by requests
+	std::map<std::string, size_t>										closed_indexes; // indexes in closed_subkeys by names of their activity indexes
+	bool																failed; // whether some request has failed, partial results aren't cached
+	std::function<void(const user_list &active_users, bool completed)>	callback; // result callback, completed is false if reading has failed
+	boost::mutex														mutex;
+};
+
+/* State of reading of one page of active users. Activity chunks are read one after another until the page is full,
+	users of each chunk are sorted, so position in the chunk is defined by the last returned user.
+*/
+struct active_users_pager
+{
+	active_users_pager(const std::vector<std::string> &subkeys_,
+	                   uint32_t chunks_,
+	                   uint32_t chunk_,
+	                   const std::string &last_user_,
+	                   size_t limit_,
+	                   std::function<void(const active_users_page &page, bool completed)> callback_)
+	: subkeys(subkeys_)
+	, chunks(chunks_)
+	, chunk(chunk_)
+	, last_user(last_user_)
+	, limit(limit_)
+	, callback(callback_)
+	{}
+
+	const std::vector<std::string>						subkeys; // days of activity statistics
+	const uint32_t										chunks; // number of activity chunks
+	uint32_t											chunk; // chunk which is being read
+	std::string											last_user; // last returned user of the chunk, empty - from the beginning of the chunk
+	const size_t										limit; // maximum number of users in the page, 0 - no limit
+	active_users_page												page; // result page
+	std::function<void(const active_users_page &page, bool completed)>	callback; // result callback, completed is false if reading has failed
+};
+
+/* State of set operation over active users of several operands. Activity chunks are processed one after another:
+	users of each operand in the chunk are read, combined by sorted merge and only the result of the chunk is kept.
+	Each user is placed in the same chunk for all days, so results of chunks don't intersect.
+*/
+struct set_operation_gather
+{
+	set_operation_gather(set_operation op_,
+	                     const std::vector<std::vector<std::string>> &operands_,
+	                     uint32_t chunks_,
+	                     std::function<void(const user_list &active_users, bool completed)> callback_)
+	: op(op_)
+	, operands(operands_)
+	, chunks(chunks_)
+	, chunk(0)
+	, requests(0)
+	, failed(false)
+	, callback(callback_)
+	{}
+
+	const set_operation												op; // operation which is applied to operands from left to right
+	const std::vector<std::vector<std::string>>						operands; // subkeys of each operand
+	const uint32_t													chunks; // number of activity chunks
+	uint32_t														chunk; // chunk which is being processed
+	size_t															requests; // number of operand reads of the chunk which are not completed yet
+	bool															failed; // whether some operand of the chunk couldn't be read
+	std::vector<std::vector<std::string>>							users; // users of operands in the chunk
+	std::vector<std::shared_ptr<const user_list>>					results; // results of processed chunks
+	std::function<void(const user_list &active_users, bool completed)>	callback; // result callback, completed is false if reading has failed
+	boost::mutex													mutex;
+};
+
+/* State of counting of active users by merging of daily sketches
+*/
+struct sketch_gather
+{
+	sketch_gather(size_t requests_, std::function<void(uint64_t count, bool completed)> callback_)
+	: requests(requests_)
+	, failed(false)
+	, callback(callback_)
+	{}
+
+	size_t												requests; // number of reads which are not completed yet
+	bool												failed; // whether sketch of some day couldn't be read
+	hyperloglog											sketch; // merged sketch of all read days
+	std::function<void(uint64_t count, bool completed)>	callback; // result callback, completed is false if reading has failed
+	boost::mutex										mutex;
+};
+
+/* State of summing of ingest counters of several days
+*/
+struct day_stats_gather
+{
+	day_stats_gather(size_t requests_, std::function<void(const day_stats &stats, bool completed)> callback_)
+	: requests(requests_)
+	, failed(false)
+	, callback(callback_)
+	{}
+
+	size_t														requests; // number of reads which are not completed yet
+	bool														failed; // whether counters of some day couldn't be read
+	day_counters												counters; // sum of counters of read days
+	std::function<void(const day_stats &stats, bool completed)>	callback; // result callback, completed is false if reading has failed
+	boost::mutex												mutex;
+};
+
+/* State of combining of operands by reading of daily activity bitmaps
+*/
+struct bitmap_gather
+{
+	bitmap_gather(set_operation op_, size_t operands, size_t requests_,
+	              std::function<void(const roaring_bitmap &ids, bool completed)> callback_)
+	: op(op_)
+	, bitmaps(operands)
+	, requests(requests_)
+	, failed(false)
+	, callback(callback_)
+	{}
+
+	const set_operation												op; // operation which is applied to operands
+	std::vector<roaring_bitmap>										bitmaps; // united bitmaps of days of each operand
+	size_t															requests; // number of reads which are not completed yet
+	bool															failed; // whether some bitmap couldn't be read
+	std::function<void(const roaring_bitmap &ids, bool completed)>	callback; // result callback, completed is false if reading has failed
+	boost::mutex													mutex;
+};
+
+/* State of streaming of active users from all activity chunks
+*/
+struct active_users_stream
+{
+	active_users_stream(size_t requests_,
+	                    size_t batch_size_,
+	                    std::function<void(const std::vector<std::string> &users)> on_users_,
+	                    std::function<void(bool completed)> on_complete_)
+	: requests(requests_)
+	, batch_size(std::max<size_t>(batch_size_, 1))
+	, failed(false)
+	, on_users(on_users_)
+	, on_complete(on_complete_)
+	{}
+
+	size_t														requests; // number of requests which are not completed yet
+	const size_t												batch_size; // maximum number of users in one batch
+	std::vector<std::string>									batch; // users which haven't been passed to on_users yet
+	bool														failed; // whether some request has failed
+	std::function<void(const std::vector<std::string> &users)>	on_users; // batch callback
+	std::function<void(bool completed)>							on_complete; // complete callback
+	boost::mutex												mutex; // serializes calls of callbacks
+};
+
+/* Runs async operation and waits until it passes result to its handler
+*/
+template <typename T>
+T wait_result(std::function<void(std::function<void(const T &result)> handler)> operation)
+{
+	pending_result<T> ret;
+	operation(ret.handler());
+	return ret.get();
+}
+
+/* Collects user logs which are read simultaneously. Each read fills own slot, so logs keep order of subkeys.
+*/
+struct user_logs_gather
+{
+	user_logs_gather(const std::vector<std::string> &keys_,
+	                 std::function<void(std::vector<ioremap::elliptics::data_pointer> &slots, bool completed)> handler_)
+	: keys(keys_)
+	, remaining(keys_.size())
+	, failed(false)
+	, slots(keys_.size())
+	, cacheable(keys_.size(), false)
+	, generations(keys_.size(), 0)
+	, handler(handler_)
+	{}
+
+	const std::vector<std::string>																keys; // keys of user logs in order of subkeys
+	std::atomic<size_t>																			remaining; // number of reads which are not completed yet
+	std::atomic<bool>																			failed; // whether some log couldn't be read, missing log isn't a failure
+	std::vector<ioremap::elliptics::data_pointer>												slots; // read logs in order of subkeys, empty if there is no log
+	std::shared_ptr<log_cache>																	cache; // cache of past days logs, null if the cache is disabled
+	std::vector<bool>																			cacheable; // whether read log could be put into the cache
+	std::vector<uint64_t>																		generations; // generations of the cache taken before logs are read
+	std::function<void(std::vector<ioremap::elliptics::data_pointer> &slots, bool completed)>	handler; // complete handler
+};
+
+/* State of reading of one page of user logs. Daily logs are read one after another by ranges until the page is full.
+*/
+struct user_logs_pager
+{
+	user_logs_pager(const std::vector<std::string> &keys_,
+	                size_t day_,
+	                uint64_t offset_,
+	                uint64_t max_bytes_,
+	                std::function<void(const user_logs_page &page, bool completed)> callback_)
+	: keys(keys_)
+	, day(day_)
+	, offset(offset_)
+	, max_bytes(max_bytes_)
+	, size(0)
+	, callback(callback_)
+	{}
+
+	const std::vector<std::string>									keys; // keys of user logs in order of subkeys
+	size_t															day; // index of the key which is being read
+	uint64_t														offset; // offset in the daily log from which reading continues
+	const uint64_t													max_bytes; // maximum size of logs data in the page, 0 - no limit
+	uint64_t														size; // size of logs data which has been added to the page
+	user_logs_page													page; // result page
+	std::function<void(const user_logs_page &page, bool completed)>	callback; // result callback, completed is false if reading has failed
+};
+
+/* Entry of the sparse offset index of daily user log.
+	Index is built from records of the log while it is read, so offset is always boundary of framed record.
+	Entry is added when framed record crosses boundary of index step, so all records before offset have time not greater than time.
+*/
+struct offset_entry
+{
+	uint64_t	time; // maximum time of records before offset relative to the begin of the log's day
+	uint64_t	offset; // offset of the next record in the daily log
+};
+
+/* Serializes offset index as pairs of little-endian time and offset, so the index doesn't depend on the host */
+static ioremap::elliptics::data_pointer pack_offsets(const std::vector<offset_entry> &entries)
+{
+	auto ret = ioremap::elliptics::data_pointer::allocate(entries.size() * consts::OFFSET_ENTRY_SIZE);
+	uint8_t *pos = ret.data<uint8_t>();
+
+	for (auto it = entries.begin(), end = entries.end(); it != end; ++it, pos += consts::OFFSET_ENTRY_SIZE) {
+		for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+			pos[i] = static_cast<uint8_t>(it->time >> (8 * i));
+			pos[sizeof(uint64_t) + i] = static_cast<uint8_t>(it->offset >> (8 * i));
+		}
+	}
+
+	return ret;
+}
+
+/* Parses offset index serialized by pack_offsets, incomplete trailing entry is ignored */
+static std::vector<offset_entry> unpack_offsets(const ioremap::elliptics::data_pointer &data)
+{
+	std::vector<offset_entry> ret(data.size() / consts::OFFSET_ENTRY_SIZE);
+	const uint8_t *pos = data.data<uint8_t>();
+
+	for (auto it = ret.begin(), end = ret.end(); it != end; ++it, pos += consts::OFFSET_ENTRY_SIZE) {
+		it->time = 0;
+		it->offset = 0;
+		for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+			it->time |= static_cast<uint64_t>(pos[i]) << (8 * i);
+			it->offset |= static_cast<uint64_t>(pos[sizeof(uint64_t) + i]) << (8 * i);
+		}
+	}
+
+	return ret;
+}
+
+/* Collects user log records of the time period which are read simultaneously for each day
+*/
+struct user_records_gather
+{
+	user_records_gather(uint64_t begin_day_,
+	                    size_t days_,
+	                    uint64_t begin_time_,
+	                    uint64_t end_time_,
+	                    std::function<void(const std::vector<framing::record> &records, bool completed)> callback_)
+	: begin_day(begin_day_)
+	, remaining(days_)
+	, slots(days_)
+	, begin_time(begin_time_)
+	, end_time(end_time_)
+	, failed(false)
+	, callback(callback_)
+	{}
+
+	const uint64_t																		begin_day; // number of the first day of the period
+	std::atomic<size_t>																	remaining; // number of days which are not read yet
+	std::vector<std::vector<framing::record>>											slots; // records of each day in order of days
+	const uint64_t																		begin_time; // begin of the time period (in seconds)
+	const uint64_t																		end_time; // end of the time period (in seconds)
+	std::atomic<bool>																	failed; // whether some daily log couldn't be read
+	std::function<void(const std::vector<framing::record> &records, bool completed)>	callback; // result callback
+};
+
 class provider::impl: public std::enable_shared_from_this<provider::impl>
 {
 public:
@@ -103,10 +513,49 @@ public:
 	     const std::vector<int>& groups, uint32_t min_writes,
 	     const std::string& log_file, const int log_level,
 	     uint32_t wait_timeout, uint32_t check_timeout);
+	impl(const memory_storage_config& config,
+	     const std::string& log_file, const int log_level);
+
+	void shutdown();
 
 	void set_session_parameters(const std::vector<int>& groups, uint32_t min_writes,
 	                            uint32_t wait_timeout, uint32_t check_timeout);
 
+	void set_coalescing_parameters(uint32_t window, uint32_t max_bytes);
+
+	void set_batch_parameters(uint32_t max_in_flight);
+
+	void set_activity_cache_parameters(size_t max_size);
+	cache_stats get_activity_cache_stats();
+
+	void set_log_cache_parameters(size_t max_size);
+	cache_stats get_log_cache_stats();
+
+	void set_active_users_cache_parameters(size_t max_size);
+	cache_stats get_active_users_cache_stats();
+
+	operation_counters &counters(provider_operation op) { return counters_[op]; }
+	std::vector<operation_stats> get_operation_stats();
+
+	void set_activity_sketch_parameters(uint32_t interval);
+
+	void set_activity_bitmap_parameters(uint32_t interval);
+
+	void set_activity_calendar_parameters(uint32_t interval);
+
+	void set_day_stats_parameters(uint32_t interval);
+
+	void set_activity_chunks(uint32_t chunks);
+
+	void set_bulk_read_parameters(uint32_t min_keys);
+
+	void set_framed_logs(bool framed);
+	void set_offset_index_parameters(uint32_t step);
+	ioremap::elliptics::data_pointer pack_log(uint64_t time, const ioremap::elliptics::data_pointer &data) const;
+	ioremap::elliptics::data_pointer pack_log(const ioremap::elliptics::data_pointer &data) const;
+
+	void repartition_activity(const std::vector<std::string>& subkeys, uint32_t chunks);
+
 	void add_log(const std::string& user,
 	             const std::string& subkey,
 	             const ioremap::elliptics::data_pointer &data);
@@ -128,16 +577,84 @@ public:
 	                           const ioremap::elliptics::data_pointer &data,
 	                           std::function<void(bool added)> callback);
 
+	std::vector<bool> add_logs(const std::vector<log_record>& records, bool with_activity);
+	void add_logs(const std::vector<log_record>& records, bool with_activity,
+	              std::function<void(const std::vector<bool> &added)> callback);
+
 	std::vector<ioremap::elliptics::data_pointer> get_user_logs(const std::string& user,
 	                                                            const std::vector<std::string>& subkeys);
 	void get_user_logs(const std::string& user,
 	                   const std::vector<std::string>& subkeys,
 	                   std::function<void(const std::vector<ioremap::elliptics::data_pointer> &data)> callback);
 
+	user_logs_page get_user_logs(const std::string& user,
+	                             const std::vector<std::string>& subkeys,
+	                             uint64_t max_bytes,
+	                             const std::string& cursor);
+	void get_user_logs(const std::string& user,
+	                   const std::vector<std::string>& subkeys,
+	                   uint64_t max_bytes,
+	                   const std::string& cursor,
+	                   std::function<void(const user_logs_page &page, bool completed)> callback);
+
+	std::vector<framing::record> get_user_records(const std::string& user, uint64_t begin_time, uint64_t end_time);
+	void get_user_records(const std::string& user,
+	                      uint64_t begin_time, uint64_t end_time,
+	                      std::function<void(const std::vector<framing::record> &records, bool completed)> callback);
+	std::vector<framing::record> get_user_records(const std::string& user, const std::vector<std::string>& subkeys);
+	void get_user_records(const std::string& user,
+	                      const std::vector<std::string>& subkeys,
+	                      std::function<void(const std::vector<framing::record> &records, bool completed)> callback);
+
 	std::set<std::string> get_active_users(const std::vector<std::string>& subkeys);
 	void get_active_users(const std::vector<std::string>& subkeys,
 	                      std::function<void(const std::set<std::string> &active_users)> callback);
 
+	user_list get_active_users_list(const std::vector<std::string>& subkeys);
+	void get_active_users_list(const std::vector<std::string>& subkeys,
+	                           std::function<void(const user_list &active_users, bool completed)> callback);
+
+	active_users_page get_active_users(const std::vector<std::string>& subkeys,
+	                                   size_t limit,
+	                                   const std::string& cursor);
+	void get_active_users(const std::vector<std::string>& subkeys,
+	                      size_t limit,
+	                      const std::string& cursor,
+	                      std::function<void(const active_users_page &page, bool completed)> callback);
+
+	void stream_active_users(const std::vector<std::string>& subkeys,
+	                         size_t batch_size,
+	                         std::function<void(const std::vector<std::string> &users)> on_users,
+	                         std::function<void(bool completed)> on_complete);
+
+	user_list combine_active_users(set_operation op, const std::vector<std::vector<std::string>>& operands);
+	void combine_active_users(set_operation op,
+	                          const std::vector<std::vector<std::string>>& operands,
+	                          std::function<void(const user_list &active_users, bool completed)> callback);
+
+	uint64_t count_active_users(const std::vector<std::string>& subkeys);
+	void count_active_users(const std::vector<std::string>& subkeys,
+	                        std::function<void(uint64_t count, bool completed)> callback);
+
+	user_list combine_activity_bitmaps(set_operation op, const std::vector<std::vector<std::string>>& operands);
+	void combine_activity_bitmaps(set_operation op,
+	                              const std::vector<std::vector<std::string>>& operands,
+	                              std::function<void(const user_list &active_users, bool completed)> callback);
+
+	uint64_t count_activity_bitmaps(set_operation op, const std::vector<std::vector<std::string>>& operands);
+	void count_activity_bitmaps(set_operation op,
+	                            const std::vector<std::vector<std::string>>& operands,
+	                            std::function<void(uint64_t count, bool completed)> callback);
+
+	day_stats get_day_stats(const std::vector<std::string>& subkeys);
+	void get_day_stats(const std::vector<std::string>& subkeys,
+	                   std::function<void(const day_stats &stats, bool completed)> callback);
+
+	std::vector<uint64_t> get_user_active_days(const std::string& user, uint64_t begin_day, uint64_t end_day);
+	void get_user_active_days(const std::string& user,
+	                          uint64_t begin_day, uint64_t end_day,
+	                          std::function<void(const std::vector<uint64_t> &days)> callback);
+
 	void for_user_logs(const std::string& user,
 	                   const std::vector<std::string>& subkeys,
 	                   std::function<bool(const ioremap::elliptics::data_pointer &data)> callback);
@@ -146,38 +663,167 @@ public:
 	                      std::function<bool(const std::set<std::string>& active_users)> callback);
 
 private:
-	ioremap::elliptics::session create_session(uint32_t io_flags = 0) const;
-
-	ioremap::elliptics::async_write_result
-	add_log(ioremap::elliptics::session& s,
-	        const std::string& user,
-	        const std::string& subkey,
-	        const ioremap::elliptics::data_pointer &data);
-	ioremap::elliptics::async_set_indexes_result
-	add_activity(ioremap::elliptics::session& s,
-	             const std::string& user,
-	             const std::string& subkey);
-	ioremap::elliptics::async_find_indexes_result
-	get_active_users(ioremap::elliptics::session& s,
-	                 const std::vector<std::string>& subkeys);
-
-	static void on_user_log(std::shared_ptr<std::list<ioremap::elliptics::async_read_result>> results,
-							std::shared_ptr<std::vector<ioremap::elliptics::data_pointer>> data,
-							std::function<void(const std::vector<ioremap::elliptics::data_pointer> &data)> callback,
-							const ioremap::elliptics::sync_read_result &entry,
-							const ioremap::elliptics::error_info &error);
-	static void on_active_users(std::function<void(const std::set<std::string> &active_users)> callback,
-	                            const ioremap::elliptics::sync_find_indexes_result &result,
-	                            const ioremap::elliptics::error_info &error);
+	void write_user_log(const std::string& user,
+	                    const std::string& subkey,
+	                    const ioremap::elliptics::data_pointer &data,
+	                    storage::write_handler_t handler);
+	void append_log(const std::string& user,
+	                const std::string& subkey,
+	                const ioremap::elliptics::data_pointer &data,
+	                coalescer::handler_t handler);
+	std::shared_ptr<coalescer> get_coalescer();
+	void write_log(const std::string& key,
+	               const ioremap::elliptics::data_pointer &data,
+	               coalescer::handler_t handler);
+	void on_log_written(const std::string& key, coalescer::handler_t handler, const write_result &res);
+
+	std::shared_ptr<activity_cache> get_activity_cache();
+	std::shared_ptr<log_cache> get_log_cache();
+	std::shared_ptr<active_users_cache> get_active_users_cache();
+	void invalidate_log(const std::string& key);
+	static bool is_past_day(const std::string& subkey);
+	static bool subkey_to_day(const std::string& subkey, uint32_t &day);
+	static void cache_log(std::shared_ptr<user_logs_gather> gather, size_t index);
+	static bool is_active(const std::shared_ptr<activity_cache>& cache,
+	                      const std::string& user,
+	                      const std::string& subkey);
+	static std::function<void(bool added)> remember_activity(std::shared_ptr<activity_cache> cache,
+	                                                         const std::string& user,
+	                                                         const std::string& subkey,
+	                                                         std::function<void(bool added)> callback);
+
+	void submit_batch(std::shared_ptr<batch> b);
+	void on_batch_record(std::shared_ptr<batch> b, size_t index, bool added);
+
+	void write_activity(const std::string& user,
+	                    const std::string& subkey,
+	                    storage::write_handler_t handler);
+	void on_activity_written(const std::string& user,
+	                         const std::string& subkey,
+	                         storage::write_handler_t handler,
+	                         const write_result &res);
+	std::vector<std::vector<std::string>> active_users_indexes(const std::vector<std::string>& subkeys, uint32_t chunks);
+	void repartition_activity(const std::string& subkey, uint32_t chunks);
+
+	void read_user_logs(const std::string& user,
+	                    const std::vector<std::string>& subkeys,
+	                    std::function<void(std::vector<ioremap::elliptics::data_pointer> &slots, bool completed)> handler);
+	void read_user_logs(std::shared_ptr<user_logs_gather> gather, const std::vector<size_t>& indexes);
+	void on_bulk_user_logs(std::shared_ptr<user_logs_gather> gather,
+	                       const std::vector<size_t>& indexes,
+	                       const std::vector<read_result> &res);
+	static void on_user_log(std::shared_ptr<user_logs_gather> gather, size_t index, const read_result &res);
+	static std::vector<ioremap::elliptics::data_pointer> non_empty(std::vector<ioremap::elliptics::data_pointer> &slots);
+	void read_page(std::shared_ptr<user_logs_pager> pager);
+	void read_page_log(std::shared_ptr<user_logs_pager> pager, uint64_t requested);
+	void on_page_log(std::shared_ptr<user_logs_pager> pager, uint64_t requested, const read_result &res);
+	static std::pair<size_t, uint64_t> parse_cursor(const std::string& cursor);
+	void on_offsets(std::shared_ptr<user_records_gather> gather,
+	                size_t index,
+	                const std::string& key,
+	                const read_result &res);
+	void read_day_records(std::shared_ptr<user_records_gather> gather,
+	                      size_t index,
+	                      const std::string& key,
+	                      uint64_t offset,
+	                      bool build_index,
+	                      const std::vector<offset_entry> &entries);
+	void on_day_records(std::shared_ptr<user_records_gather> gather,
+	                    size_t index,
+	                    const std::string& key,
+	                    uint64_t offset,
+	                    bool build_index,
+	                    std::vector<offset_entry> entries,
+	                    const read_result &res);
+	void write_offsets(const std::string& key, const std::vector<offset_entry> &entries);
+	void on_offsets_written(const std::string& key, const write_result &res);
+	static std::string make_cursor(size_t day, uint64_t offset);
+	static void on_active_users(std::shared_ptr<active_users_gather> gather, const find_result &res);
+	static void finish_active_users(std::shared_ptr<active_users_gather> gather);
+	static std::set<std::string> to_set(const user_list& users);
+	void read_users_page(std::shared_ptr<active_users_pager> pager);
+	void on_users_page(std::shared_ptr<active_users_pager> pager, const find_result &res);
+	static std::pair<uint32_t, std::string> parse_users_cursor(const std::string& cursor, uint32_t chunks);
+	static std::string make_users_cursor(uint32_t chunk, uint32_t chunks, const std::string& last_user);
+	void read_operands(std::shared_ptr<set_operation_gather> gather);
+	void on_operand(std::shared_ptr<set_operation_gather> gather, size_t operand, const find_result &res);
+	static std::shared_ptr<const user_list> combine_chunk(std::shared_ptr<set_operation_gather> gather);
+	static void on_sketch_read(std::shared_ptr<sketch_gather> gather, const read_result &res);
+	void read_activity_bitmaps(set_operation op,
+	                           const std::vector<std::vector<std::string>>& operands,
+	                           std::function<void(const roaring_bitmap &ids, bool completed)> callback);
+	static void on_bitmap_read(std::shared_ptr<bitmap_gather> gather, size_t operand, const read_result &res);
+	static void combine_bitmaps(std::shared_ptr<bitmap_gather> gather);
+	static void on_stream_user(std::shared_ptr<active_users_stream> stream, const found_entry &entry);
+	static void on_stream_finished(std::shared_ptr<active_users_stream> stream, const storage_error &error);
+
+	std::shared_ptr<activity_sketches> get_activity_sketches();
+	void write_sketch(const std::string& subkey, const hyperloglog &sketch, std::weak_ptr<activity_sketches> owner);
+	static void on_sketch_written(std::weak_ptr<activity_sketches> sketches,
+	                              const std::string& subkey,
+	                              const hyperloglog &sketch,
+	                              const write_result &res);
+
+	std::shared_ptr<day_stats_buffer> get_day_stats_buffer();
+	void add_day_stats(const std::string& user, const std::string& subkey, uint64_t size);
+	coalescer::handler_t count_log(const std::string& user,
+	                               const std::string& subkey,
+	                               uint64_t size,
+	                               coalescer::handler_t handler);
+	static void on_day_stats_read(std::shared_ptr<day_stats_gather> gather, const read_result &res);
+	void write_day_stats(const std::string& subkey, const day_counters &counters, std::weak_ptr<day_stats_buffer> owner);
+	static void on_day_stats_written(std::weak_ptr<day_stats_buffer> stats,
+	                                 const std::string& subkey,
+	                                 const day_counters &counters,
+	                                 std::shared_ptr<std::atomic<bool>> converted,
+	                                 const write_result &res);
+
+	std::shared_ptr<activity_calendars> get_activity_calendars();
+	void add_calendar_day(const std::string& user, const std::string& subkey);
+	void read_calendar(const std::string& user, std::function<void(const activity_calendar &calendar)> callback);
+	void on_calendar_read(const std::string& user,
+	                      std::function<void(const activity_calendar &calendar)> callback,
+	                      const read_result &res);
+	void write_calendar(const std::string& user, const activity_calendar &calendar, std::weak_ptr<activity_calendars> owner);
+	static void on_calendar_written(std::weak_ptr<activity_calendars> calendars,
+	                                const std::string& user,
+	                                const activity_calendar &calendar,
+	                                const write_result &res);
+
+	std::shared_ptr<activity_bitmaps> get_activity_bitmaps();
+	void write_bitmap(const std::string& subkey, const roaring_bitmap &bitmap, std::weak_ptr<activity_bitmaps> owner);
+	static void on_bitmap_written(std::weak_ptr<activity_bitmaps> bitmaps,
+	                              const std::string& subkey,
+	                              const roaring_bitmap &bitmap,
+	                              const write_result &res);
 
 	std::string combine_key(const std::string& user, const std::string& subkey) const;
+	std::string activity_index(const std::string& user, const std::string& subkey, uint32_t chunks) const;
+	std::string chunk_index(const std::string& subkey, uint32_t chunk, uint32_t chunks) const;
 
 
-	std::vector<int>					groups_; // groups of elliptics
 	uint32_t							min_writes_; // minimum number of succeeded writes for each write attempt
+	uint32_t							max_in_flight_; // maximum number of simultaneously written records of one batch
+	uint32_t							activity_chunks_; // number of chunks to which daily activity is split
+	uint32_t							bulk_read_min_keys_; // minimum number of user log keys which are read by bulk read, 0 - bulk read is disabled
+	bool								framed_logs_; // whether appended logs are packed into framed records
+	uint32_t							offset_index_step_; // distance in bytes between offset index entries, 0 - index isn't updated
 	dnet_config							config_; //elliptics config
 	ioremap::elliptics::file_logger		log_; // logger
-	ioremap::elliptics::node			node_; // elliptics node
+	ioremap::elliptics::node			node_; // elliptics node, it is used only for logging with memory storage
+	const std::shared_ptr<measured_storage>	storage_; // storage of logs, activity and statistics
+	operation_counters					counters_[provider_operations_count]; // counters of public operations
+	std::shared_ptr<activity_cache>		activity_cache_; // users which have been already marked as active, null if the cache is disabled
+	std::shared_ptr<log_cache>			log_cache_; // logs of past days which have been read recently, null if the cache is disabled
+	std::shared_ptr<active_users_cache>	active_users_cache_; // active users of closed days, null if the cache is disabled
+	const std::shared_ptr<user_dictionary>	user_dictionary_; // ids of users which are used by activity bitmaps
+	boost::mutex						mutex_; // guards replacement of coalescer_, caches and buffered sketches, bitmaps, calendars and stats
+	// buffering components write buffered data by shutdown, because their writes keep the impl alive by shared_from_this
+	std::shared_ptr<coalescer>			coalescer_; // merges async appends to the same key, null if coalescing is disabled
+	std::shared_ptr<activity_sketches>	activity_sketches_; // buffered sketches of daily activity, null if sketches are disabled
+	std::shared_ptr<activity_bitmaps>	activity_bitmaps_; // buffered bitmaps of daily activity, null if bitmaps are disabled
+	std::shared_ptr<activity_calendars>	activity_calendars_; // buffered calendars of active days, null if calendars are disabled
+	std::shared_ptr<day_stats_buffer>	day_stats_; // buffered deltas of daily ingest counters, null if counters are disabled
 };
 
 dnet_config create_config(uint32_t wait_timeout, uint32_t check_timeout)
@@ -198,11 +844,17 @@ provider::impl::impl(const std::vector<server_info>& servers,
                      const std::vector<int>& groups, uint32_t min_writes,
                      const std::string& log_file, const int log_level,
                      uint32_t wait_timeout, uint32_t check_timeout)
-: groups_(groups)
-, min_writes_(min_writes)
+: min_writes_(min_writes)
+, max_in_flight_(1024)
+, activity_chunks_(1)
+, bulk_read_min_keys_(0)
+, framed_logs_(false)
+, offset_index_step_(0)
 , config_(create_config(wait_timeout, check_timeout))
 , log_(log_file.c_str(), log_level)
 , node_(log_, config_)
+, storage_(std::make_shared<measured_storage>(std::make_shared<elliptics_storage>(node_, groups)))
+, user_dictionary_(std::make_shared<user_dictionary>(storage_, consts::USER_IDS_CACHE_SIZE))
 {
 	for (auto it = servers.begin(), end = servers.end(); it != end; ++it) {
 		try {
@@ -214,8 +866,8 @@ provider::impl::impl(const std::vector<server_info>& servers,
 		}
 	}
 
-	if (min_writes_ > groups_.size())
-		min_writes_ = groups_.size();
+	if (min_writes_ > groups.size())
+		min_writes_ = groups.size();
 
 	LOG(DNET_LOG_INFO, "provider::impl has been created\n");
 }
@@ -224,11 +876,17 @@ provider::impl::impl(const std::vector<std::string>& servers,
                      const std::vector<int>& groups, uint32_t min_writes,
                      const std::string& log_file, const int log_level,
                      uint32_t wait_timeout, uint32_t check_timeout)
-: groups_(groups)
-, min_writes_(min_writes)
+: min_writes_(min_writes)
+, max_in_flight_(1024)
+, activity_chunks_(1)
+, bulk_read_min_keys_(0)
+, framed_logs_(false)
+, offset_index_step_(0)
 , config_(create_config(wait_timeout, check_timeout))
 , log_(log_file.c_str(), log_level)
 , node_(log_, config_)
+, storage_(std::make_shared<measured_storage>(std::make_shared<elliptics_storage>(node_, groups)))
+, user_dictionary_(std::make_shared<user_dictionary>(storage_, consts::USER_IDS_CACHE_SIZE))
 {
 	for (auto it = servers.begin(), end = servers.end(); it != end; ++it) {
 		try {
@@ -240,358 +898,2320 @@ provider::impl::impl(const std::vector<std::string>& servers,
 		}
 	}
 
-	if (min_writes_ > groups_.size())
-		min_writes_ = groups_.size();
+	if (min_writes_ > groups.size())
+		min_writes_ = groups.size();
 
 	LOG(DNET_LOG_INFO, "provider::impl has been created\n");
 }
 
+provider::impl::impl(const memory_storage_config& config,
+                     const std::string& log_file, const int log_level)
+: min_writes_(1)
+, max_in_flight_(1024)
+, activity_chunks_(1)
+, bulk_read_min_keys_(0)
+, framed_logs_(false)
+, offset_index_step_(0)
+, config_(create_config(60, 60))
+, log_(log_file.c_str(), log_level)
+, node_(log_, config_) // node without remotes isn't connected to elliptics
+, storage_(std::make_shared<measured_storage>(std::make_shared<memory_storage>(config)))
+, user_dictionary_(std::make_shared<user_dictionary>(storage_, consts::USER_IDS_CACHE_SIZE))
+{
+	LOG(DNET_LOG_INFO, "provider::impl has been created with memory storage: read latency: %u us write latency: %u us index latency: %u us threads: %u\n",
+	    config.read_latency, config.write_latency, config.index_latency, config.threads);
+}
+
+void provider::impl::shutdown()
+{
+	std::shared_ptr<coalescer> c;
+	std::shared_ptr<activity_sketches> sketches;
+	std::shared_ptr<activity_bitmaps> bitmaps;
+	std::shared_ptr<activity_calendars> calendars;
+	std::shared_ptr<day_stats_buffer> stats;
+
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		std::swap(coalescer_, c);
+		std::swap(activity_sketches_, sketches);
+		std::swap(activity_bitmaps_, bitmaps);
+		std::swap(activity_calendars_, calendars);
+		std::swap(day_stats_, stats);
+	}
+
+	// appends are flushed first, so the other buffers could still get activity and counters of appends which complete meanwhile
+	c.reset();
+	sketches.reset();
+	bitmaps.reset();
+	calendars.reset();
+	stats.reset();
+
+	LOG(DNET_LOG_INFO, "provider::impl has been shut down\n");
+}
+
 void provider::impl::set_session_parameters(const std::vector<int>& groups, uint32_t min_writes,
                                             uint32_t wait_timeout, uint32_t check_timeout)
 {
-	groups_ = groups;
+	storage_->set_groups(groups);
 	min_writes_ = min_writes;
 
-	if (min_writes_ > groups_.size())
-		min_writes_ = groups_.size();
+	if (min_writes_ > groups.size())
+		min_writes_ = groups.size();
 
 	node_.set_timeouts(wait_timeout, check_timeout);
-}
 
-void provider::impl::add_log(const std::string& user,
-                             const std::string& subkey,
-                             const ioremap::elliptics::data_pointer &data)
-{
-	auto s = create_session(DNET_IO_FLAGS_CACHE | DNET_IO_FLAGS_APPEND);
+	if (auto cache = get_activity_cache())
+		cache->clear(); // users marked as active in previous groups could be missed in new groups
 
-	auto res = add_log(s, user, subkey, data);
+	if (auto cache = get_log_cache())
+		cache->clear(); // logs could differ in new groups
 
-	if (res.get().size() < min_writes_) {
-		LOG(DNET_LOG_ERROR, "Can't write data to the minimum number of groups while appending data to user log error: %s\n", res.error().message().c_str());
-		throw ioremap::elliptics::error(EREMOTEIO, "Data wasn't written to the minimum number of groups");
-	}
+	if (auto cache = get_active_users_cache())
+		cache->clear(); // activity could differ in new groups
 }
 
-void provider::impl::add_log(const std::string& user,
-                             const std::string& subkey,
-                             const ioremap::elliptics::data_pointer &data,
-                             std::function<void(bool added)> callback)
+void provider::impl::set_coalescing_parameters(uint32_t window, uint32_t max_bytes)
 {
-	auto s = create_session(DNET_IO_FLAGS_CACHE | DNET_IO_FLAGS_APPEND);
+	std::shared_ptr<coalescer> c;
+
+	if (window != 0) {
+		c = std::make_shared<coalescer>(
+			[this] (const std::string& key, const ioremap::elliptics::data_pointer& data, coalescer::handler_t handler) {
+				LOG(DNET_LOG_DEBUG, "Append coalesced data to user log key: %s size: %lu\n", key.c_str(), data.size());
+				write_log(key, data, handler);
+			},
+			window,
+			max_bytes);
+	}
 
-	auto w = boost::make_shared<waiter>(callback, node_, min_writes_, false, true);
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		std::swap(coalescer_, c);
+	}
+
+	LOG(DNET_LOG_INFO, "Coalescing of appends: window: %u ms max_bytes: %u\n", window, max_bytes);
+} // previous coalescer writes its buffered appends on destruction
 
-	add_log(s, user, subkey, data)
-	.connect(boost::bind(&waiter::on_log,
-	                     w,
-	                     _1,
-	                     _2));
+void provider::impl::set_batch_parameters(uint32_t max_in_flight)
+{
+	max_in_flight_ = std::max<uint32_t>(max_in_flight, 1);
 }
 
-void provider::impl::add_activity(const std::string& user, const std::string& subkey)
+void provider::impl::set_activity_cache_parameters(size_t max_size)
 {
-	auto s = create_session(DNET_IO_FLAGS_CACHE);
+	std::shared_ptr<activity_cache> cache;
 
-	auto res = add_activity(s, user, subkey);
+	if (max_size != 0)
+		cache = std::make_shared<activity_cache>(max_size);
 
-	if (res.get().size() < min_writes_) {
-		LOG(DNET_LOG_ERROR, "Can't write data while adding activity error: %s\n", res.error().message().c_str());
-		throw ioremap::elliptics::error(EREMOTEIO, "Data wasn't written to the minimum number of groups");
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		std::swap(activity_cache_, cache);
 	}
+
+	LOG(DNET_LOG_INFO, "Activity cache: max_size: %lu\n", max_size);
 }
 
-void provider::impl::add_activity(const std::string& user,
-                                  const std::string& subkey,
-                                  std::function<void(bool added)> callback)
+void provider::impl::set_log_cache_parameters(size_t max_size)
 {
-	auto s = create_session(DNET_IO_FLAGS_CACHE);
+	std::shared_ptr<log_cache> cache;
 
-	auto w = boost::make_shared<waiter>(callback, node_, min_writes_, true, false);
+	if (max_size != 0)
+		cache = std::make_shared<log_cache>(max_size);
 
-	add_activity(s, user, subkey)
-	.connect(boost::bind(&waiter::on_activity,
-	                     w,
-	                     _1,
-	                     _2));
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		std::swap(log_cache_, cache);
+	}
+
+	LOG(DNET_LOG_INFO, "Log cache: max_size: %lu\n", max_size);
 }
 
-void provider::impl::add_log_with_activity(const std::string& user,
-                                           const std::string& subkey,
-                                           const ioremap::elliptics::data_pointer &data)
+cache_stats provider::impl::get_log_cache_stats()
 {
-	auto log_s = create_session(DNET_IO_FLAGS_CACHE | DNET_IO_FLAGS_APPEND);
-	auto act_s = create_session(DNET_IO_FLAGS_CACHE);
+	if (auto cache = get_log_cache())
+		return cache->stats();
 
-	auto log_res = add_log(log_s, user, subkey, data);
-	auto act_res = add_activity(act_s, user, subkey);
+	cache_stats ret = {0, 0, 0, 0};
+	return ret;
+}
 
-	bool result = true;
+void provider::impl::set_active_users_cache_parameters(size_t max_size)
+{
+	std::shared_ptr<active_users_cache> cache;
 
-	if (log_res.get().size() < min_writes_) {
-		LOG(DNET_LOG_ERROR, "Can't write data while appending data to user log: %s\n", log_res.error().message().c_str());
-		result = false;
-	}
+	if (max_size != 0)
+		cache = std::make_shared<active_users_cache>(max_size);
 
-	if (act_res.get().size() < min_writes_) {
-		LOG(DNET_LOG_ERROR, "Can't write data while adding activity: %s\n", act_res.error().message().c_str());
-		result = false;
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		std::swap(active_users_cache_, cache);
 	}
 
-	if (!result)
-		throw ioremap::elliptics::error(EREMOTEIO, "Data wasn't written to the minimum number of groups");
+	LOG(DNET_LOG_INFO, "Active users cache: max_size: %lu\n", max_size);
 }
 
-void provider::impl::add_log_with_activity(const std::string& user,
-                                           const std::string& subkey,
-                                           const ioremap::elliptics::data_pointer &data,
-                                           std::function<void(bool added)> callback)
+cache_stats provider::impl::get_active_users_cache_stats()
 {
-	auto w = boost::make_shared<waiter>(callback, node_, min_writes_);
+	if (auto cache = get_active_users_cache())
+		return cache->stats();
 
-	auto log_s = create_session(DNET_IO_FLAGS_CACHE | DNET_IO_FLAGS_APPEND);
-	auto act_s = create_session(DNET_IO_FLAGS_CACHE);
-
-	add_log(log_s, user, subkey, data)
-	.connect(boost::bind(&waiter::on_log,
-	                     w,
-	                     _1,
-	                     _2));
-
-	add_activity(act_s, user, subkey)
-	.connect(boost::bind(&waiter::on_activity,
-	                     w,
-	                     _1,
-	                     _2));
+	cache_stats ret = {0, 0, 0, 0};
+	return ret;
 }
 
-std::vector<ioremap::elliptics::data_pointer> provider::impl::get_user_logs(const std::string& user, const std::vector<std::string>& subkeys)
+std::vector<operation_stats> provider::impl::get_operation_stats()
 {
-	LOG(DNET_LOG_DEBUG, "Getting user: %s logs for keys: %lu\n", user.c_str(), subkeys.size());
+	std::vector<operation_stats> ret;
+	ret.reserve(provider_operations_count);
 
-	std::vector<ioremap::elliptics::data_pointer> datas;
-	datas.reserve(subkeys.size());
+	for (int op = 0; op < provider_operations_count; ++op) {
+		ret.emplace_back(counters_[op].stats(consts::PROVIDER_OPERATIONS[op]));
+	}
 
-	std::list<ioremap::elliptics::async_read_result> results;
+	const auto storage_stats = storage_->stats();
+	ret.insert(ret.end(), storage_stats.begin(), storage_stats.end());
 
-	auto s = create_session(0);
+	return ret;
+}
 
-	for (auto it = subkeys.begin(), end = subkeys.end(); it != end; ++it) {
-		auto cmb_key = combine_key(user, *it);
-		LOG(DNET_LOG_DEBUG, "Try to read user: %s log file: %s\n", user.c_str(), cmb_key.c_str());
-		results.emplace_back(std::move(s.read_latest(cmb_key, 0, 0)));
+void provider::impl::set_activity_sketch_parameters(uint32_t interval)
+{
+	std::shared_ptr<activity_sketches> sketches;
+
+	if (interval != 0) {
+		auto owner = std::make_shared<std::weak_ptr<activity_sketches>>(); // failed writes are returned to the sketches which made them
+		sketches = std::make_shared<activity_sketches>(
+			[this, owner] (const std::string& subkey, const hyperloglog& sketch) {
+				write_sketch(subkey, sketch, *owner);
+			},
+			interval);
+		*owner = sketches;
 	}
 
-	try {
-		for (auto it = results.begin(), end = results.end(); it != end; ++it) {
-			try {
-				auto file = it->get_one().file(); // reads user log file
-				if (file.empty()) // if the file is empty
-					continue; // skip it and go to the next
-
-				datas.emplace_back(std::move(file));
-			}
-			catch (ioremap::elliptics::error& e) {
-				LOG(DNET_LOG_ERROR, "Can't read log file: %s\n", e.error_message().c_str());
-			}
-		}
-	}
-	catch (ioremap::elliptics::error& e) {
-		LOG(DNET_LOG_ERROR, "Error while getting user logs: %s\n", e.error_message().c_str());
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		std::swap(activity_sketches_, sketches);
 	}
 
-	return datas;
-}
+	LOG(DNET_LOG_INFO, "Activity sketches: interval: %u ms\n", interval);
+} // previous sketches are written on destruction
 
-void provider::impl::on_user_log(std::shared_ptr<std::list<ioremap::elliptics::async_read_result>> results,
-                                 std::shared_ptr<std::vector<ioremap::elliptics::data_pointer>> data,
-                                 std::function<void(const std::vector<ioremap::elliptics::data_pointer> &data)> callback,
-                                 const ioremap::elliptics::sync_read_result &entry,
-                                 const ioremap::elliptics::error_info &/*error*/)
+void provider::impl::set_activity_bitmap_parameters(uint32_t interval)
 {
-	try {
-		results->erase(results->begin());
-		if (!entry.empty()) {
-			auto file = entry.front().file();
-			if (!file.empty())
-				data->emplace_back(std::move(file));
-		}
+	std::shared_ptr<activity_bitmaps> bitmaps;
+
+	if (interval != 0) {
+		auto owner = std::make_shared<std::weak_ptr<activity_bitmaps>>(); // failed writes are returned to the bitmaps which made them
+		bitmaps = std::make_shared<activity_bitmaps>(
+			[this, owner] (const std::string& subkey, const roaring_bitmap& bitmap) {
+				write_bitmap(subkey, bitmap, *owner);
+			},
+			interval);
+		*owner = bitmaps;
 	}
-	catch (ioremap::elliptics::error& e) {}
 
-	if (!results->empty()) {
-		results->front().connect(boost::bind(&provider::impl::on_user_log, results, data, callback, _1, _2));
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		std::swap(activity_bitmaps_, bitmaps);
 	}
-	else
-		callback(*data);
-}
 
-void provider::impl::get_user_logs(const std::string& user,
-                                   const std::vector<std::string>& subkeys,
-                                   std::function<void(const std::vector<ioremap::elliptics::data_pointer> &data)> callback)
+	LOG(DNET_LOG_INFO, "Activity bitmaps: interval: %u ms\n", interval);
+} // previous bitmaps are written on destruction
+
+void provider::impl::set_activity_calendar_parameters(uint32_t interval)
 {
-	LOG(DNET_LOG_DEBUG, "Async getting user: %s logs for keys: %lu\n", user.c_str(), subkeys.size());
-	auto data = std::make_shared<std::vector<ioremap::elliptics::data_pointer>>();
-	data->reserve(subkeys.size());
+	std::shared_ptr<activity_calendars> calendars;
+
+	if (interval != 0) {
+		auto owner = std::make_shared<std::weak_ptr<activity_calendars>>(); // failed writes are returned to the calendars which made them
+		calendars = std::make_shared<activity_calendars>(
+			[this, owner] (const std::string& user, const activity_calendar& calendar) {
+				write_calendar(user, calendar, *owner);
+			},
+			interval);
+		*owner = calendars;
+	}
 
-	auto results = std::make_shared<std::list<ioremap::elliptics::async_read_result>>();
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		std::swap(activity_calendars_, calendars);
+	}
 
-	auto s = create_session(0);
+	LOG(DNET_LOG_INFO, "Activity calendars: interval: %u ms\n", interval);
+} // previous calendars are written on destruction
 
-	for (auto it = subkeys.begin(), end = subkeys.end(); it != end; ++it) {
-		auto cmb_key = combine_key(user, *it);
-		LOG(DNET_LOG_DEBUG, "Async try to read user: %s log file: %s\n", user.c_str(), cmb_key.c_str());
-		results->emplace_back(s.read_latest(cmb_key, 0, 0));
+void provider::impl::set_day_stats_parameters(uint32_t interval)
+{
+	std::shared_ptr<day_stats_buffer> stats;
+
+	if (interval != 0) {
+		auto owner = std::make_shared<std::weak_ptr<day_stats_buffer>>(); // failed writes are returned to the buffer which made them
+		stats = std::make_shared<day_stats_buffer>(
+			[this, owner] (const std::string& subkey, const day_counters& counters) {
+				write_day_stats(subkey, counters, *owner);
+			},
+			interval);
+		*owner = stats;
 	}
 
-	results->front()
-	.connect(boost::bind(&provider::impl::on_user_log,
-	                     results,
-	                     data,
-	                     callback,
-	                     _1,
-	                     _2));
-}
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		std::swap(day_stats_, stats);
+	}
 
-ioremap::elliptics::async_find_indexes_result
-provider::impl::get_active_users(ioremap::elliptics::session& s,
-                                 const std::vector<std::string>& subkeys)
-{
-	LOG(DNET_LOG_DEBUG, "Getting active users: %lu\n", subkeys.size());
-	return s.find_any_indexes(subkeys);
-}
+	LOG(DNET_LOG_INFO, "Day stats: interval: %u ms\n", interval);
+} // previous deltas are written on destruction
 
-std::set<std::string> provider::impl::get_active_users(const std::vector<std::string>& subkeys)
+void provider::impl::set_activity_chunks(uint32_t chunks)
 {
-	std::set<std::string> ret;
+	activity_chunks_ = std::max<uint32_t>(chunks, 1);
 
-	auto s = create_session();
+	if (auto cache = get_activity_cache())
+		cache->clear(); // cached users could be missed in chunks of the new layout
 
-	auto async_result = get_active_users(s, subkeys);
+	LOG(DNET_LOG_INFO, "Activity chunks: %u\n", activity_chunks_);
+}
 
-	for (auto it = async_result.begin(), end = async_result.end(); it != end; ++it) {
-		for (auto ind_it = it->indexes.begin(), ind_end = it->indexes.end(); ind_it != ind_end; ++ind_it) {
-			ret.insert(ind_it->data.to_string());
-			LOG(DNET_LOG_DEBUG, "Found value: %s\n", ret.rbegin()->c_str());
-		}
-	}
+void provider::impl::set_bulk_read_parameters(uint32_t min_keys)
+{
+	bulk_read_min_keys_ = min_keys;
 
-	return ret;
+	LOG(DNET_LOG_INFO, "Bulk read of user logs: min_keys: %u\n", min_keys);
 }
 
-void provider::impl::on_active_users(std::function<void(const std::set<std::string> &active_users)> callback,
-                                     const ioremap::elliptics::sync_find_indexes_result &result,
-                                     const ioremap::elliptics::error_info &/*error*/)
+void provider::impl::set_framed_logs(bool framed)
 {
-	std::set<std::string> active_users;
-
-	for (auto it = result.begin(), end = result.end(); it != end; ++it) {
-		for (auto ind_it = it->indexes.begin(), ind_end = it->indexes.end(); ind_it != ind_end; ++ind_it) {
-			active_users.insert(ind_it->data.to_string());
-		}
-	}
+	framed_logs_ = framed;
 
-	callback(active_users);
+	LOG(DNET_LOG_INFO, "Framed user logs: %s\n", framed ? "enabled" : "disabled");
 }
 
-void provider::impl::get_active_users(const std::vector<std::string>& subkeys,
-                                      std::function<void(const std::set<std::string> &active_users)> callback)
+ioremap::elliptics::data_pointer provider::impl::pack_log(uint64_t time, const ioremap::elliptics::data_pointer &data) const
 {
-	auto s = create_session();
+	if (!framed_logs_)
+		return data;
 
-	get_active_users(s, subkeys)
-	.connect(boost::bind(&provider::impl::on_active_users,
-	                     callback,
-	                     _1,
-	                     _2));
+	return framing::pack(time, 0, data);
 }
 
-void provider::impl::for_user_logs(const std::string& user,
-                                   const std::vector<std::string>& subkeys,
-                                   std::function<bool(const ioremap::elliptics::data_pointer &data)> callback)
+ioremap::elliptics::data_pointer provider::impl::pack_log(const ioremap::elliptics::data_pointer &data) const
 {
-	LOG(DNET_LOG_DEBUG, "Iterate user: %s logs: %lu\n", user.c_str(), subkeys.size());
-	std::list<ioremap::elliptics::async_read_result> results;
+	if (!framed_logs_)
+		return data;
 
-	auto s = create_session(0);
+	return framing::pack(::time(NULL), framing::ABSOLUTE_TIME, data); // custom key has no day, so time of the append is stored as is
+}
 
-	for (auto it = subkeys.begin(), end = subkeys.end(); it != end; ++it) {
-		results.emplace_back(s.read_latest(combine_key(user, *it), 0, 0));
-	}
+void provider::impl::set_offset_index_parameters(uint32_t step)
+{
+	offset_index_step_ = step;
 
-	try {
-		for (auto it = results.begin(), end = results.end(); it != end; ++it) {
-			try {
-				auto file = it->get_one().file(); // reads user log file
-				if (file.empty()) // if the file is empty
-					continue; // skip it and go to the next
-
-				if (!callback(file))
-					return;
-			} catch (ioremap::elliptics::error& e) {
-				LOG(DNET_LOG_ERROR, "Can't read log file: %s\n", e.error_message().c_str());
-			}
-		}
-	} catch (ioremap::elliptics::error& e) {
-		LOG(DNET_LOG_ERROR, "Error while iterating log files: %s\n", e.error_message().c_str());
-	}
+	LOG(DNET_LOG_INFO, "Offset index of user logs: step: %u\n", step);
 }
 
-void provider::impl::for_active_users(const std::vector<std::string>& subkeys,
-                                      std::function<bool(const std::set<std::string>& active_users)> callback)
+void provider::impl::repartition_activity(const std::vector<std::string>& subkeys, uint32_t chunks)
 {
-	LOG(DNET_LOG_DEBUG, "Iterate active users: %lu\n", subkeys.size());
+	chunks = std::max<uint32_t>(chunks, 1);
+
 	for (auto it = subkeys.begin(), end = subkeys.end(); it != end; ++it) {
-		std::vector<std::string> one_subkey;
-		one_subkey.push_back(*it);
-		if (!callback(get_active_users(one_subkey)))
-			return;
+		repartition_activity(*it, chunks);
 	}
 }
 
-ioremap::elliptics::session provider::impl::create_session(uint32_t io_flags) const
+void provider::impl::repartition_activity(const std::string& subkey, uint32_t chunks)
 {
-	auto ret = ioremap::elliptics::session(node_);
+	const auto old_chunks = activity_chunks_;
+	LOG(DNET_LOG_INFO, "Repartition activity: %s from %u to %u chunks\n", subkey.c_str(), old_chunks, chunks);
 
-	ret.set_ioflags(io_flags);
-	ret.set_cflags(0);
-	ret.set_groups(groups_); // sets groups
-	ret.set_exceptions_policy(ioremap::elliptics::session::exceptions_policy::no_exceptions);
+	if (old_chunks == chunks)
+		return;
 
-	return ret;
-}
+	size_t moved = 0, failed = 0;
 
-ioremap::elliptics::async_write_result
-provider::impl::add_log(ioremap::elliptics::session& s,
-                        const std::string& user,
-                        const std::string& subkey,
-                        const ioremap::elliptics::data_pointer &data)
-{
-	auto write_key = combine_key(user, subkey);
+	for (uint32_t chunk = 0; chunk < old_chunks; ++chunk) {
+		const auto old_index = chunk_index(subkey, chunk, old_chunks);
 
-	LOG(DNET_LOG_DEBUG, "Try to append data to user log key: %s\n", write_key.c_str());
+		std::vector<std::string> indexes;
+		indexes.push_back(old_index);
 
-	return s.write_data(write_key, data, 0); // write data into elliptics
-}
+		const auto found = wait_result<find_result>([&] (storage::find_handler_t handler) {
+			storage_->find_any_indexes(indexes, handler);
+		});
 
-ioremap::elliptics::async_set_indexes_result
-provider::impl::add_activity(ioremap::elliptics::session& s,
-                             const std::string& user,
-                             const std::string& subkey)
-{
-	LOG(DNET_LOG_DEBUG, "Try to add user to activity statistics: %s\n", subkey.c_str());
+		std::list<std::pair<pending_result<write_result>, pending_result<write_result>>> results;
 
-	std::vector<std::string> indexes;
-	std::vector<ioremap::elliptics::data_pointer> datas;
-	indexes.push_back(subkey);
-	datas.push_back(user);
+		for (auto it = found.entries.begin(), end = found.entries.end(); it != end; ++it) {
+			for (auto ind_it = it->indexes.begin(), ind_end = it->indexes.end(); ind_it != ind_end; ++ind_it) {
+				const auto user = ind_it->data.to_string();
+				const auto new_index = activity_index(user, subkey, chunks);
+				if (new_index == old_index) // user stays in the same chunk
+					continue;
 
-	LOG(DNET_LOG_DEBUG, "Update indexes with key: %s and index: %s\n", subkey.c_str(), indexes.front().c_str());
-	return s.update_indexes_internal(user, indexes, datas);
-}
+				std::vector<std::string> new_indexes, old_indexes;
+				std::vector<ioremap::elliptics::data_pointer> datas;
+				new_indexes.push_back(new_index);
+				old_indexes.push_back(old_index);
+				datas.push_back(ioremap::elliptics::data_pointer::copy(user));
+
+				results.emplace_back();
+				storage_->update_indexes(user, new_indexes, datas, results.back().first.handler());
+				storage_->remove_indexes(user, old_indexes, results.back().second.handler());
+
+				if (results.size() < max_in_flight_)
+					continue;
+
+				for (auto res = results.begin(), res_end = results.end(); res != res_end; ++res) {
+					if (res->first.get().written < min_writes_ || res->second.get().written < min_writes_)
+						++failed;
+					else
+						++moved;
+				}
+				results.clear();
+			}
+		}
+
+		for (auto res = results.begin(), res_end = results.end(); res != res_end; ++res) {
+			if (res->first.get().written < min_writes_ || res->second.get().written < min_writes_)
+				++failed;
+			else
+				++moved;
+		}
+	}
+
+	LOG(DNET_LOG_INFO, "Repartition activity: %s moved users: %lu failed: %lu\n", subkey.c_str(), moved, failed);
+
+	if (failed)
+		throw ioremap::elliptics::error(EREMOTEIO, "Some users weren't moved to new activity chunks");
+}
+
+cache_stats provider::impl::get_activity_cache_stats()
+{
+	if (auto cache = get_activity_cache())
+		return cache->stats();
+
+	cache_stats ret = {0, 0, 0, 0};
+	return ret;
+}
+
+void provider::impl::add_log(const std::string& user,
+                             const std::string& subkey,
+                             const ioremap::elliptics::data_pointer &data)
+{
+	pending_result<write_result> res;
+	write_user_log(user, subkey, data, res.handler());
+
+	if (res.get().written < min_writes_) {
+		LOG(DNET_LOG_ERROR, "Can't write data to the minimum number of groups while appending data to user log error: %s\n", res.get().error.message.c_str());
+		throw ioremap::elliptics::error(EREMOTEIO, "Data wasn't written to the minimum number of groups");
+	}
+
+	add_day_stats(user, subkey, data.size());
+}
+
+void provider::impl::add_log(const std::string& user,
+                             const std::string& subkey,
+                             const ioremap::elliptics::data_pointer &data,
+                             std::function<void(bool added)> callback)
+{
+	auto w = boost::make_shared<waiter>(callback, node_, min_writes_, false, true);
+
+	append_log(user, subkey, data,
+	           boost::bind(&waiter::on_log,
+	                       w,
+	                       _1));
+}
+
+void provider::impl::add_activity(const std::string& user, const std::string& subkey)
+{
+	auto cache = get_activity_cache();
+	if (is_active(cache, user, subkey))
+		return;
+
+	pending_result<write_result> res;
+	write_activity(user, subkey, res.handler());
+
+	if (res.get().written < min_writes_) {
+		LOG(DNET_LOG_ERROR, "Can't write data while adding activity error: %s\n", res.get().error.message.c_str());
+		throw ioremap::elliptics::error(EREMOTEIO, "Data wasn't written to the minimum number of groups");
+	}
+
+	if (cache)
+		cache->insert(user, subkey);
+}
+
+void provider::impl::add_activity(const std::string& user,
+                                  const std::string& subkey,
+                                  std::function<void(bool added)> callback)
+{
+	auto cache = get_activity_cache();
+	if (is_active(cache, user, subkey)) {
+		callback(true);
+		return;
+	}
+
+	auto w = boost::make_shared<waiter>(remember_activity(cache, user, subkey, callback),
+	                                    node_, min_writes_, true, false);
+
+	write_activity(user, subkey,
+	               boost::bind(&waiter::on_activity,
+	                           w,
+	                           _1));
+}
+
+void provider::impl::add_log_with_activity(const std::string& user,
+                                           const std::string& subkey,
+                                           const ioremap::elliptics::data_pointer &data)
+{
+	auto cache = get_activity_cache();
+	const bool active = is_active(cache, user, subkey);
+
+	pending_result<write_result> log_res;
+	write_user_log(user, subkey, data, log_res.handler());
+
+	bool result = true;
+
+	if (!active) {
+		pending_result<write_result> act_res;
+		write_activity(user, subkey, act_res.handler());
+
+		if (act_res.get().written < min_writes_) {
+			LOG(DNET_LOG_ERROR, "Can't write data while adding activity: %s\n", act_res.get().error.message.c_str());
+			result = false;
+		}
+		else if (cache)
+			cache->insert(user, subkey);
+	}
+
+	if (log_res.get().written < min_writes_) {
+		LOG(DNET_LOG_ERROR, "Can't write data while appending data to user log: %s\n", log_res.get().error.message.c_str());
+		result = false;
+	}
+	else
+		add_day_stats(user, subkey, data.size());
+
+	if (!result)
+		throw ioremap::elliptics::error(EREMOTEIO, "Data wasn't written to the minimum number of groups");
+}
+
+void provider::impl::add_log_with_activity(const std::string& user,
+                                           const std::string& subkey,
+                                           const ioremap::elliptics::data_pointer &data,
+                                           std::function<void(bool added)> callback)
+{
+	auto cache = get_activity_cache();
+	const bool active = is_active(cache, user, subkey);
+
+	auto w = boost::make_shared<waiter>(active ? callback : remember_activity(cache, user, subkey, callback),
+	                                    node_, min_writes_, false, active);
+
+	append_log(user, subkey, data,
+	           boost::bind(&waiter::on_log,
+	                       w,
+	                       _1));
+
+	if (active)
+		return;
+
+	write_activity(user, subkey,
+	               boost::bind(&waiter::on_activity,
+	                           w,
+	                           _1));
+}
+
+std::vector<bool> provider::impl::add_logs(const std::vector<log_record>& records, bool with_activity)
+{
+	return wait_result<std::vector<bool>>([&] (std::function<void(const std::vector<bool> &added)> handler) {
+		add_logs(records, with_activity, handler);
+	});
+}
+
+void provider::impl::add_logs(const std::vector<log_record>& records, bool with_activity,
+                              std::function<void(const std::vector<bool> &added)> callback)
+{
+	LOG(DNET_LOG_DEBUG, "Adding batch of records: %lu with activity: %d\n", records.size(), with_activity);
+
+	if (records.empty()) {
+		callback(std::vector<bool>());
+		return;
+	}
+
+	auto b = std::make_shared<batch>(records, with_activity, callback, max_in_flight_);
+
+	submit_batch(b);
+}
+
+void provider::impl::submit_batch(std::shared_ptr<batch> b)
+{
+	{
+		boost::mutex::scoped_lock lock(b->mutex);
+		if (b->submitting) // records will be submitted by the loop which is already running
+			return;
+		b->submitting = true;
+	}
+
+	while (true) {
+		std::vector<size_t> indexes;
+
+		{
+			boost::mutex::scoped_lock lock(b->mutex);
+			while (b->next < b->records.size() && b->in_flight < b->max_in_flight) {
+				indexes.push_back(b->next++);
+				++b->in_flight;
+			}
+
+			if (indexes.empty()) {
+				b->submitting = false;
+				return;
+			}
+		}
+
+		auto cache = get_activity_cache();
+
+		for (auto it = indexes.begin(), end = indexes.end(); it != end; ++it) {
+			const auto &record = b->records[*it];
+			const auto subkey = record.subkey.empty() ? time_to_subkey(record.time) : record.subkey;
+			const bool with_activity = b->with_activity && !is_active(cache, record.user, subkey);
+
+			std::function<void(bool added)> callback = std::bind(&provider::impl::on_batch_record,
+			                                                     shared_from_this(),
+			                                                     b,
+			                                                     *it,
+			                                                     std::placeholders::_1);
+			if (with_activity)
+				callback = remember_activity(cache, record.user, subkey, callback);
+
+			auto w = boost::make_shared<waiter>(callback, node_, min_writes_, false, !with_activity);
+
+			const auto data = record.subkey.empty() ? pack_log(record.time, record.data) : pack_log(record.data);
+
+			add_calendar_day(record.user, subkey);
+
+			write_log(combine_key(record.user, subkey), data,
+			          count_log(record.user, subkey, data.size(),
+			                    boost::bind(&waiter::on_log,
+			                                w,
+			                                _1)));
+
+			if (with_activity) {
+				write_activity(record.user, subkey,
+				               boost::bind(&waiter::on_activity,
+				                           w,
+				                           _1));
+			}
+		}
+	}
+}
+
+void provider::impl::on_batch_record(std::shared_ptr<batch> b, size_t index, bool added)
+{
+	bool finished = false;
+
+	{
+		boost::mutex::scoped_lock lock(b->mutex);
+		b->results[index] = added;
+		--b->in_flight;
+		finished = (++b->completed == b->records.size());
+	}
+
+	if (finished) {
+		LOG(DNET_LOG_DEBUG, "Batch of records: %lu has been written\n", b->records.size());
+		b->callback(b->results);
+	}
+	else
+		submit_batch(b);
+}
+
+std::vector<ioremap::elliptics::data_pointer> provider::impl::get_user_logs(const std::string& user, const std::vector<std::string>& subkeys)
+{
+	LOG(DNET_LOG_DEBUG, "Getting user: %s logs for keys: %lu\n", user.c_str(), subkeys.size());
+
+	typedef std::vector<ioremap::elliptics::data_pointer> logs_t;
+
+	return wait_result<logs_t>([&] (std::function<void(const logs_t &data)> handler) {
+		read_user_logs(user, subkeys, [handler] (logs_t &slots, bool /*completed*/) {
+			handler(non_empty(slots));
+		});
+	});
+}
+
+void provider::impl::read_user_logs(const std::string& user,
+                                    const std::vector<std::string>& subkeys,
+                                    std::function<void(std::vector<ioremap::elliptics::data_pointer> &slots, bool completed)> handler)
+{
+	if (subkeys.empty()) {
+		std::vector<ioremap::elliptics::data_pointer> slots;
+		handler(slots, true);
+		return;
+	}
+
+	std::vector<std::string> keys;
+	keys.reserve(subkeys.size());
+	for (auto it = subkeys.begin(), end = subkeys.end(); it != end; ++it) {
+		keys.emplace_back(combine_key(user, *it));
+	}
+
+	auto gather = std::make_shared<user_logs_gather>(keys, handler);
+	gather->cache = get_log_cache();
+
+	std::vector<size_t> indexes; // indexes of logs which should be read from elliptics
+	indexes.reserve(keys.size());
+	for (size_t index = 0; index < keys.size(); ++index) {
+		if (gather->cache && is_past_day(subkeys[index])) { // logs of past days are not changed, so they could be cached
+			gather->cacheable[index] = true;
+			if (gather->cache->get(keys[index], gather->slots[index]))
+				continue;
+			gather->generations[index] = gather->cache->generation(keys[index]);
+		}
+		indexes.push_back(index);
+	}
+
+	if (indexes.empty()) {
+		gather->handler(gather->slots, true);
+		return;
+	}
+
+	gather->remaining = indexes.size();
+
+	if (bulk_read_min_keys_ != 0 && indexes.size() >= bulk_read_min_keys_) {
+		std::vector<std::string> bulk_keys;
+		bulk_keys.reserve(indexes.size());
+		for (auto it = indexes.begin(), end = indexes.end(); it != end; ++it) {
+			bulk_keys.push_back(keys[*it]);
+		}
+
+		LOG(DNET_LOG_DEBUG, "Bulk read user: %s log files: %lu\n", user.c_str(), bulk_keys.size());
+		storage_->bulk_read(bulk_keys,
+		                    boost::bind(&provider::impl::on_bulk_user_logs,
+		                                shared_from_this(),
+		                                gather,
+		                                indexes,
+		                                _1));
+		return;
+	}
+
+	read_user_logs(gather, indexes);
+}
+
+void provider::impl::read_user_logs(std::shared_ptr<user_logs_gather> gather, const std::vector<size_t>& indexes)
+{
+	for (auto it = indexes.begin(), end = indexes.end(); it != end; ++it) {
+		storage_->read_latest(gather->keys[*it], 0, 0,
+		                      boost::bind(&provider::impl::on_user_log,
+		                                  gather,
+		                                  *it,
+		                                  _1));
+	}
+}
+
+void provider::impl::on_bulk_user_logs(std::shared_ptr<user_logs_gather> gather,
+                                       const std::vector<size_t>& indexes,
+                                       const std::vector<read_result> &res)
+{
+	std::vector<size_t> missed;
+
+	for (size_t pos = 0; pos < indexes.size() && pos < res.size(); ++pos) {
+		const auto index = indexes[pos];
+
+		if (!res[pos].error) {
+			gather->slots[index] = res[pos].data;
+			cache_log(gather, index);
+		}
+		else if (res[pos].error.code != -ENOENT) // bulk read has failed on some nodes - missed keys are read one by one
+			missed.push_back(index);
+	}
+
+	if (missed.empty()) {
+		gather->handler(gather->slots, true);
+		return;
+	}
+
+	LOG(DNET_LOG_ERROR, "Bulk read of user logs has failed for keys: %lu\n", missed.size());
+
+	gather->remaining = missed.size();
+	read_user_logs(gather, missed);
+}
+
+void provider::impl::on_user_log(std::shared_ptr<user_logs_gather> gather, size_t index, const read_result &res)
+{
+	if (!res.error) {
+		gather->slots[index] = res.data;
+		cache_log(gather, index);
+	}
+	else if (res.error.code != -ENOENT)
+		gather->failed = true;
+
+	if (--gather->remaining == 0)
+		gather->handler(gather->slots, !gather->failed);
+}
+
+std::vector<ioremap::elliptics::data_pointer>
+provider::impl::non_empty(std::vector<ioremap::elliptics::data_pointer> &slots)
+{
+	std::vector<ioremap::elliptics::data_pointer> ret;
+	ret.reserve(slots.size());
+
+	for (auto it = slots.begin(), end = slots.end(); it != end; ++it) {
+		if (!it->empty()) // skips days without logs
+			ret.emplace_back(framing::unpack(*it)); // headers of framed records aren't returned to users
+	}
+
+	return ret;
+}
+
+void provider::impl::get_user_logs(const std::string& user,
+                                   const std::vector<std::string>& subkeys,
+                                   std::function<void(const std::vector<ioremap::elliptics::data_pointer> &data)> callback)
+{
+	LOG(DNET_LOG_DEBUG, "Async getting user: %s logs for keys: %lu\n", user.c_str(), subkeys.size());
+
+	read_user_logs(user, subkeys, [callback] (std::vector<ioremap::elliptics::data_pointer> &slots, bool /*completed*/) {
+		callback(non_empty(slots));
+	});
+}
+
+user_logs_page provider::impl::get_user_logs(const std::string& user,
+                                            const std::vector<std::string>& subkeys,
+                                            uint64_t max_bytes,
+                                            const std::string& cursor)
+{
+	LOG(DNET_LOG_DEBUG, "Getting user: %s logs page for keys: %lu max bytes: %" PRIu64 " cursor: %s\n",
+	    user.c_str(), subkeys.size(), max_bytes, cursor.c_str());
+
+	typedef std::pair<user_logs_page, bool> result_t;
+
+	const auto res = wait_result<result_t>([&] (std::function<void(const result_t &result)> handler) {
+		get_user_logs(user, subkeys, max_bytes, cursor, [handler] (const user_logs_page &page, bool completed) {
+			handler(std::make_pair(page, completed));
+		});
+	});
+
+	if (!res.second)
+		throw ioremap::elliptics::error(EREMOTEIO, "User logs couldn't be read");
+
+	return res.first;
+}
+
+void provider::impl::get_user_logs(const std::string& user,
+                                   const std::vector<std::string>& subkeys,
+                                   uint64_t max_bytes,
+                                   const std::string& cursor,
+                                   std::function<void(const user_logs_page &page, bool completed)> callback)
+{
+	const auto position = parse_cursor(cursor); // throws on invalid cursor before any reading
+
+	std::vector<std::string> keys;
+	keys.reserve(subkeys.size());
+	for (auto it = subkeys.begin(), end = subkeys.end(); it != end; ++it) {
+		keys.emplace_back(combine_key(user, *it));
+	}
+
+	read_page(std::make_shared<user_logs_pager>(keys, position.first, position.second, max_bytes, callback));
+}
+
+void provider::impl::read_page(std::shared_ptr<user_logs_pager> pager)
+{
+	if (pager->day >= pager->keys.size()) { // all logs have been read - leaves next_cursor empty
+		pager->callback(pager->page, true);
+		return;
+	}
+
+	if (pager->max_bytes != 0 && pager->size >= pager->max_bytes) {
+		pager->page.next_cursor = make_cursor(pager->day, pager->offset);
+		pager->callback(pager->page, true);
+		return;
+	}
+
+	read_page_log(pager, pager->max_bytes ? pager->max_bytes - pager->size : 0); // 0 reads the rest of the log
+}
+
+void provider::impl::read_page_log(std::shared_ptr<user_logs_pager> pager, uint64_t requested)
+{
+	storage_->read_latest(pager->keys[pager->day], pager->offset, requested,
+	                      boost::bind(&provider::impl::on_page_log,
+	                                  shared_from_this(),
+	                                  pager,
+	                                  requested,
+	                                  _1));
+}
+
+void provider::impl::on_page_log(std::shared_ptr<user_logs_pager> pager, uint64_t requested, const read_result &res)
+{
+	bool day_completed = true; // missed log or offset beyond the end of the log completes the day
+
+	if (res.error && res.error.code != -ENOENT && !(res.error.code == -E2BIG && pager->offset != 0)) {
+		LOG(DNET_LOG_ERROR, "Can't read user log: %s error: %s\n", pager->keys[pager->day].c_str(), res.error.message.c_str());
+		pager->callback(user_logs_page(), false);
+		return;
+	}
+
+	if (!res.error) {
+		const uint64_t size = res.data.size();
+		const bool log_end = requested == 0 || // whole rest of the log has been read
+		                     size < requested ||
+		                     (res.total_size != 0 && pager->offset + size >= res.total_size);
+
+		size_t consumed;
+		auto data = framing::unpack(res.data, log_end, consumed); // the page ends at record boundary, so records aren't split
+
+		if (consumed == 0 && size != 0) { // framed record doesn't fit the rest of the page
+			if (pager->size != 0) {
+				pager->page.next_cursor = make_cursor(pager->day, pager->offset);
+				pager->callback(pager->page, true);
+				return;
+			}
+
+			const uint64_t record_size = framing::record_size(res.data);
+			if (record_size != 0 || size < framing::MAX_HEADER_SIZE) { // the first record of the page is returned whole
+				read_page_log(pager, record_size ? record_size : framing::MAX_HEADER_SIZE);
+				return;
+			}
+
+			data = framing::unpack(res.data, true, consumed); // broken header - the data is returned as is
+		}
+
+		if (!data.empty())
+			pager->page.logs.push_back(data);
+
+		pager->size += consumed;
+		pager->offset += consumed;
+		day_completed = log_end;
+	}
+
+	if (day_completed) {
+		++pager->day;
+		pager->offset = 0;
+	}
+
+	read_page(pager);
+}
+
+std::pair<size_t, uint64_t> provider::impl::parse_cursor(const std::string& cursor)
+{
+	if (cursor.empty())
+		return std::make_pair(0, 0);
+
+	const auto delimiter = cursor.find(':');
+	if (delimiter == std::string::npos)
+		throw std::invalid_argument("invalid cursor: " + cursor);
+
+	try {
+		return std::make_pair(boost::lexical_cast<size_t>(cursor.substr(0, delimiter)),
+		                      boost::lexical_cast<uint64_t>(cursor.substr(delimiter + 1)));
+	}
+	catch (boost::bad_lexical_cast&) {
+		throw std::invalid_argument("invalid cursor: " + cursor);
+	}
+}
+
+std::string provider::impl::make_cursor(size_t day, uint64_t offset)
+{
+	return boost::lexical_cast<std::string>(day) + ':' + boost::lexical_cast<std::string>(offset);
+}
+
+std::vector<framing::record> provider::impl::get_user_records(const std::string& user, uint64_t begin_time, uint64_t end_time)
+{
+	LOG(DNET_LOG_DEBUG, "Getting user: %s records for period: [%" PRIu64 ", %" PRIu64 "]\n", user.c_str(), begin_time, end_time);
+
+	typedef std::pair<std::vector<framing::record>, bool> result_t;
+
+	const auto res = wait_result<result_t>([&] (std::function<void(const result_t &result)> handler) {
+		get_user_records(user, begin_time, end_time, [handler] (const std::vector<framing::record> &records, bool completed) {
+			handler(std::make_pair(records, completed));
+		});
+	});
+
+	if (!res.second)
+		throw ioremap::elliptics::error(EREMOTEIO, "User logs couldn't be read");
+
+	return res.first;
+}
+
+void provider::impl::get_user_records(const std::string& user,
+                                      uint64_t begin_time, uint64_t end_time,
+                                      std::function<void(const std::vector<framing::record> &records, bool completed)> callback)
+{
+	const uint64_t begin_day = begin_time / consts::SECONDS_IN_DAY;
+	const uint64_t end_day = end_time / consts::SECONDS_IN_DAY;
+
+	if (end_time < begin_time) {
+		callback(std::vector<framing::record>(), true);
+		return;
+	}
+
+	auto gather = std::make_shared<user_records_gather>(begin_day, end_day - begin_day + 1, begin_time, end_time, callback);
+
+	for (uint64_t day = begin_day; day <= end_day; ++day) {
+		const size_t index = day - begin_day;
+		const uint64_t day_begin = day * consts::SECONDS_IN_DAY;
+		const auto key = combine_key(user, boost::lexical_cast<std::string>(day));
+
+		if (begin_time <= day_begin && day_begin + consts::SECONDS_IN_DAY - 1 <= end_time) { // whole day is requested - index isn't needed
+			read_day_records(gather, index, key, 0, false, std::vector<offset_entry>());
+			continue;
+		}
+
+		storage_->read_latest(key + consts::OFFSETS_SUFFIX, 0, 0,
+		                      boost::bind(&provider::impl::on_offsets,
+		                                  shared_from_this(),
+		                                  gather,
+		                                  index,
+		                                  key,
+		                                  _1));
+	}
+}
+
+void provider::impl::on_offsets(std::shared_ptr<user_records_gather> gather,
+                                size_t index,
+                                const std::string& key,
+                                const read_result &res)
+{
+	std::vector<offset_entry> entries;
+
+	if (!res.error)
+		entries = unpack_offsets(res.data);
+	else if (res.error.code != -ENOENT) // the index is only hint for reading, so the log is read whole
+		LOG(DNET_LOG_ERROR, "Can't read offset index: %s error: %s\n", key.c_str(), res.error.message.c_str());
+
+	const uint64_t day_begin = (gather->begin_day + index) * consts::SECONDS_IN_DAY;
+	const uint64_t begin = gather->begin_time > day_begin ? gather->begin_time - day_begin : 0; // period relative to the day
+
+	// the index could cover only beginning of the log, so the log is always read up to its end
+	uint64_t from = 0;
+	for (auto it = entries.begin(), it_end = entries.end(); it != it_end && it->time < begin; ++it) {
+		from = it->offset; // all records before the offset are earlier than the period
+	}
+
+	// the rest of the log is read anyway, so the index is extended by records appended after its last entry
+	read_day_records(gather, index, key, from, offset_index_step_ != 0 && (!res.error || res.error.code == -ENOENT), entries);
+}
+
+void provider::impl::read_day_records(std::shared_ptr<user_records_gather> gather,
+                                      size_t index,
+                                      const std::string& key,
+                                      uint64_t offset,
+                                      bool build_index,
+                                      const std::vector<offset_entry> &entries)
+{
+	storage_->read_latest(key, offset, 0,
+	                      boost::bind(&provider::impl::on_day_records,
+	                                  shared_from_this(),
+	                                  gather,
+	                                  index,
+	                                  key,
+	                                  offset,
+	                                  build_index,
+	                                  entries,
+	                                  _1));
+}
+
+void provider::impl::on_day_records(std::shared_ptr<user_records_gather> gather,
+                                    size_t index,
+                                    const std::string& key,
+                                    uint64_t offset,
+                                    bool build_index,
+                                    std::vector<offset_entry> entries,
+                                    const read_result &res)
+{
+	const uint64_t day_begin = (gather->begin_day + index) * consts::SECONDS_IN_DAY;
+	const uint64_t step = offset_index_step_;
+	auto &records = gather->slots[index];
+
+	if (!res.error) {
+		const size_t indexed = entries.size(); // number of entries which are already stored
+		const uint64_t indexed_end = entries.empty() ? 0 : entries.back().offset; // records before it are indexed
+		uint64_t max_time = entries.empty() ? 0 : entries.back().time; // maximum time of indexed records relative to the day
+		uint64_t begin = indexed_end;
+
+		framing::record_iterator it(res.data);
+		framing::record rec;
+		while (it.next(rec)) {
+			if (!rec.framed) { // legacy log can't be filtered - it is returned as is
+				records.push_back(rec);
+				build_index = false; // unframed data hasn't record boundaries
+				continue;
+			}
+
+			const uint64_t time = rec.timestamp(day_begin);
+			if (time >= gather->begin_time && time <= gather->end_time)
+				records.push_back(rec);
+
+			const uint64_t end = offset + it.offset(); // offset of the record's end in the daily log
+			if (!build_index || end <= indexed_end)
+				continue;
+
+			max_time = std::max(max_time, time > day_begin ? time - day_begin : 0);
+
+			if (begin / step != end / step) { // the record crosses boundary of the index step
+				offset_entry entry = {max_time, end};
+				entries.push_back(entry);
+			}
+			begin = end;
+		}
+
+		if (build_index && entries.size() != indexed)
+			write_offsets(key + consts::OFFSETS_SUFFIX, entries);
+	} else if (res.error.code != -ENOENT) { // missed log is a day without records
+		LOG(DNET_LOG_ERROR, "Can't read user log: %s error: %s\n", key.c_str(), res.error.message.c_str());
+		gather->failed = true;
+	}
+
+	if (--gather->remaining != 0)
+		return;
+
+	std::vector<framing::record> ret;
+	if (!gather->failed) {
+		for (auto it = gather->slots.begin(), end = gather->slots.end(); it != end; ++it) {
+			ret.insert(ret.end(), it->begin(), it->end());
+		}
+	}
+
+	gather->callback(ret, !gather->failed);
+}
+
+std::vector<framing::record> provider::impl::get_user_records(const std::string& user, const std::vector<std::string>& subkeys)
+{
+	LOG(DNET_LOG_DEBUG, "Getting user: %s records for keys: %lu\n", user.c_str(), subkeys.size());
+
+	typedef std::pair<std::vector<framing::record>, bool> result_t;
+
+	const auto res = wait_result<result_t>([&] (std::function<void(const result_t &result)> handler) {
+		get_user_records(user, subkeys, [handler] (const std::vector<framing::record> &records, bool completed) {
+			handler(std::make_pair(records, completed));
+		});
+	});
+
+	if (!res.second)
+		throw ioremap::elliptics::error(EREMOTEIO, "User logs couldn't be read");
+
+	return res.first;
+}
+
+void provider::impl::get_user_records(const std::string& user,
+                                      const std::vector<std::string>& subkeys,
+                                      std::function<void(const std::vector<framing::record> &records, bool completed)> callback)
+{
+	read_user_logs(user, subkeys, [callback] (std::vector<ioremap::elliptics::data_pointer> &slots, bool completed) {
+		std::vector<framing::record> ret;
+
+		for (auto it = slots.begin(), end = slots.end(); it != end; ++it) {
+			framing::record_iterator records(*it); // empty slot of day without logs has no records
+			framing::record rec;
+			while (records.next(rec)) {
+				ret.push_back(rec);
+			}
+		}
+
+		callback(ret, completed);
+	});
+}
+
+std::vector<std::vector<std::string>>
+provider::impl::active_users_indexes(const std::vector<std::string>& subkeys, uint32_t chunks)
+{
+	LOG(DNET_LOG_DEBUG, "Getting active users: %lu chunks: %u\n", subkeys.size(), chunks);
+
+	std::vector<std::vector<std::string>> ret(chunks);
+
+	for (uint32_t chunk = 0; chunk < chunks; ++chunk) { // each user is placed in the same chunk for all days
+		auto &indexes = ret[chunk];
+		indexes.reserve(subkeys.size());
+		for (auto it = subkeys.begin(), end = subkeys.end(); it != end; ++it) {
+			indexes.emplace_back(chunk_index(*it, chunk, chunks));
+		}
+	}
+
+	return ret;
+}
+
+std::set<std::string> provider::impl::get_active_users(const std::vector<std::string>& subkeys)
+{
+	return to_set(get_active_users_list(subkeys));
+}
+
+void provider::impl::get_active_users(const std::vector<std::string>& subkeys,
+                                      std::function<void(const std::set<std::string> &active_users)> callback)
+{
+	get_active_users_list(subkeys, [callback] (const user_list &active_users, bool /*completed*/) {
+		callback(to_set(active_users)); // set callback can't report failure, so it gets empty set
+	});
+}
+
+user_list provider::impl::get_active_users_list(const std::vector<std::string>& subkeys)
+{
+	typedef std::pair<user_list, bool> result_t;
+
+	const auto res = wait_result<result_t>([&] (std::function<void(const result_t &result)> handler) {
+		get_active_users_list(subkeys, [handler] (const user_list &active_users, bool completed) {
+			handler(std::make_pair(active_users, completed));
+		});
+	});
+
+	if (!res.second)
+		throw ioremap::elliptics::error(EREMOTEIO, "Active users couldn't be read");
+
+	return res.first;
+}
+
+void provider::impl::on_active_users(std::shared_ptr<active_users_gather> gather, const find_result &res)
+{
+	{
+		boost::mutex::scoped_lock lock(gather->mutex);
+
+		if (res.error && res.error.code != -ENOENT) // chunk without users of the days isn't a failure
+			gather->failed = true;
+
+		for (auto it = res.entries.begin(), end = res.entries.end(); it != end; ++it) {
+			if (it->indexes.empty())
+				continue;
+
+			auto user = it->indexes.front().data.to_string(); // all found indexes of the entry contain the same user
+
+			if (!gather->closed_indexes.empty()) { // remembers users of the days which should be cached
+				for (auto ind_it = it->indexes.begin(), ind_end = it->indexes.end(); ind_it != ind_end; ++ind_it) {
+					auto closed = gather->closed_indexes.find(ind_it->name);
+					if (closed != gather->closed_indexes.end())
+						gather->closed_users[closed->second].push_back(user);
+				}
+			}
+
+			gather->found.emplace_back(std::move(user));
+		}
+
+		if (--gather->requests != 0)
+			return;
+	}
+
+	finish_active_users(gather);
+}
+
+void provider::impl::finish_active_users(std::shared_ptr<active_users_gather> gather)
+{
+	if (gather->failed) { // users of chunks which couldn't be read are missed, so partial list isn't returned
+		gather->callback(user_list(), false);
+		return;
+	}
+
+	if (gather->cache) {
+		for (size_t index = 0; index < gather->closed_subkeys.size(); ++index) {
+			gather->cache->insert(gather->closed_subkeys[index],
+			                      std::make_shared<const user_list>(gather->closed_users[index]));
+		}
+	}
+
+	if (gather->cached.empty()) {
+		gather->callback(user_list(gather->found), true);
+		return;
+	}
+
+	auto lists = gather->cached;
+	if (!gather->found.empty())
+		lists.push_back(std::make_shared<const user_list>(gather->found));
+
+	gather->callback(user_list::merge(lists), true); // sort-merge of sorted days removes duplicates without tree
+}
+
+std::set<std::string> provider::impl::to_set(const user_list& users)
+{
+	std::set<std::string> ret;
+
+	for (size_t index = 0; index < users.size(); ++index) {
+		ret.insert(ret.end(), users.at(index)); // users are sorted, so hint makes insertion constant
+	}
+
+	return ret;
+}
+
+void provider::impl::get_active_users_list(const std::vector<std::string>& subkeys,
+                                           std::function<void(const user_list &active_users, bool completed)> callback)
+{
+	const auto chunks = activity_chunks_;
+	auto gather = std::make_shared<active_users_gather>(chunks, callback);
+	gather->cache = get_active_users_cache();
+
+	std::vector<std::string> requested; // days which aren't found in the cache
+	requested.reserve(subkeys.size());
+
+	for (auto it = subkeys.begin(), end = subkeys.end(); it != end; ++it) {
+		if (gather->cache && is_past_day(*it)) { // activity of closed days isn't changed, so it could be cached
+			if (auto users = gather->cache->get(*it)) {
+				gather->cached.push_back(users);
+				continue;
+			}
+
+			for (uint32_t chunk = 0; chunk < chunks; ++chunk) {
+				gather->closed_indexes.insert(std::make_pair(chunk_index(*it, chunk, chunks), gather->closed_subkeys.size()));
+			}
+			gather->closed_subkeys.push_back(*it);
+		}
+
+		requested.push_back(*it);
+	}
+
+	gather->closed_users.resize(gather->closed_subkeys.size());
+
+	if (requested.empty()) { // all days have been found in the cache
+		finish_active_users(gather);
+		return;
+	}
+
+	const auto indexes = active_users_indexes(requested, chunks);
+
+	for (auto it = indexes.begin(), end = indexes.end(); it != end; ++it) {
+		storage_->find_any_indexes(*it,
+		                           boost::bind(&provider::impl::on_active_users,
+		                                       gather,
+		                                       _1));
+	}
+}
+
+active_users_page provider::impl::get_active_users(const std::vector<std::string>& subkeys,
+                                                   size_t limit,
+                                                   const std::string& cursor)
+{
+	LOG(DNET_LOG_DEBUG, "Getting active users page for keys: %lu limit: %lu cursor: %s\n",
+	    subkeys.size(), limit, cursor.c_str());
+
+	typedef std::pair<active_users_page, bool> result_t;
+
+	const auto res = wait_result<result_t>([&] (std::function<void(const result_t &result)> handler) {
+		get_active_users(subkeys, limit, cursor, [handler] (const active_users_page &page, bool completed) {
+			handler(std::make_pair(page, completed));
+		});
+	});
+
+	if (!res.second)
+		throw ioremap::elliptics::error(EREMOTEIO, "Active users couldn't be read");
+
+	return res.first;
+}
+
+void provider::impl::get_active_users(const std::vector<std::string>& subkeys,
+                                      size_t limit,
+                                      const std::string& cursor,
+                                      std::function<void(const active_users_page &page, bool completed)> callback)
+{
+	const auto chunks = activity_chunks_;
+	const auto position = parse_users_cursor(cursor, chunks); // throws on invalid cursor before any reading
+
+	read_users_page(std::make_shared<active_users_pager>(subkeys, chunks, position.first, position.second, limit, callback));
+}
+
+void provider::impl::read_users_page(std::shared_ptr<active_users_pager> pager)
+{
+	if (pager->chunk >= pager->chunks) { // all chunks have been read - leaves next_cursor empty
+		pager->callback(pager->page, true);
+		return;
+	}
+
+	if (pager->limit != 0 && pager->page.users.size() >= pager->limit) {
+		pager->page.next_cursor = make_users_cursor(pager->chunk, pager->chunks, pager->last_user);
+		pager->callback(pager->page, true);
+		return;
+	}
+
+	std::vector<std::string> indexes;
+	indexes.reserve(pager->subkeys.size());
+	for (auto it = pager->subkeys.begin(), end = pager->subkeys.end(); it != end; ++it) {
+		indexes.emplace_back(chunk_index(*it, pager->chunk, pager->chunks));
+	}
+
+	storage_->find_any_indexes(indexes,
+	                           boost::bind(&provider::impl::on_users_page,
+	                                       shared_from_this(),
+	                                       pager,
+	                                       _1));
+}
+
+void provider::impl::on_users_page(std::shared_ptr<active_users_pager> pager, const find_result &res)
+{
+	if (res.error && res.error.code != -ENOENT) { // missed indexes of days without activity don't fail the page
+		LOG(DNET_LOG_ERROR, "Can't read activity chunk: %u error: %s\n", pager->chunk, res.error.message.c_str());
+		pager->callback(active_users_page(), false); // partial page would skip users of the chunk
+		return;
+	}
+
+	std::vector<std::string> users; // each user is placed in the same chunk for all days, so users of the chunk are unique
+	users.reserve(res.entries.size());
+
+	for (auto it = res.entries.begin(), end = res.entries.end(); it != end; ++it) {
+		if (!it->indexes.empty())
+			users.emplace_back(it->indexes.front().data.to_string());
+	}
+
+	std::sort(users.begin(), users.end()); // the order of found entries isn't defined, so the chunk is sorted for stable position
+
+	auto begin = pager->last_user.empty() ? users.begin() : std::upper_bound(users.begin(), users.end(), pager->last_user);
+	auto end = users.end();
+
+	if (pager->limit != 0 && static_cast<size_t>(end - begin) > pager->limit - pager->page.users.size())
+		end = begin + (pager->limit - pager->page.users.size());
+
+	for (auto it = begin; it != end; ++it) {
+		pager->page.users.emplace_back(std::move(*it));
+	}
+
+	if (end == users.end()) { // the rest of the chunk has been added
+		++pager->chunk;
+		pager->last_user.clear();
+	} else
+		pager->last_user = pager->page.users.back();
+
+	read_users_page(pager);
+}
+
+std::pair<uint32_t, std::string> provider::impl::parse_users_cursor(const std::string& cursor, uint32_t chunks)
+{
+	if (cursor.empty())
+		return std::make_pair(0, std::string());
+
+	const auto first = cursor.find(':');
+	const auto second = first == std::string::npos ? first : cursor.find(':', first + 1);
+	if (second == std::string::npos)
+		throw std::invalid_argument("invalid cursor: " + cursor);
+
+	uint32_t chunk, cursor_chunks;
+	try {
+		chunk = boost::lexical_cast<uint32_t>(cursor.substr(0, first));
+		cursor_chunks = boost::lexical_cast<uint32_t>(cursor.substr(first + 1, second - first - 1));
+	}
+	catch (boost::bad_lexical_cast&) {
+		throw std::invalid_argument("invalid cursor: " + cursor);
+	}
+
+	if (cursor_chunks != chunks || chunk >= chunks) // position in chunks isn't valid after repartition
+		throw std::invalid_argument("cursor doesn't match activity chunks: " + cursor);
+
+	return std::make_pair(chunk, cursor.substr(second + 1)); // user name could contain colons, so it is the rest of the cursor
+}
+
+std::string provider::impl::make_users_cursor(uint32_t chunk, uint32_t chunks, const std::string& last_user)
+{
+	return boost::lexical_cast<std::string>(chunk) + ':' + boost::lexical_cast<std::string>(chunks) + ':' + last_user;
+}
+
+user_list provider::impl::combine_active_users(set_operation op, const std::vector<std::vector<std::string>>& operands)
+{
+	LOG(DNET_LOG_DEBUG, "Combining active users of operands: %lu\n", operands.size());
+
+	typedef std::pair<user_list, bool> result_t;
+
+	const auto res = wait_result<result_t>([&] (std::function<void(const result_t &result)> handler) {
+		combine_active_users(op, operands, [handler] (const user_list &active_users, bool completed) {
+			handler(std::make_pair(active_users, completed));
+		});
+	});
+
+	if (!res.second)
+		throw ioremap::elliptics::error(EREMOTEIO, "Active users of operands couldn't be read");
+
+	return res.first;
+}
+
+void provider::impl::combine_active_users(set_operation op,
+                                          const std::vector<std::vector<std::string>>& operands,
+                                          std::function<void(const user_list &active_users, bool completed)> callback)
+{
+	if (operands.empty())
+		throw std::invalid_argument("operands are missed");
+
+	read_operands(std::make_shared<set_operation_gather>(op, operands, activity_chunks_, callback));
+}
+
+void provider::impl::read_operands(std::shared_ptr<set_operation_gather> gather)
+{
+	if (gather->chunk >= gather->chunks) { // all chunks have been processed
+		gather->callback(user_list::merge(gather->results), true);
+		return;
+	}
+
+	gather->users.assign(gather->operands.size(), std::vector<std::string>());
+	gather->requests = gather->operands.size();
+
+	for (size_t operand = 0; operand < gather->operands.size(); ++operand) {
+		const auto &subkeys = gather->operands[operand];
+
+		std::vector<std::string> indexes;
+		indexes.reserve(subkeys.size());
+		for (auto it = subkeys.begin(), end = subkeys.end(); it != end; ++it) {
+			indexes.emplace_back(chunk_index(*it, gather->chunk, gather->chunks));
+		}
+
+		storage_->find_any_indexes(indexes,
+		                           boost::bind(&provider::impl::on_operand,
+		                                       shared_from_this(),
+		                                       gather,
+		                                       operand,
+		                                       _1));
+	}
+}
+
+void provider::impl::on_operand(std::shared_ptr<set_operation_gather> gather, size_t operand, const find_result &res)
+{
+	{
+		boost::mutex::scoped_lock lock(gather->mutex);
+
+		if (res.error && res.error.code != -ENOENT) { // missed indexes of days without activity don't fail the operand
+			LOG(DNET_LOG_ERROR, "Can't read operand: %lu of activity chunk: %u error: %s\n",
+			    operand, gather->chunk, res.error.message.c_str());
+			gather->failed = true;
+		}
+
+		auto &users = gather->users[operand];
+		users.reserve(res.entries.size());
+		for (auto it = res.entries.begin(), end = res.entries.end(); it != end; ++it) {
+			if (!it->indexes.empty())
+				users.emplace_back(it->indexes.front().data.to_string());
+		}
+
+		if (--gather->requests != 0)
+			return;
+	}
+
+	if (gather->failed) { // result without users of the operand would be wrong for any operation
+		gather->callback(user_list(), false);
+		return;
+	}
+
+	auto result_list = combine_chunk(gather);
+	if (!result_list->empty())
+		gather->results.push_back(result_list);
+
+	++gather->chunk;
+	read_operands(gather);
+}
+
+std::shared_ptr<const user_list> provider::impl::combine_chunk(std::shared_ptr<set_operation_gather> gather)
+{
+	auto ret = std::make_shared<user_list>(gather->users.front());
+
+	for (size_t operand = 1; operand < gather->users.size(); ++operand) {
+		user_list users(gather->users[operand]);
+		gather->users[operand].clear(); // frees names which have been packed into users
+
+		switch (gather->op) {
+		case set_operation::unite:
+			*ret = user_list::merge({ret, std::make_shared<const user_list>(std::move(users))});
+			break;
+		case set_operation::intersect:
+			*ret = user_list::intersect(*ret, users);
+			break;
+		case set_operation::subtract:
+			*ret = user_list::subtract(*ret, users);
+			break;
+		}
+	}
+
+	gather->users.clear();
+	return ret;
+}
+
+uint64_t provider::impl::count_active_users(const std::vector<std::string>& subkeys)
+{
+	LOG(DNET_LOG_DEBUG, "Counting active users for keys: %lu\n", subkeys.size());
+
+	typedef std::pair<uint64_t, bool> result_t;
+
+	const auto res = wait_result<result_t>([&] (std::function<void(const result_t &result)> handler) {
+		count_active_users(subkeys, [handler] (uint64_t count, bool completed) {
+			handler(std::make_pair(count, completed));
+		});
+	});
+
+	if (!res.second)
+		throw ioremap::elliptics::error(EREMOTEIO, "Activity sketches couldn't be read");
+
+	return res.first;
+}
+
+void provider::impl::count_active_users(const std::vector<std::string>& subkeys,
+                                        std::function<void(uint64_t count, bool completed)> callback)
+{
+	auto gather = std::make_shared<sketch_gather>(subkeys.size(), callback);
+
+	if (subkeys.empty()) {
+		callback(0, true);
+		return;
+	}
+
+	if (auto sketches = get_activity_sketches()) { // adds activity which hasn't been written yet
+		for (auto it = subkeys.begin(), end = subkeys.end(); it != end; ++it) {
+			sketches->pending(*it, gather->sketch);
+		}
+	}
+
+	for (auto it = subkeys.begin(), end = subkeys.end(); it != end; ++it) {
+		storage_->read_latest(*it + consts::SKETCH_SUFFIX, 0, 0,
+		                      boost::bind(&provider::impl::on_sketch_read,
+		                                  gather,
+		                                  _1));
+	}
+}
+
+void provider::impl::on_sketch_read(std::shared_ptr<sketch_gather> gather, const read_result &res)
+{
+	{
+		boost::mutex::scoped_lock lock(gather->mutex);
+
+		if (!res.error)
+			gather->sketch.load(res.data);
+		else if (res.error.code != -ENOENT) // day without sketch has no activity
+			gather->failed = true;
+
+		if (--gather->requests != 0)
+			return;
+	}
+
+	if (gather->failed) {
+		gather->callback(0, false);
+		return;
+	}
+
+	gather->callback(gather->sketch.estimate(), true);
+}
+
+user_list provider::impl::combine_activity_bitmaps(set_operation op, const std::vector<std::vector<std::string>>& operands)
+{
+	LOG(DNET_LOG_DEBUG, "Combining activity bitmaps of operands: %lu\n", operands.size());
+
+	typedef std::pair<user_list, bool> result_t;
+
+	const auto res = wait_result<result_t>([&] (std::function<void(const result_t &result)> handler) {
+		combine_activity_bitmaps(op, operands, [handler] (const user_list &active_users, bool completed) {
+			handler(std::make_pair(active_users, completed));
+		});
+	});
+
+	if (!res.second)
+		throw ioremap::elliptics::error(EREMOTEIO, "Activity bitmaps couldn't be read");
+
+	return res.first;
+}
+
+void provider::impl::combine_activity_bitmaps(set_operation op,
+                                              const std::vector<std::vector<std::string>>& operands,
+                                              std::function<void(const user_list &active_users, bool completed)> callback)
+{
+	auto dictionary = user_dictionary_;
+
+	read_activity_bitmaps(op, operands, [dictionary, callback] (const roaring_bitmap &ids, bool completed) {
+		if (!completed) {
+			callback(user_list(), false);
+			return;
+		}
+
+		dictionary->get_names(ids, callback);
+	});
+}
+
+uint64_t provider::impl::count_activity_bitmaps(set_operation op, const std::vector<std::vector<std::string>>& operands)
+{
+	LOG(DNET_LOG_DEBUG, "Counting activity bitmaps of operands: %lu\n", operands.size());
+
+	typedef std::pair<uint64_t, bool> result_t;
+
+	const auto res = wait_result<result_t>([&] (std::function<void(const result_t &result)> handler) {
+		count_activity_bitmaps(op, operands, [handler] (uint64_t count, bool completed) {
+			handler(std::make_pair(count, completed));
+		});
+	});
+
+	if (!res.second)
+		throw ioremap::elliptics::error(EREMOTEIO, "Activity bitmaps couldn't be read");
+
+	return res.first;
+}
+
+void provider::impl::count_activity_bitmaps(set_operation op,
+                                            const std::vector<std::vector<std::string>>& operands,
+                                            std::function<void(uint64_t count, bool completed)> callback)
+{
+	read_activity_bitmaps(op, operands, [callback] (const roaring_bitmap &ids, bool completed) {
+		callback(completed ? ids.cardinality() : 0, completed);
+	});
+}
+
+day_stats provider::impl::get_day_stats(const std::vector<std::string>& subkeys)
+{
+	LOG(DNET_LOG_DEBUG, "Getting day stats for keys: %lu\n", subkeys.size());
+
+	typedef std::pair<day_stats, bool> result_t;
+
+	const auto res = wait_result<result_t>([&] (std::function<void(const result_t &result)> handler) {
+		get_day_stats(subkeys, [handler] (const day_stats &stats, bool completed) {
+			handler(std::make_pair(stats, completed));
+		});
+	});
+
+	if (!res.second)
+		throw ioremap::elliptics::error(EREMOTEIO, "Day stats couldn't be read");
+
+	return res.first;
+}
+
+void provider::impl::get_day_stats(const std::vector<std::string>& subkeys,
+                                   std::function<void(const day_stats &stats, bool completed)> callback)
+{
+	auto gather = std::make_shared<day_stats_gather>(subkeys.size(), callback);
+
+	if (auto stats = get_day_stats_buffer()) { // adds deltas which haven't been written yet
+		for (auto it = subkeys.begin(), end = subkeys.end(); it != end; ++it) {
+			stats->pending(*it, gather->counters);
+		}
+	}
+
+	if (subkeys.empty()) {
+		day_stats ret = {0, 0, 0};
+		callback(ret, true);
+		return;
+	}
+
+	for (auto it = subkeys.begin(), end = subkeys.end(); it != end; ++it) {
+		storage_->read_latest(*it + consts::STATS_SUFFIX, 0, 0,
+		                      boost::bind(&provider::impl::on_day_stats_read,
+		                                  gather,
+		                                  _1));
+	}
+}
+
+void provider::impl::on_day_stats_read(std::shared_ptr<day_stats_gather> gather, const read_result &res)
+{
+	{
+		boost::mutex::scoped_lock lock(gather->mutex);
+
+		if (!res.error)
+			gather->counters.load(res.data);
+		else if (res.error.code != -ENOENT) // day without counters has no counted records
+			gather->failed = true;
+
+		if (--gather->requests != 0)
+			return;
+	}
+
+	if (gather->failed) {
+		gather->callback(day_stats(), false);
+		return;
+	}
+
+	day_stats ret = {gather->counters.records(), gather->counters.bytes(), gather->counters.users()};
+	gather->callback(ret, true);
+}
+
+std::vector<uint64_t> provider::impl::get_user_active_days(const std::string& user, uint64_t begin_day, uint64_t end_day)
+{
+	LOG(DNET_LOG_DEBUG, "Getting active days of user: %s\n", user.c_str());
+
+	return wait_result<std::vector<uint64_t>>([&] (std::function<void(const std::vector<uint64_t> &days)> handler) {
+		get_user_active_days(user, begin_day, end_day, handler);
+	});
+}
+
+void provider::impl::get_user_active_days(const std::string& user,
+                                          uint64_t begin_day, uint64_t end_day,
+                                          std::function<void(const std::vector<uint64_t> &days)> callback)
+{
+	read_calendar(user, [begin_day, end_day, callback] (const activity_calendar &calendar) {
+		callback(calendar.days(begin_day, end_day));
+	});
+}
+
+void provider::impl::read_activity_bitmaps(set_operation op,
+                                           const std::vector<std::vector<std::string>>& operands,
+                                           std::function<void(const roaring_bitmap &ids, bool completed)> callback)
+{
+	if (operands.empty())
+		throw std::invalid_argument("operands are missed");
+
+	size_t requests = 0;
+	for (auto it = operands.begin(), end = operands.end(); it != end; ++it) {
+		requests += it->size();
+	}
+
+	auto gather = std::make_shared<bitmap_gather>(op, operands.size(), requests, callback);
+
+	if (auto bitmaps = get_activity_bitmaps()) { // adds activity which hasn't been written yet
+		for (size_t operand = 0; operand < operands.size(); ++operand) {
+			for (auto it = operands[operand].begin(), end = operands[operand].end(); it != end; ++it) {
+				bitmaps->pending(*it, gather->bitmaps[operand]);
+			}
+		}
+	}
+
+	if (requests == 0) { // operands without days have only pending activity
+		combine_bitmaps(gather);
+		return;
+	}
+
+	for (size_t operand = 0; operand < operands.size(); ++operand) {
+		for (auto it = operands[operand].begin(), end = operands[operand].end(); it != end; ++it) {
+			storage_->read_latest(*it + consts::BITMAP_SUFFIX, 0, 0,
+			                      boost::bind(&provider::impl::on_bitmap_read,
+			                                  gather,
+			                                  operand,
+			                                  _1));
+		}
+	}
+}
+
+void provider::impl::on_bitmap_read(std::shared_ptr<bitmap_gather> gather, size_t operand, const read_result &res)
+{
+	{
+		boost::mutex::scoped_lock lock(gather->mutex);
+
+		if (!res.error)
+			gather->bitmaps[operand].load(res.data);
+		else if (res.error.code != -ENOENT) // day without bitmap has no activity
+			gather->failed = true;
+
+		if (--gather->requests != 0)
+			return;
+	}
+
+	if (gather->failed) { // result without activity of the day would be wrong for any operation
+		gather->callback(roaring_bitmap(), false);
+		return;
+	}
+
+	combine_bitmaps(gather);
+}
+
+void provider::impl::combine_bitmaps(std::shared_ptr<bitmap_gather> gather)
+{
+	auto &ret = gather->bitmaps.front();
+	for (size_t index = 1; index < gather->bitmaps.size(); ++index) {
+		switch (gather->op) {
+		case set_operation::unite:
+			ret.merge(gather->bitmaps[index]);
+			break;
+		case set_operation::intersect:
+			ret.intersect(gather->bitmaps[index]);
+			break;
+		case set_operation::subtract:
+			ret.subtract(gather->bitmaps[index]);
+			break;
+		}
+	}
+
+	gather->callback(ret, true);
+}
+
+void provider::impl::stream_active_users(const std::vector<std::string>& subkeys,
+                                         size_t batch_size,
+                                         std::function<void(const std::vector<std::string> &users)> on_users,
+                                         std::function<void(bool completed)> on_complete)
+{
+	LOG(DNET_LOG_DEBUG, "Stream active users: %lu batch size: %lu\n", subkeys.size(), batch_size);
+
+	const auto chunks = activity_chunks_;
+	auto stream = std::make_shared<active_users_stream>(chunks, batch_size, on_users, on_complete);
+
+	const auto indexes = active_users_indexes(subkeys, chunks);
+
+	for (auto it = indexes.begin(), end = indexes.end(); it != end; ++it) {
+		storage_->find_any_indexes(*it,
+		                           boost::bind(&provider::impl::on_stream_user,
+		                                       stream,
+		                                       _1),
+		                           boost::bind(&provider::impl::on_stream_finished,
+		                                       stream,
+		                                       _1));
+	}
+}
+
+void provider::impl::on_stream_user(std::shared_ptr<active_users_stream> stream, const found_entry &entry)
+{
+	if (entry.indexes.empty())
+		return;
+
+	boost::mutex::scoped_lock lock(stream->mutex);
+
+	stream->batch.emplace_back(entry.indexes.front().data.to_string()); // all found indexes of the entry contain the same user
+
+	if (stream->batch.size() < stream->batch_size)
+		return;
+
+	std::vector<std::string> batch;
+	batch.swap(stream->batch);
+	stream->on_users(batch);
+}
+
+void provider::impl::on_stream_finished(std::shared_ptr<active_users_stream> stream, const storage_error &error)
+{
+	boost::mutex::scoped_lock lock(stream->mutex);
+
+	if (error && error.code != -ENOENT) // chunk without users of the days isn't a failure
+		stream->failed = true;
+
+	if (--stream->requests != 0)
+		return;
+
+	if (!stream->batch.empty()) {
+		std::vector<std::string> batch;
+		batch.swap(stream->batch);
+		stream->on_users(batch);
+	}
+
+	stream->on_complete(!stream->failed);
+}
+
+void provider::impl::for_user_logs(const std::string& user,
+                                   const std::vector<std::string>& subkeys,
+                                   std::function<bool(const ioremap::elliptics::data_pointer &data)> callback)
+{
+	LOG(DNET_LOG_DEBUG, "Iterate user: %s logs: %lu\n", user.c_str(), subkeys.size());
+
+	auto logs = get_user_logs(user, subkeys);
+
+	for (auto it = logs.begin(), end = logs.end(); it != end; ++it) {
+		if (!callback(*it))
+			return;
+	}
+}
+
+void provider::impl::for_active_users(const std::vector<std::string>& subkeys,
+                                      std::function<bool(const std::set<std::string>& active_users)> callback)
+{
+	LOG(DNET_LOG_DEBUG, "Iterate active users: %lu\n", subkeys.size());
+	for (auto it = subkeys.begin(), end = subkeys.end(); it != end; ++it) {
+		std::vector<std::string> one_subkey;
+		one_subkey.push_back(*it);
+		if (!callback(get_active_users(one_subkey)))
+			return;
+	}
+}
+
+void provider::impl::write_user_log(const std::string& user,
+                                    const std::string& subkey,
+                                    const ioremap::elliptics::data_pointer &data,
+                                    storage::write_handler_t handler)
+{
+	auto write_key = combine_key(user, subkey);
+
+	LOG(DNET_LOG_DEBUG, "Try to append data to user log key: %s\n", write_key.c_str());
+
+	add_calendar_day(user, subkey);
+
+	write_log(write_key, data, handler);
+}
+
+void provider::impl::append_log(const std::string& user,
+                                const std::string& subkey,
+                                const ioremap::elliptics::data_pointer &data,
+                                coalescer::handler_t handler)
+{
+	add_calendar_day(user, subkey);
+	handler = count_log(user, subkey, data.size(), handler);
+
+	if (auto c = get_coalescer()) {
+		c->append(combine_key(user, subkey), data, handler);
+		return;
+	}
+
+	write_log(combine_key(user, subkey), data, handler);
+}
+
+void provider::impl::write_log(const std::string& key,
+                               const ioremap::elliptics::data_pointer &data,
+                               coalescer::handler_t handler)
+{
+	storage_->append(key, data,
+	                 boost::bind(&provider::impl::on_log_written,
+	                             shared_from_this(),
+	                             key,
+	                             handler,
+	                             _1));
+}
+
+void provider::impl::on_log_written(const std::string& key, coalescer::handler_t handler, const write_result &res)
+{
+	invalidate_log(key); // the log is removed after the append, so concurrent read of the old log isn't cached
+	handler(res);
+}
+
+void provider::impl::write_offsets(const std::string& key, const std::vector<offset_entry> &entries)
+{
+	auto data = pack_offsets(entries);
+
+	// entries are built from the same log by any reader, so the longer index covers more of the log and is kept
+	storage_->write_cas(key,
+	                    [data] (const ioremap::elliptics::data_pointer &stored) { return stored.size() > data.size() ? stored : data; },
+	                    boost::bind(&provider::impl::on_offsets_written,
+	                                shared_from_this(),
+	                                key,
+	                                _1));
+}
+
+void provider::impl::on_offsets_written(const std::string& key, const write_result &res)
+{
+	if (res.written < min_writes_) // the index is only hint for reading, so the read isn't failed
+		LOG(DNET_LOG_ERROR, "Can't update offset index: %s error: %s\n", key.c_str(), res.error.message.c_str());
+}
+
+std::shared_ptr<coalescer> provider::impl::get_coalescer()
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	return coalescer_;
+}
+
+std::shared_ptr<activity_cache> provider::impl::get_activity_cache()
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	return activity_cache_;
+}
+
+std::shared_ptr<log_cache> provider::impl::get_log_cache()
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	return log_cache_;
+}
+
+std::shared_ptr<active_users_cache> provider::impl::get_active_users_cache()
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	return active_users_cache_;
+}
+
+std::shared_ptr<activity_sketches> provider::impl::get_activity_sketches()
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	return activity_sketches_;
+}
+
+void provider::impl::write_sketch(const std::string& subkey, const hyperloglog &sketch, std::weak_ptr<activity_sketches> owner)
+{
+	LOG(DNET_LOG_DEBUG, "Merge activity sketch of key: %s\n", subkey.c_str());
+
+	storage_->write_cas(subkey + consts::SKETCH_SUFFIX,
+	                    [sketch] (const ioremap::elliptics::data_pointer &stored) {
+	                        hyperloglog merged = sketch;
+	                        merged.load(stored); // invalid or missed sketch is replaced
+	                        return merged.save();
+	                    },
+	                    boost::bind(&provider::impl::on_sketch_written,
+	                                owner,
+	                                subkey,
+	                                sketch,
+	                                _1));
+}
+
+void provider::impl::on_sketch_written(std::weak_ptr<activity_sketches> sketches,
+                                       const std::string& subkey,
+                                       const hyperloglog &sketch,
+                                       const write_result &res)
+{
+	if (!res.error)
+		return;
+
+	if (auto s = sketches.lock()) // sketches which are being destroyed can't be written again
+		s->merge(subkey, sketch); // sketch will be written again on the next flush
+}
+
+std::shared_ptr<day_stats_buffer> provider::impl::get_day_stats_buffer()
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	return day_stats_;
+}
+
+void provider::impl::add_day_stats(const std::string& user, const std::string& subkey, uint64_t size)
+{
+	if (auto stats = get_day_stats_buffer()) {
+		const day_counters::record r = {user, size};
+		stats->add(subkey, r);
+	}
+}
+
+coalescer::handler_t provider::impl::count_log(const std::string& user,
+                                               const std::string& subkey,
+                                               uint64_t size,
+                                               coalescer::handler_t handler)
+{
+	std::weak_ptr<day_stats_buffer> stats = get_day_stats_buffer();
+	if (stats.expired())
+		return handler;
+
+	const auto min_writes = min_writes_;
+
+	return [=] (const write_result &res) {
+		if (res.written >= min_writes) { // counts only successful appends
+			if (auto s = stats.lock()) {
+				const day_counters::record r = {user, size};
+				s->add(subkey, r);
+			}
+		}
+		handler(res);
+	};
+}
+
+void provider::impl::write_day_stats(const std::string& subkey, const day_counters &counters, std::weak_ptr<day_stats_buffer> owner)
+{
+	LOG(DNET_LOG_DEBUG, "Merge day stats of key: %s\n", subkey.c_str());
+
+	auto converted = std::make_shared<std::atomic<bool>>(false); // whether the delta could have been sent to storage
+
+	storage_->write_cas(subkey + consts::STATS_SUFFIX,
+	                    [counters, converted] (const ioremap::elliptics::data_pointer &stored) {
+	                        *converted = true;
+	                        day_counters merged = counters;
+	                        merged.load(stored); // delta is added to stored counters, invalid or missed counters are replaced
+	                        return merged.save();
+	                    },
+	                    boost::bind(&provider::impl::on_day_stats_written,
+	                                owner,
+	                                subkey,
+	                                counters,
+	                                converted,
+	                                _1));
+}
+
+void provider::impl::on_day_stats_written(std::weak_ptr<day_stats_buffer> stats,
+                                          const std::string& subkey,
+                                          const day_counters &counters,
+                                          std::shared_ptr<std::atomic<bool>> converted,
+                                          const write_result &res)
+{
+	if (!res.error)
+		return;
+
+	// delta is added to stored counters, so it is written again only if it hasn't been applied anywhere:
+	// the write hasn't been sent or all groups have rejected it by mismatch of compare-and-swap.
+	// Delta which could have been applied (partial write or timeout) is dropped, counters are estimations anyway.
+	if (res.written != 0 || (*converted && res.error.code != -EBADFD))
+		return;
+
+	if (auto s = stats.lock()) // buffer which is being destroyed can't be written again
+		s->merge(subkey, counters); // delta will be written again on the next flush
+}
+
+std::shared_ptr<activity_calendars> provider::impl::get_activity_calendars()
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	return activity_calendars_;
+}
+
+void provider::impl::add_calendar_day(const std::string& user, const std::string& subkey)
+{
+	uint32_t day;
+	if (!subkey_to_day(subkey, day)) // custom keys aren't days
+		return;
+
+	if (auto calendars = get_activity_calendars())
+		calendars->add(user, day);
+}
+
+void provider::impl::read_calendar(const std::string& user, std::function<void(const activity_calendar &calendar)> callback)
+{
+	storage_->read_latest(consts::CALENDAR_PREFIX + user, 0, 0,
+	                      boost::bind(&provider::impl::on_calendar_read,
+	                                  shared_from_this(),
+	                                  user,
+	                                  callback,
+	                                  _1));
+}
+
+void provider::impl::on_calendar_read(const std::string& user,
+                                      std::function<void(const activity_calendar &calendar)> callback,
+                                      const read_result &res)
+{
+	activity_calendar calendar;
+
+	if (!res.error)
+		calendar.load(res.data); // user without calendar has no known days
+
+	if (auto calendars = get_activity_calendars())
+		calendars->pending(user, calendar); // adds days which haven't been written yet
+
+	callback(calendar);
+}
+
+void provider::impl::write_calendar(const std::string& user, const activity_calendar &calendar, std::weak_ptr<activity_calendars> owner)
+{
+	LOG(DNET_LOG_DEBUG, "Merge activity calendar of user: %s\n", user.c_str());
+
+	storage_->write_cas(consts::CALENDAR_PREFIX + user,
+	                    [calendar] (const ioremap::elliptics::data_pointer &stored) {
+	                        activity_calendar merged = calendar;
+	                        merged.load(stored); // invalid or missed calendar is replaced
+	                        return merged.save();
+	                    },
+	                    boost::bind(&provider::impl::on_calendar_written,
+	                                owner,
+	                                user,
+	                                calendar,
+	                                _1));
+}
+
+void provider::impl::on_calendar_written(std::weak_ptr<activity_calendars> calendars,
+                                         const std::string& user,
+                                         const activity_calendar &calendar,
+                                         const write_result &res)
+{
+	if (!res.error)
+		return;
+
+	if (auto c = calendars.lock()) // calendars which are being destroyed can't be written again
+		c->merge(user, calendar); // calendar will be written again on the next flush
+}
+
+std::shared_ptr<activity_bitmaps> provider::impl::get_activity_bitmaps()
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	return activity_bitmaps_;
+}
+
+void provider::impl::write_bitmap(const std::string& subkey, const roaring_bitmap &bitmap, std::weak_ptr<activity_bitmaps> owner)
+{
+	LOG(DNET_LOG_DEBUG, "Merge activity bitmap of key: %s\n", subkey.c_str());
+
+	storage_->write_cas(subkey + consts::BITMAP_SUFFIX,
+	                    [bitmap] (const ioremap::elliptics::data_pointer &stored) {
+	                        roaring_bitmap merged = bitmap;
+	                        merged.load(stored); // invalid or missed bitmap is replaced
+	                        return merged.save();
+	                    },
+	                    boost::bind(&provider::impl::on_bitmap_written,
+	                                owner,
+	                                subkey,
+	                                bitmap,
+	                                _1));
+}
+
+void provider::impl::on_bitmap_written(std::weak_ptr<activity_bitmaps> bitmaps,
+                                       const std::string& subkey,
+                                       const roaring_bitmap &bitmap,
+                                       const write_result &res)
+{
+	if (!res.error)
+		return;
+
+	if (auto b = bitmaps.lock()) // bitmaps which are being destroyed can't be written again
+		b->merge(subkey, bitmap); // bitmap will be written again on the next flush
+}
+
+void provider::impl::invalidate_log(const std::string& key)
+{
+	if (auto cache = get_log_cache())
+		cache->remove(key); // late append to past day
+}
+
+bool provider::impl::is_past_day(const std::string& subkey)
+{
+	if (subkey.empty() || subkey.find_first_not_of("0123456789") != std::string::npos)
+		return false; // custom key could be changed at any time
+
+	return strtoull(subkey.c_str(), NULL, 10) < static_cast<uint64_t>(::time(NULL)) / consts::SECONDS_IN_DAY;
+}
+
+bool provider::impl::subkey_to_day(const std::string& subkey, uint32_t &day)
+{
+	if (subkey.empty() || subkey.size() > 9 || subkey.find_first_not_of("0123456789") != std::string::npos)
+		return false; // custom key or day which doesn't fit calendar
+
+	day = strtoul(subkey.c_str(), NULL, 10);
+	return true;
+}
+
+void provider::impl::cache_log(std::shared_ptr<user_logs_gather> gather, size_t index)
+{
+	if (gather->cacheable[index] && !gather->slots[index].empty())
+		gather->cache->insert(gather->keys[index], gather->slots[index], gather->generations[index]);
+}
+
+bool provider::impl::is_active(const std::shared_ptr<activity_cache>& cache,
+                               const std::string& user,
+                               const std::string& subkey)
+{
+	return cache && cache->contains(user, subkey);
+}
+
+std::function<void(bool added)>
+provider::impl::remember_activity(std::shared_ptr<activity_cache> cache,
+                                  const std::string& user,
+                                  const std::string& subkey,
+                                  std::function<void(bool added)> callback)
+{
+	if (!cache)
+		return callback;
+
+	return [=] (bool added) {
+		if (added)
+			cache->insert(user, subkey); // remembers only successful updates
+		callback(added);
+	};
+}
+
+void provider::impl::write_activity(const std::string& user,
+                                    const std::string& subkey,
+                                    storage::write_handler_t handler)
+{
+	LOG(DNET_LOG_DEBUG, "Try to add user to activity statistics: %s\n", subkey.c_str());
+
+	std::vector<std::string> indexes;
+	std::vector<ioremap::elliptics::data_pointer> datas;
+	indexes.push_back(activity_index(user, subkey, activity_chunks_));
+	datas.push_back(user);
+
+	LOG(DNET_LOG_DEBUG, "Update indexes with key: %s and index: %s\n", subkey.c_str(), indexes.front().c_str());
+	storage_->update_indexes(user, indexes, datas,
+	                         boost::bind(&provider::impl::on_activity_written,
+	                                     shared_from_this(),
+	                                     user,
+	                                     subkey,
+	                                     handler,
+	                                     _1));
+}
+
+void provider::impl::on_activity_written(const std::string& user,
+                                         const std::string& subkey,
+                                         storage::write_handler_t handler,
+                                         const write_result &res)
+{
+	// the cache is cleared after the index update, otherwise concurrent read could cache the old index again
+	if (auto cache = get_active_users_cache())
+		cache->remove(subkey); // late activity of closed day
+
+	if (res.written >= min_writes_) { // statistics are updated only by activity which has been added to the index
+		if (auto sketches = get_activity_sketches())
+			sketches->add(subkey, user);
+
+		add_calendar_day(user, subkey);
+
+		if (auto bitmaps = get_activity_bitmaps()) {
+			std::weak_ptr<activity_bitmaps> owner = bitmaps;
+			user_dictionary_->get_id(user, [owner, subkey] (bool found, uint32_t id) {
+				if (!found)
+					return; // id couldn't be allocated, the user is still added to the index
+
+				if (auto b = owner.lock())
+					b->add(subkey, id);
+			});
+		}
+	}
+
+	handler(res);
+}
 
 std::string provider::impl::combine_key(const std::string& basekey, const std::string& subkey) const
 {
 	return basekey + "." + subkey;
 }
 
+std::string provider::impl::activity_index(const std::string& user, const std::string& subkey, uint32_t chunks) const
+{
+	uint32_t hash = 2166136261U; // FNV-1a is used because chunk of the user should be the same in all processes and builds
+	for (auto it = user.begin(), end = user.end(); it != end; ++it) {
+		hash ^= static_cast<unsigned char>(*it);
+		hash *= 16777619U;
+	}
+
+	return chunk_index(subkey, hash % chunks, chunks);
+}
+
+std::string provider::impl::chunk_index(const std::string& subkey, uint32_t chunk, uint32_t chunks) const
+{
+	if (chunks == 1) // activity which isn't split to chunks is stored in the index named by subkey
+		return subkey;
+
+	return combine_key(subkey, boost::lexical_cast<std::string>(chunk));
+}
+
 } /* namespace history */
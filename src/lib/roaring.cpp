@@ -0,0 +1,432 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#include "roaring.h"
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+#include <string.h>
+
+namespace history {
+
+namespace consts {
+	const uint32_t ROARING_MAGIC = 0x31425248; // "HRB1" - format of serialized bitmap
+	const uint16_t DENSE_CONTAINER = 1; // flag of serialized dense container
+}
+
+bool roaring_bitmap::container::add(uint16_t low)
+{
+	if (dense()) {
+		const uint64_t bit = 1ULL << (low & 63);
+		if (bitset[low >> 6] & bit)
+			return false;
+		bitset[low >> 6] |= bit;
+		++size;
+		return true;
+	}
+
+	auto it = std::lower_bound(array.begin(), array.end(), low);
+	if (it != array.end() && *it == low)
+		return false;
+
+	array.insert(it, low);
+	++size;
+
+	if (size > ARRAY_MAX_SIZE)
+		to_bitset();
+
+	return true;
+}
+
+bool roaring_bitmap::container::contains(uint16_t low) const
+{
+	if (dense())
+		return (bitset[low >> 6] >> (low & 63)) & 1;
+
+	return std::binary_search(array.begin(), array.end(), low);
+}
+
+void roaring_bitmap::container::to_bitset()
+{
+	bitset.assign(BITSET_WORDS, 0);
+	for (auto it = array.begin(), end = array.end(); it != end; ++it) {
+		bitset[*it >> 6] |= 1ULL << (*it & 63);
+	}
+
+	std::vector<uint16_t>().swap(array);
+}
+
+void roaring_bitmap::container::to_array()
+{
+	if (!dense() || size > ARRAY_MAX_SIZE)
+		return;
+
+	array.reserve(size);
+	for (size_t word = 0; word < BITSET_WORDS; ++word) {
+		for (uint64_t bits = bitset[word]; bits != 0; bits &= bits - 1) {
+			array.push_back(static_cast<uint16_t>((word << 6) + __builtin_ctzll(bits)));
+		}
+	}
+
+	std::vector<uint64_t>().swap(bitset);
+}
+
+void roaring_bitmap::container::update_size()
+{
+	if (!dense()) {
+		size = array.size();
+		return;
+	}
+
+	size = 0;
+	for (size_t word = 0; word < BITSET_WORDS; ++word) {
+		size += __builtin_popcountll(bitset[word]);
+	}
+}
+
+bool roaring_bitmap::add(uint32_t id)
+{
+	const uint16_t key = id >> 16;
+
+	auto it = std::lower_bound(containers_.begin(), containers_.end(), key,
+	                           [] (const container &c, uint16_t k) { return c.key < k; });
+	if (it == containers_.end() || it->key != key)
+		it = containers_.insert(it, container(key));
+
+	return it->add(id & 0xFFFF);
+}
+
+bool roaring_bitmap::contains(uint32_t id) const
+{
+	auto it = find(id >> 16);
+	return it != containers_.end() && it->contains(id & 0xFFFF);
+}
+
+uint64_t roaring_bitmap::cardinality() const
+{
+	uint64_t ret = 0;
+	for (auto it = containers_.begin(), end = containers_.end(); it != end; ++it) {
+		ret += it->size;
+	}
+	return ret;
+}
+
+bool roaring_bitmap::merge(const roaring_bitmap &other)
+{
+	const uint64_t before = cardinality();
+
+	std::vector<container> ret;
+	ret.reserve(containers_.size() + other.containers_.size());
+
+	auto lhs = containers_.begin(), lhs_end = containers_.end();
+	auto rhs = other.containers_.begin(), rhs_end = other.containers_.end();
+
+	while (lhs != lhs_end || rhs != rhs_end) {
+		if (rhs == rhs_end || (lhs != lhs_end && lhs->key < rhs->key)) {
+			ret.push_back(std::move(*lhs++));
+		} else if (lhs == lhs_end || rhs->key < lhs->key) {
+			ret.push_back(*rhs++);
+		} else {
+			ret.push_back(std::move(*lhs++));
+			unite(ret.back(), *rhs++);
+		}
+	}
+
+	containers_.swap(ret);
+
+	return cardinality() != before;
+}
+
+void roaring_bitmap::intersect(const roaring_bitmap &other)
+{
+	std::vector<container> ret;
+
+	for (auto it = containers_.begin(), end = containers_.end(); it != end; ++it) {
+		auto rhs = other.find(it->key);
+		if (rhs == other.containers_.end())
+			continue;
+
+		intersect(*it, *rhs);
+		if (it->size != 0)
+			ret.push_back(std::move(*it));
+	}
+
+	containers_.swap(ret);
+}
+
+void roaring_bitmap::subtract(const roaring_bitmap &other)
+{
+	std::vector<container> ret;
+	ret.reserve(containers_.size());
+
+	for (auto it = containers_.begin(), end = containers_.end(); it != end; ++it) {
+		auto rhs = other.find(it->key);
+		if (rhs != other.containers_.end())
+			subtract(*it, *rhs);
+
+		if (it->size != 0)
+			ret.push_back(std::move(*it));
+	}
+
+	containers_.swap(ret);
+}
+
+bool roaring_bitmap::load(const ioremap::elliptics::data_pointer &data)
+{
+	const char *pos = data.data<char>();
+	const char *end = pos + data.size();
+
+	uint32_t magic, count;
+	if (data.size() < sizeof(magic) + sizeof(count))
+		return false;
+
+	memcpy(&magic, pos, sizeof(magic));
+	memcpy(&count, pos + sizeof(magic), sizeof(count));
+	pos += sizeof(magic) + sizeof(count);
+
+	if (magic != consts::ROARING_MAGIC)
+		return false;
+
+	roaring_bitmap loaded;
+	loaded.containers_.reserve(count);
+
+	for (uint32_t index = 0; index < count; ++index) {
+		uint16_t key, flags;
+		uint32_t size;
+		if (static_cast<size_t>(end - pos) < sizeof(key) + sizeof(flags) + sizeof(size))
+			return false;
+
+		memcpy(&key, pos, sizeof(key));
+		memcpy(&flags, pos + sizeof(key), sizeof(flags));
+		memcpy(&size, pos + sizeof(key) + sizeof(flags), sizeof(size));
+		pos += sizeof(key) + sizeof(flags) + sizeof(size);
+
+		if (!loaded.containers_.empty() && loaded.containers_.back().key >= key) // containers should be sorted
+			return false;
+
+		container c(key);
+		c.size = size;
+
+		if (flags & consts::DENSE_CONTAINER) {
+			if (static_cast<size_t>(end - pos) < BITSET_WORDS * sizeof(uint64_t))
+				return false;
+			c.bitset.resize(BITSET_WORDS);
+			memcpy(c.bitset.data(), pos, BITSET_WORDS * sizeof(uint64_t));
+			pos += BITSET_WORDS * sizeof(uint64_t);
+			c.update_size(); // size is recounted, so broken size can't break other containers
+		} else {
+			if (size > ARRAY_MAX_SIZE || static_cast<size_t>(end - pos) < size * sizeof(uint16_t))
+				return false;
+			c.array.resize(size);
+			memcpy(c.array.data(), pos, size * sizeof(uint16_t));
+			pos += size * sizeof(uint16_t);
+
+			if (std::adjacent_find(c.array.begin(), c.array.end(), std::greater_equal<uint16_t>()) != c.array.end())
+				return false; // array should be sorted and unique
+		}
+
+		if (c.size != 0)
+			loaded.containers_.push_back(std::move(c));
+	}
+
+	merge(loaded);
+	return true;
+}
+
+ioremap::elliptics::data_pointer roaring_bitmap::save() const
+{
+	const uint32_t count = containers_.size();
+
+	size_t total = sizeof(consts::ROARING_MAGIC) + sizeof(count);
+	for (auto it = containers_.begin(), end = containers_.end(); it != end; ++it) {
+		total += sizeof(uint16_t) * 2 + sizeof(uint32_t);
+		total += it->dense() ? BITSET_WORDS * sizeof(uint64_t) : it->array.size() * sizeof(uint16_t);
+	}
+
+	auto ret = ioremap::elliptics::data_pointer::allocate(total);
+	char *pos = ret.data<char>();
+
+	memcpy(pos, &consts::ROARING_MAGIC, sizeof(consts::ROARING_MAGIC));
+	memcpy(pos + sizeof(consts::ROARING_MAGIC), &count, sizeof(count));
+	pos += sizeof(consts::ROARING_MAGIC) + sizeof(count);
+
+	for (auto it = containers_.begin(), end = containers_.end(); it != end; ++it) {
+		const uint16_t flags = it->dense() ? consts::DENSE_CONTAINER : 0;
+		memcpy(pos, &it->key, sizeof(it->key));
+		memcpy(pos + sizeof(it->key), &flags, sizeof(flags));
+		memcpy(pos + sizeof(it->key) + sizeof(flags), &it->size, sizeof(it->size));
+		pos += sizeof(it->key) + sizeof(flags) + sizeof(it->size);
+
+		if (it->dense()) {
+			memcpy(pos, it->bitset.data(), BITSET_WORDS * sizeof(uint64_t));
+			pos += BITSET_WORDS * sizeof(uint64_t);
+		} else {
+			memcpy(pos, it->array.data(), it->array.size() * sizeof(uint16_t));
+			pos += it->array.size() * sizeof(uint16_t);
+		}
+	}
+
+	return ret;
+}
+
+void roaring_bitmap::for_each(std::function<void(uint32_t id)> callback) const
+{
+	for (auto it = containers_.begin(), end = containers_.end(); it != end; ++it) {
+		const uint32_t high = static_cast<uint32_t>(it->key) << 16;
+
+		if (!it->dense()) {
+			for (auto low = it->array.begin(), low_end = it->array.end(); low != low_end; ++low) {
+				callback(high | *low);
+			}
+			continue;
+		}
+
+		for (size_t word = 0; word < BITSET_WORDS; ++word) {
+			for (uint64_t bits = it->bitset[word]; bits != 0; bits &= bits - 1) {
+				callback(high | static_cast<uint32_t>((word << 6) + __builtin_ctzll(bits)));
+			}
+		}
+	}
+}
+
+std::vector<roaring_bitmap::container>::iterator roaring_bitmap::find(uint16_t key)
+{
+	auto it = std::lower_bound(containers_.begin(), containers_.end(), key,
+	                           [] (const container &c, uint16_t k) { return c.key < k; });
+	return (it != containers_.end() && it->key == key) ? it : containers_.end();
+}
+
+std::vector<roaring_bitmap::container>::const_iterator roaring_bitmap::find(uint16_t key) const
+{
+	auto it = std::lower_bound(containers_.begin(), containers_.end(), key,
+	                           [] (const container &c, uint16_t k) { return c.key < k; });
+	return (it != containers_.end() && it->key == key) ? it : containers_.end();
+}
+
+void roaring_bitmap::unite(container &lhs, const container &rhs)
+{
+	if (!lhs.dense() && rhs.dense()) { // the result is dense anyway
+		std::vector<uint16_t> array;
+		array.swap(lhs.array);
+		lhs.bitset = rhs.bitset;
+		for (auto it = array.begin(), end = array.end(); it != end; ++it) {
+			lhs.bitset[*it >> 6] |= 1ULL << (*it & 63);
+		}
+		lhs.update_size();
+		return;
+	}
+
+	if (lhs.dense() && rhs.dense()) {
+		for (size_t word = 0; word < BITSET_WORDS; ++word) {
+			lhs.bitset[word] |= rhs.bitset[word];
+		}
+		lhs.update_size();
+		return;
+	}
+
+	if (lhs.dense()) {
+		for (auto it = rhs.array.begin(), end = rhs.array.end(); it != end; ++it) {
+			lhs.bitset[*it >> 6] |= 1ULL << (*it & 63);
+		}
+		lhs.update_size();
+		return;
+	}
+
+	std::vector<uint16_t> array;
+	array.reserve(lhs.array.size() + rhs.array.size());
+	std::set_union(lhs.array.begin(), lhs.array.end(),
+	               rhs.array.begin(), rhs.array.end(),
+	               std::back_inserter(array));
+	lhs.array.swap(array);
+	lhs.size = lhs.array.size();
+
+	if (lhs.size > ARRAY_MAX_SIZE)
+		lhs.to_bitset();
+}
+
+void roaring_bitmap::intersect(container &lhs, const container &rhs)
+{
+	if (lhs.dense() && rhs.dense()) {
+		for (size_t word = 0; word < BITSET_WORDS; ++word) {
+			lhs.bitset[word] &= rhs.bitset[word];
+		}
+		lhs.update_size();
+		lhs.to_array();
+		return;
+	}
+
+	std::vector<uint16_t> array;
+
+	if (lhs.dense()) { // the result isn't bigger than sparse rhs
+		for (auto it = rhs.array.begin(), end = rhs.array.end(); it != end; ++it) {
+			if (lhs.contains(*it))
+				array.push_back(*it);
+		}
+		std::vector<uint64_t>().swap(lhs.bitset);
+	} else if (rhs.dense()) {
+		for (auto it = lhs.array.begin(), end = lhs.array.end(); it != end; ++it) {
+			if (rhs.contains(*it))
+				array.push_back(*it);
+		}
+	} else {
+		std::set_intersection(lhs.array.begin(), lhs.array.end(),
+		                      rhs.array.begin(), rhs.array.end(),
+		                      std::back_inserter(array));
+	}
+
+	lhs.array.swap(array);
+	lhs.size = lhs.array.size();
+}
+
+void roaring_bitmap::subtract(container &lhs, const container &rhs)
+{
+	if (lhs.dense()) {
+		if (rhs.dense()) {
+			for (size_t word = 0; word < BITSET_WORDS; ++word) {
+				lhs.bitset[word] &= ~rhs.bitset[word];
+			}
+		} else {
+			for (auto it = rhs.array.begin(), end = rhs.array.end(); it != end; ++it) {
+				lhs.bitset[*it >> 6] &= ~(1ULL << (*it & 63));
+			}
+		}
+		lhs.update_size();
+		lhs.to_array();
+		return;
+	}
+
+	std::vector<uint16_t> array;
+	array.reserve(lhs.array.size());
+
+	if (rhs.dense()) {
+		for (auto it = lhs.array.begin(), end = lhs.array.end(); it != end; ++it) {
+			if (!rhs.contains(*it))
+				array.push_back(*it);
+		}
+	} else {
+		std::set_difference(lhs.array.begin(), lhs.array.end(),
+		                    rhs.array.begin(), rhs.array.end(),
+		                    std::back_inserter(array));
+	}
+
+	lhs.array.swap(array);
+	lhs.size = lhs.array.size();
+}
+
+} /* namespace history */
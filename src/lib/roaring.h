@@ -0,0 +1,85 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#ifndef HISTORY_SRC_LIB_ROARING_H
+#define HISTORY_SRC_LIB_ROARING_H
+
+#include <functional>
+#include <stdint.h>
+#include <vector>
+
+#include <elliptics/utils.hpp>
+
+namespace history {
+
+/* Compressed bitmap of 32-bit user ids.
+	Ids are split by the high 16 bits into containers. Sparse container keeps sorted array of the low 16 bits,
+	dense container (more than ARRAY_MAX_SIZE ids) keeps bitset of 1024 words, so operations over dense containers
+	are word loops which compiler vectorizes.
+*/
+class roaring_bitmap
+{
+public:
+	static const size_t ARRAY_MAX_SIZE = 4096; // maximum number of ids in sparse container
+	static const size_t BITSET_WORDS = 1024; // number of 64-bit words in dense container
+
+	bool add(uint32_t id); // returns true if the bitmap has been changed
+	bool contains(uint32_t id) const;
+
+	uint64_t cardinality() const;
+	bool empty() const { return containers_.empty(); }
+
+	bool merge(const roaring_bitmap &other); // unites with other bitmap, returns true if the bitmap has been changed
+	void intersect(const roaring_bitmap &other);
+	void subtract(const roaring_bitmap &other);
+
+	bool load(const ioremap::elliptics::data_pointer &data); // unites with serialized bitmap, returns false if data isn't valid bitmap
+	ioremap::elliptics::data_pointer save() const;
+
+	void for_each(std::function<void(uint32_t id)> callback) const; // calls callback for each id in ascending order
+
+private:
+	struct container
+	{
+		container(uint16_t key_) : key(key_), size(0) {}
+
+		bool dense() const { return !bitset.empty(); }
+		bool add(uint16_t low);
+		bool contains(uint16_t low) const;
+		void to_bitset();
+		void to_array(); // converts dense container with small size back to array
+		void update_size();
+
+		uint16_t				key; // the high 16 bits of ids
+		uint32_t				size; // number of ids in the container
+		std::vector<uint16_t>	array; // sorted low bits of ids, used by sparse container
+		std::vector<uint64_t>	bitset; // bits of ids, used by dense container
+	};
+
+	std::vector<container>::iterator find(uint16_t key);
+	std::vector<container>::const_iterator find(uint16_t key) const;
+
+	static void unite(container &lhs, const container &rhs);
+	static void intersect(container &lhs, const container &rhs);
+	static void subtract(container &lhs, const container &rhs);
+
+	std::vector<container>	containers_; // containers sorted by keys, empty containers are removed
+};
+
+} /* namespace history */
+
+#endif //HISTORY_SRC_LIB_ROARING_H
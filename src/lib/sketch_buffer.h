@@ -0,0 +1,145 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#ifndef HISTORY_SRC_LIB_SKETCH_BUFFER_H
+#define HISTORY_SRC_LIB_SKETCH_BUFFER_H
+
+#include <functional>
+#include <map>
+#include <string>
+
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/thread_time.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+namespace history {
+
+/* Buffers mergeable sketches of daily activity by subkeys.
+	Values are added to the local sketch of the subkey and buffered sketches are passed to write
+	every interval milliseconds, so storage merges one sketch per subkey instead of one per activity update.
+	Sketch should be default constructible and have add(value) and merge(const Sketch&) methods.
+*/
+template <class Sketch>
+class sketch_buffer
+{
+public:
+	typedef std::function<void(const std::string &subkey, const Sketch &sketch)> write_t;
+
+	sketch_buffer(write_t write, uint32_t interval)
+	: write_(write)
+	, interval_(interval)
+	, stop_(false)
+	{
+		thread_ = boost::thread(boost::bind(&sketch_buffer::run, this));
+	}
+
+	~sketch_buffer() // writes all buffered sketches
+	{
+		{
+			boost::mutex::scoped_lock lock(mutex_);
+			stop_ = true;
+		}
+		cond_.notify_all();
+		thread_.join();
+
+		flush(); // writes sketches which were changed while the thread was stopping
+	}
+
+	template <class Value>
+	void add(const std::string &subkey, const Value &value)
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		sketches_[subkey].add(value);
+	}
+
+	void merge(const std::string &subkey, const Sketch &sketch) // returns sketch which hasn't been written into the buffer
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		sketches_[subkey].merge(sketch);
+	}
+
+	bool pending(const std::string &subkey, Sketch &sketch) // merges buffered sketch of the subkey into sketch if it exists
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+
+		auto it = sketches_.find(subkey);
+		if (it == sketches_.end())
+			return false;
+
+		sketch.merge(it->second);
+		return true;
+	}
+
+	void flush() // writes all buffered sketches immediately
+	{
+		std::map<std::string, Sketch> ready;
+
+		{
+			boost::mutex::scoped_lock lock(mutex_);
+			std::swap(ready, sketches_);
+		}
+
+		write(ready);
+	}
+
+private:
+	sketch_buffer(const sketch_buffer&) = delete;
+	sketch_buffer& operator=(const sketch_buffer&) = delete;
+
+	void run() // flushing thread body
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+
+		while (!stop_) {
+			cond_.timed_wait(lock, boost::get_system_time() + interval_);
+
+			if (sketches_.empty())
+				continue;
+
+			std::map<std::string, Sketch> ready;
+			std::swap(ready, sketches_);
+
+			lock.unlock(); // writes sketches without blocking activity updates
+
+			write(ready);
+
+			lock.lock();
+		}
+	}
+
+	void write(std::map<std::string, Sketch> &ready)
+	{
+		for (auto it = ready.begin(), end = ready.end(); it != end; ++it) {
+			write_(it->first, it->second);
+		}
+	}
+
+	write_t							write_; // merges sketch into storage
+	boost::posix_time::milliseconds	interval_; // interval of writing of buffered sketches
+	bool							stop_;
+	std::map<std::string, Sketch>	sketches_; // buffered sketches by subkeys
+	boost::mutex					mutex_;
+	boost::condition_variable		cond_;
+	boost::thread					thread_;
+};
+
+} /* namespace history */
+
+#endif //HISTORY_SRC_LIB_SKETCH_BUFFER_H
@@ -0,0 +1,45 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#include "storage.h"
+
+namespace history {
+
+/* State of find_any_indexes which collects found objects
+*/
+struct find_gather
+{
+	find_result		result;
+	boost::mutex	mutex;
+};
+
+void storage::find_any_indexes(const std::vector<std::string> &indexes, find_handler_t handler)
+{
+	auto gather = std::make_shared<find_gather>();
+
+	find_any_indexes(indexes,
+	                 [gather] (const found_entry &entry) {
+	                     boost::mutex::scoped_lock lock(gather->mutex);
+	                     gather->result.entries.push_back(entry);
+	                 },
+	                 [gather, handler] (const storage_error &error) {
+	                     gather->result.error = error;
+	                     handler(gather->result);
+	                 });
+}
+
+} /* namespace history */
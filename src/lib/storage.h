@@ -0,0 +1,195 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#ifndef HISTORY_SRC_LIB_STORAGE_H
+#define HISTORY_SRC_LIB_STORAGE_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <elliptics/utils.hpp>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace history {
+
+/* Error of storage operation, code is 0 if the operation has succeeded
+*/
+struct storage_error
+{
+	storage_error() : code(0) {}
+	storage_error(int code_, const std::string &message_) : code(code_), message(message_) {}
+
+	explicit operator bool() const { return code != 0; }
+
+	int			code; // negative errno
+	std::string	message;
+};
+
+/* Result of write, append or index update
+*/
+struct write_result
+{
+	write_result() : written(0), size(0) {}
+
+	uint32_t		written; // number of groups to which the data has been written
+	uint64_t		size; // size of the object after the write, 0 if it is unknown
+	storage_error	error;
+};
+
+/* Result of read of one object
+*/
+struct read_result
+{
+	read_result() : total_size(0) {}
+
+	ioremap::elliptics::data_pointer	data; // read part of the object, it is valid only if there is no error
+	uint64_t							total_size; // size of the whole object, 0 if it is unknown
+	storage_error						error; // -ENOENT if the object doesn't exist
+};
+
+/* Index in which object has been found
+*/
+struct found_index
+{
+	std::string							name; // name of the index
+	ioremap::elliptics::data_pointer	data; // data which is kept with the object in the index
+};
+
+/* Object which has been found by find_any_indexes
+*/
+struct found_entry
+{
+	std::vector<found_index>	indexes; // requested indexes which contain the object
+};
+
+/* Result of find_any_indexes which collects all found objects
+*/
+struct find_result
+{
+	std::vector<found_entry>	entries;
+	storage_error				error;
+};
+
+/* Asynchronous key-value storage with secondary indexes which is used by provider.
+	All handlers are called exactly once, possibly from other threads.
+*/
+class storage
+{
+public:
+	typedef std::function<void(const write_result &res)> write_handler_t;
+	typedef std::function<void(const read_result &res)> read_handler_t;
+	typedef std::function<void(const std::vector<read_result> &res)> bulk_read_handler_t;
+	typedef std::function<void(const found_entry &entry)> entry_handler_t;
+	typedef std::function<void(const storage_error &error)> complete_handler_t;
+	typedef std::function<void(const find_result &res)> find_handler_t;
+	typedef std::function<ioremap::elliptics::data_pointer(const ioremap::elliptics::data_pointer &stored)> converter_t;
+
+	virtual ~storage() {}
+
+	virtual void set_groups(const std::vector<int> &groups) = 0;
+
+	/* Appends data to the object, the object is created if it doesn't exist
+	*/
+	virtual void append(const std::string &key,
+	                    const ioremap::elliptics::data_pointer &data,
+	                    write_handler_t handler) = 0;
+
+	/* Replaces the object by result of converter which accepts current data of the object.
+		Converter accepts empty data if the object doesn't exist.
+	*/
+	virtual void write_cas(const std::string &key, converter_t converter, write_handler_t handler) = 0;
+
+	/* Reads size bytes of the object from offset, 0 size reads the rest of the object
+	*/
+	virtual void read_latest(const std::string &key, uint64_t offset, uint64_t size, read_handler_t handler) = 0;
+
+	/* Reads several whole objects, handler accepts results in order of keys
+	*/
+	virtual void bulk_read(const std::vector<std::string> &keys, bulk_read_handler_t handler) = 0;
+
+	/* Adds the object to indexes, each index keeps the object with corresponding data
+	*/
+	virtual void update_indexes(const std::string &key,
+	                            const std::vector<std::string> &indexes,
+	                            const std::vector<ioremap::elliptics::data_pointer> &datas,
+	                            write_handler_t handler) = 0;
+
+	virtual void remove_indexes(const std::string &key,
+	                            const std::vector<std::string> &indexes,
+	                            write_handler_t handler) = 0;
+
+	/* Finds objects which are contained in any of indexes
+		on_entry - is called for each found object
+		on_complete - is called after all found objects, -ENOENT if no object has been found
+	*/
+	virtual void find_any_indexes(const std::vector<std::string> &indexes,
+	                              entry_handler_t on_entry,
+	                              complete_handler_t on_complete) = 0;
+
+	void find_any_indexes(const std::vector<std::string> &indexes, find_handler_t handler); // collects all found objects
+};
+
+/* Result of async operation which could be waited for. Copies share the same result.
+*/
+template <typename T>
+class pending_result
+{
+public:
+	pending_result()
+	: state_(std::make_shared<state>())
+	{}
+
+	std::function<void(const T &result)> handler() const // handler which should be passed to the operation
+	{
+		auto s = state_;
+		return [s] (const T &result) {
+			boost::mutex::scoped_lock lock(s->mutex);
+			s->result = result;
+			s->completed = true;
+			s->cond.notify_all();
+		};
+	}
+
+	const T &get() const // waits until the handler is called
+	{
+		boost::mutex::scoped_lock lock(state_->mutex);
+		while (!state_->completed)
+			state_->cond.wait(lock);
+		return state_->result;
+	}
+
+private:
+	struct state
+	{
+		state() : completed(false) {}
+
+		T							result;
+		bool						completed;
+		boost::mutex				mutex;
+		boost::condition_variable	cond;
+	};
+
+	std::shared_ptr<state>	state_;
+};
+
+} /* namespace history */
+
+#endif //HISTORY_SRC_LIB_STORAGE_H
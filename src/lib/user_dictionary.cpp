@@ -0,0 +1,310 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#include "user_dictionary.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+
+namespace history {
+
+namespace consts {
+	const char USER_ID_KEY[] = "historydb.user_id"; // counter of allocated ids
+	const char USER_ID_PREFIX[] = "historydb.user_id."; // prefix of key of user id
+	const char USER_NAMES_PREFIX[] = "historydb.user_names."; // prefix of key of block of user names
+	const uint32_t ID_RANGE = 256; // number of ids which are allocated by one update of the counter
+}
+
+struct user_dictionary::names_gather
+{
+	names_gather(const roaring_bitmap &ids_, size_t requests_,
+	             std::function<void(const user_list &users, bool completed)> callback_)
+	: ids(ids_)
+	, requests(requests_)
+	, failed(false)
+	, callback(callback_)
+	{}
+
+	const roaring_bitmap										ids; // ids whose names are gathered
+	size_t														requests; // number of block reads which are not completed yet
+	bool														failed; // whether some block couldn't be read
+	std::vector<std::string>									names; // names of found ids
+	std::function<void(const user_list &users, bool completed)>	callback; // result callback
+	boost::mutex												mutex;
+};
+
+user_dictionary::user_dictionary(std::shared_ptr<storage> s, size_t max_cached)
+: storage_(s)
+, max_cached_(max_cached)
+, next_(0)
+, end_(0)
+, allocating_(false)
+{}
+
+void user_dictionary::get_id(const std::string &user, id_callback_t callback)
+{
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+
+		auto it = ids_.find(user);
+		if (it != ids_.end()) {
+			lru_.splice(lru_.begin(), lru_, it->second); // moves the id to the most recently used
+			const uint32_t id = it->second->second;
+			lock.unlock();
+			callback(true, id);
+			return;
+		}
+	}
+
+	storage_->read_latest(consts::USER_ID_PREFIX + user, 0, 0,
+	                      boost::bind(&user_dictionary::on_id_read,
+	                                  shared_from_this(),
+	                                  user,
+	                                  callback,
+	                                  _1));
+}
+
+void user_dictionary::on_id_read(const std::string &user, id_callback_t callback, const read_result &res)
+{
+	if (!res.error && res.data.size() == sizeof(uint32_t)) {
+		uint32_t id;
+		memcpy(&id, res.data.data(), sizeof(id));
+		remember(user, id);
+		callback(true, id);
+		return;
+	}
+
+	if (res.error && res.error.code != -ENOENT) { // the user could have id which hasn't been read
+		callback(false, 0);
+		return;
+	}
+
+	allocate(boost::bind(&user_dictionary::on_allocated,
+	                     shared_from_this(),
+	                     user,
+	                     callback,
+	                     _1,
+	                     _2)); // the user hasn't id yet
+}
+
+void user_dictionary::allocate(id_callback_t callback)
+{
+	boost::mutex::scoped_lock lock(mutex_);
+
+	if (next_ < end_) {
+		const uint32_t id = next_++;
+		lock.unlock();
+		callback(true, id);
+		return;
+	}
+
+	waiters_.push_back(callback);
+	if (allocating_) // waits for the range which is being allocated
+		return;
+
+	allocating_ = true;
+	lock.unlock();
+
+	auto first = std::make_shared<uint32_t>(0);
+
+	storage_->write_cas(std::string(consts::USER_ID_KEY),
+	                    [first] (const ioremap::elliptics::data_pointer &stored) {
+	                        *first = 0;
+	                        if (stored.size() == sizeof(uint32_t))
+	                            memcpy(first.get(), stored.data(), sizeof(uint32_t));
+
+	                        const uint32_t next = *first + consts::ID_RANGE;
+	                        return ioremap::elliptics::data_pointer::copy(&next, sizeof(next));
+	                    },
+	                    boost::bind(&user_dictionary::on_range,
+	                                shared_from_this(),
+	                                first,
+	                                _1));
+}
+
+void user_dictionary::on_range(std::shared_ptr<uint32_t> first, const write_result &res)
+{
+	std::vector<id_callback_t> waiters;
+
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+
+		allocating_ = false;
+		waiters.swap(waiters_);
+
+		if (!res.error) {
+			next_ = *first;
+			end_ = *first + consts::ID_RANGE;
+		}
+	}
+
+	for (auto it = waiters.begin(), end = waiters.end(); it != end; ++it) {
+		if (res.error)
+			(*it)(false, 0);
+		else
+			allocate(*it); // waiters which don't fit into the range request the next one
+	}
+}
+
+void user_dictionary::on_allocated(const std::string &user, id_callback_t callback, bool allocated, uint32_t id)
+{
+	if (!allocated) {
+		callback(false, 0);
+		return;
+	}
+
+	const uint16_t size = std::min<size_t>(user.size(), UINT16_MAX);
+	auto entry = ioremap::elliptics::data_pointer::allocate(sizeof(id) + sizeof(size) + size);
+	memcpy(entry.data<char>(), &id, sizeof(id));
+	memcpy(entry.data<char>() + sizeof(id), &size, sizeof(size));
+	memcpy(entry.data<char>() + sizeof(id) + sizeof(size), user.data(), size);
+
+	// the name is written before the id, so each id which could be used in bitmaps has name
+	storage_->append(consts::USER_NAMES_PREFIX + boost::lexical_cast<std::string>(id >> 16), entry,
+	                 boost::bind(&user_dictionary::on_name_written,
+	                             shared_from_this(),
+	                             user,
+	                             callback,
+	                             id,
+	                             _1));
+}
+
+void user_dictionary::on_name_written(const std::string &user, id_callback_t callback, uint32_t id, const write_result &res)
+{
+	if (res.error) {
+		callback(false, 0);
+		return;
+	}
+
+	auto chosen = std::make_shared<uint32_t>(id);
+
+	storage_->write_cas(consts::USER_ID_PREFIX + user,
+	                    [id, chosen] (const ioremap::elliptics::data_pointer &stored) {
+	                        if (stored.size() == sizeof(uint32_t)) { // id has been allocated by another provider
+	                            memcpy(chosen.get(), stored.data(), sizeof(uint32_t));
+	                            return ioremap::elliptics::data_pointer::copy(stored.data(), stored.size());
+	                        }
+
+	                        *chosen = id;
+	                        return ioremap::elliptics::data_pointer::copy(&id, sizeof(id));
+	                    },
+	                    boost::bind(&user_dictionary::on_id_written,
+	                                shared_from_this(),
+	                                user,
+	                                callback,
+	                                chosen,
+	                                _1));
+}
+
+void user_dictionary::on_id_written(const std::string &user, id_callback_t callback, std::shared_ptr<uint32_t> chosen,
+                                    const write_result &res)
+{
+	if (res.error) {
+		callback(false, 0);
+		return;
+	}
+
+	remember(user, *chosen);
+	callback(true, *chosen);
+}
+
+void user_dictionary::get_names(const roaring_bitmap &ids, std::function<void(const user_list &users, bool completed)> callback)
+{
+	std::vector<uint32_t> blocks; // blocks of names which contain ids, ids are iterated in ascending order
+	ids.for_each([&blocks] (uint32_t id) {
+		if (blocks.empty() || blocks.back() != (id >> 16))
+			blocks.push_back(id >> 16);
+	});
+
+	if (blocks.empty()) {
+		callback(user_list(), true);
+		return;
+	}
+
+	auto gather = std::make_shared<names_gather>(ids, blocks.size(), callback);
+
+	for (auto it = blocks.begin(), end = blocks.end(); it != end; ++it) {
+		storage_->read_latest(consts::USER_NAMES_PREFIX + boost::lexical_cast<std::string>(*it), 0, 0,
+		                      boost::bind(&user_dictionary::on_names_read,
+		                                  gather,
+		                                  _1));
+	}
+}
+
+void user_dictionary::on_names_read(std::shared_ptr<names_gather> gather, const read_result &res)
+{
+	{
+		boost::mutex::scoped_lock lock(gather->mutex);
+
+		if (!res.error) {
+			const char *pos = res.data.data<char>();
+			const char *end = pos + res.data.size();
+
+			uint32_t id;
+			uint16_t size;
+			while (static_cast<size_t>(end - pos) >= sizeof(id) + sizeof(size)) {
+				memcpy(&id, pos, sizeof(id));
+				memcpy(&size, pos + sizeof(id), sizeof(size));
+				pos += sizeof(id) + sizeof(size);
+
+				if (static_cast<size_t>(end - pos) < size) // incomplete entry of failed append
+					break;
+
+				if (gather->ids.contains(id))
+					gather->names.emplace_back(pos, size);
+				pos += size;
+			}
+		}
+		else if (res.error.code != -ENOENT) // names of the block's ids would be missed in the result
+			gather->failed = true;
+
+		if (--gather->requests != 0)
+			return;
+	}
+
+	if (gather->failed) {
+		gather->callback(user_list(), false);
+		return;
+	}
+
+	gather->callback(user_list(gather->names), true); // sorts names and removes names of repeated appends
+}
+
+void user_dictionary::remember(const std::string &user, uint32_t id)
+{
+	boost::mutex::scoped_lock lock(mutex_);
+
+	auto it = ids_.find(user);
+	if (it != ids_.end()) {
+		it->second->second = id;
+		lru_.splice(lru_.begin(), lru_, it->second);
+		return;
+	}
+
+	lru_.push_front(std::make_pair(user, id));
+	ids_.insert(std::make_pair(user, lru_.begin()));
+
+	while (ids_.size() > max_cached_) {
+		ids_.erase(lru_.back().first);
+		lru_.pop_back();
+	}
+}
+
+} /* namespace history */
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#ifndef HISTORY_SRC_LIB_USER_DICTIONARY_H
+#define HISTORY_SRC_LIB_USER_DICTIONARY_H
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+
+#include "historydb/user_list.h"
+#include "roaring.h"
+#include "storage.h"
+
+namespace history {
+
+/* Persistent dictionary which maps user names to dense 32-bit ids.
+	Id of user is kept in key "historydb.user_id." + user, ids are allocated by ranges from counter key "historydb.user_id"
+	by compare-and-swap, so concurrent providers don't allocate the same id. Names of ids are appended
+	to blocks "historydb.user_names." + (id >> 16), one block per container of roaring bitmap.
+*/
+class user_dictionary : public std::enable_shared_from_this<user_dictionary>
+{
+public:
+	typedef std::function<void(bool found, uint32_t id)> id_callback_t;
+
+	/* Creates dictionary
+		s - storage which keeps the dictionary
+		max_cached - maximum number of cached ids, the least recently used ids are evicted when it is exceeded
+	*/
+	user_dictionary(std::shared_ptr<storage> s, size_t max_cached);
+
+	/* Gets id of the user, allocates new id if the user hasn't id yet
+		user - name of user
+		callback - result callback, found is false if id couldn't be read or allocated
+	*/
+	void get_id(const std::string &user, id_callback_t callback);
+
+	/* Gets names of ids
+		ids - ids of users
+		callback - result callback which accepts sorted names of ids which have names,
+			completed is false if some block of names couldn't be read
+	*/
+	void get_names(const roaring_bitmap &ids, std::function<void(const user_list &users, bool completed)> callback);
+
+private:
+	user_dictionary(const user_dictionary&) = delete;
+	user_dictionary& operator=(const user_dictionary&) = delete;
+
+	struct names_gather;
+
+	void on_id_read(const std::string &user, id_callback_t callback, const read_result &res);
+	void allocate(id_callback_t callback);
+	void on_range(std::shared_ptr<uint32_t> first, const write_result &res);
+	void on_allocated(const std::string &user, id_callback_t callback, bool allocated, uint32_t id);
+	void on_name_written(const std::string &user, id_callback_t callback, uint32_t id, const write_result &res);
+	void on_id_written(const std::string &user, id_callback_t callback, std::shared_ptr<uint32_t> chosen,
+	                   const write_result &res);
+	static void on_names_read(std::shared_ptr<names_gather> gather, const read_result &res);
+
+	void remember(const std::string &user, uint32_t id);
+
+	typedef std::list<std::pair<std::string, uint32_t>> lru_t;
+
+	const std::shared_ptr<storage>							storage_; // storage which keeps the dictionary
+	const size_t											max_cached_; // maximum number of cached ids
+	lru_t													lru_; // cached ids of users from the most recently used
+	std::unordered_map<std::string, lru_t::iterator>		ids_; // positions of cached ids in lru_ by users
+	uint32_t												next_; // next id of allocated range
+	uint32_t												end_; // end of allocated range
+	bool													allocating_; // whether new range is being allocated
+	std::vector<id_callback_t>								waiters_; // allocations which wait for new range
+	boost::mutex											mutex_;
+};
+
+} /* namespace history */
+
+#endif //HISTORY_SRC_LIB_USER_DICTIONARY_H
@@ -0,0 +1,179 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include "historydb/user_list.h"
+
+#include <algorithm>
+#include <queue>
+
+#include <string.h>
+
+namespace history {
+
+user_list::user_list()
+: offsets_(1, 0)
+{}
+
+user_list::user_list(std::vector<std::string> &users)
+{
+	std::sort(users.begin(), users.end());
+	users.erase(std::unique(users.begin(), users.end()), users.end());
+
+	size_t total = 0;
+	for (auto it = users.begin(), end = users.end(); it != end; ++it) {
+		total += it->size();
+	}
+
+	arena_.reserve(total);
+	offsets_.reserve(users.size() + 1);
+
+	offsets_.push_back(0);
+	for (auto it = users.begin(), end = users.end(); it != end; ++it) {
+		push_back(it->data(), it->size());
+	}
+}
+
+user_list user_list::merge(const std::vector<std::shared_ptr<const user_list>> &lists)
+{
+	typedef std::pair<size_t, size_t> cursor_t; // index of the list and index of the user in the list
+
+	auto greater = [&lists] (const cursor_t &lhs, const cursor_t &rhs) {
+		const auto &list = *lists[rhs.first];
+		return lists[lhs.first]->compare(lhs.second, list.data(rhs.second), list.length(rhs.second)) > 0;
+	};
+	std::priority_queue<cursor_t, std::vector<cursor_t>, decltype(greater)> heap(greater); // the smallest user is on the top
+
+	user_list ret;
+	size_t total_size = 0, total_users = 0;
+
+	for (size_t index = 0; index < lists.size(); ++index) {
+		total_size += lists[index]->arena_.size();
+		total_users += lists[index]->size();
+		if (!lists[index]->empty())
+			heap.push(cursor_t(index, 0));
+	}
+
+	ret.arena_.reserve(total_size);
+	ret.offsets_.reserve(total_users + 1);
+
+	while (!heap.empty()) {
+		auto top = heap.top();
+		heap.pop();
+
+		const auto &list = *lists[top.first];
+		const char *user = list.data(top.second);
+		const size_t size = list.length(top.second);
+
+		if (ret.empty() || ret.compare(ret.size() - 1, user, size) != 0) // users come in sorted order, so duplicates are adjacent
+			ret.push_back(user, size);
+
+		if (++top.second < list.size())
+			heap.push(top);
+	}
+
+	ret.arena_.shrink_to_fit();
+	ret.offsets_.shrink_to_fit();
+
+	return ret;
+}
+
+user_list user_list::intersect(const user_list &lhs, const user_list &rhs)
+{
+	user_list ret;
+	ret.arena_.reserve(std::min(lhs.arena_.size(), rhs.arena_.size()));
+	ret.offsets_.reserve(std::min(lhs.size(), rhs.size()) + 1);
+
+	for (size_t left = 0, right = 0; left < lhs.size() && right < rhs.size();) {
+		const int res = lhs.compare(left, rhs.data(right), rhs.length(right));
+		if (res < 0)
+			++left;
+		else if (res > 0)
+			++right;
+		else {
+			ret.push_back(lhs.data(left), lhs.length(left));
+			++left;
+			++right;
+		}
+	}
+
+	ret.arena_.shrink_to_fit();
+	ret.offsets_.shrink_to_fit();
+
+	return ret;
+}
+
+user_list user_list::subtract(const user_list &lhs, const user_list &rhs)
+{
+	user_list ret;
+	ret.arena_.reserve(lhs.arena_.size());
+	ret.offsets_.reserve(lhs.size() + 1);
+
+	size_t right = 0;
+	for (size_t left = 0; left < lhs.size(); ++left) {
+		int res = 1;
+		while (right < rhs.size() && (res = lhs.compare(left, rhs.data(right), rhs.length(right))) > 0) {
+			++right; // skips users of rhs which are less than current user of lhs
+		}
+
+		if (right == rhs.size() || res < 0)
+			ret.push_back(lhs.data(left), lhs.length(left));
+	}
+
+	ret.arena_.shrink_to_fit();
+	ret.offsets_.shrink_to_fit();
+
+	return ret;
+}
+
+bool user_list::contains(const std::string &user) const
+{
+	size_t begin = 0, end = size();
+
+	while (begin < end) {
+		const size_t middle = begin + (end - begin) / 2;
+		const int res = compare(middle, user.data(), user.size());
+		if (res == 0)
+			return true;
+		else if (res < 0)
+			begin = middle + 1;
+		else
+			end = middle;
+	}
+
+	return false;
+}
+
+size_t user_list::memory() const
+{
+	return sizeof(*this) + arena_.capacity() + offsets_.capacity() * sizeof(uint64_t);
+}
+
+int user_list::compare(size_t index, const char *user, size_t size) const
+{
+	const size_t own_size = length(index);
+	const int res = memcmp(data(index), user, std::min(own_size, size)); // the same order as std::string has
+	if (res != 0)
+		return res;
+	return own_size < size ? -1 : (own_size > size ? 1 : 0);
+}
+
+void user_list::push_back(const char *user, size_t size)
+{
+	arena_.insert(arena_.end(), user, user + size);
+	offsets_.push_back(arena_.size());
+}
+
+} /* namespace history */
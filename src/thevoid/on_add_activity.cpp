@@ -66,17 +66,17 @@ void on_add_activity::on_request(const ioremap::swarm::http_request &req,
 			throw std::invalid_argument("key and time are missed");
 	}
 	catch(ioremap::elliptics::error& e) {
-		get_reply()->send_error(ioremap::swarm::http_response::internal_server_error);
+		reply_error(ioremap::swarm::http_response::internal_server_error);
 	}
 	catch(...) {
-		get_reply()->send_error(ioremap::swarm::http_response::bad_request);
+		reply_error(ioremap::swarm::http_response::bad_request);
 	}
 }
 
 void on_add_activity::on_finished(bool added)
 {
 	if(!added)
-		get_reply()->send_error(ioremap::swarm::http_response::internal_server_error);
+		reply_error(ioremap::swarm::http_response::internal_server_error);
 	else
 		get_reply()->send_error(ioremap::swarm::http_response::ok);
 }
@@ -22,7 +22,7 @@
 namespace history {
 
 	struct on_add_activity :
-		public ioremap::thevoid::simple_request_stream<webserver>,
+		public measured_request_stream,
 		public std::enable_shared_from_this<on_add_activity>
 	{
 		virtual void on_request(const ioremap::swarm::http_request &req,
@@ -72,17 +72,17 @@ void on_add_log_with_activity::on_request(const ioremap::swarm::http_request &/*
 			throw std::invalid_argument("Key and time are missed");
 	}
 	catch(ioremap::elliptics::error&) {
-		get_reply()->send_error(ioremap::swarm::http_response::internal_server_error);
+		reply_error(ioremap::swarm::http_response::internal_server_error);
 	}
 	catch(...) {
-		get_reply()->send_error(ioremap::swarm::http_response::bad_request);
+		reply_error(ioremap::swarm::http_response::bad_request);
 	}
 }
 
 void on_add_log_with_activity::on_finish(bool added)
 {
 	if(!added)
-		get_reply()->send_error(ioremap::swarm::http_response::internal_server_error);
+		reply_error(ioremap::swarm::http_response::internal_server_error);
 	else
 		get_reply()->send_error(ioremap::swarm::http_response::ok);
 }
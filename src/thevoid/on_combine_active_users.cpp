@@ -0,0 +1,169 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#include "on_combine_active_users.h"
+
+#include <swarm/url.hpp>
+#include <swarm/url_query.hpp>
+
+#include <historydb/provider.h>
+#include <elliptics/error.hpp>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/algorithm/string.hpp>
+
+#include "../fastcgi/rapidjson/document.h"
+#include "../fastcgi/rapidjson/writer.h"
+#include "../fastcgi/rapidjson/stringbuffer.h"
+
+namespace history {
+
+namespace consts {
+const char OP_ITEM[] = "op";
+const char KEYS_ITEM[] = "keys";
+const char PERIODS_ITEM[] = "periods";
+const char ENGINE_ITEM[] = "engine";
+}
+
+set_operation parse_operation(const std::string &op)
+{
+	if (op == "union")
+		return set_operation::unite;
+	else if (op == "intersect")
+		return set_operation::intersect;
+	else if (op == "diff")
+		return set_operation::subtract;
+
+	throw std::invalid_argument("unknown operation: " + op);
+}
+
+void on_combine_active_users::on_request(const ioremap::swarm::http_request &req,
+                                         const boost::asio::const_buffer &/*buffer*/)
+{
+	try {
+		const auto &query = req.url().query();
+
+		auto op_item = query.item_value(consts::OP_ITEM);
+		if (!op_item)
+			throw std::invalid_argument("operation is missed");
+
+		const auto op = parse_operation(*op_item);
+
+		bool bitmap = false; // whether operands are combined by activity bitmaps instead of the index
+		if (auto engine_item = query.item_value(consts::ENGINE_ITEM)) {
+			if (*engine_item == "bitmap")
+				bitmap = true;
+			else if (*engine_item != "index")
+				throw std::invalid_argument("unknown engine: " + *engine_item);
+		}
+
+		auto provider = server()->get_provider();
+		auto callback = std::bind(&on_combine_active_users::on_finished,
+		                          shared_from_this(),
+		                          std::placeholders::_1,
+		                          std::placeholders::_2);
+
+		std::vector<std::string> operands; // operands are separated by ';', subkeys or begin and end time of operand by ':'
+
+		if (auto keys_item = query.item_value(consts::KEYS_ITEM)) {
+			boost::split(operands, *keys_item, boost::is_any_of(";"));
+
+			std::vector<std::vector<std::string>> keys(operands.size());
+			for (size_t index = 0; index < operands.size(); ++index) {
+				boost::split(keys[index], operands[index], boost::is_any_of(":"));
+			}
+
+			if (bitmap)
+				provider->combine_activity_bitmaps(op, keys, callback);
+			else
+				provider->combine_active_users(op, keys, callback);
+		} else if (auto periods_item = query.item_value(consts::PERIODS_ITEM)) {
+			boost::split(operands, *periods_item, boost::is_any_of(";"));
+
+			std::vector<std::pair<uint64_t, uint64_t>> periods;
+			periods.reserve(operands.size());
+			for (auto it = operands.begin(), end = operands.end(); it != end; ++it) {
+				std::vector<std::string> times;
+				boost::split(times, *it, boost::is_any_of(":"));
+				if (times.size() != 2)
+					throw std::invalid_argument("invalid period: " + *it);
+
+				periods.emplace_back(boost::lexical_cast<uint64_t>(times[0]),
+				                     boost::lexical_cast<uint64_t>(times[1]));
+			}
+
+			if (bitmap)
+				provider->combine_activity_bitmaps(op, periods, callback);
+			else
+				provider->combine_active_users(op, periods, callback);
+		}
+		else
+			throw std::invalid_argument("keys and periods are missed");
+	}
+	catch(ioremap::elliptics::error& e) {
+		reply_error(ioremap::swarm::http_response::internal_server_error);
+	}
+	catch(...) {
+		reply_error(ioremap::swarm::http_response::bad_request);
+	}
+}
+
+void on_combine_active_users::on_finished(const user_list& active_users, bool completed)
+{
+	if (!completed) {
+		reply_error(ioremap::swarm::http_response::internal_server_error);
+		return;
+	}
+
+	rapidjson::Document d; // creates document for json serialization
+	d.SetObject();
+
+	rapidjson::Value ausers(rapidjson::kArrayType);
+
+	for (size_t index = 0; index < active_users.size(); ++index) { // adds all users of the result to json
+		rapidjson::Value user(active_users.data(index), active_users.length(index), d.GetAllocator());
+		ausers.PushBack(user, d.GetAllocator());
+	}
+
+	d.AddMember("active_users", ausers, d.GetAllocator());
+
+	rapidjson::StringBuffer buffer; // creates string buffer for serialized json
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer); // creates json writer
+	d.Accept(writer); // accepts writer by json document
+
+	const std::string result_str = buffer.GetString();
+
+	ioremap::swarm::http_response reply;
+	reply.set_code(ioremap::swarm::http_response::ok);
+
+	auto &headers = reply.headers();
+	headers.set_content_length(result_str.size());
+	headers.set_content_type("text/json");
+
+	get_reply()->send_headers(std::move(reply),
+	                          boost::asio::buffer(result_str),
+	                          std::bind(&on_combine_active_users::on_send_finished,
+	                                    shared_from_this(),
+	                                    result_str));
+}
+
+void on_combine_active_users::on_send_finished(const std::string &)
+{
+	get_reply()->close(boost::system::error_code());
+}
+
+} /* namespace history */
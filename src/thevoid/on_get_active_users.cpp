@@ -26,7 +26,6 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/algorithm/string.hpp>
 
-#include "../fastcgi/rapidjson/document.h"
 #include "../fastcgi/rapidjson/writer.h"
 #include "../fastcgi/rapidjson/stringbuffer.h"
 
@@ -36,6 +35,8 @@ namespace consts {
 const char BEGIN_TIME_ITEM[] = "begin_time";
 const char END_TIME_ITEM[] = "end_time";
 const char KEYS_ITEM[] = "keys";
+const char LIMIT_ITEM[] = "limit";
+const char CURSOR_ITEM[] = "cursor";
 }
 
 void on_get_active_users::on_request(const ioremap::swarm::http_request &req,
@@ -46,50 +47,112 @@ void on_get_active_users::on_request(const ioremap::swarm::http_request &req,
 
 		auto begin_time = query.item_value(consts::BEGIN_TIME_ITEM);
 		auto end_time = query.item_value(consts::END_TIME_ITEM);
-
-		if (auto keys_item = query.item_value(consts::KEYS_ITEM)) {
+		auto limit = query.item_value(consts::LIMIT_ITEM);
+		auto cursor = query.item_value(consts::CURSOR_ITEM);
+
+		if (limit || cursor) { // paginated request
+			const size_t limit_value = limit ? boost::lexical_cast<size_t>(*limit) : 0;
+			const std::string cursor_value = cursor ? *cursor : std::string();
+			auto callback = std::bind(&on_get_active_users::on_page,
+			                          shared_from_this(),
+			                          std::placeholders::_1,
+			                          std::placeholders::_2);
+
+			if (auto keys_item = query.item_value(consts::KEYS_ITEM)) {
+				std::vector<std::string> keys;
+				boost::split(keys, *keys_item, boost::is_any_of(":"));
+				server()
+				->get_provider()
+				->get_active_users(keys, limit_value, cursor_value, callback);
+			} else if (begin_time and end_time) {
+				server()
+				->get_provider()
+				->get_active_users(boost::lexical_cast<uint64_t>(*begin_time),
+				                   boost::lexical_cast<uint64_t>(*end_time),
+				                   limit_value, cursor_value, callback);
+			}
+			else
+				throw std::invalid_argument("key and time are missed");
+		} else if (auto keys_item = query.item_value(consts::KEYS_ITEM)) {
 			std::vector<std::string> keys;
 			boost::split(keys, *keys_item, boost::is_any_of(":"));
 			server()
 			->get_provider()
-			->get_active_users(keys,
-			                   std::bind(&on_get_active_users::on_finished,
-			                             shared_from_this(),
-			                             std::placeholders::_1));
+			->get_active_users_list(keys,
+			                        std::bind(&on_get_active_users::on_finished,
+			                                  shared_from_this(),
+			                                  std::placeholders::_1,
+			                                  std::placeholders::_2));
 		} else if (begin_time and end_time) {
 			server()
 			->get_provider()
-			->get_active_users(boost::lexical_cast<uint64_t>(*begin_time),
-			                   boost::lexical_cast<uint64_t>(*end_time),
-			                   std::bind(&on_get_active_users::on_finished,
-			                             shared_from_this(),
-			                             std::placeholders::_1));
+			->get_active_users_list(boost::lexical_cast<uint64_t>(*begin_time),
+			                        boost::lexical_cast<uint64_t>(*end_time),
+			                        std::bind(&on_get_active_users::on_finished,
+			                                  shared_from_this(),
+			                                  std::placeholders::_1,
+			                                  std::placeholders::_2));
 		}
 		else
 			throw std::invalid_argument("key and time are missed");
 	}
 	catch(ioremap::elliptics::error& e) {
-		get_reply()->send_error(ioremap::swarm::http_response::internal_server_error);
+		reply_error(ioremap::swarm::http_response::internal_server_error);
 	}
 	catch(...) {
-		get_reply()->send_error(ioremap::swarm::http_response::bad_request);
+		reply_error(ioremap::swarm::http_response::bad_request);
+	}
+}
+
+void on_get_active_users::on_finished(const user_list& active_users, bool completed)
+{
+	if (!completed) {
+		reply_error(ioremap::swarm::http_response::internal_server_error);
+		return;
+	}
+
+	rapidjson::Document d; // creates document for json serialization
+	d.SetObject();
+
+	rapidjson::Value ausers(rapidjson::kArrayType);
+
+	for (size_t index = 0; index < active_users.size(); ++index) { // adds all active user with counters to json
+		rapidjson::Value user(active_users.data(index), active_users.length(index), d.GetAllocator());
+		ausers.PushBack(user, d.GetAllocator());
 	}
+
+	d.AddMember("active_users", ausers, d.GetAllocator());
+
+	send_json(d);
 }
 
-void on_get_active_users::on_finished(const std::set<std::string>& active_users)
+void on_get_active_users::on_page(const active_users_page& page, bool completed)
 {
+	if (!completed) {
+		reply_error(ioremap::swarm::http_response::internal_server_error);
+		return;
+	}
+
 	rapidjson::Document d; // creates document for json serialization
 	d.SetObject();
 
 	rapidjson::Value ausers(rapidjson::kArrayType);
 
-	for (auto it = active_users.begin(), itEnd = active_users.end(); it != itEnd; ++it) { // adds all active user with counters to json
+	for (auto it = page.users.begin(), itEnd = page.users.end(); it != itEnd; ++it) {
 		rapidjson::Value user(it->c_str(), it->size(), d.GetAllocator());
 		ausers.PushBack(user, d.GetAllocator());
 	}
 
 	d.AddMember("active_users", ausers, d.GetAllocator());
 
+	rapidjson::Value next_cursor(page.next_cursor.c_str(), page.next_cursor.size(), d.GetAllocator());
+	d.AddMember("next_cursor", next_cursor, d.GetAllocator()); // adds cursor of the next page, empty if there is no more users
+
+	send_json(d);
+}
+
+void on_get_active_users::send_json(rapidjson::Document& d)
+{
 	rapidjson::StringBuffer buffer; // creates string buffer for serialized json
 	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer); // creates json writer
 	d.Accept(writer); // accepts writer by json document
@@ -19,17 +19,21 @@
 
 #include "webserver.h"
 
-#include <set>
+#include <historydb/provider.h>
+
+#include "../fastcgi/rapidjson/document.h"
 
 namespace history {
 
 	struct on_get_active_users :
-		public ioremap::thevoid::simple_request_stream<webserver>,
+		public measured_request_stream,
 		public std::enable_shared_from_this<on_get_active_users>
 	{
 		virtual void on_request(const ioremap::swarm::http_request &req,
 		                        const boost::asio::const_buffer &buffer);
-		void on_finished(const std::set<std::string>& active_users);
+		void on_finished(const user_list& active_users, bool completed);
+		void on_page(const active_users_page& page, bool completed);
+		void send_json(rapidjson::Document& d);
 		void on_send_finished(const std::string &);
 	};
 
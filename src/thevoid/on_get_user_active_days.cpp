@@ -0,0 +1,95 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#include "on_get_user_active_days.h"
+
+#include <swarm/url.hpp>
+#include <swarm/url_query.hpp>
+
+#include <historydb/provider.h>
+#include <elliptics/error.hpp>
+
+#include <boost/lexical_cast.hpp>
+
+namespace history {
+
+namespace consts {
+const char USER_ITEM[] = "user";
+const char BEGIN_TIME_ITEM[] = "begin_time";
+const char END_TIME_ITEM[] = "end_time";
+}
+
+void on_get_user_active_days::on_request(const ioremap::swarm::http_request &req,
+                                         const boost::asio::const_buffer &/*buffer*/)
+{
+	try {
+		const auto &query = req.url().query();
+
+		auto user = query.item_value(consts::USER_ITEM);
+		auto begin_time = query.item_value(consts::BEGIN_TIME_ITEM);
+		auto end_time = query.item_value(consts::END_TIME_ITEM);
+
+		if (!user || !begin_time || !end_time)
+			throw std::invalid_argument("user or time is missed");
+
+		server()
+		->get_provider()
+		->get_user_active_days(*user,
+		                       boost::lexical_cast<uint64_t>(*begin_time),
+		                       boost::lexical_cast<uint64_t>(*end_time),
+		                       std::bind(&on_get_user_active_days::on_finished,
+		                                 shared_from_this(),
+		                                 std::placeholders::_1));
+	}
+	catch(ioremap::elliptics::error& e) {
+		reply_error(ioremap::swarm::http_response::internal_server_error);
+	}
+	catch(...) {
+		reply_error(ioremap::swarm::http_response::bad_request);
+	}
+}
+
+void on_get_user_active_days::on_finished(const std::vector<uint64_t> &days)
+{
+	std::string result_str = "{\"days\":[";
+	for (auto it = days.begin(), end = days.end(); it != end; ++it) {
+		if (it != days.begin())
+			result_str += ',';
+		result_str += boost::lexical_cast<std::string>(*it);
+	}
+	result_str += "]}";
+
+	ioremap::swarm::http_response reply;
+	reply.set_code(ioremap::swarm::http_response::ok);
+
+	auto &headers = reply.headers();
+	headers.set_content_length(result_str.size());
+	headers.set_content_type("text/json");
+
+	get_reply()->send_headers(std::move(reply),
+	                          boost::asio::buffer(result_str),
+	                          std::bind(&on_get_user_active_days::on_send_finished,
+	                                    shared_from_this(),
+	                                    result_str));
+}
+
+void on_get_user_active_days::on_send_finished(const std::string &)
+{
+	get_reply()->close(boost::system::error_code());
+}
+
+} /* namespace history */
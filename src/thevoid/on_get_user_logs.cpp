@@ -26,9 +26,8 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/algorithm/string.hpp>
 
-#include "../fastcgi/rapidjson/document.h"
-#include "../fastcgi/rapidjson/writer.h"
-#include "../fastcgi/rapidjson/stringbuffer.h"
+#include <stdio.h>
+#include <string.h>
 
 namespace history {
 
@@ -37,8 +36,26 @@ const char USER_ITEM[] = "user";
 const char BEGIN_TIME_ITEM[] = "begin_time";
 const char END_TIME_ITEM[] = "end_time";
 const char KEYS_ITEM[] = "keys";
+const char LIMIT_ITEM[] = "limit";
+const char CURSOR_ITEM[] = "cursor";
+const size_t CHUNK_SIZE = 64 * 1024; // maximum size of json in one chunk of the response
+const size_t CHUNK_HEADER_SIZE = 8; // maximum size of chunk size line: hex size and CRLF
+const size_t CHUNK_TRAILER_SIZE = 2 + 5; // CRLF after the chunk data and the last chunk
+const size_t MAX_ESCAPED_SIZE = 128; // free space which is enough for any escaped character or json delimiters with next cursor
+const uint64_t PAGE_SIZE = 1024 * 1024; // maximum size of logs which are read at once for request without limit
 }
 
+on_get_user_logs::on_get_user_logs()
+: log_index_(0)
+, log_offset_(0)
+, sent_logs_(0)
+, stage_(json_prefix)
+, buffer_(consts::CHUNK_HEADER_SIZE + consts::CHUNK_SIZE + consts::CHUNK_TRAILER_SIZE)
+, paginated_(false)
+, streamed_(false)
+, headers_sent_(false)
+{}
+
 void on_get_user_logs::on_request(const ioremap::swarm::http_request &req, const boost::asio::const_buffer &/*buffer*/)
 {
 	try {
@@ -51,74 +68,107 @@ void on_get_user_logs::on_request(const ioremap::swarm::http_request &req, const
 		auto begin_time = query.item_value(consts::BEGIN_TIME_ITEM);
 		auto end_time = query.item_value(consts::END_TIME_ITEM);
 
+		auto limit = query.item_value(consts::LIMIT_ITEM);
+		auto cursor = query.item_value(consts::CURSOR_ITEM);
+
+		paginated_ = limit || cursor;
+		streamed_ = !limit; // without limit all logs are returned, so they are read page by page while the response is sent
+		next_cursor_ = cursor ? *cursor : std::string();
+
+		const uint64_t max_bytes = limit ? boost::lexical_cast<uint64_t>(*limit) : consts::PAGE_SIZE;
+		const std::string user = *user_item;
+		auto provider = server()->get_provider();
+
 		if (auto keys_item = query.item_value(consts::KEYS_ITEM)) {
 			std::vector<std::string> keys;
 			boost::split(keys, *keys_item, boost::is_any_of(":"));
-			server()
-			->get_provider()
-			->get_user_logs(*user_item,
-			                keys,
-			                std::bind(&on_get_user_logs::on_finished,
-			                          shared_from_this(),
-			                          std::placeholders::_1));
-		} else if(begin_time && end_time) {
-			server()
-			->get_provider()
-			->get_user_logs(*user_item,
-			                boost::lexical_cast<uint64_t>(*begin_time),
-			                boost::lexical_cast<uint64_t>(*end_time),
-			                std::bind(&on_get_user_logs::on_finished,
-			                          shared_from_this(),
-			                          std::placeholders::_1));
+			read_page_ = [provider, user, keys, max_bytes] (const std::string &cursor, page_callback callback) {
+				provider->get_user_logs(user, keys, max_bytes, cursor, callback);
+			};
+		} else if (begin_time && end_time) {
+			const auto begin_value = boost::lexical_cast<uint64_t>(*begin_time);
+			const auto end_value = boost::lexical_cast<uint64_t>(*end_time);
+			read_page_ = [provider, user, begin_value, end_value, max_bytes] (const std::string &cursor, page_callback callback) {
+				provider->get_user_logs(user, begin_value, end_value, max_bytes, cursor, callback);
+			};
 		}
 		else
 			throw std::invalid_argument("something is missed");
 
+		read_next_page();
 	}
 	catch(ioremap::elliptics::error& e) {
-		get_reply()->send_error(ioremap::swarm::http_response::internal_server_error);
+		reply_error(ioremap::swarm::http_response::internal_server_error);
 	}
 	catch(...) {
-		get_reply()->send_error(ioremap::swarm::http_response::bad_request);
+		reply_error(ioremap::swarm::http_response::bad_request);
 	}
 }
 
-bool on_get_user_logs::on_finished(const std::vector<ioremap::elliptics::data_pointer>& data)
+void on_get_user_logs::read_next_page()
 {
-	std::string result_str;
-	if(!data.empty()) {
-		rapidjson::Document d; // creates json document
-		d.SetObject();
-
-		rapidjson::Value user_logs(rapidjson::kArrayType); // creates vector value for user one's day log
+	read_page_(next_cursor_, std::bind(&on_get_user_logs::on_page,
+	                                   shared_from_this(),
+	                                   std::placeholders::_1,
+	                                   std::placeholders::_2));
+}
 
-		for (auto it = data.begin(), end = data.end(); it != end; ++it) {
-			rapidjson::Value user_log(it->data<char>(), it->size(), d.GetAllocator()); // creates vector value for user one's day log
-			user_logs.PushBack(user_log, d.GetAllocator());
+void on_get_user_logs::on_page(const user_logs_page &page, bool completed)
+{
+	if (!completed) { // partial page would be followed by the wrong cursor
+		if (!headers_sent_) {
+			reply_error(ioremap::swarm::http_response::internal_server_error);
+			return;
 		}
 
-		d.AddMember("logs", user_logs, d.GetAllocator()); // adds logs array to json document
+		status_ = ioremap::swarm::http_response::internal_server_error; // sent part of the response is broken by closing of the connection
+		get_reply()->close(boost::system::errc::make_error_code(boost::system::errc::io_error));
+		return;
+	}
 
-		rapidjson::StringBuffer buffer; // creates string buffer for serialized json
-		rapidjson::Writer<rapidjson::StringBuffer> writer(buffer); // creates json writer
-		d.Accept(writer); // accepts writer by json document
+	logs_ = page.logs;
+	log_index_ = 0;
+	log_offset_ = 0;
+	next_cursor_ = page.next_cursor;
+
+	if (logs_.empty() && streamed_ && !next_cursor_.empty()) { // page has no payloads - reads further
+		read_next_page();
+		return;
+	}
 
-		result_str = buffer.GetString();
+	if (headers_sent_) {
+		stage_ = logs_.empty() ? json_suffix : log_begin;
+		get_reply()->send_data(next_chunk(),
+		                       std::bind(&on_get_user_logs::on_chunk_sent,
+		                                 shared_from_this(),
+		                                 std::placeholders::_1));
+		return;
 	}
 
 	ioremap::swarm::http_response reply;
 	reply.set_code(ioremap::swarm::http_response::ok);
 
 	auto &headers = reply.headers();
-	headers.set_content_length(result_str.size());
 	headers.set_content_type("text/json");
 
+	if (logs_.empty()) { // keeps empty response for user without logs
+		headers.set_content_length(0);
+		get_reply()->send_headers(std::move(reply),
+		                          boost::asio::const_buffer(),
+		                          std::bind(&on_get_user_logs::on_send_finished,
+		                                    shared_from_this(),
+		                                    std::string()));
+		return;
+	}
+
+	headers.set("Transfer-Encoding", "chunked");
+	headers_sent_ = true;
+
 	get_reply()->send_headers(std::move(reply),
-	                          boost::asio::buffer(result_str),
-	                          std::bind(&on_get_user_logs::on_send_finished,
+	                          next_chunk(),
+	                          std::bind(&on_get_user_logs::on_chunk_sent,
 	                                    shared_from_this(),
-	                                    result_str));
-	return false;
+	                                    std::placeholders::_1));
 }
 
 void on_get_user_logs::on_send_finished(const std::string &)
@@ -126,4 +176,132 @@ void on_get_user_logs::on_send_finished(const std::string &)
 	get_reply()->close(boost::system::error_code());
 }
 
+void on_get_user_logs::on_chunk_sent(const boost::system::error_code &err)
+{
+	if (err || stage_ == finished) {
+		get_reply()->close(err);
+		return;
+	}
+
+	if (stage_ == next_page) { // the page has been sent, so the next one is read only now
+		logs_.clear();
+		read_next_page();
+		return;
+	}
+
+	get_reply()->send_data(next_chunk(),
+	                       std::bind(&on_get_user_logs::on_chunk_sent,
+	                                 shared_from_this(),
+	                                 std::placeholders::_1));
+}
+
+boost::asio::const_buffer on_get_user_logs::next_chunk()
+{
+	char *payload = buffer_.data() + consts::CHUNK_HEADER_SIZE;
+	const size_t size = fill(payload, consts::CHUNK_SIZE);
+
+	char header[consts::CHUNK_HEADER_SIZE + 1];
+	const int header_size = snprintf(header, sizeof(header), "%zx\r\n", size);
+
+	char *begin = payload - header_size; // header is placed right before the payload to avoid copying of the payload
+	memcpy(begin, header, header_size);
+
+	char *end = payload + size;
+	memcpy(end, "\r\n", 2);
+	end += 2;
+
+	if (stage_ == finished) { // appends last chunk
+		memcpy(end, "0\r\n\r\n", 5);
+		end += 5;
+	}
+
+	return boost::asio::const_buffer(begin, end - begin);
+}
+
+size_t on_get_user_logs::fill(char *out, size_t size)
+{
+	static const char hex_digits[] = "0123456789ABCDEF";
+	static const char json_prefix_str[] = "{\"logs\":[";
+
+	char *pos = out;
+	char *const end = out + size - consts::MAX_ESCAPED_SIZE;
+
+	while (pos < end && stage_ != finished && stage_ != next_page) {
+		switch (stage_) {
+			case json_prefix:
+				memcpy(pos, json_prefix_str, sizeof(json_prefix_str) - 1);
+				pos += sizeof(json_prefix_str) - 1;
+				stage_ = log_begin;
+				break;
+			case log_begin:
+				if (sent_logs_ != 0)
+					*pos++ = ',';
+				*pos++ = '"';
+				stage_ = log_body;
+				break;
+			case log_body: {
+				const auto &log = logs_[log_index_];
+				const unsigned char *data = log.data<unsigned char>();
+
+				for (; log_offset_ < log.size() && pos < end; ++log_offset_) { // escapes like rapidjson::Writer does
+					const unsigned char ch = data[log_offset_];
+					if (ch == '"' || ch == '\\') {
+						*pos++ = '\\';
+						*pos++ = ch;
+					} else if (ch < 0x20) {
+						*pos++ = '\\';
+						switch (ch) {
+							case '\b': *pos++ = 'b'; break;
+							case '\t': *pos++ = 't'; break;
+							case '\n': *pos++ = 'n'; break;
+							case '\f': *pos++ = 'f'; break;
+							case '\r': *pos++ = 'r'; break;
+							default:
+								*pos++ = 'u';
+								*pos++ = '0';
+								*pos++ = '0';
+								*pos++ = hex_digits[ch >> 4];
+								*pos++ = hex_digits[ch & 0xF];
+						}
+					} else
+						*pos++ = ch;
+				}
+
+				if (log_offset_ == log.size()) {
+					logs_[log_index_] = ioremap::elliptics::data_pointer(); // releases sent log
+					stage_ = log_end;
+				}
+				break;
+			}
+			case log_end:
+				*pos++ = '"';
+				log_offset_ = 0;
+				++sent_logs_;
+				if (++log_index_ < logs_.size())
+					stage_ = log_begin;
+				else
+					stage_ = (streamed_ && !next_cursor_.empty()) ? next_page : json_suffix;
+				break;
+			case json_suffix:
+				*pos++ = ']';
+				if (paginated_) { // cursor consists of digits and colon, so it needs no escaping
+					static const char next_cursor_str[] = ",\"next_cursor\":\"";
+					memcpy(pos, next_cursor_str, sizeof(next_cursor_str) - 1);
+					pos += sizeof(next_cursor_str) - 1;
+					memcpy(pos, next_cursor_.data(), next_cursor_.size());
+					pos += next_cursor_.size();
+					*pos++ = '"';
+				}
+				*pos++ = '}';
+				stage_ = finished;
+				break;
+			case next_page:
+			case finished:
+				break;
+		}
+	}
+
+	return pos - out;
+}
+
 } /* namespace history */
@@ -20,17 +20,55 @@
 #include "webserver.h"
 
 #include <elliptics/utils.hpp>
+#include <historydb/provider.h>
 
 namespace history {
 
+	/* Handles /get_user_logs. Json response is streamed with chunked transfer encoding:
+		logs are escaped into bounded buffer chunk by chunk and next chunk is filled only when previous one has been sent.
+		Logs are read by pages of provider::get_user_logs: request with limit reads one page, request without limit
+		reads next page only when the previous one has been sent, so memory of any request is bounded by one page.
+	*/
 	struct on_get_user_logs :
-		public ioremap::thevoid::simple_request_stream<webserver>,
+		public measured_request_stream,
 		public std::enable_shared_from_this<on_get_user_logs>
 	{
+		on_get_user_logs();
+
 		virtual void on_request(const ioremap::swarm::http_request &req,
 		                        const boost::asio::const_buffer &buffer);
-		bool on_finished(const std::vector<ioremap::elliptics::data_pointer>& data);
+		void read_next_page(); // reads page of logs from next_cursor_
+		void on_page(const user_logs_page &page, bool completed);
 		void on_send_finished(const std::string &);
+		void on_chunk_sent(const boost::system::error_code &err);
+
+	private:
+		enum stage {
+			json_prefix,	// "{"logs":["
+			log_begin,		// separator and opening quote of the log
+			log_body,		// escaped log data
+			log_end,		// closing quote of the log
+			json_suffix,	// "]}"
+			next_page,		// logs of the page have been written, next page should be read
+			finished
+		};
+
+		typedef std::function<void(const user_logs_page &page, bool completed)> page_callback;
+
+		boost::asio::const_buffer next_chunk(); // fills buffer_ with next chunk of the response
+		size_t fill(char *out, size_t size); // writes next part of json into out, returns number of written bytes
+
+		std::function<void(const std::string &cursor, page_callback callback)>	read_page_; // reads page of requested logs
+		std::vector<ioremap::elliptics::data_pointer>							logs_; // logs of the page which are being sent
+		size_t																	log_index_; // index of the log which is being sent
+		size_t																	log_offset_; // offset of not sent data in the current log
+		size_t																	sent_logs_; // number of logs which have been sent by all pages
+		stage																	stage_; // stage of json writing
+		std::vector<char>														buffer_; // buffer of the chunk which is being sent
+		bool																	paginated_; // whether next_cursor should be added to the response
+		bool																	streamed_; // whether pages are read until the last one
+		bool																	headers_sent_; // whether chunked response has been started
+		std::string																next_cursor_; // cursor of the next page
 	};
 
 } /* namespace history */
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include "on_stats.h"
+
+#include <historydb/provider.h>
+
+#include <boost/lexical_cast.hpp>
+
+#include "../fastcgi/rapidjson/writer.h"
+#include "../fastcgi/rapidjson/stringbuffer.h"
+
+namespace history {
+
+void on_stats::on_request(const ioremap::swarm::http_request &/*req*/,
+                          const boost::asio::const_buffer &/*buffer*/)
+{
+	const auto handlers = server()->get_stats();
+	const auto operations = server()->get_provider()->get_operation_stats();
+
+	rapidjson::Document d; // creates document for json serialization
+	d.SetObject();
+
+	rapidjson::Value handlers_value(rapidjson::kObjectType);
+	add_stats(handlers_value, handlers, d.GetAllocator());
+	d.AddMember("handlers", handlers_value, d.GetAllocator());
+
+	rapidjson::Value operations_value(rapidjson::kObjectType);
+	add_stats(operations_value, operations, d.GetAllocator());
+	d.AddMember("operations", operations_value, d.GetAllocator());
+
+	rapidjson::StringBuffer buffer; // creates string buffer for serialized json
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer); // creates json writer
+	d.Accept(writer); // accepts writer by json document
+
+	const std::string result_str = buffer.GetString();
+
+	ioremap::swarm::http_response reply;
+	reply.set_code(ioremap::swarm::http_response::ok);
+
+	auto &headers = reply.headers();
+	headers.set_content_length(result_str.size());
+	headers.set_content_type("text/json");
+
+	get_reply()->send_headers(std::move(reply),
+	                          boost::asio::buffer(result_str),
+	                          std::bind(&on_stats::on_send_finished,
+	                                    shared_from_this(),
+	                                    result_str));
+}
+
+void on_stats::on_send_finished(const std::string &)
+{
+	get_reply()->close(boost::system::error_code());
+}
+
+void on_stats::add_stats(rapidjson::Value &object,
+                         const std::vector<operation_stats> &stats,
+                         rapidjson::Document::AllocatorType &allocator)
+{
+	for (auto it = stats.begin(), end = stats.end(); it != end; ++it) {
+		rapidjson::Value latency(rapidjson::kObjectType); // latencies in microseconds
+		latency.AddMember("min", it->min, allocator);
+		latency.AddMember("mean", it->mean, allocator);
+		latency.AddMember("p50", it->p50, allocator);
+		latency.AddMember("p90", it->p90, allocator);
+		latency.AddMember("p99", it->p99, allocator);
+		latency.AddMember("p999", it->p999, allocator);
+		latency.AddMember("max", it->max, allocator);
+
+		rapidjson::Value error_codes(rapidjson::kObjectType); // negative errno for operations, http status for handlers
+		for (auto code = it->error_codes.begin(), codes_end = it->error_codes.end(); code != codes_end; ++code) {
+			const auto code_str = boost::lexical_cast<std::string>(code->first);
+			rapidjson::Value count(code->second);
+			error_codes.AddMember(code_str.c_str(), allocator, count, allocator);
+		}
+
+		rapidjson::Value value(rapidjson::kObjectType);
+		value.AddMember("count", it->count, allocator);
+		value.AddMember("errors", it->errors, allocator);
+		value.AddMember("in_flight", it->in_flight, allocator);
+		value.AddMember("bytes", it->bytes, allocator);
+		value.AddMember("latency_us", latency, allocator);
+		value.AddMember("error_codes", error_codes, allocator);
+
+		object.AddMember(it->name.c_str(), allocator, value, allocator);
+	}
+}
+
+} /* namespace history */
@@ -26,6 +26,11 @@
 #include "on_add_log_with_activity.h"
 #include "on_get_active_users.h"
 #include "on_get_user_logs.h"
+#include "on_count_active_users.h"
+#include "on_combine_active_users.h"
+#include "on_get_user_active_days.h"
+#include "on_get_day_stats.h"
+#include "on_stats.h"
 
 namespace history {
 
@@ -34,10 +39,12 @@ webserver::webserver()
 
 bool webserver::initialize(const rapidjson::Value &config)
 {
-	if (!config.HasMember("remotes"))
+	const bool in_memory = config.HasMember("memory_storage"); // elliptics isn't used, so remotes and groups aren't needed
+
+	if (!in_memory && !config.HasMember("remotes"))
 		return false;
 
-	if (!config.HasMember("groups"))
+	if (!in_memory && !config.HasMember("groups"))
 		return false;
 
 	std::vector<std::string> remotes;
@@ -58,52 +65,157 @@ bool webserver::initialize(const rapidjson::Value &config)
 	if (config.HasMember("check_timeout"))
 		check_timeout = config["check_timeout"].GetUint();
 
-	auto &remotesArray = config["remotes"];
-	std::transform(remotesArray.Begin(), remotesArray.End(),
-		std::back_inserter(remotes),
-		std::bind(&rapidjson::Value::GetString, std::placeholders::_1));
+	if (in_memory) {
+		auto &memory = config["memory_storage"];
+		memory_storage_config memory_config = {0, 0, 0, 1};
+
+		if (memory.HasMember("read_latency"))
+			memory_config.read_latency = memory["read_latency"].GetUint();
+
+		if (memory.HasMember("write_latency"))
+			memory_config.write_latency = memory["write_latency"].GetUint();
+
+		if (memory.HasMember("index_latency"))
+			memory_config.index_latency = memory["index_latency"].GetUint();
+
+		if (memory.HasMember("threads"))
+			memory_config.threads = memory["threads"].GetUint();
+
+		provider_ = std::make_shared<provider>(memory_config, logfile, loglevel);
+	} else {
+		auto &remotesArray = config["remotes"];
+		std::transform(remotesArray.Begin(), remotesArray.End(),
+			std::back_inserter(remotes),
+			std::bind(&rapidjson::Value::GetString, std::placeholders::_1));
+
+		auto &groupsArray = config["groups"];
+		std::transform(groupsArray.Begin(), groupsArray.End(),
+			std::back_inserter(groups),
+			std::bind(&rapidjson::Value::GetInt, std::placeholders::_1));
+
+		uint32_t min_writes = groups.size();
+		if (config.HasMember("min_writes"))
+			min_writes = config["min_writes"].GetInt();
+
+		provider_ = std::make_shared<provider>(remotes, groups, min_writes,
+		                                       logfile, loglevel,
+		                                       wait_timeout, check_timeout);
+	}
+
+	if (config.HasMember("coalescing_window")) {
+		uint32_t max_bytes = 64 * 1024;
+		if (config.HasMember("coalescing_max_bytes"))
+			max_bytes = config["coalescing_max_bytes"].GetUint();
+
+		provider_->set_coalescing_parameters(config["coalescing_window"].GetUint(), max_bytes);
+	}
+
+	if (config.HasMember("activity_chunks"))
+		provider_->set_activity_chunks(config["activity_chunks"].GetUint());
+
+	if (config.HasMember("bulk_read_min_keys"))
+		provider_->set_bulk_read_parameters(config["bulk_read_min_keys"].GetUint());
+
+	if (config.HasMember("activity_cache_size"))
+		provider_->set_activity_cache_parameters(config["activity_cache_size"].GetUint64());
+
+	if (config.HasMember("log_cache_size"))
+		provider_->set_log_cache_parameters(config["log_cache_size"].GetUint64());
+
+	if (config.HasMember("active_users_cache_size"))
+		provider_->set_active_users_cache_parameters(config["active_users_cache_size"].GetUint64());
 
-	auto &groupsArray = config["groups"];
-	std::transform(groupsArray.Begin(), groupsArray.End(),
-		std::back_inserter(groups),
-		std::bind(&rapidjson::Value::GetInt, std::placeholders::_1));
+	if (config.HasMember("activity_sketch_interval"))
+		provider_->set_activity_sketch_parameters(config["activity_sketch_interval"].GetUint());
 
-	uint32_t min_writes = groups.size();
-	if (config.HasMember("min_writes"))
-		min_writes = config["min_writes"].GetInt();
+	if (config.HasMember("activity_bitmap_interval"))
+		provider_->set_activity_bitmap_parameters(config["activity_bitmap_interval"].GetUint());
 
-	provider_ = std::make_shared<provider>(remotes, groups, min_writes,
-	                                       logfile, loglevel,
-	                                       wait_timeout, check_timeout);
+	if (config.HasMember("activity_calendar_interval"))
+		provider_->set_activity_calendar_parameters(config["activity_calendar_interval"].GetUint());
 
-	on<on_root>(
+	if (config.HasMember("day_stats_interval"))
+		provider_->set_day_stats_parameters(config["day_stats_interval"].GetUint());
+
+	if (config.HasMember("framed_logs"))
+		provider_->set_framed_logs(config["framed_logs"].GetBool());
+
+	if (config.HasMember("offset_index_step"))
+		provider_->set_offset_index_parameters(config["offset_index_step"].GetUint());
+
+	on<measured<on_root, root_handler>>(
 		options::exact_match("/"),
 		options::methods("GET")
 	);
-	on<on_add_log>(
+	on<measured<on_add_log, add_log_handler>>(
 		options::exact_match("/add_log"),
 		options::methods("POST")
 	);
-	on<on_add_activity>(
+	on<measured<on_add_activity, add_activity_handler>>(
 		options::exact_match("/add_activity"),
 		options::methods("POST")
 	);
-	on<on_add_log_with_activity>(
+	on<measured<on_add_log_with_activity, add_log_with_activity_handler>>(
 		options::exact_match("/add_log_with_activity"),
 		options::methods("POST")
 	);
-	on<on_get_active_users>(
+	on<measured<on_get_active_users, get_active_users_handler>>(
 		options::exact_match("/get_active_users"),
 		options::methods("GET")
 	);
-	on<on_get_user_logs>(
+	on<measured<on_get_user_logs, get_user_logs_handler>>(
 		options::exact_match("/get_user_logs"),
 		options::methods("GET")
 	);
+	on<measured<on_count_active_users, count_active_users_handler>>(
+		options::exact_match("/count_active_users"),
+		options::methods("GET")
+	);
+	on<measured<on_combine_active_users, combine_active_users_handler>>(
+		options::exact_match("/combine_active_users"),
+		options::methods("GET")
+	);
+	on<measured<on_get_user_active_days, get_user_active_days_handler>>(
+		options::exact_match("/get_user_active_days"),
+		options::methods("GET")
+	);
+	on<measured<on_get_day_stats, get_day_stats_handler>>(
+		options::exact_match("/get_day_stats"),
+		options::methods("GET")
+	);
+	on<on_stats>(
+		options::exact_match("/stats"),
+		options::methods("GET")
+	);
 
 	return true;
 }
 
+std::vector<operation_stats> webserver::get_stats()
+{
+	static const char *names[] = { // names of http_handler
+		"/",
+		"/add_log",
+		"/add_activity",
+		"/add_log_with_activity",
+		"/get_active_users",
+		"/get_user_logs",
+		"/count_active_users",
+		"/combine_active_users",
+		"/get_user_active_days",
+		"/get_day_stats"
+	};
+
+	std::vector<operation_stats> ret;
+	ret.reserve(http_handlers_count);
+
+	for (int handler = 0; handler < http_handlers_count; ++handler) {
+		ret.emplace_back(counters_[handler].stats(names[handler]));
+	}
+
+	return ret;
+}
+
 void webserver::on_root::on_request(const ioremap::swarm::http_request &/*req*/,
                                     const boost::asio::const_buffer &/*buffer*/)
 {
@@ -19,8 +19,46 @@
 
 #include <thevoid/server.hpp>
 
+#include <historydb/operation_counters.h>
+
+#include <vector>
+
 namespace history {
 class provider;
+class webserver;
+
+/* Http handlers whose requests are measured */
+enum http_handler {
+	root_handler,
+	add_log_handler,
+	add_activity_handler,
+	add_log_with_activity_handler,
+	get_active_users_handler,
+	get_user_logs_handler,
+	count_active_users_handler,
+	combine_active_users_handler,
+	get_user_active_days_handler,
+	get_day_stats_handler,
+	http_handlers_count
+};
+
+/* Base of http handlers which are measured by webserver::measured.
+	Handler sends error replies by reply_error(), so the request is counted as failed with the status of the reply.
+*/
+struct measured_request_stream : public ioremap::thevoid::simple_request_stream<webserver>
+{
+	measured_request_stream()
+	: status_(ioremap::swarm::http_response::ok)
+	{}
+
+	void reply_error(int status)
+	{
+		status_ = status;
+		get_reply()->send_error(status);
+	}
+
+	int status_; // status of the reply
+};
 
 class webserver : public ioremap::thevoid::server<webserver>
 {
@@ -28,16 +66,49 @@ public:
 	webserver();
 	virtual bool initialize(const rapidjson::Value &config);
 
-	struct on_root : public ioremap::thevoid::simple_request_stream<webserver>
+	struct on_root : public measured_request_stream
 	{
 		virtual void on_request(const ioremap::swarm::http_request &req,
                                 const boost::asio::const_buffer &buffer);
 	};
 
+	/* Measures requests of Handler: latency from the request till destruction of the handler
+		(that is the moment when the reply has been sent), size of the request body and failed replies by their statuses.
+	*/
+	template <typename Handler, http_handler Id>
+	struct measured : public Handler
+	{
+		~measured()
+		{
+			if (!timer_)
+				return;
+
+			if (this->status_ == ioremap::swarm::http_response::ok)
+				timer_->finish(bytes_);
+			else
+				timer_->fail(this->status_);
+		}
+
+		virtual void on_request(const ioremap::swarm::http_request &req,
+		                        const boost::asio::const_buffer &buffer)
+		{
+			timer_.reset(new operation_timer(this->server()->get_counters(Id)));
+			bytes_ = boost::asio::buffer_size(buffer);
+			Handler::on_request(req, buffer);
+		}
+
+		std::unique_ptr<operation_timer>	timer_; // null until the request is received
+		uint64_t							bytes_; // size of the request body
+	};
+
 	std::shared_ptr<provider> get_provider() { return provider_; }
 
+	operation_counters &get_counters(http_handler handler) { return counters_[handler]; }
+	std::vector<operation_stats> get_stats(); // stats of http handlers
+
 private:
-	std::shared_ptr<provider> provider_;
+	std::shared_ptr<provider>	provider_;
+	operation_counters			counters_[http_handlers_count]; // counters of requests by handlers
 };
 
 } /* namespace history */
@@ -0,0 +1,534 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+
+#include <unistd.h>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
+
+#include "historydb/provider.h"
+#include "historydb/histogram.h"
+
+#include "tool.h"
+
+namespace consts {
+	const uint32_t SECONDS_IN_DAY = 24 * 60 * 60;
+	const char LOG_FILE[] = "historydb-bench.log";
+	const char ASYNC_SUFFIX[] = ".async";
+	const uint32_t DRAIN_TIMEOUT = 60; // seconds which are waited for requests in flight after the end of the run
+} /* namespace consts */
+
+typedef std::chrono::steady_clock clock_type;
+
+/* Operations of provider which could be benchmarked */
+enum class op_type
+{
+	add_log,
+	add_activity,
+	add_log_with_activity,
+	get_user_logs,
+	get_user_records,
+	get_active_users,
+	count_active_users,
+	combine_active_users,
+	get_day_stats,
+	get_user_active_days
+};
+
+const std::pair<const char *, op_type> OP_NAMES[] = {
+	{"add_log", op_type::add_log},
+	{"add_activity", op_type::add_activity},
+	{"add_log_with_activity", op_type::add_log_with_activity},
+	{"get_user_logs", op_type::get_user_logs},
+	{"get_user_records", op_type::get_user_records},
+	{"get_active_users", op_type::get_active_users},
+	{"count_active_users", op_type::count_active_users},
+	{"combine_active_users", op_type::combine_active_users},
+	{"get_day_stats", op_type::get_day_stats},
+	{"get_user_active_days", op_type::get_user_active_days}
+};
+
+struct options
+{
+	options()
+	: log_level(1)
+	, chunks(1)
+	, rate(1000)
+	, duration(10)
+	, threads(16)
+	, users(1000000)
+	, zipf(0.99)
+	, data_size(100)
+	, days(1)
+	, max_outstanding(100000)
+	, in_memory(false)
+	{}
+
+	std::vector<std::string>	remotes; // elliptics nodes as addr:port:family
+	std::vector<int>			groups; // elliptics groups
+	std::string					log_file; // elliptics client log
+	int							log_level; // elliptics client log level
+	uint32_t					chunks; // number of activity chunks which is used by frontends
+	double						rate; // mean arrival rate of requests per second
+	uint32_t					duration; // duration of the run in seconds
+	uint32_t					threads; // number of threads which execute requests
+	uint32_t					users; // number of distinct users
+	double						zipf; // exponent of Zipfian distribution of users, 0 - uniform
+	uint32_t					data_size; // size of written log records
+	uint32_t					days; // number of days which are read by read operations
+	uint32_t					max_outstanding; // maximum number of requests which are queued or in flight
+	std::string					mix; // operations with their weights
+	std::string					output; // JSON output file, empty - stdout
+	bool						in_memory; // whether in-memory storage is used instead of elliptics
+	std::vector<uint32_t>		latencies; // read, write and index latencies of in-memory storage in microseconds
+};
+
+void print_usage(char *s)
+{
+	std::cout << "Usage: " << s << " [options]\n"
+	<< "Runs open-loop benchmark of provider operations and prints results as JSON.\n"
+	<< "Requests arrive by Poisson process with specified rate regardless of completion of previous requests,\n"
+	<< "latency is measured from the moment when request should have been started.\n"
+	<< " -r addr:port:family    - adds a route to the given node, could be specified several times\n"
+	<< " -g groups              - groups id to connect which are separated by ','\n"
+	<< " -M read:write:index    - uses in-memory storage with specified latencies in microseconds instead of elliptics\n"
+	<< " -c chunks              - number of activity chunks which is used by frontends [1]\n"
+	<< " -m mix                 - operations with weights as op:weight separated by ',' [add_log:1]\n"
+	<< "                          suffix .async selects async variant, e.g. add_log:80,get_user_logs.async:20\n"
+	<< " -R rate                - mean arrival rate of requests per second [1000]\n"
+	<< " -d duration            - duration of the run in seconds [10]\n"
+	<< " -t threads             - number of threads which execute requests [16]\n"
+	<< " -u users               - number of distinct users [1000000]\n"
+	<< " -z exponent            - exponent of Zipfian distribution of users, 0 - uniform [0.99]\n"
+	<< " -s size                - size of written log records in bytes [100]\n"
+	<< " -D days                - number of days which are read by read operations [1]\n"
+	<< " -O max_outstanding     - maximum number of queued and in flight requests, others are dropped [100000]\n"
+	<< " -o file                - writes JSON results into file instead of stdout\n"
+	<< " -l log_file            - elliptics client log [historydb-bench.log]\n"
+	<< " -L log_level           - elliptics client log level [1]\n"
+	;
+}
+
+/* Benchmarked operation with its results */
+struct operation
+{
+	operation(const std::string &name, op_type type, bool async, double weight)
+	: name(name), type(type), async(async), weight(weight), errors(0)
+	{}
+
+	const std::string		name; // name of operation as it is specified in the mix
+	const op_type			type;
+	const bool				async; // whether async variant of the operation is called
+	const double			weight; // relative frequency of the operation
+	history::histogram		latency; // latency of completed requests in microseconds
+	std::atomic<uint64_t>	errors; // number of failed requests
+};
+
+std::vector<std::unique_ptr<operation>> parse_mix(const std::string &value)
+{
+	std::vector<std::unique_ptr<operation>> ret;
+
+	const auto items = history::tool::split(value, ",");
+	for (auto it = items.begin(), end = items.end(); it != end; ++it) {
+		const auto parts = history::tool::split(*it, ":");
+		if (parts.size() > 2)
+			throw std::invalid_argument("invalid mix: " + *it);
+
+		std::string name = parts[0];
+		const double weight = parts.size() == 2 ? boost::lexical_cast<double>(parts[1]) : 1;
+
+		const size_t suffix_size = sizeof(consts::ASYNC_SUFFIX) - 1;
+		const bool async = name.size() > suffix_size &&
+		                   name.compare(name.size() - suffix_size, suffix_size, consts::ASYNC_SUFFIX) == 0;
+		const std::string op_name = async ? name.substr(0, name.size() - suffix_size) : name;
+
+		auto op = std::find_if(std::begin(OP_NAMES), std::end(OP_NAMES),
+		                       [&op_name] (const std::pair<const char *, op_type> &op) { return op_name == op.first; });
+		if (op == std::end(OP_NAMES) || weight <= 0)
+			throw std::invalid_argument("invalid mix: " + *it);
+
+		ret.emplace_back(new operation(name, op->second, async, weight));
+	}
+
+	return ret;
+}
+
+/* Generates ranks of users by Zipfian distribution: rank k has probability proportional to 1 / k^exponent
+*/
+class zipf_generator
+{
+public:
+	zipf_generator(uint32_t count, double exponent)
+	: cdf_(count)
+	{
+		double total = 0;
+		for (uint32_t k = 0; k < count; ++k) {
+			total += 1 / std::pow(k + 1, exponent);
+			cdf_[k] = total;
+		}
+		for (auto it = cdf_.begin(), end = cdf_.end(); it != end; ++it) {
+			*it /= total;
+		}
+	}
+
+	template <typename Rng>
+	uint32_t operator() (Rng &rng)
+	{
+		const double value = std::uniform_real_distribution<double>()(rng);
+		const auto it = std::lower_bound(cdf_.begin(), cdf_.end(), value);
+		return it == cdf_.end() ? cdf_.size() - 1 : it - cdf_.begin();
+	}
+
+private:
+	std::vector<double>	cdf_; // cumulative probabilities of ranks
+};
+
+/* Request which should be executed */
+struct request
+{
+	operation			*op;
+	std::string			user;
+	clock_type::time_point	start; // time when the request should have been started
+};
+
+class bench
+{
+public:
+	bench(std::shared_ptr<history::provider> provider, const options &opts)
+	: provider_(provider)
+	, opts_(opts)
+	, ops_(parse_mix(opts.mix))
+	, users_(opts.users, opts.zipf)
+	, data_(ioremap::elliptics::data_pointer::copy(std::string(opts.data_size, 'x').data(), opts.data_size))
+	, stopped_(false)
+	, outstanding_(0)
+	, dropped_(0)
+	, elapsed_(0)
+	{}
+
+	void run()
+	{
+		boost::thread_group workers;
+		for (uint32_t i = 0; i < opts_.threads; ++i) {
+			workers.create_thread(boost::bind(&bench::work, this));
+		}
+
+		schedule();
+
+		{
+			boost::mutex::scoped_lock lock(mutex_);
+			stopped_ = true;
+		}
+		cond_.notify_all();
+		workers.join_all();
+
+		const auto deadline = clock_type::now() + std::chrono::seconds(consts::DRAIN_TIMEOUT);
+		while (outstanding_ != 0 && clock_type::now() < deadline) { // waits for async requests in flight
+			boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+		}
+
+		print_results();
+	}
+
+private:
+	/* Starts requests by Poisson process until the end of the run */
+	void schedule()
+	{
+		std::mt19937_64 rng(::time(NULL));
+		std::exponential_distribution<double> interval(opts_.rate);
+
+		std::vector<double> weights;
+		for (auto it = ops_.begin(), end = ops_.end(); it != end; ++it) {
+			weights.push_back((*it)->weight);
+		}
+		std::discrete_distribution<size_t> pick(weights.begin(), weights.end());
+
+		start_ = clock_type::now();
+		const auto end = start_ + std::chrono::seconds(opts_.duration);
+		auto next = start_;
+
+		while (true) {
+			next += std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(interval(rng)));
+			if (next >= end)
+				break;
+
+			const auto now = clock_type::now();
+			if (next > now)
+				boost::this_thread::sleep(boost::posix_time::microseconds(
+					std::chrono::duration_cast<std::chrono::microseconds>(next - now).count()));
+
+			if (outstanding_ >= opts_.max_outstanding) { // the system doesn't keep up with the rate
+				++dropped_;
+				continue;
+			}
+
+			request req = {ops_[pick(rng)].get(), "user" + boost::lexical_cast<std::string>(users_(rng)), next};
+			++outstanding_;
+
+			{
+				boost::mutex::scoped_lock lock(mutex_);
+				queue_.push_back(req);
+			}
+			cond_.notify_one();
+		}
+
+		elapsed_ = std::chrono::duration<double>(clock_type::now() - start_).count();
+	}
+
+	void work()
+	{
+		while (true) {
+			request req;
+
+			{
+				boost::mutex::scoped_lock lock(mutex_);
+				while (queue_.empty() && !stopped_) {
+					cond_.wait(lock);
+				}
+
+				if (queue_.empty())
+					return;
+
+				req = queue_.front();
+				queue_.pop_front();
+			}
+
+			execute(req);
+		}
+	}
+
+	void execute(const request &req)
+	{
+		auto op = req.op;
+		const auto start = req.start;
+		auto done = [this, op, start] (bool ok) {
+			if (ok)
+				op->latency.record(std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - start).count());
+			else
+				++op->errors;
+			--outstanding_;
+		};
+
+		try {
+			call(*op, req.user, done);
+		}
+		catch (std::exception &) {
+			done(false);
+		}
+	}
+
+	/* Calls sync or async variant of the operation, done is called on completion */
+	void call(const operation &op, const std::string &user, const std::function<void(bool ok)> &done)
+	{
+		const uint64_t now = ::time(NULL);
+		const uint64_t begin = now - (opts_.days - 1) * consts::SECONDS_IN_DAY;
+		const std::vector<std::pair<uint64_t, uint64_t>> periods = {
+			{begin - consts::SECONDS_IN_DAY, now - consts::SECONDS_IN_DAY},
+			{begin, now}
+		}; // users which are active in both previous and current periods
+
+		switch (op.type) {
+			case op_type::add_log:
+				if (op.async)
+					return provider_->add_log(user, now, data_, done);
+				provider_->add_log(user, now, data_);
+				return done(true);
+			case op_type::add_activity:
+				if (op.async)
+					return provider_->add_activity(user, now, done);
+				provider_->add_activity(user, now);
+				return done(true);
+			case op_type::add_log_with_activity:
+				if (op.async)
+					return provider_->add_log_with_activity(user, now, data_, done);
+				provider_->add_log_with_activity(user, now, data_);
+				return done(true);
+			case op_type::get_user_logs:
+				if (op.async)
+					return provider_->get_user_logs(user, begin, now,
+					                                [done] (const std::vector<ioremap::elliptics::data_pointer> &) { done(true); });
+				provider_->get_user_logs(user, begin, now);
+				return done(true);
+			case op_type::get_user_records:
+				if (op.async)
+					return provider_->get_user_records(user, begin, now,
+					                                   [done] (const std::vector<history::framing::record> &, bool completed) { done(completed); });
+				provider_->get_user_records(user, begin, now);
+				return done(true);
+			case op_type::get_active_users:
+				if (op.async)
+					return provider_->get_active_users(begin, now, [done] (const std::set<std::string> &) { done(true); });
+				provider_->get_active_users(begin, now);
+				return done(true);
+			case op_type::count_active_users:
+				if (op.async)
+					return provider_->count_active_users(begin, now, [done] (uint64_t, bool completed) { done(completed); });
+				provider_->count_active_users(begin, now);
+				return done(true);
+			case op_type::combine_active_users:
+				if (op.async)
+					return provider_->combine_active_users(history::set_operation::intersect, periods,
+					                                       [done] (const history::user_list &, bool completed) { done(completed); });
+				provider_->combine_active_users(history::set_operation::intersect, periods);
+				return done(true);
+			case op_type::get_day_stats:
+				if (op.async)
+					return provider_->get_day_stats(begin, now, [done] (const history::day_stats &, bool completed) { done(completed); });
+				provider_->get_day_stats(begin, now);
+				return done(true);
+			case op_type::get_user_active_days:
+				if (op.async)
+					return provider_->get_user_active_days(user, begin, now, [done] (const std::vector<uint64_t> &) { done(true); });
+				provider_->get_user_active_days(user, begin, now);
+				return done(true);
+		}
+	}
+
+	void print_results()
+	{
+		std::ofstream file;
+		if (!opts_.output.empty()) {
+			file.open(opts_.output.c_str(), std::ios::trunc);
+			if (!file)
+				throw std::runtime_error("can't create output: " + opts_.output);
+		}
+		std::ostream &out = opts_.output.empty() ? std::cout : file;
+
+		out << "{\n"
+		    << "\t\"rate\": " << opts_.rate << ",\n"
+		    << "\t\"duration\": " << elapsed_ << ",\n"
+		    << "\t\"threads\": " << opts_.threads << ",\n"
+		    << "\t\"users\": " << opts_.users << ",\n"
+		    << "\t\"zipf\": " << opts_.zipf << ",\n"
+		    << "\t\"data_size\": " << opts_.data_size << ",\n"
+		    << "\t\"dropped\": " << dropped_ << ",\n"
+		    << "\t\"unfinished\": " << outstanding_ << ",\n"
+		    << "\t\"operations\": {";
+
+		for (size_t i = 0; i < ops_.size(); ++i) {
+			const auto &op = *ops_[i];
+			const auto &latency = op.latency;
+			out << (i == 0 ? "\n" : ",\n")
+			    << "\t\t\"" << op.name << "\": {\n"
+			    << "\t\t\t\"count\": " << latency.count() << ",\n"
+			    << "\t\t\t\"errors\": " << op.errors << ",\n"
+			    << "\t\t\t\"throughput\": " << (elapsed_ > 0 ? latency.count() / elapsed_ : 0) << ",\n"
+			    << "\t\t\t\"latency_us\": {"
+			    << "\"min\": " << latency.min()
+			    << ", \"mean\": " << latency.mean()
+			    << ", \"p50\": " << latency.percentile(50)
+			    << ", \"p99\": " << latency.percentile(99)
+			    << ", \"p999\": " << latency.percentile(99.9)
+			    << ", \"max\": " << latency.max() << "}\n"
+			    << "\t\t}";
+		}
+
+		out << "\n\t}\n}\n";
+	}
+
+	std::shared_ptr<history::provider>			provider_;
+	const options								&opts_;
+	std::vector<std::unique_ptr<operation>>		ops_; // operations of the mix
+	zipf_generator								users_; // generator of user ranks
+	const ioremap::elliptics::data_pointer		data_; // written log record
+	std::deque<request>							queue_; // requests which wait for free thread
+	bool										stopped_; // whether scheduling has been finished
+	boost::mutex								mutex_;
+	boost::condition_variable					cond_;
+	std::atomic<uint64_t>						outstanding_; // number of queued and in flight requests
+	uint64_t									dropped_; // number of requests which haven't been started because of max_outstanding
+	clock_type::time_point						start_; // start of the run
+	double										elapsed_; // duration of scheduling in seconds
+};
+
+int main(int argc, char *argv[])
+{
+	options opts;
+	opts.log_file = consts::LOG_FILE;
+	opts.mix = "add_log:1";
+
+	int ch;
+	try {
+		while ((ch = getopt(argc, argv, "r:g:M:c:m:R:d:t:u:z:s:D:O:o:l:L:h")) != -1) {
+			switch (ch) {
+				case 'r': opts.remotes.push_back(optarg); break;
+				case 'g': opts.groups = history::tool::parse_groups(optarg); break;
+				case 'M': opts.in_memory = true; opts.latencies = history::tool::parse_latencies(optarg); break;
+				case 'c': opts.chunks = boost::lexical_cast<uint32_t>(optarg); break;
+				case 'm': opts.mix = optarg; break;
+				case 'R': opts.rate = boost::lexical_cast<double>(optarg); break;
+				case 'd': opts.duration = boost::lexical_cast<uint32_t>(optarg); break;
+				case 't': opts.threads = boost::lexical_cast<uint32_t>(optarg); break;
+				case 'u': opts.users = boost::lexical_cast<uint32_t>(optarg); break;
+				case 'z': opts.zipf = boost::lexical_cast<double>(optarg); break;
+				case 's': opts.data_size = boost::lexical_cast<uint32_t>(optarg); break;
+				case 'D': opts.days = boost::lexical_cast<uint32_t>(optarg); break;
+				case 'O': opts.max_outstanding = boost::lexical_cast<uint32_t>(optarg); break;
+				case 'o': opts.output = optarg; break;
+				case 'l': opts.log_file = optarg; break;
+				case 'L': opts.log_level = boost::lexical_cast<int>(optarg); break;
+				default:
+					print_usage(argv[0]);
+					return -1;
+			}
+		}
+
+		if (argc != optind || (!opts.in_memory && (opts.remotes.empty() || opts.groups.empty())) || opts.rate <= 0 ||
+		    opts.threads == 0 || opts.users == 0 || opts.days == 0 || opts.zipf < 0)
+			throw std::invalid_argument("invalid arguments");
+
+		parse_mix(opts.mix);
+	}
+	catch (...) {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	std::shared_ptr<history::provider> provider;
+	if (opts.in_memory) {
+		history::memory_storage_config config;
+		config.read_latency = opts.latencies[0];
+		config.write_latency = opts.latencies[1];
+		config.index_latency = opts.latencies[2];
+		config.threads = opts.threads;
+		provider = std::make_shared<history::provider>(config, opts.log_file, opts.log_level);
+	} else {
+		provider = std::make_shared<history::provider>(opts.remotes, opts.groups, 1,
+		                                               opts.log_file, opts.log_level);
+	}
+	provider->set_activity_chunks(opts.chunks);
+
+	try {
+		bench(provider, opts).run();
+	}
+	catch (std::exception &e) {
+		std::cerr << "Benchmark failed: " << e.what() << std::endl;
+		return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,346 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <set>
+
+#include <unistd.h>
+
+#include <boost/lexical_cast.hpp>
+
+#include "historydb/provider.h"
+#include "historydb/framing.h"
+
+#include "tool.h"
+
+namespace consts {
+	const uint32_t SECONDS_IN_DAY = 24 * 60 * 60;
+	const char LOG_FILE[] = "historydb-compact.log";
+	const uint32_t MEMORY_STORAGE_THREADS = 4; // threads which complete operations of in-memory storage
+	const size_t SEED_RECORD_SIZE = 64; // size of records which are generated for in-memory benchmark
+} /* namespace consts */
+
+struct options
+{
+	options()
+	: log_level(1)
+	, chunks(1)
+	, page_size(1024)
+	, in_flight(128)
+	, dry_run(false)
+	, in_memory(false)
+	, seed_users(0)
+	, seed_records(0)
+	{}
+
+	std::vector<std::string>	remotes; // elliptics nodes as addr:port:family
+	std::vector<int>			groups; // elliptics groups
+	std::string					log_file; // elliptics client log
+	int							log_level; // elliptics client log level
+	uint32_t					chunks; // number of activity chunks which is used by frontends
+	uint32_t					page_size; // number of users which are read from activity index at once
+	uint32_t					in_flight; // maximum number of reads and writes in flight
+	std::set<std::string>		users; // users whose logs are compacted, empty - all active users
+	std::string					checkpoint; // checkpoint file
+	bool						dry_run; // whether logs are only read and counted
+	bool						in_memory; // whether in-memory storage is used instead of elliptics
+	std::vector<uint32_t>		latencies; // read, write and index latencies of in-memory storage in microseconds
+	uint32_t					seed_users; // number of users whose logs are generated in each key before compaction
+	uint32_t					seed_records; // number of records which are generated in each log
+	std::vector<std::string>	keys; // source subkeys
+	std::string					new_key; // destination subkey
+};
+
+void print_usage(char *s)
+{
+	std::cout << "Usage: " << s << " [options] KEYS NEW_KEY\n"
+	<< "Combines logs of users who are active in KEYS (separated by ':') into key NEW_KEY.\n"
+	<< " -r addr:port:family    - adds a route to the given node, could be specified several times\n"
+	<< " -g groups              - groups id to connect which are separated by ','\n"
+	<< " -c chunks              - number of activity chunks which is used by frontends [1]\n"
+	<< " -p page_size           - number of users which are read from activity index at once [1024]\n"
+	<< " -i in_flight           - maximum number of reads and writes in flight [128]\n"
+	<< " -u user                - compacts only logs of the user, could be specified several times\n"
+	<< " -s checkpoint          - checkpoint file, compaction is resumed from it and it is updated after each page\n"
+	<< " -d                     - dry run: logs are read and counted, but nothing is written\n"
+	<< " -M read:write:index    - uses in-memory storage with specified latencies in microseconds instead of elliptics\n"
+	<< " -G users:records       - generates logs of users with records each in every key of KEYS before compaction (only with -M)\n"
+	<< " -l log_file            - elliptics client log [historydb-compact.log]\n"
+	<< " -L log_level           - elliptics client log level [1]\n"
+	;
+}
+
+/* Joins records of daily log into data of NEW_KEY. Framed records are converted to records with absolute time,
+	because time of record in daily log is relative to the begin of the day and NEW_KEY has no day.
+	Legacy unframed data and records which already have absolute time are copied as is.
+*/
+ioremap::elliptics::data_pointer join_records(const std::vector<history::framing::record> &records, uint64_t day_begin)
+{
+	std::vector<ioremap::elliptics::data_pointer> parts;
+	size_t total = 0;
+
+	for (auto rec = records.begin(), end = records.end(); rec != end; ++rec) {
+		if (!rec->framed)
+			parts.push_back(rec->data);
+		else
+			parts.push_back(history::framing::pack(rec->timestamp(day_begin), rec->flags | history::framing::ABSOLUTE_TIME, rec->data));
+		total += parts.back().size();
+	}
+
+	auto ret = ioremap::elliptics::data_pointer::allocate(total);
+	size_t offset = 0;
+	for (auto p = parts.begin(), end = parts.end(); p != end; ++p) {
+		memcpy(ret.data<char>() + offset, p->data(), p->size());
+		offset += p->size();
+	}
+
+	return ret;
+}
+
+/* Fills KEYS of in-memory storage with framed logs of synthetic users, so compaction could be benchmarked
+	without elliptics. Logs are appended by batches of page_size records.
+*/
+void seed(std::shared_ptr<history::provider> provider, const options &opts)
+{
+	const auto data = ioremap::elliptics::data_pointer::copy(std::string(consts::SEED_RECORD_SIZE, 'x'));
+	history::tool::progress logs;
+	std::vector<history::log_record> records;
+
+	provider->set_framed_logs(true); // frontends write framed logs, compactor appends already framed data
+	for (auto key = opts.keys.begin(), end = opts.keys.end(); key != end; ++key) {
+		for (uint32_t user = 0; user < opts.seed_users; ++user) {
+			for (uint32_t index = 0; index < opts.seed_records; ++index) {
+				history::log_record record;
+				record.user = "user" + boost::lexical_cast<std::string>(user);
+				record.time = 0;
+				record.subkey = *key;
+				record.data = data;
+				records.emplace_back(record);
+
+				if (records.size() >= opts.page_size || (user + 1 == opts.seed_users && index + 1 == opts.seed_records)) {
+					auto added = provider->add_logs_with_activity(records);
+					if (std::count(added.begin(), added.end(), false) != 0)
+						throw std::runtime_error("failed to generate logs of key: " + *key);
+					logs.add(records.size(), records.size() * consts::SEED_RECORD_SIZE);
+					records.clear();
+				}
+			}
+		}
+	}
+	provider->set_framed_logs(false);
+
+	logs.report("Generated records");
+}
+
+class compactor
+{
+public:
+	compactor(std::shared_ptr<history::provider> provider, const options &opts)
+	: provider_(provider)
+	, opts_(opts)
+	, failed_(0)
+	{}
+
+	int run()
+	{
+		history::tool::checkpoint cp = {0, std::string()};
+		if (!opts_.checkpoint.empty() && cp.load(opts_.checkpoint))
+			std::cout << "Resume from key: " << cp.index << " cursor: " << cp.cursor << std::endl;
+
+		for (; cp.index < opts_.keys.size(); ++cp.index, cp.cursor.clear()) {
+			const auto &key = opts_.keys[cp.index];
+			std::cout << "Compact key: " << key << std::endl;
+
+			do {
+				auto page = provider_->get_active_users(std::vector<std::string>(1, key), opts_.page_size, cp.cursor);
+				process_page(key, page.users);
+				cp.cursor = page.next_cursor;
+
+				if (!opts_.dry_run && !opts_.checkpoint.empty()) {
+					history::tool::checkpoint next = cp;
+					if (next.cursor.empty()) { // the key is completed
+						++next.index;
+					}
+					next.save(opts_.checkpoint);
+				}
+
+				users_.report("Users");
+				logs_.report("Logs");
+			} while (!cp.cursor.empty());
+		}
+
+		std::cout << "Failed users: " << failed_ << std::endl;
+		return failed_ == 0 ? 0 : 1;
+	}
+
+private:
+	void process_page(const std::string &key, std::vector<std::string> users)
+	{
+		if (!opts_.users.empty()) {
+			users.erase(std::remove_if(users.begin(), users.end(),
+			                           [this] (const std::string &user) { return opts_.users.count(user) == 0; }),
+			            users.end());
+		}
+
+		std::vector<ioremap::elliptics::data_pointer> logs(users.size());
+		std::vector<char> read(users.size(), false); // whether log of the user has been read
+		history::tool::in_flight_window window(opts_.in_flight);
+
+		const bool day = key.find_first_not_of("0123456789") == std::string::npos; // records of custom keys have absolute time
+		const uint64_t day_begin = day ? boost::lexical_cast<uint64_t>(key) * consts::SECONDS_IN_DAY : 0;
+
+		for (size_t index = 0; index < users.size(); ++index) { // reads logs of the page with bounded parallelism
+			window.acquire();
+			provider_->get_user_records(users[index], std::vector<std::string>(1, key),
+			                            [&logs, &read, &window, index, day_begin] (const std::vector<history::framing::record> &records, bool completed) {
+			                                if (!records.empty())
+			                                    logs[index] = join_records(records, day_begin);
+			                                read[index] = completed;
+			                                window.release();
+			                            });
+		}
+		window.wait();
+
+		std::vector<history::log_record> records;
+		std::vector<std::string> inactive; // users without logs, only their activity is moved
+		uint64_t bytes = 0;
+
+		for (size_t index = 0; index < users.size(); ++index) {
+			if (!read[index]) { // neither log nor activity of the user is moved, so compaction could be repeated for it
+				std::cerr << "Can't read logs of user: " << users[index] << " key: " << key << std::endl;
+				++failed_;
+				continue;
+			}
+
+			if (logs[index].empty()) {
+				inactive.push_back(users[index]);
+				continue;
+			}
+
+			history::log_record record;
+			record.user = users[index];
+			record.time = 0;
+			record.subkey = opts_.new_key;
+			record.data = logs[index];
+			bytes += record.data.size();
+			records.emplace_back(record);
+		}
+
+		if (!opts_.dry_run) {
+			auto added = provider_->add_logs_with_activity(records); // appends logs and updates activity of the page in one batch
+			failed_ += std::count(added.begin(), added.end(), false);
+
+			for (auto it = inactive.begin(), end = inactive.end(); it != end; ++it) {
+				window.acquire();
+				provider_->add_activity(*it, opts_.new_key, [this, &window] (bool added) {
+					if (!added)
+						++failed_;
+					window.release();
+				});
+			}
+			window.wait();
+		}
+
+		users_.add(users.size(), 0);
+		logs_.add(records.size(), bytes);
+	}
+
+	std::shared_ptr<history::provider>	provider_;
+	const options						&opts_;
+	std::atomic<uint64_t>				failed_; // number of users whose logs or activity haven't been written
+	history::tool::progress				users_; // processed users
+	history::tool::progress				logs_; // compacted logs
+};
+
+int main(int argc, char *argv[])
+{
+	options opts;
+	opts.log_file = consts::LOG_FILE;
+
+	int ch;
+	try {
+		while ((ch = getopt(argc, argv, "r:g:c:p:i:u:s:dM:G:l:L:h")) != -1) {
+			switch (ch) {
+				case 'r': opts.remotes.push_back(optarg); break;
+				case 'g': opts.groups = history::tool::parse_groups(optarg); break;
+				case 'c': opts.chunks = boost::lexical_cast<uint32_t>(optarg); break;
+				case 'p': opts.page_size = boost::lexical_cast<uint32_t>(optarg); break;
+				case 'i': opts.in_flight = boost::lexical_cast<uint32_t>(optarg); break;
+				case 'u': opts.users.insert(optarg); break;
+				case 's': opts.checkpoint = optarg; break;
+				case 'd': opts.dry_run = true; break;
+				case 'M': opts.in_memory = true; opts.latencies = history::tool::parse_latencies(optarg); break;
+				case 'G': {
+					const auto parts = history::tool::split(optarg, ":");
+					if (parts.size() != 2)
+						throw std::invalid_argument("invalid seed: " + std::string(optarg));
+					opts.seed_users = boost::lexical_cast<uint32_t>(parts[0]);
+					opts.seed_records = boost::lexical_cast<uint32_t>(parts[1]);
+					break;
+				}
+				case 'l': opts.log_file = optarg; break;
+				case 'L': opts.log_level = boost::lexical_cast<int>(optarg); break;
+				default:
+					print_usage(argv[0]);
+					return -1;
+			}
+		}
+
+		if (argc - optind != 2 || (!opts.in_memory && (opts.remotes.empty() || opts.groups.empty())) ||
+		    opts.page_size == 0 || (opts.seed_users != 0 && !opts.in_memory))
+			throw std::invalid_argument("invalid arguments");
+
+		opts.keys = history::tool::split(argv[optind], ":");
+		opts.new_key = argv[optind + 1];
+	}
+	catch (...) {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	std::shared_ptr<history::provider> provider;
+	if (opts.in_memory) {
+		history::memory_storage_config config;
+		config.read_latency = opts.latencies[0];
+		config.write_latency = opts.latencies[1];
+		config.index_latency = opts.latencies[2];
+		config.threads = consts::MEMORY_STORAGE_THREADS;
+		provider = std::make_shared<history::provider>(config, opts.log_file, opts.log_level);
+	} else {
+		provider = std::make_shared<history::provider>(opts.remotes, opts.groups, 1,
+		                                               opts.log_file, opts.log_level);
+	}
+	provider->set_activity_chunks(opts.chunks);
+	provider->set_batch_parameters(opts.in_flight);
+
+	std::cout << "Compact keys: " << opts.keys.size() << " into key: " << opts.new_key
+	          << (opts.dry_run ? " (dry run)" : "") << std::endl;
+
+	try {
+		if (opts.seed_users != 0)
+			seed(provider, opts);
+		return compactor(provider, opts).run();
+	}
+	catch (std::exception &e) {
+		std::cerr << "Compaction failed: " << e.what() << std::endl;
+		return -1;
+	}
+}
@@ -0,0 +1,313 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/lexical_cast.hpp>
+
+#include "historydb/provider.h"
+#include "historydb/framing.h"
+
+#include "tool.h"
+
+namespace consts {
+	const uint32_t SECONDS_IN_DAY = 24 * 60 * 60;
+	const char LOG_FILE[] = "historydb-export.log";
+	const uint32_t FORMAT_VERSION = 1; // version of layout of exported files
+} /* namespace consts */
+
+struct options
+{
+	options()
+	: log_level(1)
+	, chunks(1)
+	, page_size(1024)
+	, in_flight(128)
+	, timestamps(false)
+	{}
+
+	std::vector<std::string>	remotes; // elliptics nodes as addr:port:family
+	std::vector<int>			groups; // elliptics groups
+	std::string					log_file; // elliptics client log
+	int							log_level; // elliptics client log level
+	uint32_t					chunks; // number of activity chunks which is used by frontends
+	uint32_t					page_size; // number of users which are read from activity index at once
+	uint32_t					in_flight; // maximum number of reads in flight
+	bool						timestamps; // whether column of timestamps is written
+	std::vector<std::string>	keys; // exported subkeys
+	std::string					output; // output directory
+};
+
+void print_usage(char *s)
+{
+	std::cout << "Usage: " << s << " [options] KEYS OUTPUT\n"
+	<< "Exports logs of users who are active in KEYS (separated by ':') into directory OUTPUT/<key>.\n"
+	<< "Instead of KEYS days could be specified as begin_time-end_time (in seconds).\n"
+	<< " -r addr:port:family    - adds a route to the given node, could be specified several times\n"
+	<< " -g groups              - groups id to connect which are separated by ','\n"
+	<< " -c chunks              - number of activity chunks which is used by frontends [1]\n"
+	<< " -p page_size           - number of users which are read and kept in memory at once [1024]\n"
+	<< " -i in_flight           - maximum number of reads in flight [128]\n"
+	<< " -t                     - writes column of timestamps of records\n"
+	<< " -l log_file            - elliptics client log [historydb-export.log]\n"
+	<< " -L log_level           - elliptics client log level [1]\n"
+	;
+}
+
+/* Columnar files of one exported key. All columns are arrays of little-endian fixed size values
+	or concatenated bytes, so they could be mapped into memory and scanned without parsing:
+	users - concatenated names of users
+	users.offsets - uint64 offsets of names in users, number of users + 1 values
+	users.records - uint64 index of the first record of each user, number of users + 1 values
+	payload - concatenated payloads of records
+	payload.offsets - uint64 offsets of payloads in payload, number of records + 1 values
+	timestamps - uint64 absolute timestamp of each record (in seconds), only if it is requested
+	meta - text description of the export
+*/
+class key_export
+{
+public:
+	key_export(const std::string &dir, const std::string &key, bool timestamps)
+	: dir_(dir)
+	, key_(key)
+	, timestamps_(timestamps)
+	, users_size_(0)
+	, users_count_(0)
+	, payload_size_(0)
+	, records_count_(0)
+	{
+		open(users_, "users");
+		open(users_offsets_, "users.offsets");
+		open(users_records_, "users.records");
+		open(payload_, "payload");
+		open(payload_offsets_, "payload.offsets");
+		if (timestamps_)
+			open(timestamps_file_, "timestamps");
+
+		write(users_offsets_, 0);
+		write(users_records_, 0);
+		write(payload_offsets_, 0);
+	}
+
+	uint64_t add(const std::string &user, const std::vector<history::framing::record> &records, uint64_t day_begin)
+	{
+		const uint64_t begin_size = payload_size_;
+
+		for (auto rec = records.begin(), end = records.end(); rec != end; ++rec) {
+			payload_.write(rec->data.data<char>(), rec->data.size());
+			payload_size_ += rec->data.size();
+			write(payload_offsets_, payload_size_);
+
+			if (timestamps_)
+				write(timestamps_file_, rec->framed ? rec->timestamp(day_begin) : day_begin); // legacy log has no time of records
+
+			++records_count_;
+		}
+
+		users_.write(user.data(), user.size());
+		users_size_ += user.size();
+		write(users_offsets_, users_size_);
+		write(users_records_, records_count_);
+		++users_count_;
+
+		return payload_size_ - begin_size;
+	}
+
+	uint64_t finish()
+	{
+		std::ofstream meta((dir_ + "/meta").c_str(), std::ios::trunc);
+		meta << "version " << consts::FORMAT_VERSION << '\n'
+		     << "key " << key_ << '\n'
+		     << "users " << users_count_ << '\n'
+		     << "records " << records_count_ << '\n'
+		     << "payload_bytes " << payload_size_ << '\n'
+		     << "timestamps " << (timestamps_ ? 1 : 0) << '\n';
+
+		std::ofstream *files[] = {&users_, &users_offsets_, &users_records_, &payload_, &payload_offsets_, &timestamps_file_, &meta};
+		for (auto it = std::begin(files), end = std::end(files); it != end; ++it) {
+			if ((*it)->is_open() && !(*it)->flush())
+				throw std::runtime_error("can't write files of key: " + key_);
+		}
+
+		return records_count_;
+	}
+
+private:
+	void open(std::ofstream &file, const char *name)
+	{
+		const std::string path = dir_ + "/" + name;
+		file.open(path.c_str(), std::ios::binary | std::ios::trunc);
+		if (!file)
+			throw std::runtime_error("can't create file: " + path);
+	}
+
+	static void write(std::ofstream &file, uint64_t value) // writes value as little-endian regardless of the host
+	{
+		char bytes[sizeof(value)];
+		for (size_t i = 0; i < sizeof(value); ++i) {
+			bytes[i] = static_cast<char>(value >> (8 * i));
+		}
+		file.write(bytes, sizeof(bytes));
+	}
+
+	const std::string	dir_; // directory of the key
+	const std::string	key_; // exported key
+	const bool			timestamps_; // whether column of timestamps is written
+	std::ofstream		users_, users_offsets_, users_records_, payload_, payload_offsets_, timestamps_file_;
+	uint64_t			users_size_; // size of written names of users
+	uint64_t			users_count_; // number of written users
+	uint64_t			payload_size_; // size of written payloads
+	uint64_t			records_count_; // number of written records
+};
+
+void make_dir(const std::string &path)
+{
+	if (::mkdir(path.c_str(), 0755) != 0 && errno != EEXIST)
+		throw std::runtime_error("can't create directory: " + path);
+}
+
+std::vector<std::string> parse_keys(const std::string &value)
+{
+	const auto times = history::tool::split(value, "-");
+	if (times.size() != 2)
+		return history::tool::split(value, ":");
+
+	std::vector<std::string> ret; // days of the period
+	const uint64_t end = boost::lexical_cast<uint64_t>(times[1]) / consts::SECONDS_IN_DAY;
+	for (uint64_t day = boost::lexical_cast<uint64_t>(times[0]) / consts::SECONDS_IN_DAY; day <= end; ++day) {
+		ret.push_back(boost::lexical_cast<std::string>(day));
+	}
+	return ret;
+}
+
+/* Exports logs of users who are active in the key. Users whose logs couldn't be read aren't written.
+	returns number of such users
+*/
+uint64_t export_key(std::shared_ptr<history::provider> provider, const options &opts, const std::string &key,
+                    history::tool::progress &users, history::tool::progress &records)
+{
+	const std::string dir = opts.output + "/" + key;
+	make_dir(dir);
+
+	const bool day = key.find_first_not_of("0123456789") == std::string::npos;
+	const uint64_t day_begin = day ? boost::lexical_cast<uint64_t>(key) * consts::SECONDS_IN_DAY : 0;
+
+	key_export files(dir, key, opts.timestamps);
+	history::tool::in_flight_window window(opts.in_flight);
+	std::string cursor;
+	uint64_t failed = 0;
+
+	do {
+		auto page = provider->get_active_users(std::vector<std::string>(1, key), opts.page_size, cursor);
+		cursor = page.next_cursor;
+
+		std::vector<std::vector<history::framing::record>> logs(page.users.size()); // only logs of one page are kept in memory
+		std::vector<char> read(page.users.size(), false); // whether log of the user has been read
+
+		for (size_t index = 0; index < page.users.size(); ++index) {
+			window.acquire();
+			provider->get_user_records(page.users[index], std::vector<std::string>(1, key),
+			                           [&logs, &read, &window, index] (const std::vector<history::framing::record> &records, bool completed) {
+			                               logs[index] = records;
+			                               read[index] = completed;
+			                               window.release();
+			                           });
+		}
+		window.wait();
+
+		uint64_t bytes = 0;
+		for (size_t index = 0; index < page.users.size(); ++index) { // users are written in order of the page
+			if (!read[index]) {
+				std::cerr << "Can't read logs of user: " << page.users[index] << " key: " << key << std::endl;
+				++failed;
+				continue;
+			}
+			bytes += files.add(page.users[index], logs[index], day_begin);
+		}
+
+		users.add(page.users.size(), bytes);
+		users.report("Users");
+	} while (!cursor.empty());
+
+	records.add(files.finish(), 0);
+	records.report("Records");
+	return failed;
+}
+
+int main(int argc, char *argv[])
+{
+	options opts;
+	opts.log_file = consts::LOG_FILE;
+
+	int ch;
+	try {
+		while ((ch = getopt(argc, argv, "r:g:c:p:i:tl:L:h")) != -1) {
+			switch (ch) {
+				case 'r': opts.remotes.push_back(optarg); break;
+				case 'g': opts.groups = history::tool::parse_groups(optarg); break;
+				case 'c': opts.chunks = boost::lexical_cast<uint32_t>(optarg); break;
+				case 'p': opts.page_size = boost::lexical_cast<uint32_t>(optarg); break;
+				case 'i': opts.in_flight = boost::lexical_cast<uint32_t>(optarg); break;
+				case 't': opts.timestamps = true; break;
+				case 'l': opts.log_file = optarg; break;
+				case 'L': opts.log_level = boost::lexical_cast<int>(optarg); break;
+				default:
+					print_usage(argv[0]);
+					return -1;
+			}
+		}
+
+		if (argc - optind != 2 || opts.remotes.empty() || opts.groups.empty() || opts.page_size == 0)
+			throw std::invalid_argument("invalid arguments");
+
+		opts.keys = parse_keys(argv[optind]);
+		opts.output = argv[optind + 1];
+	}
+	catch (...) {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	auto provider = std::make_shared<history::provider>(opts.remotes, opts.groups, 1,
+	                                                    opts.log_file, opts.log_level);
+	provider->set_activity_chunks(opts.chunks);
+
+	uint64_t failed = 0;
+	try {
+		make_dir(opts.output);
+
+		history::tool::progress users, records;
+		for (auto it = opts.keys.begin(), end = opts.keys.end(); it != end; ++it) {
+			std::cout << "Export key: " << *it << std::endl;
+			failed += export_key(provider, opts, *it, users, records);
+		}
+	}
+	catch (std::exception &e) {
+		std::cerr << "Export failed: " << e.what() << std::endl;
+		return -1;
+	}
+
+	std::cout << "Failed users: " << failed << std::endl;
+	return failed == 0 ? 0 : 1;
+}
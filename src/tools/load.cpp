@@ -0,0 +1,384 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+
+#include <unistd.h>
+
+#include <boost/lexical_cast.hpp>
+
+#include "historydb/provider.h"
+#include "historydb/framing.h"
+
+#include "../fastcgi/rapidjson/document.h"
+
+#include "tool.h"
+
+namespace consts {
+	const uint32_t SECONDS_IN_DAY = 24 * 60 * 60;
+	const char LOG_FILE[] = "historydb-load.log";
+	const uint32_t MAX_FIELD_SIZE = 64 * 1024 * 1024; // maximum size of user name or data in binary input
+} /* namespace consts */
+
+struct options
+{
+	options()
+	: log_level(1)
+	, chunks(1)
+	, binary(false)
+	, framed(false)
+	, batch_size(100000)
+	, in_flight(1024)
+	, activity_cache_size(64 * 1024 * 1024)
+	{}
+
+	std::vector<std::string>	remotes; // elliptics nodes as addr:port:family
+	std::vector<int>			groups; // elliptics groups
+	std::string					log_file; // elliptics client log
+	int							log_level; // elliptics client log level
+	uint32_t					chunks; // number of activity chunks which is used by frontends
+	bool						binary; // whether input is length-prefixed binary instead of NDJSON
+	bool						framed; // whether loaded records are framed
+	uint32_t					batch_size; // number of input records which are grouped and written at once
+	uint32_t					in_flight; // maximum number of writes in flight
+	size_t						activity_cache_size; // size of activity cache which skips repeated activity updates
+	std::string					checkpoint; // checkpoint file
+	std::string					input; // input file
+};
+
+void print_usage(char *s)
+{
+	std::cout << "Usage: " << s << " [options] INPUT\n"
+	<< "Loads user logs from INPUT and adds users to activity statistics.\n"
+	<< "INPUT is NDJSON: one object {\"user\": ..., \"time\": ..., \"data\": ...} per line with optional \"subkey\",\n"
+	<< "or binary (-b): records of [u32 user size][user][u64 time][u32 data size][data] in little-endian.\n"
+	<< " -r addr:port:family    - adds a route to the given node, could be specified several times\n"
+	<< " -g groups              - groups id to connect which are separated by ','\n"
+	<< " -c chunks              - number of activity chunks which is used by frontends [1]\n"
+	<< " -b                     - input is length-prefixed binary file\n"
+	<< " -f                     - frames loaded records (see historydb/framing.h)\n"
+	<< " -n batch_size          - number of input records which are grouped and written at once [100000]\n"
+	<< " -i in_flight           - maximum number of writes in flight [1024]\n"
+	<< " -a cache_size          - size of activity cache in bytes, 0 disables it [67108864]\n"
+	<< " -s checkpoint          - checkpoint file, load is resumed from it and it is updated after each batch\n"
+	<< " -l log_file            - elliptics client log [historydb-load.log]\n"
+	<< " -L log_level           - elliptics client log level [1]\n"
+	;
+}
+
+/* Record of input file */
+struct input_record
+{
+	std::string	user; // name of user
+	std::string	subkey; // custom key or day of the record
+	uint64_t	time; // timestamp of the record (in seconds)
+	std::string	data; // record data
+};
+
+/* Reads records from NDJSON or length-prefixed binary input
+*/
+class input_reader
+{
+public:
+	input_reader(const std::string &path, bool binary)
+	: file_(path.c_str(), std::ios::binary)
+	, binary_(binary)
+	, line_(0)
+	{
+		if (!file_)
+			throw std::runtime_error("can't open input: " + path);
+	}
+
+	void seek(uint64_t offset)
+	{
+		file_.seekg(offset);
+		if (!file_)
+			throw std::runtime_error("can't seek input to checkpoint offset");
+	}
+
+	uint64_t offset() // offset of the next record
+	{
+		if (file_.eof()) // tellg fails after the end of input has been reached
+			file_.clear();
+		return file_.tellg();
+	}
+
+	/* Reads next record
+		rec - record which is filled with the next record
+		returns false at the end of input
+	*/
+	bool next(input_record &rec)
+	{
+		return binary_ ? next_binary(rec) : next_json(rec);
+	}
+
+private:
+	bool next_json(input_record &rec)
+	{
+		std::string line;
+		while (std::getline(file_, line)) {
+			++line_;
+			if (line.find_first_not_of(" \t\r") == std::string::npos) // skips empty lines
+				continue;
+
+			rapidjson::Document doc;
+			doc.Parse<0>(line.c_str());
+
+			if (doc.HasParseError() || !doc.IsObject() ||
+			    !doc.HasMember("user") || !doc["user"].IsString() ||
+			    !doc.HasMember("data") || !doc["data"].IsString() ||
+			    (doc.HasMember("time") && !doc["time"].IsUint64()) ||
+			    (doc.HasMember("subkey") && !doc["subkey"].IsString()) ||
+			    (!doc.HasMember("time") && !doc.HasMember("subkey")))
+				throw std::runtime_error("invalid record at line " + boost::lexical_cast<std::string>(line_));
+
+			rec.user.assign(doc["user"].GetString(), doc["user"].GetStringLength());
+			rec.data.assign(doc["data"].GetString(), doc["data"].GetStringLength());
+			rec.time = doc.HasMember("time") ? doc["time"].GetUint64() : 0;
+			rec.subkey = doc.HasMember("subkey") ? doc["subkey"].GetString() : std::string();
+			return true;
+		}
+		return false;
+	}
+
+	bool next_binary(input_record &rec)
+	{
+		uint32_t size = 0;
+		if (!file_.read(reinterpret_cast<char *>(&size), sizeof(size))) {
+			if (file_.gcount() != 0)
+				throw std::runtime_error("truncated record at the end of input");
+			return false;
+		}
+
+		read_field(rec.user, size);
+		if (!file_.read(reinterpret_cast<char *>(&rec.time), sizeof(rec.time)) ||
+		    !file_.read(reinterpret_cast<char *>(&size), sizeof(size)))
+			throw std::runtime_error("truncated record at the end of input");
+		read_field(rec.data, size);
+		rec.subkey.clear();
+		return true;
+	}
+
+	void read_field(std::string &field, uint32_t size)
+	{
+		if (size > consts::MAX_FIELD_SIZE)
+			throw std::runtime_error("invalid size of record field: " + boost::lexical_cast<std::string>(size));
+
+		field.resize(size);
+		if (size != 0 && !file_.read(&field[0], size))
+			throw std::runtime_error("truncated record at the end of input");
+	}
+
+	std::ifstream	file_; // input file
+	const bool		binary_; // whether input is length-prefixed binary
+	uint64_t		line_; // number of read lines of NDJSON input
+};
+
+class loader
+{
+public:
+	loader(std::shared_ptr<history::provider> provider, const options &opts)
+	: provider_(provider)
+	, opts_(opts)
+	, failed_(0)
+	{}
+
+	int run()
+	{
+		input_reader input(opts_.input, opts_.binary);
+
+		history::tool::checkpoint cp = {0, opts_.input};
+		if (!opts_.checkpoint.empty() && cp.load(opts_.checkpoint)) {
+			if (cp.cursor != opts_.input)
+				throw std::runtime_error("checkpoint belongs to other input: " + cp.cursor);
+			std::cout << "Resume from offset: " << cp.index << std::endl;
+			input.seek(cp.index);
+		}
+
+		std::vector<input_record> batch;
+		input_record rec;
+
+		while (true) {
+			batch.clear();
+			while (batch.size() < opts_.batch_size && input.next(rec)) {
+				batch.push_back(rec);
+			}
+
+			if (batch.empty())
+				break;
+
+			write_batch(batch);
+
+			cp.index = input.offset();
+			if (!opts_.checkpoint.empty())
+				cp.save(opts_.checkpoint);
+
+			records_.report("Records");
+			writes_.report("Writes");
+		}
+
+		std::cout << "Failed records: " << failed_ << std::endl;
+		return failed_ == 0 ? 0 : 1;
+	}
+
+private:
+	/* Groups records of the batch by combined key of user and subkey and writes each group by one append.
+		Groups are ordered by subkey, so activity of each subkey is updated together
+		and the activity cache skips users which have been already added.
+	*/
+	void write_batch(std::vector<input_record> &batch)
+	{
+		for (auto it = batch.begin(), end = batch.end(); it != end; ++it) {
+			if (it->subkey.empty())
+				it->subkey = boost::lexical_cast<std::string>(it->time / consts::SECONDS_IN_DAY);
+		}
+
+		std::stable_sort(batch.begin(), batch.end(), [] (const input_record &lhs, const input_record &rhs) {
+			if (lhs.subkey != rhs.subkey)
+				return lhs.subkey < rhs.subkey;
+			if (lhs.user != rhs.user)
+				return lhs.user < rhs.user;
+			return lhs.time < rhs.time; // records of one key are appended in order of time
+		});
+
+		std::vector<history::log_record> records;
+		uint64_t bytes = 0;
+
+		for (size_t begin = 0, end = 0; begin < batch.size(); begin = end) {
+			size_t size = 0;
+			for (end = begin; end < batch.size() &&
+			                  batch[end].subkey == batch[begin].subkey &&
+			                  batch[end].user == batch[begin].user; ++end) {
+				size += batch[end].data.size() + history::framing::MAX_HEADER_SIZE;
+			}
+
+			history::log_record record;
+			record.user = batch[begin].user;
+			record.time = batch[begin].time;
+			record.subkey = batch[begin].subkey;
+			record.data = concatenate(batch, begin, end, size);
+			bytes += record.data.size();
+			records.emplace_back(record);
+		}
+
+		auto added = provider_->add_logs_with_activity(records);
+		failed_ += count_failed(batch, added);
+
+		records_.add(batch.size(), bytes);
+		writes_.add(records.size(), bytes);
+	}
+
+	/* Concatenates data of records [begin, end) of one key, records are framed if it is enabled */
+	ioremap::elliptics::data_pointer concatenate(const std::vector<input_record> &batch, size_t begin, size_t end, size_t max_size)
+	{
+		std::string data;
+		data.reserve(max_size);
+
+		const bool day = batch[begin].subkey.find_first_not_of("0123456789") == std::string::npos;
+
+		for (size_t index = begin; index < end; ++index) {
+			const auto &rec = batch[index];
+			if (!opts_.framed) {
+				data.append(rec.data);
+				continue;
+			}
+
+			auto framed = history::framing::pack(rec.time, day ? 0 : history::framing::ABSOLUTE_TIME,
+			                                     ioremap::elliptics::data_pointer::from_raw(const_cast<char *>(rec.data.data()), rec.data.size()));
+			data.append(framed.data<char>(), framed.size());
+		}
+
+		return ioremap::elliptics::data_pointer::copy(data.data(), data.size());
+	}
+
+	/* Counts input records whose groups haven't been written */
+	static uint64_t count_failed(const std::vector<input_record> &batch, const std::vector<bool> &added)
+	{
+		uint64_t ret = 0;
+		size_t group = 0;
+		for (size_t index = 0; index < batch.size(); ++index) {
+			if (index > 0 && (batch[index].subkey != batch[index - 1].subkey || batch[index].user != batch[index - 1].user))
+				++group;
+			if (!added[group])
+				++ret;
+		}
+		return ret;
+	}
+
+	std::shared_ptr<history::provider>	provider_;
+	const options						&opts_;
+	uint64_t							failed_; // number of input records which haven't been written
+	history::tool::progress				records_; // loaded input records
+	history::tool::progress				writes_; // appends of grouped records
+};
+
+int main(int argc, char *argv[])
+{
+	options opts;
+	opts.log_file = consts::LOG_FILE;
+
+	int ch;
+	try {
+		while ((ch = getopt(argc, argv, "r:g:c:bfn:i:a:s:l:L:h")) != -1) {
+			switch (ch) {
+				case 'r': opts.remotes.push_back(optarg); break;
+				case 'g': opts.groups = history::tool::parse_groups(optarg); break;
+				case 'c': opts.chunks = boost::lexical_cast<uint32_t>(optarg); break;
+				case 'b': opts.binary = true; break;
+				case 'f': opts.framed = true; break;
+				case 'n': opts.batch_size = boost::lexical_cast<uint32_t>(optarg); break;
+				case 'i': opts.in_flight = boost::lexical_cast<uint32_t>(optarg); break;
+				case 'a': opts.activity_cache_size = boost::lexical_cast<size_t>(optarg); break;
+				case 's': opts.checkpoint = optarg; break;
+				case 'l': opts.log_file = optarg; break;
+				case 'L': opts.log_level = boost::lexical_cast<int>(optarg); break;
+				default:
+					print_usage(argv[0]);
+					return -1;
+			}
+		}
+
+		if (argc - optind != 1 || opts.remotes.empty() || opts.groups.empty() || opts.batch_size == 0)
+			throw std::invalid_argument("invalid arguments");
+
+		opts.input = argv[optind];
+	}
+	catch (...) {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	auto provider = std::make_shared<history::provider>(opts.remotes, opts.groups, 1,
+	                                                    opts.log_file, opts.log_level);
+	provider->set_activity_chunks(opts.chunks);
+	provider->set_batch_parameters(opts.in_flight);
+	provider->set_activity_cache_parameters(opts.activity_cache_size);
+	provider->set_framed_logs(false); // records are framed by the loader, because one append contains several records
+
+	try {
+		return loader(provider, opts).run();
+	}
+	catch (std::exception &e) {
+		std::cerr << "Load failed: " << e.what() << std::endl;
+		return -1;
+	}
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#include "tool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+
+namespace history { namespace tool {
+
+in_flight_window::in_flight_window(uint32_t max_in_flight)
+: max_in_flight_(std::max<uint32_t>(max_in_flight, 1))
+, in_flight_(0)
+{}
+
+void in_flight_window::acquire()
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	while (in_flight_ >= max_in_flight_) {
+		cond_.wait(lock);
+	}
+	++in_flight_;
+}
+
+void in_flight_window::release()
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	--in_flight_;
+	cond_.notify_all();
+}
+
+void in_flight_window::wait()
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	while (in_flight_ != 0) {
+		cond_.wait(lock);
+	}
+}
+
+progress::progress()
+: start_(boost::posix_time::microsec_clock::universal_time())
+, items_(0)
+, bytes_(0)
+{}
+
+void progress::add(uint64_t items, uint64_t bytes)
+{
+	boost::mutex::scoped_lock lock(mutex_);
+	items_ += items;
+	bytes_ += bytes;
+}
+
+void progress::report(const std::string &what)
+{
+	boost::mutex::scoped_lock lock(mutex_);
+
+	const auto elapsed = boost::posix_time::microsec_clock::universal_time() - start_;
+	const double seconds = std::max(elapsed.total_microseconds() / 1000000.0, 0.000001);
+
+	std::cout << what << ": " << items_ << " (" << static_cast<uint64_t>(items_ / seconds) << "/s), "
+	          << bytes_ << " bytes (" << bytes_ / seconds / (1024 * 1024) << " MB/s), "
+	          << seconds << " s" << std::endl;
+}
+
+bool checkpoint::load(const std::string &path)
+{
+	std::ifstream file(path.c_str());
+	if (!file)
+		return false;
+
+	std::string line;
+	if (!std::getline(file, line))
+		return false;
+
+	index = boost::lexical_cast<uint64_t>(line);
+	std::getline(file, cursor); // cursor could contain any characters except new line
+	return true;
+}
+
+void checkpoint::save(const std::string &path) const
+{
+	const std::string tmp_path = path + ".tmp";
+
+	{
+		std::ofstream file(tmp_path.c_str(), std::ios::trunc);
+		file << index << '\n' << cursor << '\n';
+		if (!file.flush())
+			throw std::runtime_error("can't write checkpoint: " + tmp_path);
+	}
+
+	if (::rename(tmp_path.c_str(), path.c_str()) != 0) // readers see the old or the new checkpoint, never partial one
+		throw std::runtime_error("can't replace checkpoint: " + path);
+}
+
+std::vector<std::string> split(const std::string &value, const char *separators)
+{
+	std::vector<std::string> ret;
+	boost::split(ret, value, boost::is_any_of(separators));
+	return ret;
+}
+
+std::vector<int> parse_groups(const std::string &value)
+{
+	std::vector<int> ret;
+	const auto strs = split(value, ",");
+	for (auto it = strs.begin(), end = strs.end(); it != end; ++it) {
+		ret.push_back(boost::lexical_cast<int>(*it));
+	}
+	return ret;
+}
+
+std::vector<uint32_t> parse_latencies(const std::string &value)
+{
+	const auto parts = split(value, ":");
+	if (parts.size() != 3)
+		throw std::invalid_argument("invalid latencies: " + value);
+
+	std::vector<uint32_t> ret;
+	for (auto it = parts.begin(), end = parts.end(); it != end; ++it) {
+		ret.push_back(boost::lexical_cast<uint32_t>(*it));
+	}
+	return ret;
+}
+
+}} /* namespace history::tool */
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+
+#ifndef HISTORY_SRC_TOOLS_TOOL_H
+#define HISTORY_SRC_TOOLS_TOOL_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace history { namespace tool {
+
+/* Limits number of asynchronous requests which are in flight at once
+*/
+class in_flight_window
+{
+public:
+	in_flight_window(uint32_t max_in_flight);
+
+	void acquire(); // waits until the window has free place and takes it
+	void release(); // frees place which has been taken by acquire
+	void wait(); // waits until all taken places are freed
+
+private:
+	const uint32_t				max_in_flight_; // maximum number of requests in flight
+	uint32_t					in_flight_; // number of requests in flight
+	boost::mutex				mutex_;
+	boost::condition_variable	cond_;
+};
+
+/* Counts processed items and bytes and prints throughput
+*/
+class progress
+{
+public:
+	progress();
+
+	void add(uint64_t items, uint64_t bytes);
+	void report(const std::string &what); // prints totals and throughput since creation to stdout
+
+private:
+	const boost::posix_time::ptime	start_; // time of creation
+	uint64_t						items_; // number of processed items
+	uint64_t						bytes_; // size of processed items
+	boost::mutex					mutex_;
+};
+
+/* Position of a tool which has processed input up to it. Checkpoint is saved into local file,
+	so interrupted tool could be restarted from the last saved position.
+*/
+struct checkpoint
+{
+	uint64_t	index; // index of input (key, file offset etc.) which is being processed
+	std::string	cursor; // position inside the input
+
+	bool load(const std::string &path); // returns false if there is no checkpoint
+	void save(const std::string &path) const; // replaces checkpoint file atomically
+};
+
+std::vector<std::string> split(const std::string &value, const char *separators);
+std::vector<int> parse_groups(const std::string &value); // parses groups which are separated by ','
+std::vector<uint32_t> parse_latencies(const std::string &value); // parses read:write:index latencies of in-memory storage
+
+}} /* namespace history::tool */
+
+#endif //HISTORY_SRC_TOOLS_TOOL_H
@@ -68,7 +68,7 @@ class historydb(object):
             return (500, "")
         return res.status
 
-    def get_user_logs(self, user, keys=None, begin_time=None, end_time=None):
+    def get_user_logs(self, user, keys=None, begin_time=None, end_time=None, limit=None, cursor=None):
         p = {'user': user}
         if keys:
                 p["keys"] = ':'.join(keys)
@@ -77,12 +77,16 @@ class historydb(object):
                 p['end_time'] = end_time
         else:
                 return
+        if limit is not None:
+                p['limit'] = limit
+        if cursor is not None:
+                p['cursor'] = cursor
         res = self.__send__(p, "/get_user_logs", "GET")
         if res is None:
             return (500, "")
         return (res.status, res.read(), res.reason)
 
-    def get_active_users(self, begin_time=None, end_time=None, keys=None):
+    def get_active_users(self, begin_time=None, end_time=None, keys=None, limit=None, cursor=None):
         p = {}
         if keys:
                 p["keys"] = ':'.join(keys)
@@ -91,11 +95,29 @@ class historydb(object):
                 p['end_time'] = end_time
         else:
                 return
+        if limit is not None:
+                p['limit'] = limit
+        if cursor is not None:
+                p['cursor'] = cursor
         res = self.__send__(p, "/get_active_users", "GET")
         if res is None:
             return (500, "")
         return (res.status, res.read(), res.reason)
 
+    def combine_active_users(self, op, keys):
+        p = {"op": op,
+             "keys": ';'.join([':'.join(x) for x in keys])}
+        res = self.__send__(p, "/combine_active_users", "GET")
+        if res is None:
+            return (500, "")
+        return (res.status, res.read(), res.reason)
+
+    def stats(self):
+        res = self.__send__({}, "/stats", "GET")
+        if res is None:
+            return (500, "")
+        return (res.status, res.read(), res.reason)
+
     def __send__(self, params, url, method="POST"):
         try:
             from httplib import HTTPConnection
@@ -29,7 +29,7 @@ random.seed()
 ioserv, thevoid, root_dir = (None, None, None)
 
 
-def output_configs(host):
+def output_configs(host, memory, framed):
     e_str_conf = '''log = {0}/historydb-elliptics.log
 log_level = 5
 group = 1
@@ -59,6 +59,17 @@ data = {0}/data
 iterate_thread_num = 2'''.format(root_dir, host)
     e_conf = open(root_dir + '/elliptics.conf', "w+")
     e_conf.write(e_str_conf)
+    if memory:
+        storage = '''"memory_storage": {
+            "threads": 2
+        }'''
+    else:
+        storage = '''"remotes": [
+            "{0}:2025:2"
+        ],
+        "groups": [
+            1
+        ]'''.format(host)
     h_str_json = '''{{
     "endpoints": [
         "0.0.0.0:8082"
@@ -71,19 +82,15 @@ iterate_thread_num = 2'''.format(root_dir, host)
     "application": {{
         "loglevel": 5,
         "logfile": "{0}/historydb-test.log",
-        "remotes": [
-            "{1}:2025:2"
-        ],
-        "groups": [
-            1
-        ]
+        "framed_logs": {2},
+        {1}
     }}
-}}'''.format(root_dir, host)
+}}'''.format(root_dir, storage, 'true' if framed else 'false')
     h_json = open(root_dir + '/historydb.json', "w+")
     h_json.write(h_str_json)
 
 
-def start(host, tmp_dir):
+def start(host, tmp_dir, memory=False, framed=False):
     global root_dir, ioserv, thevoid
 
     if not os.path.exists(tmp_dir):
@@ -96,10 +103,11 @@ def start(host, tmp_dir):
 
     root_dir = os.path.join(tmp_dir, 'historydb-test-' + hex(random.randint(0, sys.maxint))[2:])
     os.mkdir(root_dir)
-    output_configs(host=host)
+    output_configs(host=host, memory=memory, framed=framed)
 
-    ioserv = Popen(['dnet_ioserv', '-c', root_dir + '/elliptics.conf'])
-    sleep(0.5)
+    if not memory:
+        ioserv = Popen(['dnet_ioserv', '-c', root_dir + '/elliptics.conf'])
+        sleep(0.5)
     thevoid = Popen(['historydb-thevoid', '-c', root_dir + '/historydb.json'])
     sleep(0.5)
 
@@ -118,7 +126,8 @@ def stop_app(app):
 def stop(leave=False):
     global ioserv, thevoid
 
-    stop_app(ioserv)
+    if ioserv:
+        stop_app(ioserv)
     ioserv = None
 
     stop_app(thevoid)
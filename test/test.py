@@ -87,6 +87,45 @@ def check_logs(hdb, user, keys=None, begin_time=None, end_time=None):
         return True
 
 
+def check_paged_logs(hdb, user, limit, keys=None, begin_time=None, end_time=None):
+    cmp_logs = ''
+    if keys:
+        cmp_logs = ''.join([logs[user + x] for x in keys])
+    else:
+        cmp_logs = ''.join([logs[user + str(x)] for x in range(int(begin_time / (24 * 60 * 60)), int(end_time / (24 * 60 * 60)) + 1)])
+
+    log.debug("Getting user '{0}' logs by pages of {1} bytes".format(user, limit))
+    r_logs = ''
+    cursor = ''
+    while True:
+        resp = hdb.get_user_logs(user=user, keys=keys, begin_time=begin_time, end_time=end_time, limit=limit, cursor=cursor)
+        if resp[0] != 200:
+            log.error("Error while getting page of user logs")
+            return False
+        elif resp[1] == '':
+            break
+        try:
+            page = json.loads(resp[1])
+        except Exception as e:
+            log.error("Got exception: {0}".format(e))
+            return False
+        page_logs = ''.join(page['logs'])
+        if len(page_logs) > limit:
+            log.error("Page exceeds limit: {0} > {1}".format(len(page_logs), limit))
+            return False
+        r_logs += page_logs
+        cursor = page['next_cursor']
+        if not cursor:
+            break
+
+    if r_logs != cmp_logs:
+        log.error("Invalid logs from paginated getter: {0} != {1}".format(len(r_logs), len(cmp_logs)))
+        return False
+    else:
+        log.debug("Logs from paginated getter is checked and it's OK")
+        return True
+
+
 def check_activity(hdb, keys=None, begin_time=None, end_time=None):
     log.debug("Getting users activity by keys: {0} and time period: [{1} - {2}]".format(keys, begin_time, end_time))
     resp = hdb.get_active_users(keys=keys, begin_time=begin_time, end_time=end_time)
@@ -115,6 +154,95 @@ def check_activity(hdb, keys=None, begin_time=None, end_time=None):
         return True
 
 
+def check_paged_activity(hdb, limit, keys=None, begin_time=None, end_time=None):
+    users = set()
+    if keys:
+        users = set(itertools.chain(*[activity[x] for x in keys]))
+    else:
+        users = set(itertools.chain(*[activity[x] for x in range(int(begin_time / (24 * 60 * 60)), int(end_time / (24 * 60 * 60)) + 1)]))
+
+    log.debug("Getting users activity by pages of {0} users".format(limit))
+    r_users = []
+    cursor = ''
+    while True:
+        resp = hdb.get_active_users(keys=keys, begin_time=begin_time, end_time=end_time, limit=limit, cursor=cursor)
+        if resp[0] != 200:
+            log.error("Error while getting page of users activity")
+            return False
+        elif resp[1] == '':
+            break
+        try:
+            page = json.loads(resp[1])
+        except Exception as e:
+            log.error("Got exception: {0}".format(e))
+            return False
+        if len(page['active_users']) > limit:
+            log.error("Page exceeds limit: {0} > {1}".format(len(page['active_users']), limit))
+            return False
+        r_users += page['active_users']
+        cursor = page['next_cursor']
+        if not cursor:
+            break
+
+    if len(r_users) != len(set(r_users)) or set(r_users) != users:
+        log.error("Invalid activity from paginated getter: {0} != {1}".format(len(r_users), len(users)))
+        return False
+    else:
+        log.debug("Activity from paginated getter is checked and it's OK")
+        return True
+
+
+def check_combined_activity(hdb, keys):
+    operands = [set(itertools.chain(*[activity[x] for x in k])) for k in keys]
+    expected = {'union': operands[0].union(*operands[1:]),
+                'intersect': operands[0].intersection(*operands[1:]),
+                'diff': operands[0].difference(*operands[1:])}
+
+    for op in ['union', 'intersect', 'diff']:
+        log.debug("Combining users activity by '{0}' of keys: {1}".format(op, keys))
+        resp = hdb.combine_active_users(op, [[str(x) for x in k] for k in keys])
+        if resp[0] != 200:
+            log.error("Error while combining users activity by '{0}'".format(op))
+            return False
+        try:
+            r_users = json.loads(resp[1])['active_users']
+        except Exception as e:
+            log.error("Got exception: {0}".format(e))
+            return False
+        if r_users != sorted(expected[op]):
+            log.error("Invalid '{0}' of activity: {1} != {2}".format(op, len(r_users), len(expected[op])))
+            return False
+
+    log.debug("Combined activity is checked and it's OK")
+    return True
+
+
+def check_combine_errors(hdb, keys):
+    log.debug("Combining users activity by unknown operation")
+    resp = hdb.combine_active_users('xor', [[str(x) for x in keys]])
+    if resp[0] != 400:
+        log.error("Unknown operation isn't rejected: {0}".format(resp[0]))
+        return False
+
+    missing = "missing_key_" + hex(random.randint(0, MAX_USER_NO))[2:]
+    resp = hdb.combine_active_users('diff', [[str(x) for x in keys], [missing]])
+    if resp[0] != 200:
+        log.error("Error while combining users activity with key without activity: {0}".format(resp[0]))
+        return False
+    try:
+        r_users = json.loads(resp[1])['active_users']
+    except Exception as e:
+        log.error("Got exception: {0}".format(e))
+        return False
+    expected = set(itertools.chain(*[activity[x] for x in keys]))
+    if r_users != sorted(expected):
+        log.error("Invalid activity combined with key without activity: {0} != {1}".format(len(r_users), len(expected)))
+        return False
+
+    log.debug("Errors of combining are checked and it's OK")
+    return True
+
+
 def test_add_log(host, iterations, debug):
     global logs
     log.info("Run add_log test {0} times".format(iterations))
@@ -156,6 +284,9 @@ def test_add_log(host, iterations, debug):
     if not check_logs(hdb, user, begin_time=begin_time, end_time=end_time):
         result = False
 
+    if not check_paged_logs(hdb, user, 1000, begin_time=begin_time, end_time=end_time):
+        result = False
+
     if result:
         log.info("Add_log test successed")
     else:
@@ -197,6 +328,16 @@ def test_add_activity(host, iterations, debug):
     if not check_activity(hdb, begin_time=begin_time, end_time=end_time):
         result = False
 
+    if not check_paged_activity(hdb, 10, begin_time=begin_time, end_time=end_time):
+        result = False
+
+    days = range(int(begin_time / (24 * 60 * 60)), int(end_time / (24 * 60 * 60)) + 1)
+    if keys and not check_combined_activity(hdb, [list(keys), days]):
+        result = False
+
+    if not check_combine_errors(hdb, days):
+        result = False
+
     if result:
         log.info("Add_activity test successed")
     else:
@@ -259,6 +400,35 @@ def test_add_log_with_activity(host, iterations, debug):
     return result
 
 
+
+def test_stats(host, iterations, debug):
+    log.info("Run test_stats")
+    result = True
+    hdb = historydb(host, debug)
+
+    resp = hdb.stats()
+    if resp[0] != 200:
+        log.error("Error while getting stats: {0}".format(resp[0]))
+        return False
+
+    try:
+        stats = json.loads(resp[1])
+        for name in ["/add_log", "add_log.async", "storage.append"]:
+            entry = stats['handlers'][name] if name.startswith('/') else stats['operations'][name]
+            log.debug("Stats of '{0}': {1}".format(name, entry))
+            if entry['count'] == 0 or entry['latency_us']['p50'] > entry['latency_us']['max']:
+                log.error("Wrong stats of '{0}': {1}".format(name, entry))
+                result = False
+    except Exception as e:
+        log.error("Got exception: {0}".format(e))
+        result = False
+
+    if result:
+        log.info("Stats test successed")
+    else:
+        log.info("Stats test failed")
+    return result
+
 if __name__ == '__main__':
     from optparse import OptionParser
     from misc import start, stop
@@ -279,12 +449,16 @@ if __name__ == '__main__':
                       help="Number of times testing function of HistoryDB will be executed in each test case")
     parser.add_option("-D", "--dir", dest="tmp_dir", default='/var/tmp', metavar="DIR",
                       help="Temporary directory for data and logs [default: %default]")
+    parser.add_option("-m", "--memory", action="store_true", dest="memory", default=False,
+                      help="Uses in-memory storage of historydb instead of elliptics [default: %default]")
+    parser.add_option("-f", "--framed", action="store_true", dest="framed", default=False,
+                      help="Enables framing of appended logs, logs should be returned without headers [default: %default]")
     (options, args) = parser.parse_args()
 
     if options.debug:
         ch.setLevel(logging.DEBUG)
 
-    start(host=socket.gethostname(), tmp_dir=options.tmp_dir)
+    start(host=socket.gethostname(), tmp_dir=options.tmp_dir, memory=options.memory, framed=options.framed)
 
     host = socket.gethostname() + ':8082'
 
@@ -301,6 +475,7 @@ if __name__ == '__main__':
         tests.append(test_add_log)
         tests.append(test_add_activity)
         tests.append(test_add_log_with_activity)
+        tests.append(test_stats)
 
     test_time = datetime.now()
     for t in tests:
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+#include <boost/test/unit_test.hpp>
+
+#include "active_users_cache.h"
+
+using history::active_users_cache;
+using history::user_list;
+
+namespace {
+
+std::shared_ptr<const user_list> make_users(std::vector<std::string> users)
+{
+	return std::make_shared<user_list>(users);
+}
+
+} /* namespace */
+
+BOOST_AUTO_TEST_SUITE(active_users_cache_days)
+
+BOOST_AUTO_TEST_CASE(hit_and_miss)
+{
+	active_users_cache cache(1 << 20);
+
+	BOOST_CHECK(!cache.get("day1"));
+	const auto users = make_users({"b", "a"});
+	cache.insert("day1", users);
+
+	const auto cached = cache.get("day1");
+	BOOST_REQUIRE(cached);
+	BOOST_REQUIRE_EQUAL(cached->size(), 2u);
+	BOOST_CHECK_EQUAL(cached->at(0), "a");
+	BOOST_CHECK_EQUAL(cached->at(1), "b");
+
+	auto stats = cache.stats();
+	BOOST_CHECK_EQUAL(stats.hits, 1u);
+	BOOST_CHECK_EQUAL(stats.misses, 1u);
+	BOOST_CHECK_EQUAL(stats.size, std::string("day1").size() + users->memory());
+
+	cache.remove("day1");
+	BOOST_CHECK(!cache.get("day1"));
+	BOOST_CHECK_EQUAL(cache.stats().size, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(lru_eviction)
+{
+	const auto users = make_users({"a", "b", "c"});
+	const size_t day_size = std::string("day1").size() + users->memory();
+	active_users_cache cache(day_size * 2);
+
+	cache.insert("day1", users);
+	cache.insert("day2", users);
+	BOOST_CHECK(cache.get("day1")); // day2 becomes the least recently used
+	cache.insert("day3", users);
+
+	BOOST_CHECK(cache.get("day1"));
+	BOOST_CHECK(!cache.get("day2"));
+	BOOST_CHECK(cache.get("day3"));
+
+	auto stats = cache.stats();
+	BOOST_CHECK_EQUAL(stats.evictions, 1u);
+	BOOST_CHECK_EQUAL(stats.size, day_size * 2);
+
+	cache.clear();
+	stats = cache.stats();
+	BOOST_CHECK_EQUAL(stats.evictions, 3u);
+	BOOST_CHECK_EQUAL(stats.size, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(too_big_day)
+{
+	const auto users = make_users({"a", "b", "c"});
+	active_users_cache cache(users->memory() - 1);
+
+	cache.insert("day", users);
+	BOOST_CHECK(!cache.get("day"));
+	BOOST_CHECK_EQUAL(cache.stats().size, 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,148 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+
+#include "coalescer.h"
+#include "helpers.h"
+
+using history::coalescer;
+using history::pending_result;
+using history::read_result;
+using history::write_result;
+using ioremap::elliptics::data_pointer;
+
+namespace {
+
+/* Storage with counter of writes which are made by coalescer */
+struct counted_storage
+{
+	counted_storage()
+	: storage(history::test::make_memory_storage())
+	, writes(0)
+	{}
+
+	coalescer::write_t writer() {
+		return [this] (const std::string &key, const data_pointer &data, coalescer::handler_t handler) {
+			++writes;
+			storage->append(key, data, handler);
+		};
+	}
+
+	std::string read(const std::string &key) {
+		pending_result<read_result> res;
+		storage->read_latest(key, 0, 0, res.handler());
+		return res.get().data.to_string();
+	}
+
+	std::shared_ptr<history::memory_storage>	storage;
+	std::atomic<int>							writes; // number of writes which have been made by coalescer
+};
+
+} /* namespace */
+
+BOOST_AUTO_TEST_SUITE(coalescer_appends)
+
+BOOST_AUTO_TEST_CASE(merges_appends)
+{
+	counted_storage s;
+	coalescer c(s.writer(), 60000, 1 << 20);
+
+	std::vector<pending_result<write_result>> results(3);
+	c.append("key", data_pointer::copy(std::string("a")), results[0].handler());
+	c.append("key", data_pointer::copy(std::string("b")), results[1].handler());
+	c.append("other", data_pointer::copy(std::string("c")), results[2].handler());
+	BOOST_CHECK_EQUAL(s.writes, 0);
+
+	c.flush();
+	for (auto it = results.begin(), end = results.end(); it != end; ++it)
+		BOOST_CHECK(!it->get().error);
+
+	BOOST_CHECK_EQUAL(s.writes, 2); // one write per key
+	BOOST_CHECK_EQUAL(s.read("key"), "ab"); // appends keep their order
+	BOOST_CHECK_EQUAL(s.read("other"), "c");
+}
+
+BOOST_AUTO_TEST_CASE(max_bytes)
+{
+	counted_storage s;
+	coalescer c(s.writer(), 60000, 4);
+
+	pending_result<write_result> first, second, third;
+	c.append("key", data_pointer::copy(std::string("ab")), first.handler());
+	BOOST_CHECK_EQUAL(s.writes, 0);
+	c.append("key", data_pointer::copy(std::string("cd")), second.handler()); // reaches max_bytes
+	BOOST_CHECK(!first.get().error);
+	BOOST_CHECK(!second.get().error);
+	BOOST_CHECK_EQUAL(s.writes, 1);
+	BOOST_CHECK_EQUAL(s.read("key"), "abcd");
+
+	c.append("key", data_pointer::copy(std::string("e")), third.handler());
+	BOOST_CHECK_EQUAL(s.writes, 1);
+	c.flush();
+	BOOST_CHECK(!third.get().error);
+	BOOST_CHECK_EQUAL(s.read("key"), "abcde");
+}
+
+BOOST_AUTO_TEST_CASE(window)
+{
+	counted_storage s;
+	coalescer c(s.writer(), 10, 1 << 20);
+
+	pending_result<write_result> res;
+	c.append("key", data_pointer::copy(std::string("abc")), res.handler());
+	BOOST_CHECK(!res.get().error); // the append is written by the flushing thread
+	BOOST_CHECK_EQUAL(s.writes, 1);
+	BOOST_CHECK_EQUAL(s.read("key"), "abc");
+}
+
+BOOST_AUTO_TEST_CASE(destructor_flush)
+{
+	counted_storage s;
+	pending_result<write_result> first, second;
+
+	{
+		coalescer c(s.writer(), 60000, 1 << 20);
+		c.append("key", data_pointer::copy(std::string("a")), first.handler());
+		c.append("key", data_pointer::copy(std::string("b")), second.handler());
+	}
+
+	BOOST_CHECK(!first.get().error);
+	BOOST_CHECK(!second.get().error);
+	BOOST_CHECK_EQUAL(s.writes, 1);
+	BOOST_CHECK_EQUAL(s.read("key"), "ab");
+}
+
+BOOST_AUTO_TEST_CASE(error_is_passed_to_all_handlers)
+{
+	auto s = std::make_shared<history::test::failing_storage>();
+	s->fail("key");
+
+	coalescer c([s] (const std::string &key, const data_pointer &data, coalescer::handler_t handler) {
+		s->append(key, data, handler);
+	}, 60000, 1 << 20);
+
+	std::vector<pending_result<write_result>> results(3);
+	for (auto it = results.begin(), end = results.end(); it != end; ++it)
+		c.append("key", data_pointer::copy(std::string("a")), it->handler());
+	c.flush();
+
+	for (auto it = results.begin(), end = results.end(); it != end; ++it)
+		BOOST_CHECK_EQUAL(it->get().error.code, -EIO);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
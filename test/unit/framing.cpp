@@ -0,0 +1,136 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+#include <boost/test/unit_test.hpp>
+
+#include "historydb/framing.h"
+
+using namespace history::framing;
+using ioremap::elliptics::data_pointer;
+
+namespace {
+
+/* Concatenates records into one log */
+data_pointer concat(const std::vector<data_pointer> &parts)
+{
+	std::string ret;
+	for (auto it = parts.begin(), end = parts.end(); it != end; ++it)
+		ret += it->to_string();
+	return data_pointer::copy(ret);
+}
+
+} /* namespace */
+
+BOOST_AUTO_TEST_SUITE(framing)
+
+BOOST_AUTO_TEST_CASE(pack_and_iterate)
+{
+	const uint64_t day_begin = 1380153600; // 2013-09-26 00:00:00 UTC
+	auto log = concat({
+		pack(day_begin + 10, 0, data_pointer::copy(std::string("first"))),
+		pack(day_begin + 20, ABSOLUTE_TIME, data_pointer::copy(std::string("second"))),
+		pack(day_begin + 30, 0, data_pointer())
+	});
+
+	BOOST_CHECK_EQUAL(*log.data<uint8_t>(), RECORD_MARKER);
+
+	record_iterator it(log);
+	record rec;
+
+	BOOST_REQUIRE(it.next(rec));
+	BOOST_CHECK(rec.framed);
+	BOOST_CHECK_EQUAL(rec.time, 10u); // time is stored as offset from the begin of the day
+	BOOST_CHECK_EQUAL(rec.timestamp(day_begin), day_begin + 10);
+	BOOST_CHECK_EQUAL(rec.data.to_string(), "first");
+
+	BOOST_REQUIRE(it.next(rec));
+	BOOST_CHECK(rec.framed);
+	BOOST_CHECK_EQUAL(rec.flags, ABSOLUTE_TIME);
+	BOOST_CHECK_EQUAL(rec.timestamp(0), day_begin + 20);
+	BOOST_CHECK_EQUAL(rec.data.to_string(), "second");
+
+	BOOST_REQUIRE(it.next(rec));
+	BOOST_CHECK(rec.framed);
+	BOOST_CHECK_EQUAL(rec.data.size(), 0u);
+	BOOST_CHECK_EQUAL(it.offset(), log.size());
+
+	BOOST_CHECK(!it.next(rec));
+}
+
+BOOST_AUTO_TEST_CASE(unpack_payloads)
+{
+	auto log = concat({
+		pack(1, 0, data_pointer::copy(std::string("abc"))),
+		pack(2, 0, data_pointer::copy(std::string(300, 'x'))) // length takes two bytes of varint
+	});
+
+	BOOST_CHECK_EQUAL(unpack(log).to_string(), "abc" + std::string(300, 'x'));
+	BOOST_CHECK_EQUAL(unpack(data_pointer()).size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(record_sizes)
+{
+	auto first = pack(1, 0, data_pointer::copy(std::string("abc")));
+	auto second = pack(2, 0, data_pointer::copy(std::string(300, 'x')));
+	auto log = concat({first, second});
+
+	BOOST_CHECK_EQUAL(record_size(log), first.size());
+	BOOST_CHECK_EQUAL(record_size(log.slice(first.size(), log.size() - first.size())), second.size());
+	BOOST_CHECK_EQUAL(record_size(log.slice(0, 1)), 0u); // header is incomplete
+	BOOST_CHECK_EQUAL(record_size(data_pointer::copy(std::string("legacy"))), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(partial_log)
+{
+	auto first = pack(1, 0, data_pointer::copy(std::string("abc")));
+	auto second = pack(2, 0, data_pointer::copy(std::string("defgh")));
+	auto log = concat({first, second});
+	auto part = log.slice(0, log.size() - 2); // the second record is cut
+
+	size_t consumed = 0;
+	BOOST_CHECK_EQUAL(unpack(part, false, consumed).to_string(), "abc");
+	BOOST_CHECK_EQUAL(consumed, first.size());
+
+	auto rest = log.slice(consumed, log.size() - consumed); // the next part starts at the cut record
+	BOOST_CHECK_EQUAL(unpack(rest, true, consumed).to_string(), "defgh");
+	BOOST_CHECK_EQUAL(consumed, second.size());
+
+	BOOST_CHECK_EQUAL(unpack(second.slice(0, 3), false, consumed).size(), 0u); // the first record isn't complete
+	BOOST_CHECK_EQUAL(consumed, 0u);
+
+	BOOST_CHECK_EQUAL(unpack(part, true, consumed).to_string(), "abc" + part.slice(first.size(), part.size() - first.size()).to_string());
+	BOOST_CHECK_EQUAL(consumed, part.size()); // broken tail of complete log is returned as is
+}
+
+BOOST_AUTO_TEST_CASE(legacy_log)
+{
+	auto log = data_pointer::copy(std::string("legacy text log"));
+
+	size_t consumed = 0;
+	BOOST_CHECK_EQUAL(unpack(log, false, consumed).to_string(), "legacy text log");
+	BOOST_CHECK_EQUAL(consumed, log.size());
+
+	record_iterator it(log);
+	record rec;
+	BOOST_REQUIRE(it.next(rec));
+	BOOST_CHECK(!rec.framed);
+	BOOST_CHECK_EQUAL(rec.data.to_string(), "legacy text log");
+	BOOST_CHECK(!it.next(rec));
+
+	auto mixed = concat({pack(1, 0, data_pointer::copy(std::string("abc"))), log}); // legacy data appended to framed log
+	BOOST_CHECK_EQUAL(unpack(mixed).to_string(), "abclegacy text log");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,157 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#ifndef HISTORY_TEST_UNIT_HELPERS_H
+#define HISTORY_TEST_UNIT_HELPERS_H
+
+#include <errno.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+
+#include "memory_storage.h"
+
+namespace history { namespace test {
+
+/* Makes in-memory storage which completes operations without latency */
+inline std::shared_ptr<memory_storage> make_memory_storage()
+{
+	memory_storage_config config = {0, 0, 0, 2};
+	return std::make_shared<memory_storage>(config);
+}
+
+/* Storage which passes operations to in-memory storage and fails operations with keys of failed prefixes by -EIO.
+	It is used for checking error paths which memory_storage never takes.
+*/
+class failing_storage : public storage
+{
+public:
+	failing_storage()
+	: storage_(make_memory_storage())
+	{}
+
+	void fail(const std::string &prefix) { // operations with keys which start with prefix will fail
+		boost::mutex::scoped_lock lock(mutex_);
+		prefixes_.push_back(prefix);
+	}
+
+	void heal() { // operations won't fail anymore
+		boost::mutex::scoped_lock lock(mutex_);
+		prefixes_.clear();
+	}
+
+	void set_groups(const std::vector<int> &groups) {
+		storage_->set_groups(groups);
+	}
+
+	void append(const std::string &key, const ioremap::elliptics::data_pointer &data, write_handler_t handler) {
+		if (failed(key))
+			handler(write_error(key));
+		else
+			storage_->append(key, data, handler);
+	}
+
+	void write_cas(const std::string &key, converter_t converter, write_handler_t handler) {
+		if (failed(key))
+			handler(write_error(key));
+		else
+			storage_->write_cas(key, converter, handler);
+	}
+
+	void read_latest(const std::string &key, uint64_t offset, uint64_t size, read_handler_t handler) {
+		if (failed(key))
+			handler(read_error(key));
+		else
+			storage_->read_latest(key, offset, size, handler);
+	}
+
+	void bulk_read(const std::vector<std::string> &keys, bulk_read_handler_t handler) {
+		std::vector<read_result> ret(keys.size());
+		for (size_t i = 0; i < keys.size(); ++i) {
+			if (failed(keys[i])) {
+				ret[i] = read_error(keys[i]);
+				continue;
+			}
+			pending_result<read_result> res;
+			storage_->read_latest(keys[i], 0, 0, res.handler());
+			ret[i] = res.get();
+		}
+		handler(ret);
+	}
+
+	void update_indexes(const std::string &key,
+	                    const std::vector<std::string> &indexes,
+	                    const std::vector<ioremap::elliptics::data_pointer> &datas,
+	                    write_handler_t handler) {
+		if (failed(key))
+			handler(write_error(key));
+		else
+			storage_->update_indexes(key, indexes, datas, handler);
+	}
+
+	void remove_indexes(const std::string &key, const std::vector<std::string> &indexes, write_handler_t handler) {
+		if (failed(key))
+			handler(write_error(key));
+		else
+			storage_->remove_indexes(key, indexes, handler);
+	}
+
+	using storage::find_any_indexes;
+
+	void find_any_indexes(const std::vector<std::string> &indexes,
+	                      entry_handler_t on_entry,
+	                      complete_handler_t on_complete) {
+		for (auto it = indexes.begin(), end = indexes.end(); it != end; ++it) {
+			if (failed(*it)) {
+				on_complete(storage_error(-EIO, "index is failed: " + *it));
+				return;
+			}
+		}
+		storage_->find_any_indexes(indexes, on_entry, on_complete);
+	}
+
+private:
+	bool failed(const std::string &key) {
+		boost::mutex::scoped_lock lock(mutex_);
+		for (auto it = prefixes_.begin(), end = prefixes_.end(); it != end; ++it) {
+			if (key.compare(0, it->size(), *it) == 0)
+				return true;
+		}
+		return false;
+	}
+
+	static write_result write_error(const std::string &key) {
+		write_result ret;
+		ret.error = storage_error(-EIO, "write is failed: " + key);
+		return ret;
+	}
+
+	static read_result read_error(const std::string &key) {
+		read_result ret;
+		ret.error = storage_error(-EIO, "read is failed: " + key);
+		return ret;
+	}
+
+	std::shared_ptr<memory_storage>	storage_;
+	std::vector<std::string>		prefixes_; // prefixes of keys of failed operations
+	boost::mutex					mutex_;
+};
+
+}} /* namespace history::test */
+
+#endif //HISTORY_TEST_UNIT_HELPERS_H
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+
+#include <boost/lexical_cast.hpp>
+
+#include "hyperloglog.h"
+
+using history::hyperloglog;
+
+namespace {
+
+/* Checks that estimate is within 5% of actual cardinality */
+void check_estimate(const hyperloglog &sketch, uint64_t actual)
+{
+	const double error = std::abs(static_cast<double>(sketch.estimate()) - actual) / actual;
+	BOOST_CHECK_MESSAGE(error < 0.05, "estimate: " << sketch.estimate() << " actual: " << actual);
+}
+
+} /* namespace */
+
+BOOST_AUTO_TEST_SUITE(hyperloglog_sketch)
+
+BOOST_AUTO_TEST_CASE(estimate)
+{
+	hyperloglog sketch;
+	BOOST_CHECK_EQUAL(sketch.estimate(), 0u);
+
+	BOOST_CHECK(sketch.add("user"));
+	BOOST_CHECK(!sketch.add("user"));
+	BOOST_CHECK_EQUAL(sketch.estimate(), 1u);
+
+	for (size_t i = 0; i < 100000; ++i)
+		sketch.add("user" + boost::lexical_cast<std::string>(i));
+	check_estimate(sketch, 100001);
+}
+
+BOOST_AUTO_TEST_CASE(merge)
+{
+	hyperloglog lhs, rhs;
+	for (size_t i = 0; i < 20000; ++i) {
+		lhs.add("user" + boost::lexical_cast<std::string>(i));
+		rhs.add("user" + boost::lexical_cast<std::string>(i + 10000));
+	}
+
+	BOOST_CHECK(lhs.merge(rhs));
+	BOOST_CHECK(!lhs.merge(rhs));
+	check_estimate(lhs, 30000);
+}
+
+BOOST_AUTO_TEST_CASE(save_and_load)
+{
+	hyperloglog sketch;
+	for (size_t i = 0; i < 5000; ++i)
+		sketch.add("user" + boost::lexical_cast<std::string>(i));
+
+	hyperloglog loaded;
+	BOOST_REQUIRE(loaded.load(sketch.save()));
+	BOOST_CHECK_EQUAL(loaded.estimate(), sketch.estimate());
+
+	hyperloglog other;
+	for (size_t i = 5000; i < 10000; ++i)
+		other.add("user" + boost::lexical_cast<std::string>(i));
+	BOOST_REQUIRE(loaded.load(other.save())); // load merges the sketch
+	check_estimate(loaded, 10000);
+}
+
+BOOST_AUTO_TEST_CASE(invalid_load)
+{
+	hyperloglog sketch;
+	BOOST_CHECK(!sketch.load(ioremap::elliptics::data_pointer()));
+	BOOST_CHECK(!sketch.load(ioremap::elliptics::data_pointer::copy(std::string("garbage"))));
+
+	std::string saved = hyperloglog().save().to_string();
+	saved[0] = hyperloglog::PRECISION + 1; // sketch of other precision can't be merged
+	BOOST_CHECK(!sketch.load(ioremap::elliptics::data_pointer::copy(saved)));
+	BOOST_CHECK_EQUAL(sketch.estimate(), 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+#include <boost/test/unit_test.hpp>
+
+#include <boost/lexical_cast.hpp>
+
+#include "log_cache.h"
+
+using history::log_cache;
+using ioremap::elliptics::data_pointer;
+
+BOOST_AUTO_TEST_SUITE(log_cache_entries)
+
+BOOST_AUTO_TEST_CASE(hit_and_miss)
+{
+	log_cache cache(1 << 20);
+	data_pointer data;
+
+	BOOST_CHECK(!cache.get("key", data));
+	cache.insert("key", data_pointer::copy(std::string("log")));
+	BOOST_REQUIRE(cache.get("key", data));
+	BOOST_CHECK_EQUAL(data.to_string(), "log");
+
+	cache.insert("key", data_pointer::copy(std::string("new log"))); // replaces the log
+	BOOST_REQUIRE(cache.get("key", data));
+	BOOST_CHECK_EQUAL(data.to_string(), "new log");
+
+	cache.remove("key");
+	BOOST_CHECK(!cache.get("key", data));
+
+	auto stats = cache.stats();
+	BOOST_CHECK_EQUAL(stats.hits, 2u);
+	BOOST_CHECK_EQUAL(stats.misses, 2u);
+	BOOST_CHECK_EQUAL(stats.evictions, 0u);
+	BOOST_CHECK_EQUAL(stats.size, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(eviction)
+{
+	const size_t max_size = 64 * 1024;
+	log_cache cache(max_size);
+	const auto log = data_pointer::copy(std::string(1024, 'x'));
+
+	for (size_t i = 0; i < 1000; ++i)
+		cache.insert("key" + boost::lexical_cast<std::string>(i), log);
+
+	auto stats = cache.stats();
+	BOOST_CHECK_GT(stats.evictions, 0u);
+	BOOST_CHECK_GT(stats.size, 0u);
+	BOOST_CHECK_LE(stats.size, max_size);
+
+	data_pointer data;
+	BOOST_CHECK(cache.get("key999", data)); // the most recent log is kept
+	BOOST_CHECK(!cache.get("key0", data)); // the oldest log is evicted
+
+	cache.insert("big", data_pointer::copy(std::string(max_size, 'x'))); // bigger than a shard - isn't cached
+	BOOST_CHECK(!cache.get("big", data));
+
+	cache.clear();
+	stats = cache.stats();
+	BOOST_CHECK_EQUAL(stats.size, 0u);
+	BOOST_CHECK(!cache.get("key999", data));
+}
+
+BOOST_AUTO_TEST_CASE(generation)
+{
+	log_cache cache(1 << 20);
+	data_pointer data;
+
+	auto generation = cache.generation("key"); // the log is being read
+	cache.remove("key"); // the log is appended while it is read
+	cache.insert("key", data_pointer::copy(std::string("stale log")), generation);
+	BOOST_CHECK(!cache.get("key", data));
+
+	generation = cache.generation("key");
+	cache.insert("key", data_pointer::copy(std::string("log")), generation);
+	BOOST_REQUIRE(cache.get("key", data));
+	BOOST_CHECK_EQUAL(data.to_string(), "log");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
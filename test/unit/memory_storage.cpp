@@ -0,0 +1,126 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+#include <boost/test/unit_test.hpp>
+
+#include "helpers.h"
+
+using history::find_result;
+using history::pending_result;
+using history::read_result;
+using history::write_result;
+using ioremap::elliptics::data_pointer;
+
+namespace {
+
+read_result read(history::storage &s, const std::string &key, uint64_t offset = 0, uint64_t size = 0)
+{
+	pending_result<read_result> res;
+	s.read_latest(key, offset, size, res.handler());
+	return res.get();
+}
+
+write_result append(history::storage &s, const std::string &key, const std::string &data)
+{
+	pending_result<write_result> res;
+	s.append(key, data_pointer::copy(data), res.handler());
+	return res.get();
+}
+
+} /* namespace */
+
+BOOST_AUTO_TEST_SUITE(memory_storage_objects)
+
+BOOST_AUTO_TEST_CASE(append_and_read)
+{
+	auto s = history::test::make_memory_storage();
+
+	BOOST_CHECK_EQUAL(read(*s, "key").error.code, -ENOENT);
+
+	auto written = append(*s, "key", "abc");
+	BOOST_CHECK(!written.error);
+	BOOST_CHECK_GT(written.written, 0u);
+	BOOST_CHECK_EQUAL(written.size, 3u);
+	BOOST_CHECK_EQUAL(append(*s, "key", "def").size, 6u);
+
+	auto res = read(*s, "key");
+	BOOST_REQUIRE(!res.error);
+	BOOST_CHECK_EQUAL(res.data.to_string(), "abcdef");
+	BOOST_CHECK_EQUAL(res.total_size, 6u);
+
+	BOOST_CHECK_EQUAL(read(*s, "key", 2, 3).data.to_string(), "cde");
+	BOOST_CHECK_EQUAL(read(*s, "key", 4, 100).data.to_string(), "ef");
+	BOOST_CHECK_EQUAL(read(*s, "key", 6).data.size(), 0u);
+	BOOST_CHECK_EQUAL(read(*s, "key", 7).error.code, -E2BIG);
+}
+
+BOOST_AUTO_TEST_CASE(write_cas)
+{
+	auto s = history::test::make_memory_storage();
+
+	for (int i = 0; i < 3; ++i) {
+		pending_result<write_result> res;
+		s->write_cas("counter", [] (const data_pointer &stored) {
+			return data_pointer::copy(stored.to_string() + "x");
+		}, res.handler());
+		BOOST_CHECK(!res.get().error);
+	}
+
+	BOOST_CHECK_EQUAL(read(*s, "counter").data.to_string(), "xxx");
+}
+
+BOOST_AUTO_TEST_CASE(bulk_read)
+{
+	auto s = history::test::make_memory_storage();
+	append(*s, "first", "1");
+	append(*s, "second", "2");
+
+	pending_result<std::vector<read_result>> res;
+	s->bulk_read({"first", "missing", "second"}, res.handler());
+
+	const auto &results = res.get();
+	BOOST_REQUIRE_EQUAL(results.size(), 3u);
+	BOOST_CHECK_EQUAL(results[0].data.to_string(), "1");
+	BOOST_CHECK_EQUAL(results[1].error.code, -ENOENT);
+	BOOST_CHECK_EQUAL(results[2].data.to_string(), "2");
+}
+
+BOOST_AUTO_TEST_CASE(indexes)
+{
+	auto s = history::test::make_memory_storage();
+
+	pending_result<write_result> updated, removed;
+	s->update_indexes("user", {"day1", "day2"}, {data_pointer::copy(std::string("a")), data_pointer::copy(std::string("b"))},
+	                  updated.handler());
+	BOOST_CHECK(!updated.get().error);
+
+	pending_result<find_result> found;
+	s->find_any_indexes({"day1", "day2", "day3"}, found.handler());
+	BOOST_CHECK(!found.get().error);
+	BOOST_REQUIRE_EQUAL(found.get().entries.size(), 1u);
+	BOOST_REQUIRE_EQUAL(found.get().entries[0].indexes.size(), 2u);
+	BOOST_CHECK_EQUAL(found.get().entries[0].indexes[0].name, "day1");
+	BOOST_CHECK_EQUAL(found.get().entries[0].indexes[0].data.to_string(), "a");
+
+	s->remove_indexes("user", {"day1", "day2"}, removed.handler());
+	BOOST_CHECK(!removed.get().error);
+
+	pending_result<find_result> missing;
+	s->find_any_indexes({"day1"}, missing.handler());
+	BOOST_CHECK_EQUAL(missing.get().error.code, -ENOENT);
+	BOOST_CHECK(missing.get().entries.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,194 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <set>
+#include <stdexcept>
+
+#include <boost/lexical_cast.hpp>
+
+#include "historydb/provider.h"
+
+using history::provider;
+using ioremap::elliptics::data_pointer;
+
+namespace {
+
+const uint64_t DAY_BEGIN = 1380153600; // 2013-09-26 00:00:00 UTC
+
+/* Provider on in-memory storage which completes operations without latency */
+struct memory_provider
+{
+	memory_provider()
+	: config({0, 0, 0, 2})
+	, p(config, "/dev/null", 0)
+	{}
+
+	history::memory_storage_config	config;
+	provider						p;
+};
+
+std::string concat(const std::vector<data_pointer> &logs)
+{
+	std::string ret;
+	for (auto it = logs.begin(), end = logs.end(); it != end; ++it)
+		ret += it->to_string();
+	return ret;
+}
+
+} /* namespace */
+
+BOOST_AUTO_TEST_SUITE(provider_memory)
+
+BOOST_AUTO_TEST_CASE(logs_round_trip)
+{
+	memory_provider m;
+
+	m.p.add_log("user", "k1", data_pointer::copy(std::string("abc")));
+	m.p.add_log("user", "k1", data_pointer::copy(std::string("def")));
+	m.p.add_log("user", "k2", data_pointer::copy(std::string("ghi")));
+	m.p.add_log("user", DAY_BEGIN + 10, data_pointer::copy(std::string("jkl")));
+
+	const auto logs = m.p.get_user_logs("user", std::vector<std::string>({"k1", "missing", "k2"}));
+	BOOST_REQUIRE_EQUAL(logs.size(), 2u); // missing logs are skipped
+	BOOST_CHECK_EQUAL(logs[0].to_string(), "abcdef");
+	BOOST_CHECK_EQUAL(logs[1].to_string(), "ghi");
+
+	BOOST_CHECK_EQUAL(concat(m.p.get_user_logs("user", DAY_BEGIN, DAY_BEGIN + 100)), "jkl");
+	BOOST_CHECK(m.p.get_user_logs("other", DAY_BEGIN, DAY_BEGIN + 100).empty());
+}
+
+BOOST_AUTO_TEST_CASE(paged_logs)
+{
+	memory_provider m;
+	m.p.set_framed_logs(true);
+
+	std::string expected;
+	for (int i = 0; i < 50; ++i) {
+		const std::string record = "record" + boost::lexical_cast<std::string>(i) + ";";
+		m.p.add_log("user", i % 2 ? "k2" : "k1", data_pointer::copy(record));
+	}
+	const std::vector<std::string> subkeys({"k1", "k2"});
+	expected = concat(m.p.get_user_logs("user", subkeys));
+
+	std::string cursor, read;
+	size_t pages = 0;
+	do {
+		const auto page = m.p.get_user_logs("user", subkeys, 64, cursor);
+		BOOST_CHECK_LE(concat(page.logs).size(), 64u);
+		read += concat(page.logs);
+		cursor = page.next_cursor;
+		BOOST_REQUIRE(++pages < 100);
+	} while (!cursor.empty());
+
+	BOOST_CHECK_GT(pages, 2u);
+	BOOST_CHECK_EQUAL(read, expected); // records aren't lost or repeated between pages
+
+	const auto whole = m.p.get_user_logs("user", subkeys, 0, std::string());
+	BOOST_CHECK(whole.next_cursor.empty());
+	BOOST_CHECK_EQUAL(concat(whole.logs), expected);
+}
+
+BOOST_AUTO_TEST_CASE(invalid_cursors)
+{
+	memory_provider m;
+	const std::vector<std::string> subkeys({"k1"});
+
+	BOOST_CHECK_THROW(m.p.get_user_logs("user", subkeys, 64, "garbage"), std::invalid_argument);
+	BOOST_CHECK_THROW(m.p.get_user_logs("user", subkeys, 64, "1:x"), std::invalid_argument);
+	BOOST_CHECK_THROW(m.p.get_active_users(subkeys, 10, "garbage"), std::invalid_argument);
+	BOOST_CHECK_THROW(m.p.get_active_users(subkeys, 10, "0:1000:user"), std::invalid_argument); // chunks have been changed
+}
+
+BOOST_AUTO_TEST_CASE(paged_active_users)
+{
+	memory_provider m;
+
+	std::set<std::string> expected;
+	for (int i = 0; i < 25; ++i) {
+		const std::string user = "user:" + boost::lexical_cast<std::string>(i); // names could contain delimiter of cursor
+		m.p.add_activity(user, "day");
+		expected.insert(user);
+	}
+
+	const std::vector<std::string> subkeys({"day"});
+	std::set<std::string> read;
+	std::string cursor;
+	size_t pages = 0;
+	do {
+		const auto page = m.p.get_active_users(subkeys, 4, cursor);
+		BOOST_CHECK_LE(page.users.size(), 4u);
+		for (auto it = page.users.begin(), end = page.users.end(); it != end; ++it)
+			BOOST_CHECK(read.insert(*it).second); // users aren't repeated between pages
+		cursor = page.next_cursor;
+		BOOST_REQUIRE(++pages < 100);
+	} while (!cursor.empty());
+
+	BOOST_CHECK(read == expected);
+	BOOST_CHECK(m.p.get_active_users(subkeys) == expected);
+}
+
+BOOST_AUTO_TEST_CASE(records_with_offset_index)
+{
+	memory_provider m;
+	m.p.set_framed_logs(true);
+	m.p.set_offset_index_parameters(32);
+
+	for (uint64_t i = 0; i < 100; ++i)
+		m.p.add_log("user", DAY_BEGIN + i * 60, data_pointer::copy("record" + boost::lexical_cast<std::string>(i)));
+
+	for (int pass = 0; pass < 2; ++pass) { // the first pass builds the index, the second one reads with it
+		const auto records = m.p.get_user_records("user", DAY_BEGIN + 50 * 60, DAY_BEGIN + 59 * 60);
+		BOOST_REQUIRE_EQUAL(records.size(), 10u);
+		for (size_t i = 0; i < records.size(); ++i) {
+			BOOST_CHECK(records[i].framed);
+			BOOST_CHECK_EQUAL(records[i].timestamp(DAY_BEGIN), DAY_BEGIN + (50 + i) * 60);
+			BOOST_CHECK_EQUAL(records[i].data.to_string(), "record" + boost::lexical_cast<std::string>(50 + i));
+		}
+	}
+
+	for (uint64_t i = 100; i < 150; ++i) // extends the indexed log
+		m.p.add_log("user", DAY_BEGIN + i * 60, data_pointer::copy("record" + boost::lexical_cast<std::string>(i)));
+
+	const auto records = m.p.get_user_records("user", DAY_BEGIN + 120 * 60, DAY_BEGIN + 200 * 60);
+	BOOST_REQUIRE_EQUAL(records.size(), 30u);
+	BOOST_CHECK_EQUAL(records.front().data.to_string(), "record120");
+	BOOST_CHECK_EQUAL(records.back().data.to_string(), "record149");
+
+	BOOST_CHECK_EQUAL(m.p.get_user_records("user", std::vector<std::string>()).size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(shutdown_flush)
+{
+	std::atomic<int> added(0);
+
+	{
+		memory_provider m;
+		m.p.set_coalescing_parameters(60000, 1 << 20);
+		for (int i = 0; i < 10; ++i) {
+			m.p.add_log("user", "k", data_pointer::copy(std::string("abc")), [&added] (bool ok) {
+				if (ok)
+					++added;
+			});
+		}
+		BOOST_CHECK_EQUAL(added, 0); // appends are buffered for the window
+	}
+
+	BOOST_CHECK_EQUAL(added, 10); // destruction of the provider writes buffered appends
+}
+
+BOOST_AUTO_TEST_SUITE_END()
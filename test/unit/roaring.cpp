@@ -0,0 +1,146 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+#include <boost/test/unit_test.hpp>
+
+#include "roaring.h"
+
+using history::roaring_bitmap;
+
+BOOST_AUTO_TEST_SUITE(roaring)
+
+BOOST_AUTO_TEST_CASE(add_and_contains)
+{
+	roaring_bitmap b;
+	BOOST_CHECK(b.empty());
+	BOOST_CHECK(b.add(1));
+	BOOST_CHECK(b.add(70000)); // the other container
+	BOOST_CHECK(!b.add(1));
+	BOOST_CHECK(b.contains(1));
+	BOOST_CHECK(b.contains(70000));
+	BOOST_CHECK(!b.contains(2));
+	BOOST_CHECK_EQUAL(b.cardinality(), 2u);
+
+	std::vector<uint32_t> ids;
+	b.for_each([&ids] (uint32_t id) { ids.push_back(id); });
+	BOOST_REQUIRE_EQUAL(ids.size(), 2u);
+	BOOST_CHECK_EQUAL(ids[0], 1u);
+	BOOST_CHECK_EQUAL(ids[1], 70000u);
+}
+
+BOOST_AUTO_TEST_CASE(dense_container)
+{
+	roaring_bitmap b;
+	const uint32_t count = roaring_bitmap::ARRAY_MAX_SIZE * 2;
+	for (uint32_t i = 0; i < count; ++i)
+		b.add(i * 3);
+	BOOST_CHECK_EQUAL(b.cardinality(), count);
+	BOOST_CHECK(b.contains(3 * 100));
+	BOOST_CHECK(!b.contains(3 * 100 + 1));
+
+	uint32_t previous = 0, seen = 0;
+	b.for_each([&previous, &seen] (uint32_t id) {
+		BOOST_CHECK(seen == 0 || id > previous);
+		previous = id;
+		++seen;
+	});
+	BOOST_CHECK_EQUAL(seen, count);
+
+	roaring_bitmap loaded;
+	BOOST_REQUIRE(loaded.load(b.save()));
+	BOOST_CHECK_EQUAL(loaded.cardinality(), count);
+	BOOST_CHECK(loaded.contains(3 * (count - 1)));
+}
+
+BOOST_AUTO_TEST_CASE(dense_to_sparse)
+{
+	roaring_bitmap b, removed;
+	for (uint32_t i = 0; i < roaring_bitmap::ARRAY_MAX_SIZE + 100; ++i) {
+		b.add(i);
+		if (i >= 10)
+			removed.add(i);
+	}
+	b.subtract(removed); // dense container becomes small and is converted back to array
+	BOOST_CHECK_EQUAL(b.cardinality(), 10u);
+	BOOST_CHECK(b.contains(9));
+	BOOST_CHECK(!b.contains(10));
+
+	roaring_bitmap loaded;
+	BOOST_REQUIRE(loaded.load(b.save()));
+	BOOST_CHECK_EQUAL(loaded.cardinality(), 10u);
+}
+
+BOOST_AUTO_TEST_CASE(set_operations)
+{
+	roaring_bitmap lhs, rhs;
+	for (uint32_t i = 0; i < 10000; ++i) {
+		lhs.add(i);
+		rhs.add(i + 5000);
+	}
+	rhs.add(1 << 20);
+
+	roaring_bitmap united = lhs;
+	BOOST_CHECK(united.merge(rhs));
+	BOOST_CHECK(!united.merge(rhs));
+	BOOST_CHECK_EQUAL(united.cardinality(), 15001u);
+
+	roaring_bitmap intersected = lhs;
+	intersected.intersect(rhs);
+	BOOST_CHECK_EQUAL(intersected.cardinality(), 5000u);
+	BOOST_CHECK(intersected.contains(5000));
+	BOOST_CHECK(!intersected.contains(4999));
+	BOOST_CHECK(!intersected.contains(1 << 20));
+
+	roaring_bitmap subtracted = lhs;
+	subtracted.subtract(rhs);
+	BOOST_CHECK_EQUAL(subtracted.cardinality(), 5000u);
+	BOOST_CHECK(subtracted.contains(4999));
+	BOOST_CHECK(!subtracted.contains(5000));
+
+	roaring_bitmap empty;
+	intersected.intersect(empty);
+	BOOST_CHECK(intersected.empty());
+}
+
+BOOST_AUTO_TEST_CASE(load_unites)
+{
+	roaring_bitmap lhs, rhs;
+	lhs.add(1);
+	rhs.add(2);
+	BOOST_REQUIRE(lhs.load(rhs.save()));
+	BOOST_CHECK(lhs.contains(1));
+	BOOST_CHECK(lhs.contains(2));
+	BOOST_CHECK_EQUAL(lhs.cardinality(), 2u);
+}
+
+BOOST_AUTO_TEST_CASE(invalid_load)
+{
+	roaring_bitmap b;
+	b.add(1);
+	b.add(100000);
+	const std::string saved = b.save().to_string();
+
+	roaring_bitmap truncated;
+	BOOST_CHECK(!truncated.load(ioremap::elliptics::data_pointer::copy(saved.substr(0, saved.size() - 1))));
+
+	roaring_bitmap empty;
+	BOOST_CHECK(!empty.load(ioremap::elliptics::data_pointer()));
+
+	roaring_bitmap garbage;
+	BOOST_CHECK(!garbage.load(ioremap::elliptics::data_pointer::copy(std::string("garbage"))));
+	BOOST_CHECK(garbage.empty()); // invalid data doesn't change the bitmap
+}
+
+BOOST_AUTO_TEST_SUITE_END()
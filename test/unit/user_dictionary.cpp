@@ -0,0 +1,157 @@
+/*
+ * Copyright 2013+ Kirill Smorodinnikov <shaitkir@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+#include <boost/test/unit_test.hpp>
+
+#include "helpers.h"
+#include "user_dictionary.h"
+
+using history::pending_result;
+using history::roaring_bitmap;
+using history::user_dictionary;
+using history::user_list;
+using history::test::failing_storage;
+
+namespace {
+
+std::pair<bool, uint32_t> get_id(user_dictionary &dictionary, const std::string &user)
+{
+	pending_result<std::pair<bool, uint32_t>> res;
+	auto handler = res.handler();
+	dictionary.get_id(user, [handler] (bool found, uint32_t id) {
+		handler(std::make_pair(found, id));
+	});
+	return res.get();
+}
+
+std::pair<std::vector<std::string>, bool> get_names(user_dictionary &dictionary, const roaring_bitmap &ids)
+{
+	pending_result<std::pair<std::vector<std::string>, bool>> res;
+	auto handler = res.handler();
+	dictionary.get_names(ids, [handler] (const user_list &users, bool completed) {
+		std::vector<std::string> names;
+		for (size_t i = 0; i < users.size(); ++i)
+			names.push_back(users.at(i));
+		handler(std::make_pair(names, completed));
+	});
+	return res.get();
+}
+
+} /* namespace */
+
+BOOST_AUTO_TEST_SUITE(user_dictionary_ids)
+
+BOOST_AUTO_TEST_CASE(allocation)
+{
+	auto s = std::make_shared<failing_storage>();
+	auto dictionary = std::make_shared<user_dictionary>(s, 1000);
+
+	const auto a = get_id(*dictionary, "a");
+	const auto b = get_id(*dictionary, "b");
+	BOOST_REQUIRE(a.first);
+	BOOST_REQUIRE(b.first);
+	BOOST_CHECK_NE(a.second, b.second);
+	BOOST_CHECK_EQUAL(get_id(*dictionary, "a").second, a.second);
+
+	auto other = std::make_shared<user_dictionary>(s, 1000); // another provider with the same storage
+	BOOST_CHECK_EQUAL(get_id(*other, "a").second, a.second);
+
+	const auto c = get_id(*other, "c"); // is allocated from the next range
+	BOOST_REQUIRE(c.first);
+	BOOST_CHECK_NE(c.second, a.second);
+	BOOST_CHECK_NE(c.second, b.second);
+}
+
+BOOST_AUTO_TEST_CASE(names)
+{
+	auto s = std::make_shared<failing_storage>();
+	auto dictionary = std::make_shared<user_dictionary>(s, 1000);
+
+	roaring_bitmap ids;
+	ids.add(get_id(*dictionary, "carol").second);
+	ids.add(get_id(*dictionary, "alice").second);
+	get_id(*dictionary, "bob"); // isn't requested
+
+	auto names = get_names(*dictionary, ids);
+	BOOST_CHECK(names.second);
+	BOOST_REQUIRE_EQUAL(names.first.size(), 2u);
+	BOOST_CHECK_EQUAL(names.first[0], "alice");
+	BOOST_CHECK_EQUAL(names.first[1], "carol");
+
+	names = get_names(*dictionary, roaring_bitmap());
+	BOOST_CHECK(names.second);
+	BOOST_CHECK(names.first.empty());
+
+	roaring_bitmap unknown;
+	unknown.add(1 << 20); // block of names doesn't exist
+	names = get_names(*dictionary, unknown);
+	BOOST_CHECK(names.second);
+	BOOST_CHECK(names.first.empty());
+}
+
+BOOST_AUTO_TEST_CASE(cache)
+{
+	auto s = std::make_shared<failing_storage>();
+	auto dictionary = std::make_shared<user_dictionary>(s, 1);
+
+	const auto a = get_id(*dictionary, "a");
+	const auto b = get_id(*dictionary, "b"); // evicts id of a
+	BOOST_REQUIRE(a.first);
+	BOOST_REQUIRE(b.first);
+
+	s->fail("historydb.user_id.");
+	BOOST_CHECK_EQUAL(get_id(*dictionary, "b").second, b.second); // is taken from the cache
+	BOOST_CHECK(!get_id(*dictionary, "a").first);
+}
+
+BOOST_AUTO_TEST_CASE(read_errors)
+{
+	auto s = std::make_shared<failing_storage>();
+	auto dictionary = std::make_shared<user_dictionary>(s, 1000);
+
+	roaring_bitmap ids;
+	ids.add(get_id(*dictionary, "a").second);
+
+	s->fail("historydb.user_id.");
+	BOOST_CHECK(!get_id(*dictionary, "b").first); // b could have id which hasn't been read
+
+	s->fail("historydb.user_names.");
+	const auto names = get_names(*dictionary, ids);
+	BOOST_CHECK(!names.second);
+	BOOST_CHECK(names.first.empty());
+
+	s->heal();
+	const auto b = get_id(*dictionary, "b");
+	BOOST_REQUIRE(b.first);
+	BOOST_CHECK_EQUAL(b.second, ids.cardinality()); // failed read hasn't allocated id
+}
+
+BOOST_AUTO_TEST_CASE(write_errors)
+{
+	auto s = std::make_shared<failing_storage>();
+	auto dictionary = std::make_shared<user_dictionary>(s, 1000);
+
+	s->fail("historydb.user_id");
+	BOOST_CHECK(!get_id(*dictionary, "a").first); // range isn't allocated
+
+	s->heal();
+	s->fail("historydb.user_names.");
+	BOOST_CHECK(!get_id(*dictionary, "a").first); // name isn't written, so id isn't used
+
+	s->heal();
+	BOOST_CHECK(get_id(*dictionary, "a").first);
+}
+
+BOOST_AUTO_TEST_SUITE_END()